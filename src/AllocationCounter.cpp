@@ -0,0 +1,158 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "AllocationCounter.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace FredEmmott::ControllerTester {
+
+namespace {
+std::atomic<uint64_t> gAllocationCount {};
+std::atomic<uint64_t> gAllocationBytes {};
+
+void* CountedAllocate(std::size_t size, std::align_val_t alignment) noexcept {
+  gAllocationCount.fetch_add(1, std::memory_order_relaxed);
+  gAllocationBytes.fetch_add(size, std::memory_order_relaxed);
+
+  if (size == 0) {
+    size = 1;
+  }
+  const auto align = static_cast<std::size_t>(alignment);
+  if (align <= __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+    return std::malloc(size);
+  }
+#ifdef _MSC_VER
+  return _aligned_malloc(size, align);
+#else
+  // std::aligned_alloc() requires the size to be a multiple of the alignment
+  return std::aligned_alloc(align, ((size + align - 1) / align) * align);
+#endif
+}
+
+void CountedFree(
+  void* p,
+  [[maybe_unused]] std::align_val_t alignment) noexcept {
+  if (!p) {
+    return;
+  }
+#ifdef _MSC_VER
+  if (
+    static_cast<std::size_t>(alignment) > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+    _aligned_free(p);
+    return;
+  }
+#endif
+  std::free(p);
+}
+
+void* CountedAllocateOrThrow(std::size_t size, std::align_val_t alignment) {
+  auto ret = CountedAllocate(size, alignment);
+  if (!ret) {
+    throw std::bad_alloc();
+  }
+  return ret;
+}
+
+constexpr auto DEFAULT_ALIGNMENT
+  = std::align_val_t {__STDCPP_DEFAULT_NEW_ALIGNMENT__};
+
+}// namespace
+
+AllocationStats operator-(
+  const AllocationStats& a,
+  const AllocationStats& b) {
+  return {
+    .mCount = a.mCount - b.mCount,
+    .mBytes = a.mBytes - b.mBytes,
+  };
+}
+
+AllocationStats GetAllocationStats() {
+  return {
+    .mCount = gAllocationCount.load(std::memory_order_relaxed),
+    .mBytes = gAllocationBytes.load(std::memory_order_relaxed),
+  };
+}
+
+}// namespace FredEmmott::ControllerTester
+
+using namespace FredEmmott::ControllerTester;
+
+void* operator new(std::size_t size) {
+  return CountedAllocateOrThrow(size, DEFAULT_ALIGNMENT);
+}
+
+void* operator new[](std::size_t size) {
+  return CountedAllocateOrThrow(size, DEFAULT_ALIGNMENT);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+  return CountedAllocateOrThrow(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+  return CountedAllocateOrThrow(size, alignment);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  return CountedAllocate(size, DEFAULT_ALIGNMENT);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  return CountedAllocate(size, DEFAULT_ALIGNMENT);
+}
+
+void* operator new(
+  std::size_t size,
+  std::align_val_t alignment,
+  const std::nothrow_t&) noexcept {
+  return CountedAllocate(size, alignment);
+}
+
+void* operator new[](
+  std::size_t size,
+  std::align_val_t alignment,
+  const std::nothrow_t&) noexcept {
+  return CountedAllocate(size, alignment);
+}
+
+void operator delete(void* p) noexcept {
+  CountedFree(p, DEFAULT_ALIGNMENT);
+}
+
+void operator delete[](void* p) noexcept {
+  CountedFree(p, DEFAULT_ALIGNMENT);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+  CountedFree(p, DEFAULT_ALIGNMENT);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+  CountedFree(p, DEFAULT_ALIGNMENT);
+}
+
+void operator delete(void* p, std::align_val_t alignment) noexcept {
+  CountedFree(p, alignment);
+}
+
+void operator delete[](void* p, std::align_val_t alignment) noexcept {
+  CountedFree(p, alignment);
+}
+
+void operator delete(
+  void* p,
+  std::size_t,
+  std::align_val_t alignment) noexcept {
+  CountedFree(p, alignment);
+}
+
+void operator delete[](
+  void* p,
+  std::size_t,
+  std::align_val_t alignment) noexcept {
+  CountedFree(p, alignment);
+}
@@ -0,0 +1,23 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <cstdint>
+
+namespace FredEmmott::ControllerTester {
+
+struct AllocationStats final {
+  uint64_t mCount {};
+  uint64_t mBytes {};
+};
+
+AllocationStats operator-(const AllocationStats&, const AllocationStats&);
+
+/* Totals for every call to the global `operator new` since the process
+ * started.
+ *
+ * Diff two snapshots to get the cost of a frame or an operation.
+ */
+AllocationStats GetAllocationStats();
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,243 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "AnomalyDetector.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace FredEmmott::ControllerTester {
+
+namespace {
+
+static_assert((AnomalyDetector::LOG_CAPACITY
+               & (AnomalyDetector::LOG_CAPACITY - 1))
+              == 0);
+constexpr std::size_t WORDS_PER_ENTRY {2};
+
+// The type, axis, and value
+constexpr uint64_t PackDetails(const Anomaly& anomaly) {
+  return static_cast<uint64_t>(anomaly.mType)
+    | (static_cast<uint64_t>(anomaly.mAxis & 0xffffff) << 8)
+    | (static_cast<uint64_t>(static_cast<uint32_t>(anomaly.mValue)) << 32);
+}
+
+constexpr void UnpackDetails(uint64_t word, Anomaly& anomaly) {
+  anomaly.mType = static_cast<AnomalyType>(word & 0xff);
+  anomaly.mAxis = static_cast<uint32_t>((word >> 8) & 0xffffff);
+  anomaly.mValue = static_cast<int32_t>(static_cast<uint32_t>(word >> 32));
+}
+
+}// namespace
+
+const char* GetAnomalyTypeName(AnomalyType type) {
+  switch (type) {
+    case AnomalyType::Spike:
+      return "Spike";
+    case AnomalyType::Dropout:
+      return "Dropout";
+    case AnomalyType::Frozen:
+      return "Frozen";
+    case AnomalyType::ReadFailure:
+      return "Read failure";
+  }
+  return "Unknown";
+}
+
+AnomalyDetector::AnomalyDetector(
+  const DeviceInfo& device,
+  const AnomalyThresholds& thresholds)
+  : mFrozenAfter(thresholds.mFrozenAfter),
+    mLog(std::make_unique<std::atomic<uint64_t>[]>(
+      LOG_CAPACITY * WORDS_PER_ENTRY)) {
+  mAxes.reserve(device.mAxes.size());
+  for (const auto& axis: device.mAxes) {
+    const auto range = static_cast<double>(axis.mMax) - axis.mMin;
+    const auto jump = std::llround(range * thresholds.mJumpFraction);
+    mAxes.push_back({
+      .mMin = axis.mMin,
+      .mMax = axis.mMax,
+      .mJump = std::max<int64_t>(1, jump),
+    });
+  }
+}
+
+void AnomalyDetector::Push(Clock::time_point now, const DeviceState& state) {
+  assert(state.mAxes.size() == mAxes.size());
+  const auto time
+    = std::chrono::duration_cast<std::chrono::microseconds>(now - mEpoch);
+  mInReadFailure = false;
+
+  if (mConsecutiveSamples == 0) {
+    for (std::size_t i = 0; i < mAxes.size(); ++i) {
+      auto& axis = mAxes[i];
+      axis.mPrevious = state.mAxes[i];
+      axis.mPossibleSpike = false;
+      // Not a change, but otherwise the frozen check would never start
+      axis.mLastChange = time;
+    }
+  } else {
+    for (std::size_t i = 0; i < mAxes.size(); ++i) {
+      const auto value = state.mAxes[i];
+      auto& axis = mAxes[i];
+      this->CheckJumps(i, time, value);
+      if (value != axis.mPrevious) {
+        this->RecordChange(i, time);
+      }
+      axis.mBeforePrevious = axis.mPrevious;
+      axis.mPrevious = value;
+    }
+    for (std::size_t i = 0; i < mAxes.size(); ++i) {
+      this->CheckFrozen(i, time);
+    }
+  }
+
+  ++mConsecutiveSamples;
+  mPreviousTime = time;
+}
+
+void AnomalyDetector::CheckJumps(
+  std::size_t index,
+  std::chrono::microseconds time,
+  int32_t value) {
+  auto& axis = mAxes[index];
+  const auto distance = [](int64_t a, int64_t b) { return std::abs(a - b); };
+
+  // The previous sample jumped; if this one jumped back, it was a spike
+  if (
+    axis.mPossibleSpike && distance(value, axis.mPrevious) > axis.mJump
+    && distance(value, axis.mBeforePrevious) <= axis.mJump / 2) {
+    this->Record({
+      .mTime = mPreviousTime,
+      .mType = AnomalyType::Spike,
+      .mAxis = static_cast<uint32_t>(index),
+      .mValue = axis.mPrevious,
+    });
+  }
+
+  const auto jumped = distance(value, axis.mPrevious) > axis.mJump;
+  const auto toRail = (value == axis.mMin || value == axis.mMax || value == 0);
+  if (jumped && toRail) {
+    this->Record({
+      .mTime = time,
+      .mType = AnomalyType::Dropout,
+      .mAxis = static_cast<uint32_t>(index),
+      .mValue = value,
+    });
+  }
+  axis.mPossibleSpike = jumped && !toRail;
+}
+
+void AnomalyDetector::RecordChange(
+  std::size_t index,
+  std::chrono::microseconds time) {
+  auto& axis = mAxes[index];
+  axis.mHasChanged = true;
+  axis.mLastChange = time;
+  axis.mFrozenReported = false;
+
+  if (index != mLatestChangeAxis) {
+    mLatestOtherChange = mLatestChange;
+    mLatestChangeAxis = index;
+  }
+  mLatestChange = time;
+}
+
+void AnomalyDetector::CheckFrozen(
+  std::size_t index,
+  std::chrono::microseconds time) {
+  auto& axis = mAxes[index];
+  if (axis.mFrozenReported || !axis.mHasChanged) {
+    return;
+  }
+  if (time - axis.mLastChange < mFrozenAfter) {
+    return;
+  }
+  // Resting positions are expected to be steady, e.g. a released trigger
+  // or a centered stick with a deadzone
+  const auto value = axis.mPrevious;
+  const auto center = (static_cast<int64_t>(axis.mMin) + axis.mMax) / 2;
+  if (
+    value == axis.mMin || value == axis.mMax
+    || std::abs(value - center) <= 1) {
+    return;
+  }
+  const auto otherChange = (index == mLatestChangeAxis) ? mLatestOtherChange
+                                                        : mLatestChange;
+  if (otherChange <= axis.mLastChange) {
+    return;
+  }
+
+  axis.mFrozenReported = true;
+  this->Record({
+    .mTime = time,
+    .mType = AnomalyType::Frozen,
+    .mAxis = static_cast<uint32_t>(index),
+    .mValue = value,
+  });
+}
+
+void AnomalyDetector::PushReadFailure(Clock::time_point now) {
+  // Values from before the failure aren't a baseline for spikes
+  mConsecutiveSamples = 0;
+  if (mInReadFailure) {
+    return;
+  }
+  mInReadFailure = true;
+  this->Record({
+    .mTime
+    = std::chrono::duration_cast<std::chrono::microseconds>(now - mEpoch),
+    .mType = AnomalyType::ReadFailure,
+  });
+}
+
+void AnomalyDetector::Record(const Anomaly& anomaly) {
+  mCounts[static_cast<std::size_t>(anomaly.mType)].fetch_add(
+    1, std::memory_order_relaxed);
+
+  const auto sequence = mLogEnd.load(std::memory_order_relaxed);
+  mLogClaimed.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  auto words = &mLog[(sequence & (LOG_CAPACITY - 1)) * WORDS_PER_ENTRY];
+  words[0].store(
+    static_cast<uint64_t>(anomaly.mTime.count()), std::memory_order_relaxed);
+  words[1].store(PackDetails(anomaly), std::memory_order_relaxed);
+  mLogEnd.store(sequence + 1, std::memory_order_release);
+}
+
+std::pmr::vector<Anomaly> AnomalyDetector::GetRecentAnomalies(
+  std::pmr::memory_resource* resource) const {
+  std::pmr::vector<Anomaly> ret {resource};
+  const auto end = mLogEnd.load(std::memory_order_acquire);
+  const auto begin = (end > LOG_CAPACITY) ? (end - LOG_CAPACITY) : 0;
+  ret.reserve(end - begin);
+  for (auto sequence = begin; sequence < end; ++sequence) {
+    const auto words = &mLog[(sequence & (LOG_CAPACITY - 1)) * WORDS_PER_ENTRY];
+    Anomaly anomaly {
+      .mTime = std::chrono::microseconds {
+        static_cast<int64_t>(words[0].load(std::memory_order_relaxed))},
+    };
+    UnpackDetails(words[1].load(std::memory_order_relaxed), anomaly);
+    ret.push_back(anomaly);
+  }
+
+  // Drop any that were overwritten while we were reading them
+  std::atomic_thread_fence(std::memory_order_acquire);
+  const auto claimed = mLogClaimed.load(std::memory_order_relaxed);
+  const auto firstValid
+    = (claimed > LOG_CAPACITY) ? (claimed - LOG_CAPACITY) : 0;
+  if (firstValid > begin) {
+    const auto overwritten
+      = std::min<std::size_t>(firstValid - begin, ret.size());
+    ret.erase(ret.begin(), ret.begin() + overwritten);
+  }
+  return ret;
+}
+
+uint64_t AnomalyDetector::GetAnomalyCount(AnomalyType type) const {
+  return mCounts[static_cast<std::size_t>(type)].load(
+    std::memory_order_relaxed);
+}
+
+}// namespace FredEmmott::ControllerTester
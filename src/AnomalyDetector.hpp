@@ -0,0 +1,124 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+#include "DeviceInfo.hpp"
+#include "DeviceState.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+struct AnomalyThresholds {
+  // An axis change larger than this fraction of the range in one sample is
+  // a jump; a jump that's reversed by the next sample is a spike
+  float mJumpFraction {0.2f};
+  // How long an axis can hold a mid-travel value while other axes move
+  std::chrono::microseconds mFrozenAfter {std::chrono::seconds {2}};
+};
+
+enum class AnomalyType : uint8_t {
+  // A single-sample excursion, e.g. a dirty potentiometer wiper
+  Spike,
+  // A jump to `mMin`, `mMax`, or 0, e.g. a wiper losing contact
+  Dropout,
+  // Unchanged for `mFrozenAfter` while other axes moved
+  Frozen,
+  // `GetState()` failed; consecutive failures are one anomaly
+  ReadFailure,
+};
+constexpr std::size_t ANOMALY_TYPE_COUNT {4};
+
+const char* GetAnomalyTypeName(AnomalyType);
+
+struct Anomaly {
+  // Since the detector was created
+  std::chrono::microseconds mTime {};
+  AnomalyType mType {};
+  // Index into `DeviceInfo::mAxes`; 0 for `ReadFailure`
+  uint32_t mAxis {};
+  int32_t mValue {};
+};
+
+/* Faults that only show up at high sample rates, found as samples arrive.
+ *
+ * Each sample costs O(1) per axis. Anomalies are kept in a fixed-size log
+ * that can be read from any thread; the sampling thread never waits for
+ * readers, so the oldest entries are overwritten if it fills up.
+ *
+ * Buttons are not checked here; see `SessionAnalyzer` for bounce.
+ */
+class AnomalyDetector final {
+ public:
+  using Clock = std::chrono::steady_clock;
+  static constexpr std::size_t LOG_CAPACITY {256};
+
+  AnomalyDetector(const DeviceInfo&, const AnomalyThresholds&);
+
+  AnomalyDetector() = delete;
+  AnomalyDetector(const AnomalyDetector&) = delete;
+  AnomalyDetector(AnomalyDetector&&) = delete;
+  AnomalyDetector& operator=(const AnomalyDetector&) = delete;
+  AnomalyDetector& operator=(AnomalyDetector&&) = delete;
+
+  // Call for every sample, from a single thread; this never blocks or
+  // allocates
+  void Push(Clock::time_point, const DeviceState&);
+  void PushReadFailure(Clock::time_point);
+
+  // These can be called from any thread
+
+  // Oldest first, up to `LOG_CAPACITY`
+  std::pmr::vector<Anomaly> GetRecentAnomalies(
+    std::pmr::memory_resource* = std::pmr::get_default_resource()) const;
+  // Including anomalies that have left the log
+  uint64_t GetAnomalyCount(AnomalyType) const;
+
+ private:
+  struct AxisState {
+    int32_t mMin {};
+    int32_t mMax {};
+    int64_t mJump {};
+
+    int32_t mPrevious {};
+    int32_t mBeforePrevious {};
+    // The previous sample jumped, and wasn't a dropout
+    bool mPossibleSpike {false};
+
+    bool mHasChanged {false};
+    std::chrono::microseconds mLastChange {};
+    bool mFrozenReported {false};
+  };
+
+  const Clock::time_point mEpoch {Clock::now()};
+  std::chrono::microseconds mFrozenAfter;
+  std::vector<AxisState> mAxes;
+  // Only used on the sampling thread
+  std::size_t mConsecutiveSamples {};
+  std::chrono::microseconds mPreviousTime {};
+  bool mInReadFailure {false};
+  // The most recent axis change, and the most recent by any other axis
+  std::size_t mLatestChangeAxis {};
+  std::chrono::microseconds mLatestChange {};
+  std::chrono::microseconds mLatestOtherChange {};
+
+  // Two words per entry; reads are validated like `SampleRing`
+  std::unique_ptr<std::atomic<uint64_t>[]> mLog;
+  std::atomic<uint64_t> mLogClaimed {0};
+  std::atomic<uint64_t> mLogEnd {0};
+  std::array<std::atomic<uint64_t>, ANOMALY_TYPE_COUNT> mCounts {};
+
+  void Record(const Anomaly&);
+  void CheckJumps(std::size_t axis, std::chrono::microseconds, int32_t value);
+  void RecordChange(std::size_t axis, std::chrono::microseconds);
+  void CheckFrozen(std::size_t axis, std::chrono::microseconds);
+};
+
+}// namespace FredEmmott::ControllerTester
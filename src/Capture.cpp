@@ -0,0 +1,249 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "Capture.hpp"
+
+#include <array>
+#include <cassert>
+#include <cstring>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+
+#include "SerializedControls.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+namespace {
+
+constexpr std::array<char, 4> MAGIC {'F', 'C', 'T', 'C'};
+constexpr uint32_t VERSION {1};
+
+/* Followed by:
+ * - `SerializedControl`s for the axes, then buttons, then hats
+ * - `mNameBytes` of device name
+ * - `mStringBytes` of control names
+ * - padding to an 8-byte boundary
+ * - samples
+ */
+struct FileHeader {
+  std::array<char, 4> mMagic {};
+  uint32_t mVersion {};
+  Guid mProduct;
+  Guid mUnit;
+  // Microseconds since the epoch
+  int64_t mStartTime {};
+  uint32_t mAxisCount {};
+  uint32_t mButtonCount {};
+  uint32_t mHatCount {};
+  uint32_t mNameBytes {};
+  uint32_t mStringBytes {};
+  uint32_t mSampleSize {};
+};
+static_assert(std::is_trivially_copyable_v<FileHeader>);
+static_assert(sizeof(FileHeader) % 8 == 0);
+
+constexpr std::size_t Align8(std::size_t size) {
+  return (size + 7) & ~std::size_t {7};
+}
+
+// Each sample is the time in microseconds, the axes, the hats, padding,
+// then the button words
+struct SampleLayout {
+  std::size_t mAxesOffset {};
+  std::size_t mHatsOffset {};
+  std::size_t mButtonsOffset {};
+  std::size_t mSize {};
+};
+
+constexpr SampleLayout
+GetSampleLayout(std::size_t axes, std::size_t hats, std::size_t buttonWords) {
+  SampleLayout ret {};
+  ret.mAxesOffset = sizeof(int64_t);
+  ret.mHatsOffset = ret.mAxesOffset + (axes * sizeof(int32_t));
+  ret.mButtonsOffset = Align8(ret.mHatsOffset + (hats * sizeof(int32_t)));
+  ret.mSize = ret.mButtonsOffset + (buttonWords * sizeof(uint64_t));
+  return ret;
+}
+
+}// namespace
+
+CaptureWriter::CaptureWriter(
+  const std::filesystem::path& path,
+  const DeviceInfo& device,
+  Clock::time_point start)
+  : mStart(start),
+    mAxisCount(device.mAxes.size()),
+    mHatCount(device.mHats.size()),
+    mButtonWordCount(
+      DeviceState::GetButtonWordCount(device.mButtons.size())) {
+  const auto layout
+    = GetSampleLayout(mAxisCount, mHatCount, mButtonWordCount);
+  mSample.resize(layout.mSize);
+
+  const auto controls = SerializeControls(device);
+  // `start` may be in the past, e.g. for a triggered capture
+  const auto startTime = std::chrono::system_clock::now()
+    - std::chrono::duration_cast<std::chrono::system_clock::duration>(
+      Clock::now() - start);
+  const FileHeader header {
+    .mMagic = MAGIC,
+    .mVersion = VERSION,
+    .mProduct = device.mProduct,
+    .mUnit = device.mGuid,
+    .mStartTime = std::chrono::duration_cast<std::chrono::microseconds>(
+                    startTime.time_since_epoch())
+                    .count(),
+    .mAxisCount = static_cast<uint32_t>(device.mAxes.size()),
+    .mButtonCount = static_cast<uint32_t>(device.mButtons.size()),
+    .mHatCount = static_cast<uint32_t>(device.mHats.size()),
+    .mNameBytes = static_cast<uint32_t>(device.mName.size()),
+    .mStringBytes = static_cast<uint32_t>(controls.mStrings.size()),
+    .mSampleSize = static_cast<uint32_t>(layout.mSize),
+  };
+
+  std::error_code ec;
+  std::filesystem::create_directories(path.parent_path(), ec);
+  mFile.open(path, std::ios::binary | std::ios::trunc);
+  mFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  mFile.write(
+    reinterpret_cast<const char*>(controls.mRecords.data()),
+    controls.mRecords.size() * sizeof(SerializedControl));
+  mFile.write(device.mName.data(), device.mName.size());
+  mFile.write(controls.mStrings.data(), controls.mStrings.size());
+
+  const auto written = sizeof(header)
+    + (controls.mRecords.size() * sizeof(SerializedControl))
+    + device.mName.size() + controls.mStrings.size();
+  constexpr std::array<char, 8> padding {};
+  mFile.write(padding.data(), Align8(written) - written);
+}
+
+bool CaptureWriter::IsValid() const {
+  return mFile.good();
+}
+
+void CaptureWriter::Append(Clock::time_point time, const DeviceState& state) {
+  assert(state.mAxes.size() == mAxisCount);
+  assert(state.mHats.size() == mHatCount);
+  assert(state.mButtons.size() == mButtonWordCount);
+
+  const auto layout
+    = GetSampleLayout(mAxisCount, mHatCount, mButtonWordCount);
+  const int64_t micros
+    = std::chrono::duration_cast<std::chrono::microseconds>(time - mStart)
+        .count();
+  const auto buf = mSample.data();
+  std::memcpy(buf, &micros, sizeof(micros));
+  std::memcpy(
+    buf + layout.mAxesOffset, state.mAxes.data(), mAxisCount * sizeof(int32_t));
+  std::memcpy(
+    buf + layout.mHatsOffset, state.mHats.data(), mHatCount * sizeof(int32_t));
+  std::memcpy(
+    buf + layout.mButtonsOffset,
+    state.mButtons.data(),
+    mButtonWordCount * sizeof(uint64_t));
+
+  mFile.write(reinterpret_cast<const char*>(buf), mSample.size());
+  ++mSampleCount;
+}
+
+std::size_t CaptureWriter::GetSampleCount() const {
+  return mSampleCount;
+}
+
+CaptureReader::CaptureReader(const std::filesystem::path& path)
+  : mFile(path) {
+  const auto data = mFile.GetData();
+  FileHeader header;
+  if (data.size() < sizeof(header)) {
+    return;
+  }
+  std::memcpy(&header, data.data(), sizeof(header));
+  if (header.mMagic != MAGIC || header.mVersion != VERSION) {
+    return;
+  }
+
+  const std::size_t recordCount = static_cast<std::size_t>(header.mAxisCount)
+    + header.mButtonCount + header.mHatCount;
+  const auto recordsSize = recordCount * sizeof(SerializedControl);
+  const auto samplesOffset = Align8(
+    sizeof(header) + recordsSize + header.mNameBytes + header.mStringBytes);
+  const auto layout = GetSampleLayout(
+    header.mAxisCount,
+    header.mHatCount,
+    DeviceState::GetButtonWordCount(header.mButtonCount));
+  if (data.size() < samplesOffset || header.mSampleSize != layout.mSize) {
+    return;
+  }
+
+  const auto records = data.subspan(sizeof(header), recordsSize);
+  const std::string_view name {
+    reinterpret_cast<const char*>(records.data() + recordsSize),
+    header.mNameBytes};
+  const std::string_view strings {
+    name.data() + name.size(), header.mStringBytes};
+  if (!DeserializeControls(
+        records,
+        strings,
+        header.mAxisCount,
+        header.mButtonCount,
+        header.mHatCount,
+        mDeviceInfo)) {
+    return;
+  }
+  mDeviceInfo.mName = std::string {name};
+  mDeviceInfo.mGuid = header.mUnit;
+  mDeviceInfo.mProduct = header.mProduct;
+  mStartTime = std::chrono::system_clock::time_point {
+    std::chrono::duration_cast<std::chrono::system_clock::duration>(
+      std::chrono::microseconds {header.mStartTime})};
+
+  mSampleSize = layout.mSize;
+  // Ignore any partial sample from an interrupted recording
+  mSampleCount = (data.size() - samplesOffset) / mSampleSize;
+  mSamples = data.subspan(samplesOffset, mSampleCount * mSampleSize);
+  mValid = true;
+}
+
+bool CaptureReader::IsValid() const {
+  return mValid;
+}
+
+const DeviceInfo& CaptureReader::GetDeviceInfo() const {
+  return mDeviceInfo;
+}
+
+std::chrono::system_clock::time_point CaptureReader::GetStartTime() const {
+  return mStartTime;
+}
+
+std::size_t CaptureReader::GetSampleCount() const {
+  return mSampleCount;
+}
+
+std::chrono::microseconds CaptureReader::ReadSample(
+  std::size_t index,
+  DeviceState& state) const {
+  assert(index < mSampleCount);
+  const auto axisCount = mDeviceInfo.mAxes.size();
+  const auto hatCount = mDeviceInfo.mHats.size();
+  state.Resize(axisCount, hatCount, mDeviceInfo.mButtons.size());
+  const auto layout
+    = GetSampleLayout(axisCount, hatCount, state.mButtons.size());
+
+  const auto buf = mSamples.data() + (index * mSampleSize);
+  int64_t micros {};
+  std::memcpy(&micros, buf, sizeof(micros));
+  std::memcpy(
+    state.mAxes.data(), buf + layout.mAxesOffset, axisCount * sizeof(int32_t));
+  std::memcpy(
+    state.mHats.data(), buf + layout.mHatsOffset, hatCount * sizeof(int32_t));
+  std::memcpy(
+    state.mButtons.data(),
+    buf + layout.mButtonsOffset,
+    state.mButtons.size() * sizeof(uint64_t));
+  return std::chrono::microseconds {micros};
+}
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,87 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <vector>
+
+#include "DeviceInfo.hpp"
+#include "DeviceState.hpp"
+#include "MemoryMappedFile.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+/* A recorded session: a device's controls, then every state that was read.
+ *
+ * Samples are fixed-size, so a capture can be read from the middle, and an
+ * interrupted recording only loses the partial sample at the end.
+ */
+class CaptureWriter final {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  CaptureWriter(
+    const std::filesystem::path&,
+    const DeviceInfo&,
+    Clock::time_point start = Clock::now());
+
+  CaptureWriter() = delete;
+  CaptureWriter(const CaptureWriter&) = delete;
+  CaptureWriter(CaptureWriter&&) = delete;
+  CaptureWriter& operator=(const CaptureWriter&) = delete;
+  CaptureWriter& operator=(CaptureWriter&&) = delete;
+
+  // False if the file couldn't be written
+  bool IsValid() const;
+
+  // `state` must have the same control counts as the device
+  void Append(Clock::time_point, const DeviceState& state);
+  std::size_t GetSampleCount() const;
+
+ private:
+  std::ofstream mFile;
+  Clock::time_point mStart;
+  std::size_t mAxisCount {};
+  std::size_t mHatCount {};
+  std::size_t mButtonWordCount {};
+  std::size_t mSampleCount {};
+  std::vector<std::byte> mSample;
+};
+
+class CaptureReader final {
+ public:
+  explicit CaptureReader(const std::filesystem::path&);
+
+  CaptureReader() = delete;
+  CaptureReader(const CaptureReader&) = delete;
+  CaptureReader(CaptureReader&&) = delete;
+  CaptureReader& operator=(const CaptureReader&) = delete;
+  CaptureReader& operator=(CaptureReader&&) = delete;
+
+  // False if the file is missing, or isn't a capture
+  bool IsValid() const;
+
+  // Controls, with no coverage; includes the name and GUIDs
+  const DeviceInfo& GetDeviceInfo() const;
+  std::chrono::system_clock::time_point GetStartTime() const;
+  std::size_t GetSampleCount() const;
+
+  // Returns the time since the start of the capture; `state` is resized
+  std::chrono::microseconds ReadSample(std::size_t index, DeviceState& state)
+    const;
+
+ private:
+  MemoryMappedFile mFile;
+  bool mValid {false};
+  DeviceInfo mDeviceInfo;
+  std::chrono::system_clock::time_point mStartTime;
+  std::span<const std::byte> mSamples;
+  std::size_t mSampleSize {};
+  std::size_t mSampleCount {};
+};
+
+}// namespace FredEmmott::ControllerTester
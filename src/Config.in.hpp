@@ -13,6 +13,10 @@ constexpr auto BUILD_VERSION {"@CMAKE_PROJECT_VERSION@"};
 constexpr auto BUILD_VERSION_W {L"@CMAKE_PROJECT_VERSION@"};
 constexpr auto MAX_FPS {60};
 constexpr size_t AXIS_HISTORY_FRAMES {MAX_FPS * 5};
+// Initial size of the per-frame arena; it grows if a frame needs more
+constexpr size_t FRAME_ARENA_BYTES {64 * 1024};
+// Percentiles in the performance overlay cover this many seconds
+constexpr auto PERFORMANCE_HUD_SECONDS {5};
 
 const ImVec4 WARNING_COLOR {1.0f, 0.6f, 0.0f, 1.0f};
 const ImVec4 FULL_RANGE_COLOR {0.0f, 1.0f, 0.0f, 1.0f};
@@ -0,0 +1,243 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "ControlAnalysis.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace FredEmmott::ControllerTester {
+
+int32_t GetAxisValue(const std::byte* state, const AxisInfo& axis) {
+  return *reinterpret_cast<const int32_t*>(state + axis.mDataOffset);
+}
+
+int32_t GetHatValue(const std::byte* state, const HatInfo& hat) {
+  return *reinterpret_cast<const int32_t*>(state + hat.mDataOffset);
+}
+
+bool IsButtonPressed(const std::byte* state, const ButtonInfo& button) {
+  return (*reinterpret_cast<const uint8_t*>(state + button.mDataOffset))
+    & 0x80;
+}
+
+void DecodeState(
+  const DeviceInfo& info,
+  std::span<const std::byte> raw,
+  DeviceState& state) {
+  state.Resize(info.mAxes.size(), info.mHats.size(), info.mButtons.size());
+  const auto buf = raw.data();
+  for (std::size_t i = 0; i < info.mAxes.size(); ++i) {
+    state.mAxes[i] = GetAxisValue(buf, info.mAxes[i]);
+  }
+  for (std::size_t i = 0; i < info.mHats.size(); ++i) {
+    state.mHats[i] = GetHatValue(buf, info.mHats[i]);
+  }
+  for (std::size_t i = 0; i < info.mButtons.size(); ++i) {
+    if (IsButtonPressed(buf, info.mButtons[i])) {
+      state.mButtons[i / DeviceState::BUTTONS_PER_WORD]
+        |= uint64_t {1} << (i % DeviceState::BUTTONS_PER_WORD);
+    }
+  }
+}
+
+void UpdateAxisHistory(
+  AxisInfo& axis,
+  int32_t value,
+  std::size_t historyLength) {
+  if (axis.mValues.empty()) {
+    axis.mValues.resize(historyLength, value);
+    return;
+  }
+
+  assert(axis.mValues.size() == historyLength);
+  axis.mValues.erase(axis.mValues.begin());
+  axis.mValues.push_back(value);
+}
+
+void UpdateAxisExtents(AxisInfo& axis, int32_t value) {
+  axis.mMinSeen = std::min<int32_t>(axis.mMinSeen, value);
+  axis.mMaxSeen = std::max<int32_t>(axis.mMaxSeen, value);
+}
+
+namespace {
+constexpr auto NEAR_SCALE = 0.05f;
+}
+
+TestedRange GetTestedRange(const AxisInfo& axis) {
+  const auto fullRange = axis.mMax - axis.mMin;
+  const auto nearMin = axis.mMin + (fullRange * NEAR_SCALE);
+  const auto nearMax = axis.mMax - (fullRange * NEAR_SCALE);
+  if (axis.mMinSeen == axis.mMin && axis.mMaxSeen == axis.mMax) {
+    return TestedRange::FullRange;
+  }
+  if (axis.mMinSeen < nearMin && axis.mMaxSeen > nearMax) {
+    return TestedRange::NearFullRange;
+  }
+  return TestedRange::Default;
+}
+
+AxisPosition GetAxisPosition(const AxisInfo& axis, int32_t value) {
+  const auto fullRange = axis.mMax - axis.mMin;
+  const auto nearMin = axis.mMin + (fullRange * NEAR_SCALE);
+  const auto nearMax = axis.mMax - (fullRange * NEAR_SCALE);
+
+  if (value == axis.mMin || value == axis.mMax) {
+    return AxisPosition::AtLimit;
+  }
+  if (value < nearMin || value > nearMax) {
+    return AxisPosition::NearLimit;
+  }
+
+  const bool inDeadZone = (value > (axis.mMin + (fullRange * 0.45)))
+    && (value < (axis.mMax - (fullRange * 0.45)));
+  if (!inDeadZone) {
+    return AxisPosition::Active;
+  }
+  return AxisPosition::Center;
+}
+
+std::optional<long> GetAxisPercent(const AxisInfo& axis, int32_t value) {
+  std::optional<long> percent;
+  if (axis.mMin >= 0) {
+    percent
+      = std::lround((100.0f * (value - axis.mMin)) / (axis.mMax - axis.mMin));
+    if (percent == 0 && value != axis.mMin) {
+      percent = 1;
+    } else if (percent == 100 && value != axis.mMax) {
+      percent = 99;
+    }
+  } else if (std::abs(axis.mMax / axis.mMin) <= 0.001) {
+    // symmetrical, -x to +x
+    if (value >= 0) {
+      percent = std::lround((100.0f * value) / axis.mMax);
+    } else {
+      percent = std::lround((-100.0f * value) / axis.mMin);
+    }
+
+    if (percent == -100 && value != axis.mMin) {
+      percent = -99;
+    } else if (percent == 100 && value != axis.mMax) {
+      percent = 99;
+    }
+  }
+  return percent;
+}
+
+bool IsHatCentered(int32_t value) {
+  return (value == -1) || (value & 0xffff) == 0xffff;
+}
+
+uint16_t GetHatSeenFlag(int32_t value) {
+  switch (value) {
+    case 0:
+    case 36000:
+      return HatInfo::SEEN_NORTH;
+    case 4500:
+      return HatInfo::SEEN_NORTHEAST;
+    case 9000:
+      return HatInfo::SEEN_EAST;
+    case 13500:
+      return HatInfo::SEEN_SOUTHEAST;
+    case 18000:
+      return HatInfo::SEEN_SOUTH;
+    case 22500:
+      return HatInfo::SEEN_SOUTHWEST;
+    case 27000:
+      return HatInfo::SEEN_WEST;
+    case 31500:
+      return HatInfo::SEEN_NORTHWEST;
+    default:
+      if (IsHatCentered(value)) {
+        return HatInfo::SEEN_CENTER;
+      }
+      return 0;
+  }
+}
+
+uint16_t GetHatFullRangeFlags(HatType type) {
+  uint16_t fullRange {};
+  switch (type) {
+    case HatType::EightWay:
+      fullRange |= HatInfo::SEEN_NORTHEAST | HatInfo::SEEN_SOUTHEAST
+        | HatInfo::SEEN_SOUTHWEST | HatInfo::SEEN_NORTHWEST;
+      [[fallthrough]];
+    case HatType::FourWay:
+      fullRange |= HatInfo::SEEN_CENTER | HatInfo::SEEN_NORTH
+        | HatInfo::SEEN_EAST | HatInfo::SEEN_SOUTH | HatInfo::SEEN_WEST;
+      break;
+    case HatType::Other:
+      // Not going to try and check full-range for a hat with 36,000 values
+      fullRange = 0xffff;
+  }
+  return fullRange;
+}
+
+void UpdateHatSeen(HatInfo& hat, int32_t value) {
+  if (hat.mType == HatType::Other) {
+    return;
+  }
+  hat.mSeenFlags |= GetHatSeenFlag(value);
+}
+
+void UpdateButtonSeen(ButtonInfo& button, bool pressed) {
+  if (pressed) {
+    button.mSeenOn = true;
+  } else {
+    button.mSeenOff = true;
+  }
+}
+
+bool IsFullyTested(const DeviceInfo& device) {
+  const auto axisTested = [](const AxisInfo& axis) {
+    return GetTestedRange(axis) == TestedRange::FullRange;
+  };
+  const auto buttonTested = [](const ButtonInfo& button) {
+    return button.mSeenOn && button.mSeenOff;
+  };
+  const auto hatTested = [](const HatInfo& hat) {
+    if (hat.mType == HatType::Other) {
+      return true;
+    }
+    const auto required = GetHatFullRangeFlags(hat.mType);
+    return (hat.mSeenFlags & required) == required;
+  };
+  return std::ranges::all_of(device.mAxes, axisTested)
+    && std::ranges::all_of(device.mButtons, buttonTested)
+    && std::ranges::all_of(device.mHats, hatTested);
+}
+
+bool RestoreCoverage(DeviceInfo& device, const DeviceInfo& previous) {
+  const auto sameControls = [](const auto& a, const auto& b) {
+    return std::ranges::equal(a, b, [](const auto& x, const auto& y) {
+      return x.mName == y.mName && x.mGuid == y.mGuid;
+    });
+  };
+  if (
+    !sameControls(device.mAxes, previous.mAxes)
+    || !sameControls(device.mButtons, previous.mButtons)
+    || !sameControls(device.mHats, previous.mHats)) {
+    return false;
+  }
+
+  for (std::size_t i = 0; i < device.mAxes.size(); ++i) {
+    auto& axis = device.mAxes[i];
+    const auto& old = previous.mAxes[i];
+    axis.mMinSeen = old.mMinSeen;
+    axis.mMaxSeen = old.mMaxSeen;
+    axis.mValues = old.mValues;
+  }
+  for (std::size_t i = 0; i < device.mButtons.size(); ++i) {
+    auto& button = device.mButtons[i];
+    const auto& old = previous.mButtons[i];
+    button.mSeenOff = old.mSeenOff;
+    button.mSeenOn = old.mSeenOn;
+  }
+  for (std::size_t i = 0; i < device.mHats.size(); ++i) {
+    device.mHats[i].mSeenFlags = previous.mHats[i].mSeenFlags;
+  }
+  return true;
+}
+
+}// namespace FredEmmott::ControllerTester
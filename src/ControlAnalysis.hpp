@@ -0,0 +1,80 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+#include "ControlInfo.hpp"
+#include "DeviceInfo.hpp"
+#include "DeviceState.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+/* Decoding and coverage tracking for individual controls.
+ *
+ * Kept separate from the GUI so the same logic can be used elsewhere and
+ * benchmarked without a window.
+ */
+
+int32_t GetAxisValue(const std::byte* state, const AxisInfo&);
+int32_t GetHatValue(const std::byte* state, const HatInfo&);
+bool IsButtonPressed(const std::byte* state, const ButtonInfo&);
+
+// The generic path, for layouts that are only known at runtime, e.g.
+// DirectInput; `state` is resized to match `info`
+void DecodeState(
+  const DeviceInfo& info,
+  std::span<const std::byte> raw,
+  DeviceState& state);
+
+void UpdateAxisHistory(AxisInfo&, int32_t value, std::size_t historyLength);
+void UpdateAxisExtents(AxisInfo&, int32_t value);
+
+enum class TestedRange {
+  Default,
+  NearFullRange,
+  FullRange,
+};
+TestedRange GetTestedRange(const AxisInfo&);
+
+enum class AxisPosition {
+  // Within 5% of the center, or the value is not classified
+  Center,
+  Active,
+  // Within 5% of min/max
+  NearLimit,
+  AtLimit,
+};
+AxisPosition GetAxisPosition(const AxisInfo&, int32_t value);
+
+// Nullopt if the axis range doesn't have an obvious percentage
+std::optional<long> GetAxisPercent(const AxisInfo&, int32_t value);
+
+bool IsHatCentered(int32_t value);
+// The `HatInfo::SEEN_*` flag for this value, or 0 if there isn't one
+uint16_t GetHatSeenFlag(int32_t value);
+// All the `HatInfo::SEEN_*` flags that must be seen for a full-range test
+uint16_t GetHatFullRangeFlags(HatType);
+void UpdateHatSeen(HatInfo&, int32_t value);
+
+void UpdateButtonSeen(ButtonInfo&, bool pressed);
+
+/* Whether every control has been fully exercised.
+ *
+ * That is, every axis has been tested over its full range, every button has
+ * been seen both pressed and released, and every four- or eight-way hat has
+ * been seen in every direction.
+ */
+bool IsFullyTested(const DeviceInfo&);
+
+/* Copy seen ranges, history, and seen flags from an earlier connection.
+ *
+ * Does nothing and returns false unless both have the same controls, in the
+ * same order.
+ */
+bool RestoreCoverage(DeviceInfo& device, const DeviceInfo& previous);
+
+}// namespace FredEmmott::ControllerTester
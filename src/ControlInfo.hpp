@@ -2,39 +2,39 @@
 // SPDX-License-Identifier: ISC
 #pragma once
 
-#include <Windows.h>
-
-#include <winrt/base.h>
-
+#include <cstdint>
 #include <limits>
 #include <string>
+#include <vector>
+
+#include "Guid.hpp"
 
 namespace FredEmmott::ControllerTester {
 
 struct AxisInfo final {
   std::string mName;
-  winrt::guid mGuid {};
+  Guid mGuid {};
 
-  LONG mMin {std::numeric_limits<LONG>::max()};
-  LONG mMax {std::numeric_limits<LONG>::min()};
+  int32_t mMin {std::numeric_limits<int32_t>::max()};
+  int32_t mMax {std::numeric_limits<int32_t>::min()};
 
-  LONG mMinSeen {std::numeric_limits<LONG>::max()};
-  LONG mMaxSeen {std::numeric_limits<LONG>::min()};
+  int32_t mMinSeen {std::numeric_limits<int32_t>::max()};
+  int32_t mMaxSeen {std::numeric_limits<int32_t>::min()};
 
-  std::vector<LONG> mValues;
+  std::vector<int32_t> mValues {};
 
-  DWORD mDataOffset {};
+  uint32_t mDataOffset {};
 };
 
 struct ButtonInfo final {
   std::string mName;
-  winrt::guid mGuid {};
+  Guid mGuid {};
 
   bool mLastState {false};
   bool mSeenOff {false};
   bool mSeenOn {false};
 
-  DWORD mDataOffset {};
+  uint32_t mDataOffset {};
 };
 
 enum class HatType {
@@ -45,7 +45,7 @@ enum class HatType {
 
 struct HatInfo final {
   std::string mName;
-  winrt::guid mGuid {};
+  Guid mGuid {};
   HatType mType {HatType::Other};
 
   static constexpr uint16_t SEEN_CENTER = 1;
@@ -60,7 +60,7 @@ struct HatInfo final {
   // Only valid for HatType::FourWay and HatType::EightWay
   uint16_t mSeenFlags {};
 
-  DWORD mDataOffset {};
+  uint32_t mDataOffset {};
 };
 
 }// namespace FredEmmott::ControllerTester
\ No newline at end of file
@@ -0,0 +1,953 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "ControllerGUI.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <format>
+#include <numbers>
+
+#include <imgui.h>
+
+#include "Config.hpp"
+#include "ControlAnalysis.hpp"
+#include "Trace.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+namespace {
+
+// A few seconds at 1kHz, so readers can be descheduled without losing
+// samples
+constexpr std::size_t SHARED_FEED_CAPACITY {4096};
+
+}// namespace
+
+RollingSamples MakeHUDSamples() {
+  return {
+    std::chrono::seconds {Config::PERFORMANCE_HUD_SECONDS},
+    Config::MAX_FPS * Config::PERFORMANCE_HUD_SECONDS,
+  };
+}
+
+ControllerGUI::Performance::Performance()
+  : mAxes(MakeHUDSamples()),
+    mButtons(MakeHUDSamples()),
+    mHats(MakeHUDSamples()) {
+}
+
+ControllerGUI::DevicePerformance::DevicePerformance()
+  : mPoll(MakeHUDSamples()), mGetState(MakeHUDSamples()) {
+}
+
+ControllerGUI::ControllerGUI(FrameArena& frameArena)
+  : mFrameArena(frameArena) {
+}
+
+const ControllerGUI::Performance& ControllerGUI::GetPerformance() const {
+  return mPerformance;
+}
+
+const std::map<Guid, ControllerGUI::DevicePerformance>&
+ControllerGUI::GetDevicePerformance() const {
+  return mDevicePerformance;
+}
+
+void ControllerGUI::RemoveMissingDevices(std::span<const Guid> present) {
+  const auto missing = [present](const auto& pair) {
+    return std::ranges::find(present, pair.first) == present.end();
+  };
+  std::erase_if(mReaders, missing);
+  // Stops their samplers, which would otherwise keep polling the instances
+  // they opened
+  std::erase_if(mSamplingSessions, missing);
+  std::erase_if(mCaptures, missing);
+  std::erase_if(mDevicePerformance, missing);
+}
+
+void ControllerGUI::SetResultsDatabase(ResultsDatabase* results) {
+  mResults = results;
+}
+
+bool ControllerGUI::BeginControllerTab(DeviceInfo* device) {
+  return ImGui::BeginTabItem(device->mName.c_str());
+}
+
+void ControllerGUI::EndControllerTab(
+  DeviceInfo* device,
+  const std::optional<DeviceState>& state,
+  bool fresh,
+  bool canSample) {
+  if (!state) {
+    ImGui::TextDisabled("Couldn't read controller state.");
+    ImGui::EndTabItem();
+    return;
+  }
+
+  if (mResults) {
+    GUIRecordResult(device);
+  }
+  if (mCaptureDirectory) {
+    GUICapture(device, *state, fresh);
+  }
+  if (canSample) {
+    GUISampling(device);
+  }
+
+  {
+    const auto fixedColumns
+      = (device->mAxes.empty() ? 0 : 1) + (device->mHats.empty() ? 0 : 1);
+    const auto buttonCount = device->mButtons.size();
+    constexpr auto buttonsPerColumn = 16;
+    const auto columnCount = (buttonCount == 0)
+      ? fixedColumns
+      : static_cast<unsigned int>(
+          (std::ceill(static_cast<float>(buttonCount) / buttonsPerColumn)
+           + fixedColumns));
+    ImGui::BeginTable("##Controls", columnCount, 0, {-FLT_MIN, -FLT_MIN});
+
+    if (!device->mAxes.empty()) {
+      ImGui::TableSetupColumn("##Axes", ImGuiTableColumnFlags_WidthStretch);
+    }
+    if (!device->mHats.empty()) {
+      ImGui::TableSetupColumn("##Hats", ImGuiTableColumnFlags_WidthFixed);
+    }
+    for (int i = fixedColumns; i < columnCount; ++i) {
+      ImGui::PushID(i);
+      ImGui::TableSetupColumn(
+        "##ButtonColumn", ImGuiTableColumnFlags_WidthFixed);
+      ImGui::PopID();
+    }
+
+    ImGui::TableNextRow();
+
+    if (!device->mAxes.empty()) {
+      ScopedTimer timer {mPerformance.mAxes};
+      ImGui::TableNextColumn();
+      ImGui::BeginChild("Axes Scroll", {-FLT_MIN, 0});
+      GUIControllerAxes(device, *state);
+      ImGui::EndChild();
+    }
+
+    if (!device->mHats.empty()) {
+      ScopedTimer timer {mPerformance.mHats};
+      ImGui::TableNextColumn();
+      GUIControllerHats(device, *state);
+    }
+
+    if (buttonCount) {
+      ScopedTimer timer {mPerformance.mButtons};
+      for (int firstButton = 0; firstButton < buttonCount;
+           firstButton += buttonsPerColumn) {
+        ImGui::TableNextColumn();
+        GUIControllerButtons(device, *state, firstButton, buttonsPerColumn);
+      }
+    }
+
+    ImGui::EndTable();
+  }
+
+  ImGui::EndTabItem();
+}
+
+static std::array<ImVec2, 8>
+GetArrowCoords(const ImVec2& topLeft, float scale, float rotation) {
+  // Drawing from (-0.5, 0.5) to (0.5, -0.5) to keep the origin
+  // at (0, 0) for simplicity
+  std::array<ImVec2, 8> ret {{
+    {0.0f, 0.5f},
+    {0.4f, 0.1f},
+    {0.1f, 0.1f},
+    {0.1f, -0.5f},
+    {-0.1f, -0.5f},
+    {-0.1f, 0.1f},
+    {-0.4f, 0.1f},
+    {0.0f, 0.5f},
+  }};
+
+  const auto sin = std::sin(rotation + std::numbers::pi_v<float>);
+  const auto cos = std::cos(rotation + std::numbers::pi_v<float>);
+  for (auto& point: ret) {
+    // Rotate
+    point = {
+      (point.x * cos) - (point.y * sin),
+      (point.y * cos) + (point.x * sin),
+    };
+
+    // Translate from origin of (0, 0) to origin of (0.5, 0.5)
+    point.x += 0.5;
+    point.y += 0.5;
+
+    // Scale
+    point.x *= scale;
+    point.y *= scale;
+
+    // Translate
+    point.x += topLeft.x;
+    point.y += topLeft.y;
+  }
+
+  return ret;
+}
+
+void ControllerGUI::GUIControllerHats(
+  DeviceInfo* info,
+  const DeviceState& state) {
+  const Trace::Zone traceZone {"ControllerGUI::GUIControllerHats"};
+  auto drawList = ImGui::GetWindowDrawList();
+
+  const auto color = ImGui::GetColorU32(ImGuiCol_Text);
+
+  const auto x = ImGui::GetCursorScreenPos().x;
+  const auto diameter = ImGui::GetTextLineHeight() * 2.0f;
+  const auto borderThickness = 1.0f;
+
+  const auto& style = ImGui::GetStyle();
+  float yOffset = style.FramePadding.y;
+  for (std::size_t i = 0; i < info->mHats.size(); ++i) {
+    auto& hat = info->mHats[i];
+    const auto y = ImGui::GetCursorScreenPos().y + yOffset;
+    yOffset = 0;
+    const ImVec2 center {x + (diameter / 2), y + (diameter / 2)};
+    drawList->AddCircle(center, diameter / 2, color, 0, borderThickness);
+
+    const auto value = state.mHats[i];
+    if (IsHatCentered(value)) {
+      const auto scale = 0.3f;
+      drawList->AddCircleFilled(center, diameter * scale / 2, color);
+    } else {
+      constexpr auto scale = 0.6f;
+      const auto offset = (diameter * (1.0f - scale)) / 2;
+
+      const auto points = GetArrowCoords(
+        {x + offset, y + offset},
+        diameter * scale,
+        (value / 36000.0f) * 2 * std::numbers::pi_v<float>);
+
+      drawList->AddConvexPolyFilled(points.data(), points.size(), color);
+    }
+
+    UpdateHatSeen(hat, value);
+    const auto fullRange = GetHatFullRangeFlags(hat.mType);
+
+    ImGui::PushID(hat.mDataOffset);
+    ImGui::BeginGroup();
+    ImGui::Dummy({diameter, diameter});
+    ImGui::SameLine();
+    if ((hat.mSeenFlags & fullRange) == fullRange) {
+      ImGui::TextColored(Config::FULL_RANGE_COLOR, "%s", hat.mName.c_str());
+    } else {
+      ImGui::Text("%s", hat.mName.c_str());
+    }
+    ImGui::EndGroup();
+    if (ImGui::BeginItemTooltip()) {
+      switch (hat.mType) {
+        case HatType::EightWay:
+          ImGui::Text("Eight-way hat");
+          break;
+        case HatType::FourWay:
+          ImGui::Text("Four-way hat");
+          break;
+        case HatType::Other:
+          ImGui::Text("36,000-way hat");
+          break;
+      }
+
+      if (hat.mType != HatType::Other) {
+        std::pmr::vector<std::string_view> seen {&mFrameArena};
+        if (hat.mSeenFlags & HatInfo::SEEN_CENTER) {
+          seen.push_back("C");
+        }
+        if (hat.mSeenFlags & HatInfo::SEEN_NORTH) {
+          seen.push_back("N");
+        }
+        if (hat.mSeenFlags & HatInfo::SEEN_NORTHEAST) {
+          seen.push_back("NE");
+        }
+        if (hat.mSeenFlags & HatInfo::SEEN_EAST) {
+          seen.push_back("E");
+        }
+        if (hat.mSeenFlags & HatInfo::SEEN_SOUTHEAST) {
+          seen.push_back("SE");
+        }
+        if (hat.mSeenFlags & HatInfo::SEEN_SOUTH) {
+          seen.push_back("S");
+        }
+        if (hat.mSeenFlags & HatInfo::SEEN_SOUTHWEST) {
+          seen.push_back("SW");
+        }
+        if (hat.mSeenFlags & HatInfo::SEEN_WEST) {
+          seen.push_back("W");
+        }
+        if (hat.mSeenFlags & HatInfo::SEEN_NORTHWEST) {
+          seen.push_back("NW");
+        }
+
+        if (seen.empty()) {
+          ImGui::Text("Tested: [none]");
+        } else {
+          std::pmr::string text {&mFrameArena};
+          std::format_to(
+            std::back_inserter(text), "Tested: {}", seen.front());
+          for (auto it = seen.begin() + 1; it != seen.end(); ++it) {
+            std::format_to(std::back_inserter(text), ", {}", *it);
+          }
+          if ((hat.mSeenFlags & fullRange) == fullRange) {
+            ImGui::TextColored(Config::FULL_RANGE_COLOR, "%s", text.c_str());
+          } else {
+            ImGui::Text("%s", text.c_str());
+          }
+        }
+      }
+
+      ImGui::Spacing();
+      ImGui::Text("Value: %ld", value);
+      ImGui::EndTooltip();
+    }
+    ImGui::PopID();
+
+    ImGui::SetCursorPosY(ImGui::GetCursorPosY() + diameter);
+  }
+}
+
+void ControllerGUI::GUIControllerAxes(
+  DeviceInfo* info,
+  const DeviceState& state) {
+  const Trace::Zone traceZone {"ControllerGUI::GUIControllerAxes"};
+  const auto height = ImGui::GetTextLineHeight() * 3;
+
+  float maxLabelWidth = 0;
+  for (const auto& axis: info->mAxes) {
+    const auto thisWidth = ImGui::CalcTextSize(axis.mName.c_str()).x;
+    if (thisWidth > maxLabelWidth) {
+      maxLabelWidth = thisWidth;
+    }
+  }
+  const auto& style = ImGui::GetStyle();
+  const auto plotWidth
+    = -(maxLabelWidth + style.ScrollbarSize + style.FramePadding.x);
+
+  for (std::size_t i = 0; i < info->mAxes.size(); ++i) {
+    auto& axis = info->mAxes[i];
+    const auto value = state.mAxes[i];
+    {
+      const Trace::Zone traceZone {"Update axis statistics"};
+      UpdateAxisHistory(axis, value, Config::AXIS_HISTORY_FRAMES);
+      UpdateAxisExtents(axis, value);
+    }
+
+    std::pmr::vector<float> values {&mFrameArena};
+    values.reserve(axis.mValues.size());
+    for (const auto& value: axis.mValues) {
+      values.push_back(static_cast<float>(value));
+    }
+
+    std::string valueStr;
+    if (const auto percent = GetAxisPercent(axis, value)) {
+      valueStr = std::format("{:d}%", *percent);
+    } else {
+      valueStr = std::to_string(value);
+    }
+
+    ImGui::PushID(axis.mDataOffset);
+
+    const auto testedRange = GetTestedRange(axis);
+
+    switch (testedRange) {
+      case TestedRange::FullRange:
+        ImGui::PushStyleColor(ImGuiCol_Text, Config::FULL_RANGE_COLOR);
+        break;
+      case TestedRange::NearFullRange:
+        ImGui::PushStyleColor(ImGuiCol_Text, Config::WARNING_COLOR);
+        break;
+      default:
+        break;
+    }
+
+    bool changedColor = true;
+    switch (GetAxisPosition(axis, value)) {
+      case AxisPosition::AtLimit:
+        ImGui::PushStyleColor(ImGuiCol_PlotLines, Config::FULL_RANGE_COLOR);
+        break;
+      case AxisPosition::NearLimit:
+        ImGui::PushStyleColor(ImGuiCol_PlotLines, Config::WARNING_COLOR);
+        break;
+      case AxisPosition::Active:
+        ImGui::PushStyleColor(
+          ImGuiCol_PlotLines, ImGui::GetStyleColorVec4(ImGuiCol_ButtonActive));
+        break;
+      case AxisPosition::Center:
+        changedColor = false;
+        break;
+    }
+
+    ImGui::SetNextItemWidth(plotWidth);
+
+    ImGui::PlotLines(
+      axis.mName.c_str(),
+      values.data(),
+      values.size(),
+      0,
+      valueStr.c_str(),
+      axis.mMin,
+      axis.mMax,
+      {0, height});
+
+    if (changedColor) {
+      ImGui::PopStyleColor();
+    }
+
+    if (testedRange != TestedRange::Default) {
+      ImGui::PopStyleColor();
+    }
+
+    if (ImGui::BeginItemTooltip()) {
+      ImGui::Text(
+        "Lowest possible: %ld\nHighest possible: %ld", axis.mMin, axis.mMax);
+      switch (testedRange) {
+        case TestedRange::FullRange:
+          ImGui::PushStyleColor(ImGuiCol_Text, {0.0f, 1.0f, 0.f, 1.0f});
+          break;
+        case TestedRange::NearFullRange:
+          ImGui::PushStyleColor(ImGuiCol_Text, Config::WARNING_COLOR);
+          break;
+        default:
+          break;
+      }
+      ImGui::Text("Lowest tested: %ld", axis.mMinSeen);
+      ImGui::Text("Highest tested: %ld", axis.mMaxSeen);
+      if (testedRange != TestedRange::Default) {
+        ImGui::PopStyleColor();
+      }
+      ImGui::Spacing();
+      ImGui::Text("Value: %ld", value);
+      if (testedRange == TestedRange::NearFullRange) {
+        ImGui::Spacing();
+        ImGui::PushStyleColor(ImGuiCol_Text, Config::WARNING_COLOR);
+        ImGui::Text("Tested > 95%% but < 100%% of full range;");
+        ImGui::Text("the controller may need calibrating.");
+        ImGui::PopStyleColor();
+      }
+      ImGui::EndTooltip();
+    }
+
+    ImGui::PopID();
+  }
+}
+
+void ControllerGUI::GUIControllerButtons(
+  DeviceInfo* info,
+  const DeviceState& state,
+  size_t first,
+  size_t count) {
+  const Trace::Zone traceZone {"ControllerGUI::GUIControllerButtons"};
+  const auto buttonCount = info->mButtons.size();
+  if (first >= buttonCount) {
+    // Currently deciding to just hide buttons that don't exist on this
+    // controller, but the code below will handle rendering them as disabled
+    // too if you remove this, and the break below
+    return;
+  }
+  const auto& style = ImGui::GetStyle();
+
+  const auto x = ImGui::GetCursorScreenPos().x;
+  const auto diameter = ImGui::GetTextLineHeight();
+  const auto labelX = x + diameter + style.ItemInnerSpacing.x;
+  const auto borderThickness = 1.0f;
+
+  const auto enabledBorderColor = ImGui::GetColorU32(ImGuiCol_Text);
+  const auto disabledBorderColor = ImGui::GetColorU32(ImGuiCol_TextDisabled);
+
+  const auto activeColor = ImGui::GetColorU32(ImGuiCol_ButtonActive);
+
+  auto drawList = ImGui::GetWindowDrawList();
+
+  float yOffset = style.FramePadding.y;
+
+  for (auto i = first; i < first + count; ++i) {
+    const auto present = i < buttonCount;
+    if (!present) {
+      break;
+    }
+
+    ImGui::PushID(i);
+
+    // First entry draws too high
+    const auto y = ImGui::GetCursorScreenPos().y + yOffset;
+    yOffset = 0;
+
+    const auto pressed = present ? state.IsButtonPressed(i) : false;
+    // Draw fill
+    if (pressed) {
+      drawList->AddCircleFilled(
+        {x + (diameter / 2), y + diameter / 2}, diameter / 2, activeColor);
+    }
+
+    // Draw border
+    drawList->AddCircle(
+      {x + (diameter / 2), y + diameter / 2},
+      diameter / 2,
+      present ? enabledBorderColor : disabledBorderColor,
+      0,
+      borderThickness);
+
+    ImGui::SetCursorPosX(labelX);
+
+    if (!present) {
+      ImGui::BeginDisabled();
+      ImGui::Text("%s", std::format("Button {}", i).c_str());
+      ImGui::EndDisabled();
+    } else {
+      auto& button = info->mButtons.at(i);
+      UpdateButtonSeen(button, pressed);
+
+      if (button.mSeenOff && button.mSeenOn) {
+        ImGui::TextColored(
+          Config::FULL_RANGE_COLOR, "%s", button.mName.c_str());
+      } else {
+        ImGui::Text("%s", button.mName.c_str());
+      }
+    }
+
+    ImGui::PopID();
+  }
+}
+
+static ResultsDatabase::TimingStats GetTimingStats(
+  const RollingSamples::Summary& summary) {
+  return {
+    .mP50 = summary.mP50,
+    .mP99 = summary.mP99,
+    .mMax = summary.mMax,
+  };
+}
+
+void ControllerGUI::GUIRecordResult(DeviceInfo* device) {
+  if (ImGui::Button("Record result")) {
+    const auto& performance = GetDevicePerformance(device);
+    const auto result = MakeUnitResult(
+      *device,
+      GetTimingStats(performance.mPoll.GetSummary(&mFrameArena)),
+      GetTimingStats(performance.mGetState.GetSummary(&mFrameArena)));
+    if (mResults->Append(result)) {
+      mRecordedResults[device->mGuid] = result.mPassed;
+    } else {
+      mRecordedResults.erase(device->mGuid);
+    }
+  }
+
+  const auto it = mRecordedResults.find(device->mGuid);
+  if (it != mRecordedResults.end()) {
+    ImGui::SameLine();
+    if (it->second) {
+      ImGui::Text("Recorded: passed");
+    } else {
+      ImGui::Text("Recorded: not fully tested");
+    }
+  }
+}
+
+void ControllerGUI::SetCaptureDirectory(std::filesystem::path directory) {
+  mCaptureDirectory = std::move(directory);
+}
+
+// Without an extension
+static std::string GetCaptureFileStem(const DeviceInfo& device) {
+  std::string name;
+  for (const auto c: device.mName) {
+    const bool safe = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+      || (c >= '0' && c <= '9') || c == '-';
+    name += safe ? c : '_';
+  }
+  const auto now = std::chrono::floor<std::chrono::seconds>(
+    std::chrono::system_clock::now());
+  return std::format("{}-{:%Y%m%d-%H%M%S}", name, now);
+}
+
+void ControllerGUI::GUICapture(
+  DeviceInfo* device,
+  const DeviceState& state,
+  bool fresh) {
+  auto it = mCaptures.find(device->mGuid);
+  if (it == mCaptures.end()) {
+    if (ImGui::Button("Start capture")) {
+      auto writer = std::make_unique<CaptureWriter>(
+        *mCaptureDirectory / (GetCaptureFileStem(*device) + ".fctcap"),
+        *device);
+      if (writer->IsValid()) {
+        mCaptures.emplace(device->mGuid, std::move(writer));
+      }
+    }
+    return;
+  }
+
+  auto& writer = *it->second;
+  // Repeating a stale state would look like a device that stopped moving
+  if (fresh) {
+    writer.Append(CaptureWriter::Clock::now(), state);
+  }
+  if (ImGui::Button("Stop capture") || !writer.IsValid()) {
+    mCaptures.erase(it);
+    return;
+  }
+  ImGui::SameLine();
+  ImGui::Text("%zu samples", writer.GetSampleCount());
+}
+
+void ControllerGUI::GUISampling(DeviceInfo* device) {
+  const auto it = mSamplingSessions.find(device->mGuid);
+  if (it == mSamplingSessions.end()) {
+    if (ImGui::Button("Start high-rate sampling")) {
+      mStartSampling = device->mGuid;
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Sampling settings")) {
+      ImGui::OpenPopup("Sampling settings");
+    }
+    GUISamplingSettings();
+    return;
+  }
+
+  if (ImGui::Button("Stop sampling")) {
+    mSamplingSessions.erase(it);
+    return;
+  }
+
+  const auto& session = it->second;
+  ImGui::SameLine();
+  ImGui::Text(
+    "%llu samples",
+    static_cast<unsigned long long>(session.mSampler->GetSampleCount()));
+  if (const auto realTime = session.mSampler->GetRealTimeStatus()) {
+    ImGui::SameLine();
+    ImGui::TextDisabled(
+      "(low-jitter: %s)",
+      FormatRealTimeStatus(session.mSampler->GetRealTimeSettings(), *realTime)
+        .c_str());
+  }
+
+  if (const auto& capture = session.mTriggeredCapture) {
+    ImGui::SameLine();
+    ImGui::Text(
+      "%llu triggered captures",
+      static_cast<unsigned long long>(capture->GetCaptureCount()));
+    const auto dropped = capture->GetDroppedTriggerCount();
+    if (dropped) {
+      ImGui::SameLine();
+      ImGui::TextColored(
+        Config::WARNING_COLOR,
+        "(%llu more dropped while writing)",
+        static_cast<unsigned long long>(dropped));
+    }
+  }
+  if (session.mFeed) {
+    ImGui::SameLine();
+    ImGui::TextDisabled("(shared with other apps)");
+  } else if (!session.mFeedError.empty()) {
+    ImGui::SameLine();
+    ImGui::TextColored(
+      Config::WARNING_COLOR, "(not shared: %s)", session.mFeedError.c_str());
+  }
+
+  GUIAnomalies(device, *session.mAnomalies);
+  GUINoise(device, *session.mNoise);
+}
+
+void ControllerGUI::GUIAnomalies(
+  DeviceInfo* device,
+  const AnomalyDetector& detector) {
+  uint64_t total {};
+  for (std::size_t i = 0; i < ANOMALY_TYPE_COUNT; ++i) {
+    total += detector.GetAnomalyCount(static_cast<AnomalyType>(i));
+  }
+  if (total == 0) {
+    ImGui::TextDisabled("No anomalies detected.");
+    return;
+  }
+
+  ImGui::PushStyleColor(ImGuiCol_Text, Config::WARNING_COLOR);
+  const auto open = ImGui::CollapsingHeader(
+    std::format("Anomalies ({})###Anomalies", total).c_str());
+  ImGui::PopStyleColor();
+  if (!open) {
+    return;
+  }
+
+  const auto anomalies = detector.GetRecentAnomalies(&mFrameArena);
+  ImGui::BeginChild(
+    "##AnomalyLog", {-FLT_MIN, ImGui::GetTextLineHeightWithSpacing() * 8});
+  // Newest first
+  for (auto it = anomalies.rbegin(); it != anomalies.rend(); ++it) {
+    const auto seconds = std::chrono::duration<double>(it->mTime).count();
+    if (it->mType == AnomalyType::ReadFailure) {
+      ImGui::Text("%10.3fs  %s", seconds, GetAnomalyTypeName(it->mType));
+      continue;
+    }
+    const auto axisName = (it->mAxis < device->mAxes.size())
+      ? device->mAxes[it->mAxis].mName.c_str()
+      : "?";
+    ImGui::Text(
+      "%10.3fs  %s: %s = %d",
+      seconds,
+      GetAnomalyTypeName(it->mType),
+      axisName,
+      it->mValue);
+  }
+  ImGui::EndChild();
+}
+
+void ControllerGUI::GUINoise(
+  DeviceInfo* device,
+  const NoiseAnalyzer& analyzer) {
+  if (!ImGui::CollapsingHeader("Noise")) {
+    return;
+  }
+  const Trace::Zone traceZone {"ControllerGUI::GUINoise"};
+  // Below 16-bit quantization noise
+  constexpr float minLevel {-120};
+  const auto height = ImGui::GetTextLineHeightWithSpacing() * 3;
+
+  for (std::size_t i = 0; i < device->mAxes.size(); ++i) {
+    const auto& name = device->mAxes.at(i).mName;
+    const auto spectrum = analyzer.GetSpectrum(i, &mFrameArena);
+    if (spectrum.mGeneration == 0) {
+      ImGui::TextDisabled("%s: collecting samples...", name.c_str());
+      continue;
+    }
+
+    if (spectrum.mPeaks.empty()) {
+      ImGui::Text(
+        "%s: no peaks; noise floor %.0f dB",
+        name.c_str(),
+        spectrum.mNoiseFloor);
+    } else {
+      std::string peaks;
+      for (const auto& peak: spectrum.mPeaks) {
+        peaks += std::format(
+          "{}{:.1f} Hz ({:+.0f} dB)",
+          peaks.empty() ? "" : ", ",
+          peak.mFrequency,
+          peak.mLevel - spectrum.mNoiseFloor);
+      }
+      ImGui::PushStyleColor(ImGuiCol_Text, Config::WARNING_COLOR);
+      ImGui::Text("%s: %s", name.c_str(), peaks.c_str());
+      ImGui::PopStyleColor();
+    }
+
+    ImGui::SetNextItemWidth(-FLT_MIN);
+    ImGui::PlotLines(
+      std::format("##Spectrum{}", i).c_str(),
+      spectrum.mLevels.data(),
+      static_cast<int>(spectrum.mLevels.size()),
+      0,
+      std::format(
+        "0-{:.0f} Hz", spectrum.mBinWidth * (spectrum.mLevels.size() - 1))
+        .c_str(),
+      minLevel,
+      0,
+      {0, height});
+  }
+}
+
+void ControllerGUI::GUISamplingSettings() {
+  if (!ImGui::BeginPopup("Sampling settings")) {
+    return;
+  }
+
+  ImGui::SeparatorText("Anomalies");
+  float jump = mAnomalyThresholds.mJumpFraction * 100;
+  if (ImGui::SliderFloat(
+        "Spike or dropout size", &jump, 1, 100, "%.0f%% of range")) {
+    mAnomalyThresholds.mJumpFraction = jump / 100;
+  }
+  auto frozenAfter = static_cast<float>(
+    std::chrono::duration<double>(mAnomalyThresholds.mFrozenAfter).count());
+  if (ImGui::SliderFloat("Frozen after", &frozenAfter, 0.1f, 30, "%.1f s")) {
+    mAnomalyThresholds.mFrozenAfter
+      = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::duration<float>(frozenAfter));
+  }
+
+  ImGui::SeparatorText("Noise");
+  ImGui::SliderFloat(
+    "Ignore below",
+    &mNoiseSettings.mMinimumFrequency,
+    1,
+    100,
+    "%.0f Hz");
+
+  if (mCaptureDirectory) {
+    ImGui::SeparatorText("Triggered captures");
+    ImGui::Checkbox("Enabled", &mTriggeredCaptures);
+    ImGui::BeginDisabled(!mTriggeredCaptures);
+    auto& conditions = mTriggerSettings.mConditions;
+    float axisJump = conditions.mAxisJump * 100;
+    if (ImGui::SliderFloat(
+          "Axis jump in one sample", &axisJump, 0, 100, "%.0f%% of range")) {
+      conditions.mAxisJump = axisJump / 100;
+    }
+    ImGui::Checkbox("Axis leaves its range", &conditions.mOutOfRange);
+    ImGui::Checkbox("Button pressed or released", &conditions.mButtonChange);
+    ImGui::Checkbox("Hat leaves center", &conditions.mHatLeavesCenter);
+
+    auto preTrigger = static_cast<int>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+        mTriggerSettings.mPreTrigger)
+        .count());
+    if (ImGui::SliderInt("Before trigger", &preTrigger, 0, 5000, "%d ms")) {
+      mTriggerSettings.mPreTrigger = std::chrono::milliseconds {preTrigger};
+    }
+    auto postTrigger = static_cast<int>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+        mTriggerSettings.mPostTrigger)
+        .count());
+    if (ImGui::SliderInt("After trigger", &postTrigger, 0, 5000, "%d ms")) {
+      mTriggerSettings.mPostTrigger = std::chrono::milliseconds {postTrigger};
+    }
+    ImGui::EndDisabled();
+  }
+
+  ImGui::SeparatorText("Timing");
+  ImGui::Checkbox("Low-jitter mode", &mRealTime.mEnabled);
+  if (ImGui::IsItemHovered()) {
+    ImGui::SetTooltip(
+      "Pins each sampling thread to a core at real-time priority, and spins "
+      "for the end of each wait. Samples are closer to on time, but use much "
+      "more CPU; compare with freds-controller-tester-jitter.");
+  }
+
+  ImGui::SeparatorText("Sharing");
+  ImGui::Checkbox("Share samples with other apps", &mSharedFeeds);
+  if (ImGui::IsItemHovered()) {
+    ImGui::SetTooltip(
+      "Other apps, such as freds-controller-tester-feed, can read every "
+      "sample from shared memory without opening the device.");
+  }
+
+  ImGui::Separator();
+  ImGui::TextDisabled("Changes take effect the next time sampling starts.");
+  ImGui::EndPopup();
+}
+
+ControllerGUI::SamplingSession ControllerGUI::CreateSamplingSession(
+  const DeviceInfo& device) {
+  SamplingSession ret {
+    .mAnomalies = std::make_unique<AnomalyDetector>(device, mAnomalyThresholds),
+    .mNoise = std::make_unique<NoiseAnalyzer>(device, mNoiseSettings),
+  };
+  if (mTriggeredCaptures && mCaptureDirectory) {
+    ret.mTriggeredCapture = std::make_unique<TriggeredCapture>(
+      device,
+      *mCaptureDirectory / (GetCaptureFileStem(device) + "-trigger"),
+      mTriggerSettings);
+  }
+  if (mSharedFeeds) {
+    if (!mFeedDirectory) {
+      mFeedDirectory = std::make_unique<SharedFeedDirectory>();
+    }
+    ret.mFeed = std::make_unique<SharedFeedWriter>(
+      device, SHARED_FEED_CAPACITY, mFeedDirectory.get());
+    if (!ret.mFeed->IsValid()) {
+      const auto error = ret.mFeed->GetError();
+      ret.mFeedError = (error == std::errc::file_exists)
+        ? "already shared by another process"
+        : error.message();
+      ret.mFeed.reset();
+    }
+  }
+  return ret;
+}
+
+ControllerGUI::Reader& ControllerGUI::GetReader(const DeviceInfo& device) {
+  auto& ret = mReaders[device.mGuid];
+  if (
+    ret.mReader
+    && (ret.mAxisCount != device.mAxes.size()
+        || ret.mButtonCount != device.mButtons.size()
+        || ret.mHatCount != device.mHats.size())) {
+    ret.mReader.reset();
+  }
+  if (!ret.mReader) {
+    ret.mAxisCount = device.mAxes.size();
+    ret.mButtonCount = device.mButtons.size();
+    ret.mHatCount = device.mHats.size();
+  }
+  return ret;
+}
+
+DeviceReader::Reading ControllerGUI::ReadState(
+  DeviceInfo* device,
+  DeviceReader& reader) {
+  auto reading = [&reader, this]() {
+    const Trace::Zone traceZone {"DeviceReader::Read"};
+    return reader.Read(&mFrameArena);
+  }();
+
+  auto& performance = GetDevicePerformance(device);
+  if (reading.mFresh) {
+    const auto now = RollingSamples::Clock::now();
+    performance.mPoll.Push(
+      std::chrono::duration<float, std::milli>(reading.mPoll).count(), now);
+    performance.mGetState.Push(
+      std::chrono::duration<float, std::milli>(reading.mGetState).count(),
+      now);
+  }
+
+  const auto health = reader.GetHealth(&mFrameArena);
+  performance.mDegraded = health.mDegraded;
+  performance.mSpikeCount = health.mSpikeCount;
+  GUIDeviceHealth(health);
+  return reading;
+}
+
+void ControllerGUI::GUIDeviceHealth(const DeviceReader::Health& health) {
+  if (health.mHungCall) {
+    ImGui::TextColored(
+      Config::WARNING_COLOR,
+      "Not responding: %s has been running for %.1fs; showing the last "
+      "state read.",
+      DeviceReader::GetCallName(*health.mHungCall),
+      std::chrono::duration<float>(health.mHungFor).count());
+  } else if (health.mDegraded) {
+    ImGui::TextColored(
+      Config::WARNING_COLOR,
+      "Degraded: the driver was slow to respond, so it's only being read "
+      "occasionally until it's back to normal.");
+  }
+  if (health.mSpikeCount == 0) {
+    return;
+  }
+
+  ImGui::PushStyleColor(ImGuiCol_Text, Config::WARNING_COLOR);
+  const auto open = ImGui::CollapsingHeader(
+    std::format("Latency spikes ({})###LatencySpikes", health.mSpikeCount)
+      .c_str());
+  ImGui::PopStyleColor();
+  if (!open) {
+    return;
+  }
+
+  const auto now = DeviceReader::Clock::now();
+  // Newest first
+  for (auto it = health.mSpikes.rbegin(); it != health.mSpikes.rend(); ++it) {
+    ImGui::Text(
+      "%8.1fs ago  %s took %.0fms",
+      std::chrono::duration<float>(now - it->mStart).count(),
+      DeviceReader::GetCallName(it->mCall),
+      std::chrono::duration<float, std::milli>(it->mDuration).count());
+  }
+}
+
+ControllerGUI::DevicePerformance& ControllerGUI::GetDevicePerformance(
+  DeviceInfo* device) {
+  auto [it, inserted] = mDevicePerformance.try_emplace(device->mGuid);
+  if (inserted) {
+    it->second.mName = device->mName;
+  }
+  return it->second;
+}
+
+}// namespace FredEmmott::ControllerTester
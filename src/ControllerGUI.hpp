@@ -0,0 +1,259 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#pragma once
+
+#include <chrono>
+#include <concepts>
+#include <cstddef>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "AnomalyDetector.hpp"
+#include "Capture.hpp"
+#include "DeviceInfo.hpp"
+#include "DeviceReader.hpp"
+#include "DeviceState.hpp"
+#include "FrameArena.hpp"
+#include "Guid.hpp"
+#include "NoiseAnalysis.hpp"
+#include "PerformanceMetrics.hpp"
+#include "ResultsDatabase.hpp"
+#include "Sampler.hpp"
+#include "SharedSampleFeed.hpp"
+#include "Trace.hpp"
+#include "TriggeredCapture.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+// Sized for the F12 overlay
+RollingSamples MakeHUDSamples();
+
+/* The contents of a controller's tab.
+ *
+ * This only needs an ImGui context, so it can be driven without a window,
+ * e.g. by the benchmarks.
+ */
+class ControllerGUI final {
+ public:
+  explicit ControllerGUI(FrameArena&);
+
+  ControllerGUI() = delete;
+  ControllerGUI(const ControllerGUI&) = delete;
+  ControllerGUI(ControllerGUI&&) = delete;
+  ControllerGUI& operator=(const ControllerGUI&) = delete;
+  ControllerGUI& operator=(ControllerGUI&&) = delete;
+
+  /* Must be called inside an ImGui tab bar.
+   *
+   * The device is read on the GUI thread, so this is only suitable for
+   * devices that never block, e.g. the benchmarks' synthetic devices.
+   */
+  template <Device T>
+  void GUIControllerTab(T* device) {
+    if (!BeginControllerTab(device)) {
+      return;
+    }
+    EndControllerTab(
+      device,
+      ReadState(device),
+      /* fresh = */ true,
+      /* canSample = */ false);
+  }
+
+  /* Also offers high-rate sampling, for anomaly detection and triggered
+   * captures.
+   *
+   * `getOpener(const T&)` returns a `DeviceOpener` for a second instance of
+   * the device; see `DeviceTracker::GetOpener()`. One instance is opened
+   * and read for the tab by a `DeviceReader`, on its own thread, so a driver
+   * that blocks can't freeze the GUI, and another is polled on its own
+   * thread while sampling.
+   */
+  template <Device T, std::invocable<const T&> FGetOpener>
+  void GUIControllerTab(T* device, FGetOpener&& getOpener) {
+    if (!BeginControllerTab(device)) {
+      return;
+    }
+    auto& reader = GetReader(*device);
+    if (!reader.mReader) {
+      reader.mReader = std::make_unique<DeviceReader>(getOpener(*device));
+    }
+    const auto reading = ReadState(device, *reader.mReader);
+    EndControllerTab(
+      device, reading.mState, reading.mFresh, /* canSample = */ true);
+
+    if (mStartSampling != device->mGuid) {
+      return;
+    }
+    mStartSampling.reset();
+    if (auto another = getOpener(*device)()) {
+      StartSampling(std::move(*another));
+    }
+  }
+
+  struct Performance {
+    Performance();
+
+    RollingSamples mAxes;
+    RollingSamples mButtons;
+    RollingSamples mHats;
+  };
+  const Performance& GetPerformance() const;
+
+  struct DevicePerformance {
+    DevicePerformance();
+
+    std::string mName;
+    RollingSamples mPoll;
+    RollingSamples mGetState;
+    // From the device's `DeviceReader`, if it has one
+    bool mDegraded {false};
+    uint64_t mSpikeCount {};
+  };
+  const std::map<Guid, DevicePerformance>& GetDevicePerformance() const;
+
+  // Closes the readers, sampling sessions, and captures of devices that
+  // aren't in `present`, so a device that's added again gets new instances
+  void RemoveMissingDevices(std::span<const Guid> present);
+
+  // Adds a 'Record result' button to each tab; may be null
+  void SetResultsDatabase(ResultsDatabase*);
+  // Adds a 'Start capture' button to each tab; captures include every
+  // state read while the tab is open
+  void SetCaptureDirectory(std::filesystem::path);
+
+ private:
+  bool BeginControllerTab(DeviceInfo*);
+  // Draws the controls, and ends the tab; `fresh` is false if the state
+  // was already shown, e.g. while the device isn't responding
+  void EndControllerTab(
+    DeviceInfo*,
+    const std::optional<DeviceState>&,
+    bool fresh,
+    bool canSample);
+
+  template <Device T>
+  std::optional<DeviceState> ReadState(T* device) {
+    auto& performance = GetDevicePerformance(device);
+    {
+      const Trace::Zone traceZone {"DeviceInfo::Poll"};
+      ScopedTimer timer {performance.mPoll};
+      device->Poll();
+    }
+    const Trace::Zone traceZone {"DeviceInfo::GetState"};
+    ScopedTimer timer {performance.mGetState};
+    return device->GetState(&mFrameArena);
+  }
+  struct Reader {
+    // Reopens the device itself if it stops working
+    std::unique_ptr<DeviceReader> mReader {};
+    // The controls it was opened with; a device that's added again with
+    // the same GUID can have different controls
+    std::size_t mAxisCount {};
+    std::size_t mButtonCount {};
+    std::size_t mHatCount {};
+  };
+
+  // Closes the reader if it was opened with different controls
+  Reader& GetReader(const DeviceInfo&);
+  // Also shows the reader's health
+  DeviceReader::Reading ReadState(DeviceInfo*, DeviceReader&);
+
+  void GUIControllerAxes(DeviceInfo* info, const DeviceState& state);
+  void GUIControllerButtons(
+    DeviceInfo* info,
+    const DeviceState& state,
+    size_t first,
+    size_t count);
+  void GUIControllerHats(DeviceInfo* info, const DeviceState& state);
+  void GUIRecordResult(DeviceInfo* info);
+  void GUICapture(DeviceInfo* info, const DeviceState& state, bool fresh);
+  void GUISampling(DeviceInfo* info);
+  void GUISamplingSettings();
+  void GUIAnomalies(DeviceInfo* info, const AnomalyDetector&);
+  void GUINoise(DeviceInfo* info, const NoiseAnalyzer&);
+  void GUIDeviceHealth(const DeviceReader::Health&);
+
+  struct SamplingSession {
+    std::unique_ptr<AnomalyDetector> mAnomalies {};
+    std::unique_ptr<NoiseAnalyzer> mNoise {};
+    // Null if triggered captures are disabled
+    std::unique_ptr<TriggeredCapture> mTriggeredCapture {};
+    // Null if sharing is disabled, or the feed couldn't be created
+    std::unique_ptr<SharedFeedWriter> mFeed {};
+    // Why the feed couldn't be created
+    std::string mFeedError {};
+    // Declared last so it's stopped first, as it uses the others
+    std::unique_ptr<Sampler> mSampler {};
+  };
+  // Everything except the sampler
+  SamplingSession CreateSamplingSession(const DeviceInfo&);
+
+  template <Device T>
+  void StartSampling(T&& device) {
+    const auto guid = device.mGuid;
+    auto session = CreateSamplingSession(device);
+    // A core per session, so that sessions don't delay each other
+    auto realTime = mRealTime;
+    realTime.mCore = GetRealTimeCore(mSamplingSessions.size());
+    session.mSampler = std::make_unique<Sampler>(
+      std::move(device),
+      mTriggerSettings.mSampleInterval,
+      [anomalies = session.mAnomalies.get(),
+       noise = session.mNoise.get(),
+       capture = session.mTriggeredCapture.get(),
+       feed = session.mFeed.get()](
+        Sampler::Clock::time_point time,
+        const std::optional<DeviceState>& state) {
+        if (!state) {
+          anomalies->PushReadFailure(time);
+          return;
+        }
+        anomalies->Push(time, *state);
+        noise->Push(time, *state);
+        if (capture) {
+          capture->Push(time, *state);
+        }
+        if (feed) {
+          feed->Push(time, *state);
+        }
+      },
+      realTime);
+    mSamplingSessions.insert_or_assign(guid, std::move(session));
+  }
+
+  FrameArena& mFrameArena;
+  Performance mPerformance;
+  std::map<Guid, DevicePerformance> mDevicePerformance;
+  ResultsDatabase* mResults {nullptr};
+  // Whether the last recorded result for each unit passed
+  std::map<Guid, bool> mRecordedResults;
+  std::optional<std::filesystem::path> mCaptureDirectory;
+  std::map<Guid, std::unique_ptr<CaptureWriter>> mCaptures;
+  // Created when a device's tab is first shown, and kept for its history
+  // until the device is removed
+  std::map<Guid, Reader> mReaders;
+
+  AnomalyThresholds mAnomalyThresholds;
+  NoiseAnalysisSettings mNoiseSettings;
+  bool mTriggeredCaptures {false};
+  TriggeredCaptureSettings mTriggerSettings;
+  bool mSharedFeeds {true};
+  RealTimeSettings mRealTime;
+  // Created with the first feed; outlives the sessions, which use it
+  std::unique_ptr<SharedFeedDirectory> mFeedDirectory;
+  // Set by the 'Start sampling' button, as opening the device needs its type
+  std::optional<Guid> mStartSampling;
+  std::map<Guid, SamplingSession> mSamplingSessions;
+  DevicePerformance& GetDevicePerformance(DeviceInfo*);
+};
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,125 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "DecodePlan.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) \
+  || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FCT_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace FredEmmott::ControllerTester {
+
+namespace {
+
+template <class TRuns, class TControls>
+void AppendRuns(
+  TRuns& runs,
+  const TControls& controls,
+  uint32_t stride,
+  std::size_t& rawSize) {
+  for (uint32_t i = 0; i < controls.size(); ++i) {
+    const auto offset = controls[i].mDataOffset;
+    rawSize = std::max<std::size_t>(rawSize, offset + stride);
+    if (!runs.empty()) {
+      auto& last = runs.back();
+      if (last.mRawOffset + (last.mCount * stride) == offset) {
+        ++last.mCount;
+        continue;
+      }
+    }
+    runs.push_back({.mRawOffset = offset, .mFirstIndex = i, .mCount = 1});
+  }
+}
+
+// The high bit of 8 DirectInput button bytes, with the first byte in the
+// lowest bit
+uint64_t PackButtons(const std::byte* bytes) {
+  uint64_t x {};
+  std::memcpy(&x, bytes, sizeof(x));
+  x &= 0x8080'8080'8080'8080;
+  // Moves the high bit of byte N to bit (56 + N); the shifted copies never
+  // overlap, so there are no carries
+  return (x * 0x0002'0408'1020'4081) >> 56;
+}
+
+void SetButtons(
+  std::span<uint64_t> words,
+  std::size_t firstIndex,
+  uint64_t bits,
+  std::size_t count) {
+  const auto word = firstIndex / DeviceState::BUTTONS_PER_WORD;
+  const auto shift = firstIndex % DeviceState::BUTTONS_PER_WORD;
+  words[word] |= bits << shift;
+  if (shift + count > DeviceState::BUTTONS_PER_WORD) {
+    words[word + 1] |= bits >> (DeviceState::BUTTONS_PER_WORD - shift);
+  }
+}
+
+}// namespace
+
+DecodePlan::DecodePlan(const DeviceInfo& info)
+  : mAxisCount(info.mAxes.size()),
+    mHatCount(info.mHats.size()),
+    mButtonCount(info.mButtons.size()) {
+  AppendRuns(mAxisRuns, info.mAxes, sizeof(int32_t), mRawSize);
+  AppendRuns(mHatRuns, info.mHats, sizeof(int32_t), mRawSize);
+  AppendRuns(mButtonRuns, info.mButtons, 1, mRawSize);
+}
+
+std::size_t DecodePlan::GetRawSize() const {
+  return mRawSize;
+}
+
+std::size_t DecodePlan::GetRunCount() const {
+  return mAxisRuns.size() + mHatRuns.size() + mButtonRuns.size();
+}
+
+void DecodePlan::Decode(std::span<const std::byte> raw, DeviceState& state)
+  const {
+  assert(raw.size() >= mRawSize);
+  state.Resize(mAxisCount, mHatCount, mButtonCount);
+  const auto buf = raw.data();
+
+  for (const auto& run: mAxisRuns) {
+    std::memcpy(
+      state.mAxes.data() + run.mFirstIndex,
+      buf + run.mRawOffset,
+      run.mCount * sizeof(int32_t));
+  }
+  for (const auto& run: mHatRuns) {
+    std::memcpy(
+      state.mHats.data() + run.mFirstIndex,
+      buf + run.mRawOffset,
+      run.mCount * sizeof(int32_t));
+  }
+
+  const std::span<uint64_t> words {state.mButtons};
+  for (const auto& run: mButtonRuns) {
+    auto src = buf + run.mRawOffset;
+    std::size_t index = run.mFirstIndex;
+    std::size_t remaining = run.mCount;
+#ifdef FCT_HAVE_SSE2
+    for (; remaining >= 16; remaining -= 16, src += 16, index += 16) {
+      const auto bits = _mm_movemask_epi8(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+      SetButtons(words, index, static_cast<uint16_t>(bits), 16);
+    }
+#endif
+    for (; remaining >= 8; remaining -= 8, src += 8, index += 8) {
+      SetButtons(words, index, PackButtons(src), 8);
+    }
+    for (; remaining > 0; --remaining, ++src, ++index) {
+      if (std::to_integer<uint8_t>(*src) & 0x80) {
+        SetButtons(words, index, 1, 1);
+      }
+    }
+  }
+}
+
+}// namespace FredEmmott::ControllerTester
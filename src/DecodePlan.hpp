@@ -0,0 +1,56 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "DeviceInfo.hpp"
+#include "DeviceState.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+/* A DirectInput-style data format, compiled into block copies.
+ *
+ * Built once per device from the `mDataOffset`s; consecutive controls that
+ * are also adjacent in the raw buffer become a single run. DirectInput
+ * formats built by `DirectInputDeviceInfo` are always one run of axes, one
+ * of hats, and one of buttons, so `Decode()` is two `memcpy()`s and a
+ * pass over the button bytes that packs 16 at a time with SSE2 where
+ * available.
+ *
+ * Produces the same results as `DecodeState()`.
+ */
+class DecodePlan final {
+ public:
+  DecodePlan() = default;
+  explicit DecodePlan(const DeviceInfo&);
+
+  // `raw` must be at least `GetRawSize()` bytes
+  void Decode(std::span<const std::byte> raw, DeviceState&) const;
+
+  // One past the last byte that's read
+  std::size_t GetRawSize() const;
+  // For diagnostics and benchmarks
+  std::size_t GetRunCount() const;
+
+ private:
+  struct Run {
+    uint32_t mRawOffset {};
+    uint32_t mFirstIndex {};
+    uint32_t mCount {};
+  };
+
+  std::vector<Run> mAxisRuns;
+  std::vector<Run> mHatRuns;
+  std::vector<Run> mButtonRuns;
+
+  std::size_t mAxisCount {};
+  std::size_t mHatCount {};
+  std::size_t mButtonCount {};
+  std::size_t mRawSize {};
+};
+
+}// namespace FredEmmott::ControllerTester
@@ -1,11 +0,0 @@
-// Copyright 2023 Fred Emmott <fred@fredemmott.com>
-// SPDX-License-Identifier: ISC
-
-#include "DeviceInfo.hpp"
-
-namespace FredEmmott::ControllerTester {
-
-DeviceInfo::~DeviceInfo() {
-}
-
-}
\ No newline at end of file
@@ -2,27 +2,45 @@
 // SPDX-License-Identifier: ISC
 #pragma once
 
-#include <winrt/base.h>
-
+#include <concepts>
+#include <cstddef>
+#include <memory_resource>
+#include <optional>
+#include <string>
 #include <vector>
 
 #include "ControlInfo.hpp"
+#include "DeviceState.hpp"
+#include "Guid.hpp"
 
 namespace FredEmmott::ControllerTester {
 
+/* The backend-independent parts of a device.
+ *
+ * This is not polymorphic: backends provide `Poll()` and `GetState()` on
+ * their own `final` types (see the `Device` concept), and code that needs to
+ * handle several backends uses `DeviceSet`, so those calls can be inlined.
+ */
 struct DeviceInfo {
-  virtual ~DeviceInfo() = 0;
-
   std::string mName;
-  winrt::guid mGuid;
+  // Identifies this unit
+  Guid mGuid;
+  // Shared by every unit of the same model, if the backend can tell
+  Guid mProduct;
 
   std::vector<AxisInfo> mAxes;
   std::vector<ButtonInfo> mButtons;
   std::vector<HatInfo> mHats;
-
-  virtual bool Poll() = 0;
-
-  virtual std::vector<std::byte> GetState() = 0;
 };
 
-}// namespace FredEmmott::ControllerTester
\ No newline at end of file
+// `GetState()` returns nullopt if the device couldn't be read
+template <class T>
+concept Device = std::derived_from<T, DeviceInfo>
+  && requires(T& device, std::pmr::memory_resource* resource) {
+       { device.Poll() } -> std::same_as<bool>;
+       {
+         device.GetState(resource)
+       } -> std::same_as<std::optional<DeviceState>>;
+     };
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,295 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "DeviceReader.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+#include "Trace.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+struct DeviceReader::Shared {
+  explicit Shared(std::unique_ptr<AnySource> source)
+    : mSource(std::move(source)) {
+  }
+  explicit Shared(Opener open) : mOpen(std::move(open)) {
+  }
+
+  // Only used on the reader thread; null until `mOpen` succeeds, if there's
+  // an opener
+  std::unique_ptr<AnySource> mSource;
+  Opener mOpen;
+
+  // For the watchdog, without waiting for the mutex; nanoseconds since the
+  // clock's epoch, or 0 between calls
+  std::atomic<int64_t> mCallStarted {0};
+  std::atomic<Call> mCall {Call::Poll};
+
+  mutable std::mutex mMutex;
+  std::condition_variable mWakeup;
+  // Protected by `mMutex`
+  bool mStop {false};
+  bool mRequested {false};
+  bool mBusy {false};
+  std::optional<DeviceState> mLatest;
+  uint64_t mSequence {};
+  Clock::duration mPoll {};
+  Clock::duration mGetState {};
+  bool mDegraded {false};
+  std::size_t mOnTime {};
+  uint64_t mSpikeCount {};
+  std::array<Spike, MAX_SPIKES> mSpikes {};
+};
+
+DeviceReader::AnySource::~AnySource() = default;
+
+DeviceReader::Health::Health(std::pmr::memory_resource* resource)
+  : mSpikes(resource) {
+}
+
+const char* DeviceReader::GetCallName(Call call) {
+  switch (call) {
+    case Call::Poll:
+      return "Poll()";
+    case Call::GetState:
+      return "GetState()";
+  }
+  return "Unknown";
+}
+
+DeviceReader::DeviceReader(
+  std::unique_ptr<AnySource> source,
+  const DeviceReaderSettings& settings)
+  : mSettings(settings),
+    mShared(std::make_shared<Shared>(std::move(source))),
+    mThread(&DeviceReader::Run, mShared, settings) {
+}
+
+DeviceReader::DeviceReader(
+  Opener open,
+  const DeviceReaderSettings& settings)
+  : mSettings(settings),
+    mShared(std::make_shared<Shared>(std::move(open))),
+    mThread(&DeviceReader::Run, mShared, settings) {
+}
+
+DeviceReader::~DeviceReader() {
+  std::unique_lock lock(mShared->mMutex);
+  mShared->mStop = true;
+  mShared->mWakeup.notify_all();
+  const auto idle = mShared->mWakeup.wait_for(
+    lock, mSettings.mWait, [this] { return !mShared->mBusy; });
+  lock.unlock();
+
+  if (idle) {
+    mThread.join();
+  } else {
+    // Blocking here would freeze the GUI for as long as the driver does
+    mThread.detach();
+  }
+}
+
+DeviceReader::Reading DeviceReader::Read(std::pmr::memory_resource* resource) {
+  auto& shared = *mShared;
+  std::unique_lock lock(shared.mMutex);
+  // Requests are skipped while degraded, so a hung device is only waited
+  // for by the probes
+  if (!(shared.mDegraded || GetHungFor(shared, mSettings, Clock::now()))) {
+    shared.mRequested = true;
+    shared.mWakeup.notify_all();
+    const auto target = shared.mSequence + 1;
+    shared.mWakeup.wait_for(lock, mSettings.mWait, [&shared, target] {
+      return shared.mSequence >= target;
+    });
+  }
+
+  Reading ret;
+  ret.mFresh = shared.mSequence != mSequence;
+  mSequence = shared.mSequence;
+  if (ret.mFresh) {
+    ret.mPoll = shared.mPoll;
+    ret.mGetState = shared.mGetState;
+  }
+  if (shared.mLatest) {
+    // Assignment keeps `resource`, unlike copy construction
+    ret.mState.emplace(resource);
+    *ret.mState = *shared.mLatest;
+  }
+  return ret;
+}
+
+DeviceReader::Health DeviceReader::GetHealth(
+  std::pmr::memory_resource* resource) const {
+  const auto& shared = *mShared;
+  Health ret {resource};
+  std::unique_lock lock(shared.mMutex);
+  ret.mDegraded = shared.mDegraded;
+  if (const auto hungFor = GetHungFor(shared, mSettings, Clock::now())) {
+    ret.mDegraded = true;
+    ret.mHungCall = shared.mCall.load(std::memory_order_relaxed);
+    ret.mHungFor = *hungFor;
+  }
+
+  ret.mSpikeCount = shared.mSpikeCount;
+  const auto count = std::min<uint64_t>(shared.mSpikeCount, MAX_SPIKES);
+  ret.mSpikes.reserve(count);
+  for (auto i = shared.mSpikeCount - count; i < shared.mSpikeCount; ++i) {
+    ret.mSpikes.push_back(shared.mSpikes[i % MAX_SPIKES]);
+  }
+  return ret;
+}
+
+std::optional<DeviceReader::Clock::duration> DeviceReader::GetHungFor(
+  const Shared& shared,
+  const DeviceReaderSettings& settings,
+  Clock::time_point now) {
+  const auto started = shared.mCallStarted.load(std::memory_order_acquire);
+  if (!started) {
+    return std::nullopt;
+  }
+  const auto elapsed
+    = now - Clock::time_point {std::chrono::nanoseconds {started}};
+  if (elapsed <= settings.mDeadline) {
+    return std::nullopt;
+  }
+  return elapsed;
+}
+
+void DeviceReader::Run(
+  std::shared_ptr<Shared> sharedPtr,
+  DeviceReaderSettings settings) {
+  Trace::SetThreadName("DeviceReader");
+  auto& shared = *sharedPtr;
+  // Enough for the largest DirectInput state; states are decoded into
+  // this instead of the heap
+  alignas(std::max_align_t) std::array<std::byte, 4096> buffer;
+
+  const auto timeCall = [&shared](Call call, auto&& f) {
+    const auto start = Clock::now();
+    shared.mCall.store(call, std::memory_order_relaxed);
+    shared.mCallStarted.store(
+      std::chrono::nanoseconds {start.time_since_epoch()}.count(),
+      std::memory_order_release);
+    f();
+    shared.mCallStarted.store(0, std::memory_order_release);
+    return Spike {
+      .mStart = start,
+      .mCall = call,
+      .mDuration = Clock::now() - start,
+    };
+  };
+
+  // Opening isn't timed like the calls: a slow open delays the first
+  // state, but doesn't say anything about how the device responds
+  const auto open = [&shared, &settings](Clock::time_point& retryAt) {
+    if (shared.mSource || !shared.mOpen || Clock::now() < retryAt) {
+      return;
+    }
+    const Trace::Zone traceZone {"DeviceReader::Open"};
+    try {
+      shared.mSource = shared.mOpen();
+    } catch (...) {
+      // e.g. the device was removed while it was being opened
+    }
+    retryAt = Clock::now() + settings.mReopenAfter;
+  };
+  Clock::time_point retryAt {};
+  // While reads are failing, when the first one failed
+  std::optional<Clock::time_point> failingSince;
+
+  auto nextProbe = Clock::now();
+  std::unique_lock lock(shared.mMutex);
+  while (true) {
+    if (shared.mDegraded) {
+      shared.mWakeup.wait_until(
+        lock, nextProbe, [&shared] { return shared.mStop; });
+    } else {
+      shared.mWakeup.wait(
+        lock, [&shared] { return shared.mStop || shared.mRequested; });
+    }
+    if (shared.mStop) {
+      return;
+    }
+    if (shared.mDegraded && Clock::now() < nextProbe) {
+      continue;
+    }
+    shared.mRequested = false;
+    shared.mBusy = true;
+    lock.unlock();
+
+    std::pmr::monotonic_buffer_resource resource {
+      buffer.data(), buffer.size()};
+    std::optional<DeviceState> state;
+    open(retryAt);
+    Spike poll {.mStart = Clock::now(), .mCall = Call::Poll, .mDuration = {}};
+    Spike getState {
+      .mStart = poll.mStart,
+      .mCall = Call::GetState,
+      .mDuration = {},
+    };
+    if (shared.mSource) {
+      poll = timeCall(Call::Poll, [&shared] {
+        const Trace::Zone traceZone {"DeviceInfo::Poll"};
+        shared.mSource->Poll();
+      });
+      getState = timeCall(Call::GetState, [&shared, &state, &resource] {
+        const Trace::Zone traceZone {"DeviceInfo::GetState"};
+        state = shared.mSource->GetState(&resource);
+      });
+    }
+
+    // A failed read is usually transient, e.g. while DirectInput re-acquires
+    // the device; only an instance that keeps failing is reopened, as it may
+    // be for a device that's been unplugged, even if it's back
+    if (state) {
+      failingSince.reset();
+    } else if (!failingSince) {
+      failingSince = Clock::now();
+    } else if (
+      shared.mOpen && shared.mSource
+      && Clock::now() - *failingSince >= settings.mReopenAfter) {
+      shared.mSource.reset();
+      failingSince.reset();
+      retryAt = {};
+    }
+
+    lock.lock();
+    shared.mBusy = false;
+    if (!state) {
+      shared.mLatest.reset();
+    } else {
+      if (!shared.mLatest) {
+        shared.mLatest.emplace();
+      }
+      *shared.mLatest = *state;
+    }
+    ++shared.mSequence;
+    shared.mPoll = poll.mDuration;
+    shared.mGetState = getState.mDuration;
+
+    bool onTime = true;
+    for (const auto& call: {poll, getState}) {
+      if (call.mDuration <= settings.mDeadline) {
+        continue;
+      }
+      onTime = false;
+      shared.mSpikes[shared.mSpikeCount++ % MAX_SPIKES] = call;
+    }
+    if (!onTime) {
+      shared.mDegraded = true;
+      shared.mOnTime = 0;
+    } else if (
+      shared.mDegraded && ++shared.mOnTime >= settings.mRecoverAfter) {
+      shared.mDegraded = false;
+    }
+    nextProbe = Clock::now() + settings.mProbeInterval;
+    shared.mWakeup.notify_all();
+  }
+}
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,192 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <chrono>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "DeviceInfo.hpp"
+#include "DeviceState.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+struct DeviceReaderSettings {
+  using Clock = std::chrono::steady_clock;
+
+  // How long `Read()` waits for a new state before returning the last one;
+  // short, as it's called from the GUI thread
+  Clock::duration mWait {std::chrono::milliseconds {2}};
+  // A call that takes longer is a latency spike, and marks the device as
+  // degraded
+  Clock::duration mDeadline {std::chrono::milliseconds {50}};
+  // While degraded, requests are skipped; the device is only read this often
+  Clock::duration mProbeInterval {std::chrono::seconds {1}};
+  // With an opener, reads that keep failing for this long reopen the device,
+  // e.g. because it was unplugged and plugged back in; also how often a
+  // device that couldn't be opened is retried
+  Clock::duration mReopenAfter {std::chrono::seconds {1}};
+  // Consecutive on-time reads needed to stop being degraded
+  std::size_t mRecoverAfter {3};
+};
+
+// Returns `std::optional<T>` for a `Device` `T`, e.g.
+// `DeviceTracker::GetOpener()`
+template <class F>
+concept DeviceOpener = std::invocable<F&>
+  && Device<typename std::invoke_result_t<F&>::value_type>;
+
+/* Reads a device on its own thread, so that a driver call that blocks
+ * can't freeze the caller.
+ *
+ * Some drivers block in `Poll()`, `GetState()`, or when re-acquiring the
+ * device; reads are requested by `Read()`, which only waits briefly for
+ * them, and returns the last state otherwise. Calls that miss the deadline
+ * are recorded as spikes, and mark the device as degraded until it's back
+ * to reading on time.
+ *
+ * Like `Sampler`, this takes ownership of the device; use
+ * `DeviceTracker::OpenAnother()` for a device that the GUI is also showing,
+ * or pass an opener so the device is opened on the reader's thread too.
+ */
+class DeviceReader final {
+ public:
+  using Clock = DeviceReaderSettings::Clock;
+
+  enum class Call : uint8_t {
+    Poll,
+    GetState,
+  };
+  static const char* GetCallName(Call);
+
+  template <Device T>
+  explicit DeviceReader(T&& device, const DeviceReaderSettings& settings = {})
+    : DeviceReader(
+      std::make_unique<Source<T>>(std::move(device)),
+      settings) {
+  }
+
+  // Calls `open()` on the reader's thread, as opening can block; reads are
+  // nullopt until it succeeds
+  template <DeviceOpener F>
+  explicit DeviceReader(F open, const DeviceReaderSettings& settings = {})
+    : DeviceReader(
+      Opener {[open = std::move(open)]() mutable
+                -> std::unique_ptr<AnySource> {
+        using T = typename std::invoke_result_t<F&>::value_type;
+        auto device = open();
+        if (!device) {
+          return nullptr;
+        }
+        return std::make_unique<Source<T>>(std::move(*device));
+      }},
+      settings) {
+  }
+
+  // Waits up to `mWait` for a call that's in progress; a hung call is left
+  // to finish on the thread, which then destroys the device
+  ~DeviceReader();
+
+  DeviceReader() = delete;
+  DeviceReader(const DeviceReader&) = delete;
+  DeviceReader(DeviceReader&&) = delete;
+  DeviceReader& operator=(const DeviceReader&) = delete;
+  DeviceReader& operator=(DeviceReader&&) = delete;
+
+  struct Reading {
+    // Nullopt if the device hasn't been read yet, or the last read failed
+    std::optional<DeviceState> mState;
+    // False if there hasn't been a new read since the last `Read()`
+    bool mFresh {false};
+    // How long the read's calls took, if it's fresh
+    Clock::duration mPoll {};
+    Clock::duration mGetState {};
+  };
+  // The state is copied into `resource`
+  Reading Read(std::pmr::memory_resource* resource);
+
+  struct Spike {
+    Clock::time_point mStart;
+    Call mCall;
+    Clock::duration mDuration;
+  };
+
+  struct Health {
+    explicit Health(std::pmr::memory_resource*);
+
+    bool mDegraded {false};
+    // Set if a call has been running for longer than the deadline
+    std::optional<Call> mHungCall;
+    Clock::duration mHungFor {};
+    uint64_t mSpikeCount {};
+    // The most recent `MAX_SPIKES`, oldest first
+    std::pmr::vector<Spike> mSpikes;
+  };
+  static constexpr std::size_t MAX_SPIKES {32};
+  Health GetHealth(std::pmr::memory_resource*) const;
+
+  const DeviceReaderSettings& GetSettings() const {
+    return mSettings;
+  }
+
+ private:
+  class AnySource {
+   public:
+    virtual ~AnySource();
+    virtual bool Poll() = 0;
+    virtual std::optional<DeviceState> GetState(
+      std::pmr::memory_resource*) = 0;
+  };
+
+  template <Device T>
+  class Source final : public AnySource {
+   public:
+    explicit Source(T&& device) : mDevice(std::move(device)) {
+    }
+
+    bool Poll() override {
+      return mDevice.Poll();
+    }
+
+    std::optional<DeviceState> GetState(
+      std::pmr::memory_resource* resource) override {
+      return mDevice.GetState(resource);
+    }
+
+   private:
+    T mDevice;
+  };
+
+  // Owned by both this and the thread, as the thread can outlive this
+  struct Shared;
+  // Returns null if the device couldn't be opened
+  using Opener = std::function<std::unique_ptr<AnySource>()>;
+
+  DeviceReader(std::unique_ptr<AnySource>, const DeviceReaderSettings&);
+  DeviceReader(Opener, const DeviceReaderSettings&);
+
+  const DeviceReaderSettings mSettings;
+  std::shared_ptr<Shared> mShared;
+  // The last read returned by `Read()`
+  uint64_t mSequence {};
+  // Not a `jthread`, as it's detached if a call is hung
+  std::thread mThread;
+
+  static void Run(std::shared_ptr<Shared>, DeviceReaderSettings);
+  // Nullopt unless a call has been running for longer than the deadline
+  static std::optional<Clock::duration> GetHungFor(
+    const Shared&,
+    const DeviceReaderSettings&,
+    Clock::time_point now);
+};
+
+}// namespace FredEmmott::ControllerTester
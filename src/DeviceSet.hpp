@@ -0,0 +1,125 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <concepts>
+#include <cstddef>
+#include <memory_resource>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "DeviceInfo.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+/* A device from any of the backends in a `DeviceSet`.
+ *
+ * Use `std::visit()` to call `Poll()` or `GetState()` on the concrete type;
+ * `GetDeviceInfo()` is enough for everything else.
+ */
+template <Device... TInfos>
+using DeviceRef = std::variant<TInfos*...>;
+
+template <Device... TInfos>
+DeviceInfo* GetDeviceInfo(const DeviceRef<TInfos...>& device) {
+  return std::visit([](auto info) -> DeviceInfo* { return info; }, device);
+}
+
+/* The trackers for a compile-time list of backends.
+ *
+ * Each backend's devices are stored contiguously in its tracker, and visited
+ * through their concrete types; there are no virtual calls per device.
+ */
+template <class... TTrackers>
+class DeviceSet final {
+ public:
+  using Ref = DeviceRef<typename TTrackers::Info...>;
+
+  DeviceSet() = default;
+
+  // One argument per tracker, e.g. for trackers that need configuration
+  template <class... TArgs>
+    requires(sizeof...(TArgs) == sizeof...(TTrackers))
+  explicit DeviceSet(TArgs&&... args)
+    : mTrackers(std::forward<TArgs>(args)...) {
+  }
+
+  template <class T>
+  T& GetTracker() {
+    return std::get<T>(mTrackers);
+  }
+
+  void MarkStale() {
+    std::apply(
+      [](auto&... trackers) { (trackers.MarkStale(), ...); }, mTrackers);
+  }
+
+  // `DeviceTracker::OpenAnother()` on the first tracker for this type
+  template <Device T>
+  std::optional<T> OpenAnother(const T& device) {
+    std::optional<T> ret;
+    std::apply(
+      [&](auto&... trackers) {
+        const auto open = [&](auto& tracker) {
+          using Info = typename std::decay_t<decltype(tracker)>::Info;
+          if constexpr (std::same_as<Info, T>) {
+            ret = tracker.OpenAnother(device);
+            return true;
+          }
+          return false;
+        };
+        (open(trackers) || ...);
+      },
+      mTrackers);
+    return ret;
+  }
+
+  // `DeviceTracker::GetOpener()` on the first tracker for this type
+  template <Device T>
+  auto GetOpener(const T& device) {
+    return this->GetTrackerFor<T>().GetOpener(device);
+  }
+
+  // Backends in the order they were listed; within each backend, the order
+  // from `DeviceTracker::GetAllDevices()`
+  template <class F>
+  void ForEachDevice(F&& f) {
+    std::apply(
+      [&f](auto&... trackers) { (trackers.ForEachDevice(f), ...); },
+      mTrackers);
+  }
+
+  // Same order as `ForEachDevice()`
+  std::pmr::vector<Ref> GetAllDevices(
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+    std::pmr::vector<Ref> ret {resource};
+    // By index, in case two backends share an info type
+    [this, &ret]<std::size_t... I>(std::index_sequence<I...>) {
+      (std::get<I>(mTrackers).ForEachDevice([&ret](auto& device) {
+        ret.emplace_back(std::in_place_index<I>, &device);
+      }),
+       ...);
+    }(std::index_sequence_for<TTrackers...> {});
+    return ret;
+  }
+
+ private:
+  std::tuple<TTrackers...> mTrackers;
+
+  // The first tracker for this type
+  template <Device T, std::size_t I = 0>
+  auto& GetTrackerFor() {
+    using Tracker = std::tuple_element_t<I, std::tuple<TTrackers...>>;
+    if constexpr (std::same_as<typename Tracker::Info, T>) {
+      return std::get<I>(mTrackers);
+    } else {
+      return this->GetTrackerFor<T, I + 1>();
+    }
+  }
+};
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,21 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "DeviceState.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+DeviceState::DeviceState(std::pmr::memory_resource* resource)
+  : mAxes(resource), mHats(resource), mButtons(resource) {
+}
+
+void DeviceState::Resize(
+  std::size_t axisCount,
+  std::size_t hatCount,
+  std::size_t buttonCount) {
+  mAxes.assign(axisCount, 0);
+  mHats.assign(hatCount, -1);
+  mButtons.assign(GetButtonWordCount(buttonCount), 0);
+}
+
+}// namespace FredEmmott::ControllerTester
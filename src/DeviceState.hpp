@@ -0,0 +1,43 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+namespace FredEmmott::ControllerTester {
+
+/* Decoded control values for one read of a device.
+ *
+ * One contiguous array per control type, in the same order as
+ * `DeviceInfo::mAxes`, `mHats`, and `mButtons`; buttons are a bitset.
+ */
+struct DeviceState final {
+  static constexpr std::size_t BUTTONS_PER_WORD {64};
+
+  static constexpr std::size_t GetButtonWordCount(std::size_t buttonCount) {
+    return (buttonCount + BUTTONS_PER_WORD - 1) / BUTTONS_PER_WORD;
+  }
+
+  explicit DeviceState(
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+  // Sets the array sizes; values are zeroed, and hats are centered
+  void Resize(
+    std::size_t axisCount,
+    std::size_t hatCount,
+    std::size_t buttonCount);
+
+  bool IsButtonPressed(std::size_t index) const {
+    return (mButtons[index / BUTTONS_PER_WORD] >> (index % BUTTONS_PER_WORD))
+      & 1;
+  }
+
+  std::pmr::vector<int32_t> mAxes;
+  std::pmr::vector<int32_t> mHats;
+  std::pmr::vector<uint64_t> mButtons;
+};
+
+}// namespace FredEmmott::ControllerTester
@@ -4,55 +4,111 @@
 
 #include <algorithm>
 #include <concepts>
+#include <cstddef>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
 #include <ranges>
 #include <string>
+#include <tuple>
+#include <utility>
 #include <vector>
 
+#include "ControlAnalysis.hpp"
 #include "DeviceInfo.hpp"
+#include "Trace.hpp"
 
 namespace FredEmmott::ControllerTester {
 
 /* Also requires:
  * { TDerived::GetKey(TIterator) } -> TKey
  * { TDerived::GetKey(TInfo) } -> TKey
+ *
+ * When a device is removed, its controls and coverage are kept for a while,
+ * and restored if a device with the same key and controls is added; trackers
+ * whose keys don't identify a physical device should set
+ * `RETAIN_COVERAGE` to false.
  */
-template <
-  class TDerived,
-  std::derived_from<DeviceInfo> TInfo,
-  class TIterator,
-  class TKey>
+template <class TDerived, Device TInfo, class TIterator, class TKey>
 class DeviceTracker {
  public:
+  using Info = TInfo;
+
+  static constexpr bool RETAIN_COVERAGE {true};
+  static constexpr std::size_t MAX_RETIRED_DEVICES {32};
+
   virtual ~DeviceTracker() = default;
 
-  std::vector<DeviceInfo*> GetAllDevices() {
+  // Sorted by name; devices with the same name are in the order they were
+  // first seen
+  std::pmr::vector<TInfo*> GetAllDevices(
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
     if (mStale) {
       this->Refresh();
     }
 
-    std::vector<DeviceInfo*> ret;
+    std::pmr::vector<TInfo*> ret {resource};
+    ret.reserve(mDevices.size());
     for (auto& [key, info]: mDevices) {
       ret.push_back(&info);
     }
 
-    std::stable_sort(ret.begin(), ret.end(), [](DeviceInfo* a, DeviceInfo* b) {
-      return std::string_view {a->mName} < std::string_view {b->mName};
-    });
-
     return ret;
   }
 
+  // In the same order as `GetAllDevices()`, without building a list
+  template <std::invocable<TInfo&> F>
+  void ForEachDevice(F&& f) {
+    if (mStale) {
+      this->Refresh();
+    }
+
+    for (auto& [key, info]: mDevices) {
+      f(info);
+    }
+  }
+
   void MarkStale() {
     mStale = true;
   }
 
+  /* A second, independent instance of a device, e.g. for a `Sampler`.
+   *
+   * It has the same controls but no coverage; nullopt if the device has
+   * been removed.
+   */
+  std::optional<TInfo> OpenAnother(const TInfo& device) {
+    return this->OpenByKey(TDerived::GetKey(device));
+  }
+
+  /* Calls `OpenAnother()` when it's invoked, which can be from another
+   * thread, e.g. a `DeviceReader`'s, as opening a device can block.
+   *
+   * The tracker must outlive it.
+   */
+  auto GetOpener(const TInfo& device) {
+    return [this, key = TDerived::GetKey(device)]() {
+      return this->OpenByKey(key);
+    };
+  }
+
  protected:
+  // Held while enumerating or creating devices, so that they can be opened
+  // from any thread; also hold it while changing anything that
+  // `Enumerate()` or `CreateInfo()` use
+  std::mutex mEnumerationMutex;
+
   virtual std::vector<TIterator> Enumerate() = 0;
 
   virtual TInfo CreateInfo(const TIterator&) = 0;
 
   void Refresh() {
-    const auto devices = this->Enumerate();
+    const Trace::Zone traceZone {"DeviceTracker::Refresh"};
+    std::unique_lock lock(mEnumerationMutex);
+    const auto devices = [this]() {
+      const Trace::Zone traceZone {"DeviceTracker::Enumerate"};
+      return this->Enumerate();
+    }();
 
     // Remove devices that are no longer present
     for (auto existingIt = mDevices.begin(); existingIt != mDevices.end();) {
@@ -60,27 +116,74 @@ class DeviceTracker {
       const auto newIt = std::ranges::find_if(
         devices, [key](const auto& it) { return TDerived::GetKey(it) == key; });
       if (newIt == devices.end()) {
+        if constexpr (TDerived::RETAIN_COVERAGE) {
+          this->Retire(key, std::move(std::get<1>(*existingIt)));
+        }
         existingIt = mDevices.erase(existingIt);
       } else {
         ++existingIt;
       }
     }
 
-    // Add new ones
+    // Add new ones, keeping `mDevices` sorted by name so that
+    // `GetAllDevices()` doesn't need to sort every frame
     for (const auto& newIt: devices) {
       const auto key = TDerived::GetKey(newIt);
       auto existingIt = std::ranges::find(
         mDevices, key, [](const auto& pair) { return std::get<0>(pair); });
-      if (existingIt == mDevices.end()) {
-        mDevices.push_back({key, this->CreateInfo(newIt)});
+      if (existingIt != mDevices.end()) {
+        continue;
       }
+      auto info = [this, &newIt]() {
+        const Trace::Zone traceZone {"DeviceTracker::CreateInfo"};
+        return this->CreateInfo(newIt);
+      }();
+      if constexpr (TDerived::RETAIN_COVERAGE) {
+        this->Restore(key, info);
+      }
+      const auto insertAt = std::ranges::upper_bound(
+        mDevices, std::string_view {info.mName}, {}, [](const auto& pair) {
+          return std::string_view {std::get<1>(pair).mName};
+        });
+      mDevices.insert(insertAt, {key, std::move(info)});
     }
 
     mStale = false;
   }
 
  private:
+  std::optional<TInfo> OpenByKey(const TKey& key) {
+    const Trace::Zone traceZone {"DeviceTracker::OpenAnother"};
+    std::unique_lock lock(mEnumerationMutex);
+    for (const auto& it: this->Enumerate()) {
+      if (TDerived::GetKey(it) == key) {
+        return this->CreateInfo(it);
+      }
+    }
+    return std::nullopt;
+  }
+
   bool mStale {true};
   std::vector<std::tuple<TKey, TInfo>> mDevices;
+  // Oldest first
+  std::vector<std::tuple<TKey, DeviceInfo>> mRetired;
+
+  void Retire(const TKey& key, TInfo&& info) {
+    if (mRetired.size() >= MAX_RETIRED_DEVICES) {
+      mRetired.erase(mRetired.begin());
+    }
+    // Just the backend-independent parts; this doesn't keep the device open
+    mRetired.emplace_back(key, static_cast<DeviceInfo&&>(info));
+  }
+
+  void Restore(const TKey& key, TInfo& info) {
+    const auto it = std::ranges::find(
+      mRetired, key, [](const auto& pair) { return std::get<0>(pair); });
+    if (it == mRetired.end()) {
+      return;
+    }
+    RestoreCoverage(info, std::get<1>(*it));
+    mRetired.erase(it);
+  }
 };
 }// namespace FredEmmott::ControllerTester
\ No newline at end of file
@@ -3,6 +3,10 @@
 
 #include "DirectInputDeviceInfo.hpp"
 
+#include <algorithm>
+
+#include "Trace.hpp"
+
 namespace FredEmmott::ControllerTester {
 
 BOOL DirectInputDeviceInfo::CBEnumDeviceObjects(
@@ -86,18 +90,14 @@ BOOL DirectInputDeviceInfo::CBEnumDeviceObjects(
   return DIENUM_CONTINUE;
 }
 
-DirectInputDeviceInfo::DirectInputDeviceInfo(
-  const winrt::com_ptr<IDirectInputDevice8>& device)
-  : mDevice(device) {
-  if (!mDevice) {
-    return;
+void DirectInputDeviceInfo::EnumerateControls() {
+  {
+    const Trace::Zone traceZone {"IDirectInputDevice8::EnumObjects"};
+    winrt::check_hresult(mDevice->EnumObjects(
+      &CBEnumDeviceObjects, this, DIDFT_AXIS | DIDFT_BUTTON | DIDFT_POV));
   }
 
-  // Populate controls
-  winrt::check_hresult(mDevice->EnumObjects(
-    &CBEnumDeviceObjects, this, DIDFT_AXIS | DIDFT_BUTTON | DIDFT_POV));
-
-  const std::vector<winrt::guid> axisOrder {
+  const std::vector<Guid> axisOrder {
     GUID_XAxis,
     GUID_YAxis,
     GUID_ZAxis,
@@ -119,8 +119,56 @@ DirectInputDeviceInfo::DirectInputDeviceInfo(
       }
       return ait < bit;
     });
+}
 
-  DWORD offset {};
+DirectInputDeviceInfo::DirectInputDeviceInfo(
+  const winrt::com_ptr<IDirectInputDevice8>& device,
+  const DIDEVICEINSTANCE& instance,
+  const LayoutCache* layoutCache)
+  : mDevice(device) {
+  mName = instance.tszProductName;
+  mGuid = instance.guidInstance;
+  mProduct = instance.guidProduct;
+  if (!mDevice) {
+    return;
+  }
+
+  // Populate controls
+  const LayoutCache::Key cacheKey {
+    .mProduct = instance.guidProduct,
+    .mInstance = instance.guidInstance,
+  };
+  LayoutCache::ControlCounts counts {};
+  std::optional<uint32_t> cachedFlags;
+  if (layoutCache) {
+    const Trace::Zone traceZone {"LayoutCache::Load"};
+    DIDEVCAPS caps {.dwSize = sizeof(DIDEVCAPS)};
+    winrt::check_hresult(mDevice->GetCapabilities(&caps));
+    counts = {
+      .mAxes = caps.dwAxes,
+      .mButtons = caps.dwButtons,
+      .mHats = caps.dwPOVs,
+    };
+    cachedFlags = layoutCache->Load(cacheKey, counts, *this);
+  }
+
+  if (cachedFlags) {
+    mNeedsPolling = (*cachedFlags & LAYOUT_NEEDS_POLLING);
+  } else {
+    this->EnumerateControls();
+    const LayoutCache::ControlCounts enumerated {
+      .mAxes = static_cast<uint32_t>(mAxes.size()),
+      .mButtons = static_cast<uint32_t>(mButtons.size()),
+      .mHats = static_cast<uint32_t>(mHats.size()),
+    };
+    // If they differ, the entry would never be used
+    if (layoutCache && enumerated == counts) {
+      layoutCache->Store(
+        cacheKey, *this, mNeedsPolling ? LAYOUT_NEEDS_POLLING : 0);
+    }
+  }
+
+  uint32_t offset {};
   std::vector<DIOBJECTDATAFORMAT> objectFormats;
   for (auto& axis: mAxes) {
     objectFormats.push_back(DIOBJECTDATAFORMAT {
@@ -129,7 +177,7 @@ DirectInputDeviceInfo::DirectInputDeviceInfo(
       .dwType = DIDFT_ANYINSTANCE | DIDFT_AXIS,
     });
     axis.mDataOffset = offset;
-    offset += sizeof(LONG);
+    offset += sizeof(int32_t);
   }
   // Hats before buttons as they still need to be 4-byte aligned
   for (auto& hat: mHats) {
@@ -139,7 +187,7 @@ DirectInputDeviceInfo::DirectInputDeviceInfo(
       .dwType = DIDFT_ANYINSTANCE | DIDFT_POV,
     });
     hat.mDataOffset = offset;
-    offset += sizeof(LONG);
+    offset += sizeof(int32_t);
   }
   for (auto& button: mButtons) {
     objectFormats.push_back(DIOBJECTDATAFORMAT {
@@ -166,6 +214,8 @@ DirectInputDeviceInfo::DirectInputDeviceInfo(
     .rgodf = objectFormats.data(),
   };
   winrt::check_hresult(mDevice->SetDataFormat(&dataFormat));
+  mDecodePlan = DecodePlan {*this};
+  const Trace::Zone traceZone {"IDirectInputDevice8::Acquire"};
   winrt::check_hresult(mDevice->Acquire());
 }
 
@@ -183,19 +233,31 @@ bool DirectInputDeviceInfo::Poll() {
   return mDevice->Poll() == DI_OK;
 }
 
-std::vector<std::byte> DirectInputDeviceInfo::GetState() {
+std::optional<DeviceState> DirectInputDeviceInfo::GetState(
+  std::pmr::memory_resource* resource) {
   if (!mDevice) {
-    return {};
+    return std::nullopt;
   }
   if (!mDataSize) {
-    return {};
+    return std::nullopt;
   }
 
-  std::vector<std::byte> state(mDataSize, {});
-  if (mDevice->GetDeviceState(mDataSize, state.data()) != DI_OK) {
-    return {};
+  std::pmr::vector<std::byte> raw(mDataSize, {}, resource);
+  const auto result = mDevice->GetDeviceState(mDataSize, raw.data());
+  if (result == DIERR_INPUTLOST || result == DIERR_NOTACQUIRED) {
+    // e.g. after the device was reset; this can block, so it's left to
+    // whichever thread reads the device
+    const Trace::Zone traceZone {"IDirectInputDevice8::Acquire"};
+    mDevice->Acquire();
+    return std::nullopt;
+  }
+  if (result != DI_OK) {
+    return std::nullopt;
   }
-  return state;
+
+  DeviceState ret {resource};
+  mDecodePlan.Decode(raw, ret);
+  return ret;
 }
 
 }// namespace FredEmmott::ControllerTester
\ No newline at end of file
@@ -7,12 +7,18 @@
 #include <dinput.h>
 
 #include "ControlInfo.hpp"
+#include "DecodePlan.hpp"
 #include "DeviceInfo.hpp"
+#include "LayoutCache.hpp"
 
 namespace FredEmmott::ControllerTester {
 
 struct DirectInputDeviceInfo final : public DeviceInfo {
-  DirectInputDeviceInfo(const winrt::com_ptr<IDirectInputDevice8>&);
+  // The cache is optional
+  DirectInputDeviceInfo(
+    const winrt::com_ptr<IDirectInputDevice8>&,
+    const DIDEVICEINSTANCE&,
+    const LayoutCache*);
   ~DirectInputDeviceInfo();
 
   DirectInputDeviceInfo() = delete;
@@ -22,13 +28,19 @@ struct DirectInputDeviceInfo final : public DeviceInfo {
   DirectInputDeviceInfo& operator=(const DirectInputDeviceInfo&) = delete;
   DirectInputDeviceInfo& operator=(DirectInputDeviceInfo&&) = default;
 
-  virtual bool Poll() override;
-  virtual std::vector<std::byte> GetState() override;
+  bool Poll();
+  std::optional<DeviceState> GetState(std::pmr::memory_resource*);
 
  private:
   winrt::com_ptr<IDirectInputDevice8> mDevice;
   bool mNeedsPolling {false};
   DWORD mDataSize {};
+  DecodePlan mDecodePlan;
+
+  // `LayoutCache` backend flags
+  static constexpr uint32_t LAYOUT_NEEDS_POLLING {1};
+
+  void EnumerateControls();
 
   static BOOL CBEnumDeviceObjects(LPCDIDEVICEOBJECTINSTANCE it, LPVOID pvRef);
 };
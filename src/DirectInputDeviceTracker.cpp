@@ -16,15 +16,20 @@ DirectInputDeviceTracker::DirectInputDeviceTracker() {
     nullptr));
 }
 
-winrt::guid DirectInputDeviceTracker::GetKey(const DIDEVICEINSTANCE& instance) {
+Guid DirectInputDeviceTracker::GetKey(const DIDEVICEINSTANCE& instance) {
   return instance.guidInstance;
 }
 
-winrt::guid DirectInputDeviceTracker::GetKey(
-  const DirectInputDeviceInfo& info) {
+Guid DirectInputDeviceTracker::GetKey(const DirectInputDeviceInfo& info) {
   return info.mGuid;
 }
 
+void DirectInputDeviceTracker::SetLayoutCacheDirectory(
+  const std::filesystem::path& path) {
+  std::unique_lock lock(mEnumerationMutex);
+  mLayoutCache.emplace(path);
+}
+
 static BOOL CBEnumerate(LPCDIDEVICEINSTANCE device, LPVOID ref) {
   auto& vec = *reinterpret_cast<std::vector<DIDEVICEINSTANCE>*>(ref);
   vec.push_back(*device);
@@ -46,11 +51,7 @@ DirectInputDeviceInfo DirectInputDeviceTracker::CreateInfo(
   winrt::check_hresult(
     mDI->CreateDevice(instance.guidInstance, device.put(), nullptr));
 
-  DirectInputDeviceInfo ret {device};
-  ret.mName = instance.tszProductName;
-  ret.mGuid = instance.guidInstance;
-
-  return ret;
+  return {device, instance, mLayoutCache ? &*mLayoutCache : nullptr};
 }
 
 }// namespace FredEmmott::ControllerTester
\ No newline at end of file
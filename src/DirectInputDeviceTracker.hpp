@@ -8,8 +8,12 @@
 
 #include <dinput.h>
 
+#include <filesystem>
+#include <optional>
+
 #include "DeviceTracker.hpp"
 #include "DirectInputDeviceInfo.hpp"
+#include "LayoutCache.hpp"
 
 namespace FredEmmott::ControllerTester {
 
@@ -17,13 +21,16 @@ class DirectInputDeviceTracker final : public DeviceTracker<
                                          DirectInputDeviceTracker,
                                          DirectInputDeviceInfo,
                                          DIDEVICEINSTANCE,
-                                         winrt::guid> {
+                                         Guid> {
  public:
   DirectInputDeviceTracker();
   virtual ~DirectInputDeviceTracker() = default;
 
-  static winrt::guid GetKey(const DIDEVICEINSTANCE&);
-  static winrt::guid GetKey(const DirectInputDeviceInfo&);
+  static Guid GetKey(const DIDEVICEINSTANCE&);
+  static Guid GetKey(const DirectInputDeviceInfo&);
+
+  // Devices created after this call load and store their layouts here
+  void SetLayoutCacheDirectory(const std::filesystem::path&);
 
  protected:
   virtual std::vector<DIDEVICEINSTANCE> Enumerate() override;
@@ -31,6 +38,7 @@ class DirectInputDeviceTracker final : public DeviceTracker<
 
  private:
   winrt::com_ptr<IDirectInput8> mDI;
+  std::optional<LayoutCache> mLayoutCache;
 };
 
 }// namespace FredEmmott::ControllerTester
\ No newline at end of file
@@ -0,0 +1,385 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "EvdevDeviceInfo.hpp"
+
+#include <fcntl.h>
+#include <sys/ioctl.h>
+
+#include <climits>
+#include <cstring>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "Trace.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+namespace {
+
+constexpr std::size_t BITS_PER_LONG {sizeof(unsigned long) * CHAR_BIT};
+constexpr uint8_t HAT_COUNT {4};
+// Hat values are DirectInput-style; -1 is centered
+constexpr int32_t HAT_CENTERED {-1};
+constexpr std::byte BUTTON_PRESSED {0x80};
+// Per read; a read returns every event that's pending, up to this many
+constexpr std::size_t EVENTS_PER_READ {64};
+// Reads that can be waiting for `Poll()`; any more wait in the kernel
+constexpr std::size_t READ_BUFFERS {16};
+
+// For `EVIOCGBIT()` and `EVIOCGKEY()`
+template <std::size_t N>
+using Bits
+  = std::array<unsigned long, (N + BITS_PER_LONG - 1) / BITS_PER_LONG>;
+
+bool TestBit(std::span<const unsigned long> bits, std::size_t bit) {
+  return (bits[bit / BITS_PER_LONG] >> (bit % BITS_PER_LONG)) & 1;
+}
+
+template <std::size_t N>
+Bits<N> GetBits(int fd, unsigned long request) {
+  Bits<N> ret {};
+  ioctl(fd, request, ret.data());
+  return ret;
+}
+
+Bits<ABS_CNT> GetAbsBits(int fd) {
+  return GetBits<ABS_CNT>(fd, EVIOCGBIT(EV_ABS, sizeof(Bits<ABS_CNT>)));
+}
+
+Bits<KEY_CNT> GetKeyBits(int fd) {
+  return GetBits<KEY_CNT>(fd, EVIOCGBIT(EV_KEY, sizeof(Bits<KEY_CNT>)));
+}
+
+bool IsHat(uint16_t code) {
+  return code >= ABS_HAT0X && code <= ABS_HAT3Y;
+}
+
+// Multitouch axes are per-contact, not controls
+bool IsAxis(uint16_t code) {
+  return code < ABS_MT_SLOT && !IsHat(code);
+}
+
+std::string GetAxisName(uint16_t code) {
+  switch (code) {
+    case ABS_X:
+      return "X";
+    case ABS_Y:
+      return "Y";
+    case ABS_Z:
+      return "Z";
+    case ABS_RX:
+      return "Rx";
+    case ABS_RY:
+      return "Ry";
+    case ABS_RZ:
+      return "Rz";
+    case ABS_THROTTLE:
+      return "Throttle";
+    case ABS_RUDDER:
+      return "Rudder";
+    case ABS_WHEEL:
+      return "Wheel";
+    case ABS_GAS:
+      return "Gas";
+    case ABS_BRAKE:
+      return "Brake";
+  }
+  return "Axis " + std::to_string(code);
+}
+
+// Hundredths of a degree clockwise from north, like DirectInput
+int32_t GetHatValue(int32_t x, int32_t y) {
+  constexpr int32_t values[3][3] {
+    {31500, 0, 4500},
+    {27000, HAT_CENTERED, 9000},
+    {22500, 18000, 13500},
+  };
+  const auto column = (x > 0) - (x < 0) + 1;
+  const auto row = (y > 0) - (y < 0) + 1;
+  return values[row][column];
+}
+
+uint32_t HashString(std::string_view value) {
+  // FNV-1a
+  uint32_t hash {0x811c9dc5};
+  for (const auto c: value) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 0x01000193;
+  }
+  return hash;
+}
+
+std::string GetString(int fd, unsigned long request) {
+  std::array<char, 256> buffer {};
+  if (ioctl(fd, request, buffer.data()) < 0) {
+    return {};
+  }
+  return {buffer.data()};
+}
+
+}// namespace
+
+std::optional<EvdevDeviceInstance> EvdevDeviceInfo::Probe(
+  const std::filesystem::path& path) {
+  const UniqueFD fd {open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC)};
+  if (!fd) {
+    return std::nullopt;
+  }
+
+  const auto abs = GetAbsBits(fd.Get());
+  const auto keys = GetKeyBits(fd.Get());
+  bool hasControllerButtons = false;
+  for (auto code = BTN_JOYSTICK; code <= BTN_THUMBR; ++code) {
+    hasControllerButtons |= TestBit(keys, code);
+  }
+  for (auto code = BTN_TRIGGER_HAPPY; code <= BTN_TRIGGER_HAPPY40; ++code) {
+    hasControllerButtons |= TestBit(keys, code);
+  }
+  // Touchpads and tablets also have absolute X and Y
+  const auto hasSticks = TestBit(abs, ABS_X) && !TestBit(keys, BTN_TOUCH);
+  if (!(hasControllerButtons || hasSticks)) {
+    return std::nullopt;
+  }
+
+  input_id id {};
+  ioctl(fd.Get(), EVIOCGID, &id);
+  // Prefer the serial number, then the physical port, so that the GUID is
+  // the same when the device is reconnected
+  auto where = GetString(fd.Get(), EVIOCGUNIQ(255));
+  if (where.empty()) {
+    where = GetString(fd.Get(), EVIOCGPHYS(255));
+  }
+  if (where.empty()) {
+    where = path.string();
+  }
+
+  return EvdevDeviceInstance {
+    .mPath = path,
+    .mGuid = {
+      HashString(where),
+      id.vendor,
+      id.product,
+      {
+        static_cast<uint8_t>(id.bustype & 0xff),
+        static_cast<uint8_t>(id.bustype >> 8),
+        static_cast<uint8_t>(id.version & 0xff),
+        static_cast<uint8_t>(id.version >> 8),
+        'E',
+        'V',
+        'D',
+        'V',
+      },
+    },
+  };
+}
+
+EvdevDeviceInfo::EvdevDeviceInfo(
+  const EvdevDeviceInstance& instance,
+  InputQueue::Backend backend)
+  : mPath(instance.mPath),
+    mFD(open(instance.mPath.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC)) {
+  const Trace::Zone traceZone {"EvdevDeviceInfo::EvdevDeviceInfo"};
+  mGuid = instance.mGuid;
+  mKeySlots.fill(-1);
+  if (!mFD) {
+    mName = mPath.filename().string();
+    return;
+  }
+  const auto fd = mFD.Get();
+  mName = GetString(fd, EVIOCGNAME(255));
+
+  input_id id {};
+  ioctl(fd, EVIOCGID, &id);
+  // The same format as DirectInput's product GUIDs, so results for the
+  // same model match across platforms
+  mProduct = {
+    static_cast<uint32_t>(id.vendor)
+      | (static_cast<uint32_t>(id.product) << 16),
+    0,
+    0,
+    {0, 0, 'P', 'I', 'D', 'V', 'I', 'D'},
+  };
+
+  const auto abs = GetAbsBits(fd);
+  const auto keys = GetKeyBits(fd);
+  // Same layout as `DirectInputDeviceInfo`: axes, then hats, then buttons
+  uint32_t offset {};
+  for (uint16_t code = 0; code < ABS_CNT; ++code) {
+    if (!(IsAxis(code) && TestBit(abs, code))) {
+      continue;
+    }
+    input_absinfo range {};
+    ioctl(fd, EVIOCGABS(code), &range);
+    mAbsSlots[code] = {
+      .mKind = AbsSlot::Kind::Axis,
+      .mIndex = static_cast<uint8_t>(mAxes.size()),
+    };
+    mAxes.push_back(AxisInfo {
+      .mName = GetAxisName(code),
+      .mMin = range.minimum,
+      .mMax = range.maximum,
+      .mDataOffset = offset,
+    });
+    offset += sizeof(int32_t);
+  }
+  for (uint8_t hat = 0; hat < HAT_COUNT; ++hat) {
+    const uint16_t x = ABS_HAT0X + (hat * 2);
+    const uint16_t y = x + 1;
+    if (!(TestBit(abs, x) || TestBit(abs, y))) {
+      continue;
+    }
+    const auto index = static_cast<uint8_t>(mHats.size());
+    mAbsSlots[x] = {.mKind = AbsSlot::Kind::HatX, .mIndex = index};
+    mAbsSlots[y] = {.mKind = AbsSlot::Kind::HatY, .mIndex = index};
+    mHats.push_back(HatInfo {
+      .mName = "Hat " + std::to_string(index + 1),
+      .mType = HatType::EightWay,
+      .mDataOffset = offset,
+    });
+    mHatPositions.push_back({});
+    offset += sizeof(int32_t);
+  }
+  for (uint16_t code = BTN_MISC; code < KEY_CNT; ++code) {
+    if (!TestBit(keys, code)) {
+      continue;
+    }
+    mKeySlots[code] = static_cast<int16_t>(mButtons.size());
+    mButtons.push_back(ButtonInfo {
+      .mName = "Button " + std::to_string(mButtons.size() + 1),
+      .mDataOffset = offset,
+    });
+    ++offset;
+  }
+
+  mRaw.resize((offset + 3) & ~3);
+  for (const auto& hat: mHats) {
+    std::memcpy(
+      mRaw.data() + hat.mDataOffset, &HAT_CENTERED, sizeof(HAT_CENTERED));
+  }
+  mDecodePlan = DecodePlan {*this};
+  this->Resync();
+
+  mInput.emplace(
+    fd,
+    InputQueueSettings {
+      .mBackend = backend,
+      .mBufferSize = EVENTS_PER_READ * sizeof(input_event),
+      .mBufferCount = READ_BUFFERS,
+    });
+  if (!mInput->IsValid()) {
+    mInput.reset();
+    mFD.Reset();
+  }
+}
+
+EvdevDeviceInfo::~EvdevDeviceInfo() {
+}
+
+bool EvdevDeviceInfo::Poll() {
+  if (!mInput) {
+    return false;
+  }
+  const auto present = mInput->Read(
+    [this](std::span<const std::byte> events) { this->ApplyEvents(events); });
+  if (!present) {
+    // e.g. `ENODEV` once it's unplugged
+    mInput.reset();
+    mFD.Reset();
+  }
+  return present;
+}
+
+std::optional<DeviceState> EvdevDeviceInfo::GetState(
+  std::pmr::memory_resource* resource) {
+  if (!mFD) {
+    return std::nullopt;
+  }
+  DeviceState ret {resource};
+  mDecodePlan.Decode(mRaw, ret);
+  return ret;
+}
+
+void EvdevDeviceInfo::ApplyEvents(std::span<const std::byte> events) {
+  input_event event;
+  for (std::size_t offset = 0; offset + sizeof(event) <= events.size();
+       offset += sizeof(event)) {
+    std::memcpy(&event, events.data() + offset, sizeof(event));
+    this->ApplyEvent(event);
+  }
+}
+
+void EvdevDeviceInfo::ApplyEvent(const input_event& event) {
+  if (event.type == EV_SYN) {
+    if (event.code == SYN_DROPPED) {
+      mDropping = true;
+    } else if (event.code == SYN_REPORT && mDropping) {
+      mDropping = false;
+      this->Resync();
+    }
+    return;
+  }
+  if (mDropping) {
+    return;
+  }
+
+  if (event.type == EV_ABS && event.code < ABS_CNT) {
+    this->SetAbs(event.code, event.value);
+  } else if (event.type == EV_KEY && event.code < KEY_CNT) {
+    // 2 is autorepeat, which is still pressed
+    this->SetKey(event.code, event.value != 0);
+  }
+}
+
+void EvdevDeviceInfo::SetAbs(uint16_t code, int32_t value) {
+  const auto slot = mAbsSlots[code];
+  switch (slot.mKind) {
+    case AbsSlot::Kind::None:
+      return;
+    case AbsSlot::Kind::Axis:
+      std::memcpy(
+        mRaw.data() + mAxes[slot.mIndex].mDataOffset, &value, sizeof(value));
+      return;
+    case AbsSlot::Kind::HatX:
+    case AbsSlot::Kind::HatY: {
+      auto& position = mHatPositions[slot.mIndex];
+      position[slot.mKind == AbsSlot::Kind::HatX ? 0 : 1] = value;
+      const auto hat = GetHatValue(position[0], position[1]);
+      std::memcpy(
+        mRaw.data() + mHats[slot.mIndex].mDataOffset, &hat, sizeof(hat));
+      return;
+    }
+  }
+}
+
+void EvdevDeviceInfo::SetKey(uint16_t code, bool pressed) {
+  const auto index = mKeySlots[code];
+  if (index < 0) {
+    return;
+  }
+  mRaw[mButtons[index].mDataOffset] = pressed ? BUTTON_PRESSED : std::byte {};
+}
+
+void EvdevDeviceInfo::Resync() {
+  const auto fd = mFD.Get();
+  for (uint16_t code = 0; code < ABS_CNT; ++code) {
+    if (mAbsSlots[code].mKind == AbsSlot::Kind::None) {
+      continue;
+    }
+    input_absinfo info {};
+    if (ioctl(fd, EVIOCGABS(code), &info) == 0) {
+      this->SetAbs(code, info.value);
+    }
+  }
+
+  Bits<KEY_CNT> pressed {};
+  if (ioctl(fd, EVIOCGKEY(sizeof(pressed)), pressed.data()) < 0) {
+    return;
+  }
+  for (uint16_t code = BTN_MISC; code < KEY_CNT; ++code) {
+    this->SetKey(code, TestBit(pressed, code));
+  }
+}
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,95 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <linux/input.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "DecodePlan.hpp"
+#include "DeviceInfo.hpp"
+#include "InputQueue.hpp"
+#include "UniqueFD.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+// Like `DIDEVICEINSTANCE`: enough to identify a device without opening it
+// for reading
+struct EvdevDeviceInstance {
+  std::filesystem::path mPath;
+  Guid mGuid;
+};
+
+/* A Linux input device, read through its `/dev/input/event*` node.
+ *
+ * Events are read through an `InputNode`, and applied to a DirectInput-style
+ * state buffer as they're read, so states are decoded by the same
+ * `DecodePlan` as DirectInput devices.
+ * Axes keep the driver's range; hats are converted from their X/Y pairs to
+ * hundredths of a degree; buttons are the `BTN_*` codes in numeric order.
+ */
+struct EvdevDeviceInfo final : public DeviceInfo {
+  explicit EvdevDeviceInfo(
+    const EvdevDeviceInstance&,
+    InputQueue::Backend = InputQueue::Backend::IoUring);
+  ~EvdevDeviceInfo();
+
+  EvdevDeviceInfo() = delete;
+  EvdevDeviceInfo(const EvdevDeviceInfo&) = delete;
+  EvdevDeviceInfo(EvdevDeviceInfo&&) = default;
+
+  EvdevDeviceInfo& operator=(const EvdevDeviceInfo&) = delete;
+  EvdevDeviceInfo& operator=(EvdevDeviceInfo&&) = default;
+
+  // Nullopt if the node can't be opened, or isn't a game controller
+  static std::optional<EvdevDeviceInstance> Probe(
+    const std::filesystem::path&);
+
+  // Reads every pending event; false if the device has gone
+  bool Poll();
+  std::optional<DeviceState> GetState(std::pmr::memory_resource*);
+
+  std::filesystem::path mPath;
+
+ private:
+  struct AbsSlot {
+    enum class Kind : uint8_t {
+      None,
+      Axis,
+      HatX,
+      HatY,
+    };
+    Kind mKind {Kind::None};
+    uint8_t mIndex {};
+  };
+
+  UniqueFD mFD;
+  // Declared after `mFD`, as it must be closed first
+  std::optional<InputNode> mInput;
+  DecodePlan mDecodePlan;
+  std::vector<std::byte> mRaw;
+  std::array<AbsSlot, ABS_CNT> mAbsSlots {};
+  // Index into `mButtons`, or -1
+  std::array<int16_t, KEY_CNT> mKeySlots {};
+  // The last X and Y for each hat
+  std::vector<std::array<int32_t, 2>> mHatPositions;
+  // After `SYN_DROPPED`, events are ignored until the next `SYN_REPORT`,
+  // then the whole state is read again
+  bool mDropping {false};
+
+  // Whole `input_event`s, which aren't necessarily aligned
+  void ApplyEvents(std::span<const std::byte>);
+  void ApplyEvent(const input_event&);
+  void SetAbs(uint16_t code, int32_t value);
+  void SetKey(uint16_t code, bool pressed);
+  void Resync();
+};
+
+}// namespace FredEmmott::ControllerTester
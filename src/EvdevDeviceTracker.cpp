@@ -0,0 +1,43 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "EvdevDeviceTracker.hpp"
+
+#include <filesystem>
+#include <system_error>
+
+namespace FredEmmott::ControllerTester {
+
+EvdevDeviceTracker::EvdevDeviceTracker(InputQueue::Backend backend)
+  : mBackend(backend) {
+}
+
+Guid EvdevDeviceTracker::GetKey(const EvdevDeviceInstance& instance) {
+  return instance.mGuid;
+}
+
+Guid EvdevDeviceTracker::GetKey(const EvdevDeviceInfo& info) {
+  return info.mGuid;
+}
+
+std::vector<EvdevDeviceInstance> EvdevDeviceTracker::Enumerate() {
+  std::vector<EvdevDeviceInstance> ret;
+  std::error_code ec;
+  for (const auto& entry:
+       std::filesystem::directory_iterator {"/dev/input", ec}) {
+    if (!entry.path().filename().string().starts_with("event")) {
+      continue;
+    }
+    if (auto instance = EvdevDeviceInfo::Probe(entry.path())) {
+      ret.push_back(std::move(*instance));
+    }
+  }
+  return ret;
+}
+
+EvdevDeviceInfo EvdevDeviceTracker::CreateInfo(
+  const EvdevDeviceInstance& instance) {
+  return EvdevDeviceInfo {instance, mBackend};
+}
+
+}// namespace FredEmmott::ControllerTester
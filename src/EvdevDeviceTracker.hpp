@@ -0,0 +1,40 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <vector>
+
+#include "DeviceTracker.hpp"
+#include "EvdevDeviceInfo.hpp"
+#include "InputQueue.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+/* Game controllers from `/dev/input/event*`.
+ *
+ * Nodes that can't be opened, e.g. without access to the `input` group,
+ * are skipped, like nodes for keyboards and mice.
+ */
+class EvdevDeviceTracker final : public DeviceTracker<
+                                   EvdevDeviceTracker,
+                                   EvdevDeviceInfo,
+                                   EvdevDeviceInstance,
+                                   Guid> {
+ public:
+  explicit EvdevDeviceTracker(
+    InputQueue::Backend = InputQueue::Backend::IoUring);
+  virtual ~EvdevDeviceTracker() = default;
+
+  static Guid GetKey(const EvdevDeviceInstance&);
+  static Guid GetKey(const EvdevDeviceInfo&);
+
+ protected:
+  virtual std::vector<EvdevDeviceInstance> Enumerate() override;
+  virtual EvdevDeviceInfo CreateInfo(const EvdevDeviceInstance&) override;
+
+ private:
+  // For the devices' `InputNode`s
+  InputQueue::Backend mBackend;
+};
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,105 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "ControlInfo.hpp"
+#include "DeviceInfo.hpp"
+#include "DeviceState.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+// `mDataOffset`s aren't used for decoding, but still identify the controls,
+// e.g. for ImGui IDs, so they must be unique within each kind of control
+struct FixedAxis {
+  std::string_view mName;
+  int32_t mMin {};
+  int32_t mMax {};
+  uint32_t mDataOffset {};
+};
+
+struct FixedButton {
+  std::string_view mName;
+  uint32_t mDataOffset {};
+};
+
+struct FixedHat {
+  std::string_view mName;
+  HatType mType {HatType::Other};
+  uint32_t mDataOffset {};
+};
+
+/* The controls of a backend whose layout never changes, e.g. XInput.
+ *
+ * The counts are part of the type, so decoders for these backends can fill
+ * a `FixedState` with fixed-size arrays instead of following per-control
+ * offsets like the generic path (`DecodeState()`).
+ */
+template <
+  std::size_t TAxisCount,
+  std::size_t TButtonCount,
+  std::size_t THatCount>
+struct FixedLayout {
+  static constexpr std::size_t AXIS_COUNT {TAxisCount};
+  static constexpr std::size_t BUTTON_COUNT {TButtonCount};
+  static constexpr std::size_t HAT_COUNT {THatCount};
+  static constexpr std::size_t BUTTON_WORD_COUNT {
+    DeviceState::GetButtonWordCount(TButtonCount)};
+
+  std::array<FixedAxis, TAxisCount> mAxes;
+  std::array<FixedButton, TButtonCount> mButtons;
+  std::array<FixedHat, THatCount> mHats;
+
+  void PopulateControls(DeviceInfo& info) const {
+    info.mAxes.clear();
+    info.mAxes.reserve(AXIS_COUNT);
+    for (const auto& axis: mAxes) {
+      info.mAxes.push_back(AxisInfo {
+        .mName = std::string {axis.mName},
+        .mMin = axis.mMin,
+        .mMax = axis.mMax,
+        .mDataOffset = axis.mDataOffset,
+      });
+    }
+
+    info.mButtons.clear();
+    info.mButtons.reserve(BUTTON_COUNT);
+    for (const auto& button: mButtons) {
+      info.mButtons.push_back(ButtonInfo {
+        .mName = std::string {button.mName},
+        .mDataOffset = button.mDataOffset,
+      });
+    }
+
+    info.mHats.clear();
+    info.mHats.reserve(HAT_COUNT);
+    for (const auto& hat: mHats) {
+      info.mHats.push_back(HatInfo {
+        .mName = std::string {hat.mName},
+        .mType = hat.mType,
+        .mDataOffset = hat.mDataOffset,
+      });
+    }
+  }
+};
+
+// A `DeviceState` with sizes known at compile time
+template <class TLayout>
+struct FixedState {
+  std::array<int32_t, TLayout::AXIS_COUNT> mAxes {};
+  std::array<int32_t, TLayout::HAT_COUNT> mHats {};
+  std::array<uint64_t, TLayout::BUTTON_WORD_COUNT> mButtons {};
+
+  void CopyTo(DeviceState& state) const {
+    state.mAxes.assign(mAxes.begin(), mAxes.end());
+    state.mHats.assign(mHats.begin(), mHats.end());
+    state.mButtons.assign(mButtons.begin(), mButtons.end());
+  }
+};
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,64 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "FrameArena.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+FrameArena::FrameArena(std::size_t initialCapacity) {
+  this->Allocate(initialCapacity);
+}
+
+FrameArena::~FrameArena() {
+  mResource.reset();
+}
+
+void FrameArena::Allocate(std::size_t capacity) {
+  mResource.reset();
+  mBuffer = std::make_unique<std::byte[]>(capacity);
+  mCapacity = capacity;
+  mResource.emplace(
+    mBuffer.get(), mCapacity, std::pmr::new_delete_resource());
+}
+
+void FrameArena::Reset() {
+  if (mBytesAllocated > mCapacity) {
+    ++mOverflowCount;
+    // Leave some headroom for alignment padding and for growth
+    this->Allocate(mBytesAllocated * 2);
+  } else {
+    mResource->release();
+  }
+  mBytesAllocated = 0;
+}
+
+std::size_t FrameArena::GetBytesAllocated() const {
+  return mBytesAllocated;
+}
+
+std::size_t FrameArena::GetCapacity() const {
+  return mCapacity;
+}
+
+std::size_t FrameArena::GetOverflowCount() const {
+  return mOverflowCount;
+}
+
+void* FrameArena::do_allocate(std::size_t bytes, std::size_t alignment) {
+  mBytesAllocated += bytes;
+  return mResource->allocate(bytes, alignment);
+}
+
+void FrameArena::do_deallocate(
+  [[maybe_unused]] void* p,
+  [[maybe_unused]] std::size_t bytes,
+  [[maybe_unused]] std::size_t alignment) {
+  // Monotonic: memory is only reclaimed by `Reset()`
+}
+
+bool FrameArena::do_is_equal(
+  const std::pmr::memory_resource& other) const noexcept {
+  return this == &other;
+}
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,54 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+
+namespace FredEmmott::ControllerTester {
+
+/* A monotonic allocator for temporaries that only live for a single frame.
+ *
+ * Everything allocated from it is released at once by `Reset()`; if a frame
+ * needs more than the current buffer, the buffer is grown on the next reset,
+ * so steady-state frames do not touch the heap.
+ */
+class FrameArena final : public std::pmr::memory_resource {
+ public:
+  explicit FrameArena(std::size_t initialCapacity);
+  ~FrameArena();
+
+  FrameArena() = delete;
+  FrameArena(const FrameArena&) = delete;
+  FrameArena(FrameArena&&) = delete;
+  FrameArena& operator=(const FrameArena&) = delete;
+  FrameArena& operator=(FrameArena&&) = delete;
+
+  void Reset();
+
+  // Bytes handed out since the last `Reset()`
+  std::size_t GetBytesAllocated() const;
+  std::size_t GetCapacity() const;
+  // Number of resets where the frame did not fit in the buffer
+  std::size_t GetOverflowCount() const;
+
+ protected:
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+  void do_deallocate(void* p, std::size_t bytes, std::size_t alignment)
+    override;
+  bool do_is_equal(const std::pmr::memory_resource&) const noexcept override;
+
+ private:
+  std::unique_ptr<std::byte[]> mBuffer;
+  std::size_t mCapacity {};
+  std::optional<std::pmr::monotonic_buffer_resource> mResource;
+
+  std::size_t mBytesAllocated {};
+  std::size_t mOverflowCount {};
+
+  void Allocate(std::size_t capacity);
+};
+
+}// namespace FredEmmott::ControllerTester
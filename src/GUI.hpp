@@ -7,10 +7,24 @@
 
 #include <sfml/Window.hpp>
 
+#include <filesystem>
+#include <optional>
+
 #include <imgui.h>
 
+#include "AllocationCounter.hpp"
+#include "Config.hpp"
 #include "ControlInfo.hpp"
+#include "ControllerGUI.hpp"
+#include "DeviceSet.hpp"
 #include "DirectInputDeviceTracker.hpp"
+#include "FrameArena.hpp"
+#include "LatencyGUI.hpp"
+#include "PerformanceMetrics.hpp"
+#include "RemoteDeviceTracker.hpp"
+#include "RemoteGUI.hpp"
+#include "ResultsDatabase.hpp"
+#include "TimelineGUI.hpp"
 #include "XInputDeviceTracker.hpp"
 
 namespace FredEmmott::ControllerTester {
@@ -26,20 +40,46 @@ class GUI final {
 
   void GUITabs();
   void GUIAboutTab();
-  void GUIControllerTab(DeviceInfo*);
-  void GUIControllerAxes(DeviceInfo* info, std::byte* state);
-  void GUIControllerButtons(
-    DeviceInfo* info,
-    std::byte* state,
-    size_t first,
-    size_t count);
-  void GUIControllerHats(DeviceInfo* info, std::byte* state);
-
-  DirectInputDeviceTracker mDirectInputDevices;
-  XInputDeviceTracker mXInputDevices;
+  void GUIDebugOverlay();
+  void GUITraceControls();
+  void GUIPerformanceRow(
+    const char* label,
+    const RollingSamples&,
+    const char* format = "%.3f");
+
+  DeviceSet<
+    XInputDeviceTracker,
+    DirectInputDeviceTracker,
+    RemoteDeviceTracker>
+    mDevices;
   bool mDPIChanged {false};
   float mDPIScaling {};
   RECT mRecommendedWindowRect {};
+  std::filesystem::path mDataDirectory;
+  std::filesystem::path mLastTracePath;
+
+  FrameArena mFrameArena {Config::FRAME_ARENA_BYTES};
+  bool mShowDebugOverlay {false};
+  AllocationStats mLastFrameAllocations {};
+  size_t mLastFrameArenaBytes {};
+
+  struct FramePerformance {
+    FramePerformance();
+
+    RollingSamples mFrameInterval;
+    // Frame interval minus waiting for the frame rate limit
+    RollingSamples mFrameCPUTime;
+    RollingSamples mRender;
+    RollingSamples mVertexCount;
+    RollingSamples mIndexCount;
+  };
+  FramePerformance mFramePerformance;
+
+  ControllerGUI mControllerGUI {mFrameArena};
+  LatencyGUI mLatencyGUI {mFrameArena};
+  TimelineGUI mTimelineGUI {mFrameArena};
+  RemoteGUI mRemoteGUI {mFrameArena};
+  std::optional<ResultsDatabase> mResults;
 
   static LRESULT SubclassProc(
     HWND hWnd,
@@ -0,0 +1,49 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <array>
+#include <bit>
+#include <compare>
+#include <cstdint>
+
+#ifdef _WIN32
+#include <guiddef.h>
+#endif
+
+namespace FredEmmott::ControllerTester {
+
+/* A GUID without depending on <Windows.h> or C++/WinRT.
+ *
+ * Layout-compatible with the Win32 `GUID` struct, which it can be converted
+ * to and from on Windows.
+ */
+struct Guid final {
+  uint32_t mData1 {};
+  uint16_t mData2 {};
+  uint16_t mData3 {};
+  std::array<uint8_t, 8> mData4 {};
+
+  constexpr Guid() = default;
+  constexpr Guid(
+    uint32_t data1,
+    uint16_t data2,
+    uint16_t data3,
+    const std::array<uint8_t, 8>& data4)
+    : mData1(data1), mData2(data2), mData3(data3), mData4(data4) {
+  }
+
+#ifdef _WIN32
+  constexpr Guid(const GUID& guid) : Guid(std::bit_cast<Guid>(guid)) {
+  }
+
+  operator const GUID&() const {
+    return *reinterpret_cast<const GUID*>(this);
+  }
+#endif
+
+  constexpr auto operator<=>(const Guid&) const = default;
+};
+static_assert(sizeof(Guid) == 16);
+
+}// namespace FredEmmott::ControllerTester
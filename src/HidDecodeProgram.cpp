@@ -0,0 +1,664 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "HidDecodeProgram.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <optional>
+#include <string>
+#include <utility>
+
+namespace FredEmmott::ControllerTester {
+
+namespace {
+
+// Linux's `HID_MAX_BUFFER_SIZE`
+constexpr uint32_t MAX_REPORT_SIZE {16384};
+constexpr uint32_t MAX_FIELD_BITS {32};
+// A 64-bit load is shifted by up to 7 bits
+constexpr uint8_t MAX_BUTTON_RUN {57};
+constexpr int32_t HAT_CENTERED {-1};
+
+// Usage pages
+constexpr uint16_t GENERIC_DESKTOP {0x01};
+constexpr uint16_t SIMULATION {0x02};
+constexpr uint16_t GAME {0x05};
+constexpr uint16_t BUTTON {0x09};
+constexpr uint16_t SENSOR {0x20};
+
+// Generic desktop usages
+constexpr uint16_t HAT_SWITCH {0x39};
+constexpr uint16_t DPAD_UP {0x90};
+constexpr uint16_t DPAD_LEFT {0x93};
+
+enum class ItemType : uint8_t {
+  Main = 0,
+  Global = 1,
+  Local = 2,
+};
+
+namespace MainTag {
+constexpr uint8_t Input {0x8};
+constexpr uint8_t Collection {0xa};
+constexpr uint8_t EndCollection {0xc};
+}// namespace MainTag
+
+namespace GlobalTag {
+constexpr uint8_t UsagePage {0x0};
+constexpr uint8_t LogicalMinimum {0x1};
+constexpr uint8_t LogicalMaximum {0x2};
+constexpr uint8_t ReportSize {0x7};
+constexpr uint8_t ReportID {0x8};
+constexpr uint8_t ReportCount {0x9};
+constexpr uint8_t Push {0xa};
+constexpr uint8_t Pop {0xb};
+}// namespace GlobalTag
+
+namespace LocalTag {
+constexpr uint8_t Usage {0x0};
+constexpr uint8_t UsageMinimum {0x1};
+constexpr uint8_t UsageMaximum {0x2};
+}// namespace LocalTag
+
+constexpr uint8_t LONG_ITEM {0xfe};
+constexpr uint32_t INPUT_CONSTANT {1 << 0};
+constexpr uint32_t INPUT_VARIABLE {1 << 1};
+constexpr uint32_t COLLECTION_APPLICATION {0x01};
+
+enum class ControlType {
+  Axis,
+  Hat,
+  Button,
+};
+
+uint16_t GetPage(uint32_t usage) {
+  return static_cast<uint16_t>(usage >> 16);
+}
+
+uint16_t GetID(uint32_t usage) {
+  return static_cast<uint16_t>(usage & 0xffff);
+}
+
+std::optional<ControlType> GetControlType(uint32_t usage, uint32_t bitSize) {
+  const auto id = GetID(usage);
+  switch (GetPage(usage)) {
+    case BUTTON:
+      return ControlType::Button;
+    case GENERIC_DESKTOP:
+      if (id == HAT_SWITCH) {
+        return ControlType::Hat;
+      }
+      if (id >= DPAD_UP && id <= DPAD_LEFT) {
+        return ControlType::Button;
+      }
+      // X through wheel, and the vectors; not e.g. the system controls
+      if (
+        bitSize > 1
+        && ((id >= 0x30 && id <= 0x38) || (id >= 0x40 && id <= 0x48))) {
+        return ControlType::Axis;
+      }
+      return std::nullopt;
+    case SIMULATION:
+    case GAME:
+    case SENSOR:
+      return bitSize > 1 ? ControlType::Axis : ControlType::Button;
+  }
+  return std::nullopt;
+}
+
+std::string ToHex(uint32_t value, int digits) {
+  std::array<char, 8> buffer {};
+  const auto end
+    = std::to_chars(buffer.data(), buffer.data() + buffer.size(), value, 16)
+        .ptr;
+  std::string ret(buffer.data(), end);
+  if (std::cmp_less(ret.size(), digits)) {
+    ret.insert(0, digits - ret.size(), '0');
+  }
+  return ret;
+}
+
+std::string GetUsageName(uint32_t usage) {
+  const auto id = GetID(usage);
+  switch (GetPage(usage)) {
+    case BUTTON:
+      return "Button " + std::to_string(id);
+    case GENERIC_DESKTOP: {
+      constexpr std::array<const char*, 9> axes {
+        "X", "Y", "Z", "Rx", "Ry", "Rz", "Slider", "Dial", "Wheel"};
+      constexpr std::array<const char*, 7> vectors {
+        "Vx", "Vy", "Vz", "Vbrx", "Vbry", "Vbrz", "Vno"};
+      constexpr std::array<const char*, 4> dpad {
+        "D-pad Up", "D-pad Down", "D-pad Right", "D-pad Left"};
+      if (id >= 0x30 && id < 0x30 + axes.size()) {
+        return axes[id - 0x30];
+      }
+      if (id >= 0x40 && id < 0x40 + vectors.size()) {
+        return vectors[id - 0x40];
+      }
+      if (id >= DPAD_UP && id <= DPAD_LEFT) {
+        return dpad[id - DPAD_UP];
+      }
+      break;
+    }
+    case SIMULATION:
+      switch (id) {
+        case 0xba:
+          return "Rudder";
+        case 0xbb:
+          return "Throttle";
+        case 0xc4:
+          return "Accelerator";
+        case 0xc5:
+          return "Brake";
+        case 0xc6:
+          return "Clutch";
+        case 0xc8:
+          return "Steering";
+      }
+      break;
+  }
+  return "Usage " + ToHex(GetPage(usage), 4) + ":" + ToHex(id, 4);
+}
+
+HatType GetHatType(int32_t min, int32_t max) {
+  switch (max - min + 1) {
+    case 4:
+      return HatType::FourWay;
+    case 8:
+      return HatType::EightWay;
+  }
+  return HatType::Other;
+}
+
+uint64_t GetMask(uint8_t bitSize) {
+  return (uint64_t {1} << bitSize) - 1;
+}
+
+// The 64 bits starting at `bitOffset`, or fewer at the end of the report
+uint64_t Load(std::span<const std::byte> report, uint32_t bitOffset) {
+  const auto byte = bitOffset / 8;
+  uint64_t word {};
+  if (byte + sizeof(word) <= report.size()) {
+    std::memcpy(&word, report.data() + byte, sizeof(word));
+  } else {
+    std::memcpy(&word, report.data() + byte, report.size() - byte);
+  }
+  return word >> (bitOffset % 8);
+}
+
+int32_t SignExtend(uint64_t bits, uint8_t bitSize) {
+  const auto shift = 64 - bitSize;
+  return static_cast<int32_t>(static_cast<int64_t>(bits << shift) >> shift);
+}
+
+// Replaces `count` bits starting at `firstIndex`
+void SetButtons(
+  std::span<uint64_t> words,
+  std::size_t firstIndex,
+  uint64_t bits,
+  uint8_t count) {
+  constexpr auto perWord = DeviceState::BUTTONS_PER_WORD;
+  const auto mask = GetMask(count);
+  const auto word = firstIndex / perWord;
+  const auto shift = firstIndex % perWord;
+  words[word] = (words[word] & ~(mask << shift)) | (bits << shift);
+  if (shift + count > perWord) {
+    const auto rest = perWord - shift;
+    words[word + 1] = (words[word + 1] & ~(mask >> rest)) | (bits >> rest);
+  }
+}
+
+}// namespace
+
+struct HidDecodeProgram::Parser {
+  struct Globals {
+    uint16_t mUsagePage {};
+    int32_t mLogicalMinimum {};
+    int32_t mLogicalMaximum {};
+    // For descriptors that have e.g. a 1-byte maximum of 0xff with a
+    // minimum of 0; that's -1 as specified, but means 255
+    uint32_t mUnsignedLogicalMaximum {};
+    uint32_t mReportSize {};
+    uint32_t mReportCount {};
+    uint8_t mReportID {};
+  };
+
+  struct Usage {
+    uint32_t mValue {};
+    // Includes the usage page
+    bool mExtended {false};
+  };
+
+  explicit Parser(HidDecodeProgram& program) : mProgram(program) {
+  }
+
+  bool Parse(std::span<const std::byte> descriptor);
+
+ private:
+  HidDecodeProgram& mProgram;
+
+  Globals mGlobals;
+  std::vector<Globals> mGlobalStack;
+  std::vector<Usage> mUsages;
+  std::optional<Usage> mUsageMinimum;
+  std::optional<Usage> mUsageMaximum;
+  std::size_t mDepth {};
+  bool mHaveApplication {false};
+  bool mHaveReportIDs {false};
+
+  // Report bits so far, and instructions, for each report ID; reports can
+  // be interleaved in the descriptor, but instructions are grouped by report
+  std::array<uint32_t, 256> mReportBits {};
+  std::map<uint8_t, std::vector<Instruction>> mReports;
+
+  uint32_t Resolve(const Usage&) const;
+  std::vector<uint32_t> GetUsages() const;
+  int32_t GetLogicalMaximum() const;
+  bool AddInput(uint32_t flags);
+  void AddField(uint32_t usage, uint32_t bitOffset);
+  bool Finish();
+};
+
+bool HidDecodeProgram::Parser::Parse(std::span<const std::byte> descriptor) {
+  std::size_t i {};
+  while (i < descriptor.size()) {
+    const auto prefix = std::to_integer<uint8_t>(descriptor[i++]);
+    if (prefix == LONG_ITEM) {
+      if (i + 2 > descriptor.size()) {
+        return false;
+      }
+      // Reserved; none are defined
+      i += 2 + std::to_integer<uint8_t>(descriptor[i]);
+      continue;
+    }
+
+    const std::size_t size = (prefix & 3) == 3 ? 4 : (prefix & 3);
+    if (i + size > descriptor.size()) {
+      return false;
+    }
+    uint32_t data {};
+    for (std::size_t byte = 0; byte < size; ++byte) {
+      data |= std::to_integer<uint32_t>(descriptor[i + byte]) << (byte * 8);
+    }
+    i += size;
+    const auto signedData = size
+      ? SignExtend(data, static_cast<uint8_t>(size * 8))
+      : 0;
+
+    const auto type = static_cast<ItemType>((prefix >> 2) & 3);
+    const auto tag = static_cast<uint8_t>(prefix >> 4);
+    switch (type) {
+      case ItemType::Main:
+        if (tag == MainTag::Input) {
+          if (!this->AddInput(data)) {
+            return false;
+          }
+        } else if (tag == MainTag::Collection) {
+          if (
+            data == COLLECTION_APPLICATION && !mHaveApplication
+            && !mUsages.empty()) {
+            mHaveApplication = true;
+            mProgram.mApplicationUsage = this->Resolve(mUsages.front());
+          }
+          ++mDepth;
+        } else if (tag == MainTag::EndCollection) {
+          if (mDepth == 0) {
+            return false;
+          }
+          --mDepth;
+        }
+        // Local items only apply to the next main item
+        mUsages.clear();
+        mUsageMinimum.reset();
+        mUsageMaximum.reset();
+        break;
+      case ItemType::Global:
+        switch (tag) {
+          case GlobalTag::UsagePage:
+            mGlobals.mUsagePage = static_cast<uint16_t>(data);
+            break;
+          case GlobalTag::LogicalMinimum:
+            mGlobals.mLogicalMinimum = signedData;
+            break;
+          case GlobalTag::LogicalMaximum:
+            mGlobals.mLogicalMaximum = signedData;
+            mGlobals.mUnsignedLogicalMaximum = data;
+            break;
+          case GlobalTag::ReportSize:
+            mGlobals.mReportSize = data;
+            break;
+          case GlobalTag::ReportID:
+            if (data == 0 || data > 0xff) {
+              return false;
+            }
+            mGlobals.mReportID = static_cast<uint8_t>(data);
+            mHaveReportIDs = true;
+            break;
+          case GlobalTag::ReportCount:
+            mGlobals.mReportCount = data;
+            break;
+          case GlobalTag::Push:
+            mGlobalStack.push_back(mGlobals);
+            break;
+          case GlobalTag::Pop:
+            if (mGlobalStack.empty()) {
+              return false;
+            }
+            mGlobals = mGlobalStack.back();
+            mGlobalStack.pop_back();
+            break;
+        }
+        break;
+      case ItemType::Local: {
+        const Usage usage {.mValue = data, .mExtended = size == 4};
+        if (tag == LocalTag::Usage) {
+          mUsages.push_back(usage);
+        } else if (tag == LocalTag::UsageMinimum) {
+          mUsageMinimum = usage;
+        } else if (tag == LocalTag::UsageMaximum) {
+          mUsageMaximum = usage;
+        }
+        break;
+      }
+      default:
+        // Reserved
+        break;
+    }
+  }
+  return this->Finish();
+}
+
+uint32_t HidDecodeProgram::Parser::Resolve(const Usage& usage) const {
+  if (usage.mExtended) {
+    return usage.mValue;
+  }
+  return (static_cast<uint32_t>(mGlobals.mUsagePage) << 16)
+    | (usage.mValue & 0xffff);
+}
+
+// Usages for each field, as far as they're specified; the last one applies
+// to any more fields
+std::vector<uint32_t> HidDecodeProgram::Parser::GetUsages() const {
+  std::vector<uint32_t> ret;
+  for (const auto& usage: mUsages) {
+    ret.push_back(this->Resolve(usage));
+  }
+  if (mUsageMinimum && mUsageMaximum) {
+    const auto min = this->Resolve(*mUsageMinimum);
+    const auto max = this->Resolve(*mUsageMaximum);
+    for (auto usage = min;
+         usage <= max && ret.size() < mGlobals.mReportCount;
+         ++usage) {
+      ret.push_back(usage);
+    }
+  }
+  return ret;
+}
+
+int32_t HidDecodeProgram::Parser::GetLogicalMaximum() const {
+  const auto& g = mGlobals;
+  if (g.mLogicalMinimum >= 0 && g.mLogicalMaximum < g.mLogicalMinimum) {
+    return static_cast<int32_t>(std::min<uint32_t>(
+      g.mUnsignedLogicalMaximum, std::numeric_limits<int32_t>::max()));
+  }
+  return g.mLogicalMaximum;
+}
+
+bool HidDecodeProgram::Parser::AddInput(uint32_t flags) {
+  auto& bits = mReportBits[mGlobals.mReportID];
+  const auto first = bits;
+  const auto total
+    = static_cast<uint64_t>(mGlobals.mReportSize) * mGlobals.mReportCount;
+  if (first + total > MAX_REPORT_SIZE * 8) {
+    return false;
+  }
+  bits += static_cast<uint32_t>(total);
+
+  // Padding, or e.g. keyboard keys
+  if ((flags & INPUT_CONSTANT) || !(flags & INPUT_VARIABLE)) {
+    return true;
+  }
+  if (mGlobals.mReportSize == 0 || mGlobals.mReportSize > MAX_FIELD_BITS) {
+    return true;
+  }
+
+  const auto usages = this->GetUsages();
+  if (usages.empty()) {
+    return true;
+  }
+  for (uint32_t i = 0; i < mGlobals.mReportCount; ++i) {
+    this->AddField(
+      usages[std::min<std::size_t>(i, usages.size() - 1)],
+      first + (i * mGlobals.mReportSize));
+  }
+  return true;
+}
+
+void HidDecodeProgram::Parser::AddField(uint32_t usage, uint32_t bitOffset) {
+  const auto bitSize = static_cast<uint8_t>(mGlobals.mReportSize);
+  const auto type = GetControlType(usage, bitSize);
+  if (!type) {
+    return;
+  }
+
+  auto& p = mProgram;
+  auto& instructions = mReports[mGlobals.mReportID];
+  const auto min = mGlobals.mLogicalMinimum;
+  const auto max = this->GetLogicalMaximum();
+  constexpr std::size_t maxIndex {std::numeric_limits<uint16_t>::max()};
+
+  switch (*type) {
+    case ControlType::Axis: {
+      if (p.mAxes.size() >= maxIndex) {
+        return;
+      }
+      instructions.push_back({
+        .mBitOffset = bitOffset,
+        .mBitSize = bitSize,
+        .mOp = min < 0 ? Op::SignedAxis : Op::Axis,
+        .mIndex = static_cast<uint16_t>(p.mAxes.size()),
+      });
+      p.mAxes.push_back(AxisInfo {
+        .mName = GetUsageName(usage),
+        .mMin = min,
+        .mMax = max,
+      });
+      return;
+    }
+    case ControlType::Hat: {
+      if (p.mHats.size() >= maxIndex || max <= min) {
+        return;
+      }
+      instructions.push_back({
+        .mBitOffset = bitOffset,
+        .mBitSize = bitSize,
+        .mOp = Op::Hat,
+        .mIndex = static_cast<uint16_t>(p.mHats.size()),
+        .mMin = min,
+        .mMax = max,
+      });
+      p.mHats.push_back(HatInfo {
+        .mName = "Hat " + std::to_string(p.mHats.size() + 1),
+        .mType = GetHatType(min, max),
+      });
+      return;
+    }
+    case ControlType::Button: {
+      if (p.mButtons.size() >= maxIndex) {
+        return;
+      }
+      const auto index = static_cast<uint16_t>(p.mButtons.size());
+      p.mButtons.push_back(ButtonInfo {.mName = GetUsageName(usage)});
+      if (bitSize > 1) {
+        instructions.push_back({
+          .mBitOffset = bitOffset,
+          .mBitSize = bitSize,
+          .mOp = Op::WideButton,
+          .mIndex = index,
+        });
+        return;
+      }
+      if (!instructions.empty()) {
+        auto& last = instructions.back();
+        if (
+          last.mOp == Op::Buttons && last.mBitSize < MAX_BUTTON_RUN
+          && last.mBitOffset + last.mBitSize == bitOffset
+          && last.mIndex + last.mBitSize == index) {
+          ++last.mBitSize;
+          return;
+        }
+      }
+      instructions.push_back({
+        .mBitOffset = bitOffset,
+        .mBitSize = 1,
+        .mOp = Op::Buttons,
+        .mIndex = index,
+      });
+      return;
+    }
+  }
+}
+
+bool HidDecodeProgram::Parser::Finish() {
+  auto& p = mProgram;
+  if (mReports.empty()) {
+    return false;
+  }
+  // With report IDs, every report starts with one; without, there's only
+  // report 0
+  if (mHaveReportIDs && mReports.contains(0)) {
+    return false;
+  }
+  p.mHasReportIDs = mHaveReportIDs;
+  const uint32_t idBits = mHaveReportIDs ? 8 : 0;
+
+  for (const auto& [id, instructions]: mReports) {
+    p.mReportIndex[id] = static_cast<uint16_t>(p.mReports.size() + 1);
+    p.mReports.push_back({
+      .mID = id,
+      .mSize = (idBits + mReportBits[id] + 7) / 8,
+      .mFirstInstruction = static_cast<uint32_t>(p.mInstructions.size()),
+      .mInstructionCount = static_cast<uint32_t>(instructions.size()),
+    });
+    for (auto instruction: instructions) {
+      instruction.mBitOffset += idBits;
+      p.mInstructions.push_back(instruction);
+    }
+  }
+  return true;
+}
+
+HidDecodeProgram::HidDecodeProgram(std::span<const std::byte> descriptor) {
+  if (!Parser {*this}.Parse(descriptor)) {
+    *this = {};
+  }
+}
+
+bool HidDecodeProgram::IsValid() const {
+  return !mInstructions.empty();
+}
+
+uint32_t HidDecodeProgram::GetApplicationUsage() const {
+  return mApplicationUsage;
+}
+
+void HidDecodeProgram::Describe(DeviceInfo& info) const {
+  uint32_t offset {};
+  info.mAxes = mAxes;
+  for (auto& axis: info.mAxes) {
+    axis.mDataOffset = offset;
+    offset += sizeof(int32_t);
+  }
+  info.mHats = mHats;
+  for (auto& hat: info.mHats) {
+    hat.mDataOffset = offset;
+    offset += sizeof(int32_t);
+  }
+  info.mButtons = mButtons;
+  for (auto& button: info.mButtons) {
+    button.mDataOffset = offset++;
+  }
+}
+
+bool HidDecodeProgram::Decode(
+  std::span<const std::byte> report,
+  DeviceState& state) const {
+  if (report.empty()) {
+    return false;
+  }
+  const auto id = mHasReportIDs ? std::to_integer<uint8_t>(report[0]) : 0;
+  const auto index = mReportIndex[id];
+  if (!index) {
+    return false;
+  }
+  const auto& info = mReports[index - 1];
+  if (report.size() < info.mSize) {
+    return false;
+  }
+
+  if (
+    state.mAxes.size() != mAxes.size() || state.mHats.size() != mHats.size()
+    || state.mButtons.size()
+      != DeviceState::GetButtonWordCount(mButtons.size())) {
+    state.Resize(mAxes.size(), mHats.size(), mButtons.size());
+  }
+
+  const std::span<uint64_t> words {state.mButtons};
+  const auto instructions = std::span {mInstructions}.subspan(
+    info.mFirstInstruction, info.mInstructionCount);
+  for (const auto& in: instructions) {
+    const auto bits = Load(report, in.mBitOffset) & GetMask(in.mBitSize);
+    switch (in.mOp) {
+      case Op::Axis:
+        state.mAxes[in.mIndex] = static_cast<int32_t>(bits);
+        break;
+      case Op::SignedAxis:
+        state.mAxes[in.mIndex] = SignExtend(bits, in.mBitSize);
+        break;
+      case Op::Hat: {
+        // Out-of-range values are the 'null state'; that's how HID hats
+        // are centered
+        const auto value = static_cast<int64_t>(bits);
+        state.mHats[in.mIndex] = (value < in.mMin || value > in.mMax)
+          ? HAT_CENTERED
+          : static_cast<int32_t>(
+            ((value - in.mMin) * 36000) / (in.mMax - in.mMin + 1));
+        break;
+      }
+      case Op::Buttons:
+        SetButtons(words, in.mIndex, bits, in.mBitSize);
+        break;
+      case Op::WideButton:
+        SetButtons(words, in.mIndex, bits != 0, 1);
+        break;
+    }
+  }
+  return true;
+}
+
+std::vector<uint8_t> HidDecodeProgram::GetReportIDs() const {
+  std::vector<uint8_t> ret;
+  for (const auto& report: mReports) {
+    ret.push_back(report.mID);
+  }
+  return ret;
+}
+
+std::size_t HidDecodeProgram::GetMaxReportSize() const {
+  std::size_t ret {};
+  for (const auto& report: mReports) {
+    ret = std::max<std::size_t>(ret, report.mSize);
+  }
+  return ret;
+}
+
+std::size_t HidDecodeProgram::GetInstructionCount() const {
+  return mInstructions.size();
+}
+
+}// namespace FredEmmott::ControllerTester
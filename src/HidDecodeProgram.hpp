@@ -0,0 +1,101 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "DeviceInfo.hpp"
+#include "DeviceState.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+/* A HID report descriptor, compiled into a program that decodes input
+ * reports.
+ *
+ * The descriptor is parsed once; every input field that's a control becomes
+ * an instruction with its bit offset, size, and logical range, and runs of
+ * adjacent one-bit buttons become a single instruction. Each instruction is
+ * one unaligned 64-bit load, a shift, and a mask, so decoding never loops
+ * over bits.
+ *
+ * Controls are axes, hats, and buttons from the generic desktop, simulation,
+ * game, sensor, and button usage pages; array fields, e.g. keyboard
+ * keys, are skipped. HID is little-endian, like every platform we build for.
+ */
+class HidDecodeProgram final {
+ public:
+  HidDecodeProgram() = default;
+  // Check `IsValid()`; descriptors that are malformed or have no controls
+  // are invalid
+  explicit HidDecodeProgram(std::span<const std::byte> descriptor);
+
+  bool IsValid() const;
+
+  // The first application collection's usage, with the usage page in the
+  // high 16 bits; e.g. `0x0001'0005` for a gamepad
+  uint32_t GetApplicationUsage() const;
+
+  // Adds the controls, in the same order as the decoded `DeviceState`.
+  // `mDataOffset`s are a DirectInput-style layout, so they're unique
+  void Describe(DeviceInfo&) const;
+
+  // Sets the state's sizes, and only the values of the controls in this
+  // report; controls from other reports keep their values. False if the
+  // report's ID is unknown, or it's too short
+  bool Decode(std::span<const std::byte> report, DeviceState&) const;
+
+  // Input report IDs that have controls; just 0 if the device doesn't use
+  // report IDs
+  std::vector<uint8_t> GetReportIDs() const;
+  // In bytes, including the report ID
+  std::size_t GetMaxReportSize() const;
+  // For diagnostics and benchmarks
+  std::size_t GetInstructionCount() const;
+
+ private:
+  enum class Op : uint8_t {
+    Axis,
+    SignedAxis,
+    Hat,
+    // `mBitSize` one-bit buttons, starting at `mIndex`
+    Buttons,
+    // A multi-bit button, pressed if non-zero
+    WideButton,
+  };
+
+  struct Instruction {
+    uint32_t mBitOffset {};
+    uint8_t mBitSize {};
+    Op mOp {};
+    uint16_t mIndex {};
+    // Only used for hats
+    int32_t mMin {};
+    int32_t mMax {};
+  };
+
+  struct Report {
+    uint8_t mID {};
+    uint32_t mSize {};
+    uint32_t mFirstInstruction {};
+    uint32_t mInstructionCount {};
+  };
+
+  struct Parser;
+
+  std::vector<Instruction> mInstructions;
+  std::vector<Report> mReports;
+  // Index into `mReports` plus one, or 0
+  std::array<uint16_t, 256> mReportIndex {};
+  bool mHasReportIDs {false};
+  uint32_t mApplicationUsage {};
+
+  std::vector<AxisInfo> mAxes;
+  std::vector<HatInfo> mHats;
+  std::vector<ButtonInfo> mButtons;
+};
+
+}// namespace FredEmmott::ControllerTester
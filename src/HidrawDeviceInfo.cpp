@@ -0,0 +1,222 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "HidrawDeviceInfo.hpp"
+
+#include <fcntl.h>
+#include <linux/hidraw.h>
+#include <sys/ioctl.h>
+
+#include <array>
+#include <bit>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "Trace.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+namespace {
+
+// Application collection usages, with the usage page in the high 16 bits
+constexpr uint32_t JOYSTICK {0x0001'0004};
+constexpr uint32_t GAMEPAD {0x0001'0005};
+constexpr uint32_t MULTI_AXIS_CONTROLLER {0x0001'0008};
+constexpr uint16_t SIMULATION_PAGE {0x02};
+constexpr uint16_t GAME_PAGE {0x05};
+// Reports that can be waiting for `Poll()`; any more wait in the kernel
+constexpr std::size_t READ_BUFFERS {64};
+
+bool IsGameController(uint32_t applicationUsage) {
+  switch (applicationUsage) {
+    case JOYSTICK:
+    case GAMEPAD:
+    case MULTI_AXIS_CONTROLLER:
+      return true;
+  }
+  const auto page = applicationUsage >> 16;
+  return page == SIMULATION_PAGE || page == GAME_PAGE;
+}
+
+uint32_t HashString(std::string_view value) {
+  // FNV-1a
+  uint32_t hash {0x811c9dc5};
+  for (const auto c: value) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 0x01000193;
+  }
+  return hash;
+}
+
+std::string GetString(int fd, unsigned long request) {
+  std::array<char, 256> buffer {};
+  if (ioctl(fd, request, buffer.data()) < 0) {
+    return {};
+  }
+  return {buffer.data()};
+}
+
+}// namespace
+
+std::optional<HidrawDeviceInstance> HidrawDeviceInfo::Probe(
+  const std::filesystem::path& path) {
+  const UniqueFD fd {open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC)};
+  if (!fd) {
+    return std::nullopt;
+  }
+
+  hidraw_report_descriptor descriptor {};
+  int size {};
+  if (
+    ioctl(fd.Get(), HIDIOCGRDESCSIZE, &size) < 0 || size <= 0
+    || size > HID_MAX_DESCRIPTOR_SIZE) {
+    return std::nullopt;
+  }
+  descriptor.size = static_cast<uint32_t>(size);
+  if (ioctl(fd.Get(), HIDIOCGRDESC, &descriptor) < 0) {
+    return std::nullopt;
+  }
+  auto program = std::make_shared<const HidDecodeProgram>(
+    std::as_bytes(std::span {descriptor.value, descriptor.size}));
+  if (
+    !(program->IsValid()
+      && IsGameController(program->GetApplicationUsage()))) {
+    return std::nullopt;
+  }
+
+  hidraw_devinfo info {};
+  ioctl(fd.Get(), HIDIOCGRAWINFO, &info);
+  const auto vendor = static_cast<uint16_t>(info.vendor);
+  const auto product = static_cast<uint16_t>(info.product);
+  // Prefer the serial number, then the physical port, so that the GUID is
+  // the same when the device is reconnected
+  auto where = GetString(fd.Get(), HIDIOCGRAWUNIQ(256));
+  if (where.empty()) {
+    where = GetString(fd.Get(), HIDIOCGRAWPHYS(256));
+  }
+  if (where.empty()) {
+    where = path.string();
+  }
+
+  return HidrawDeviceInstance {
+    .mPath = path,
+    .mGuid = {
+      HashString(where),
+      vendor,
+      product,
+      {
+        static_cast<uint8_t>(info.bustype & 0xff),
+        static_cast<uint8_t>((info.bustype >> 8) & 0xff),
+        0,
+        0,
+        'H',
+        'I',
+        'D',
+        'R',
+      },
+    },
+    .mProgram = std::move(program),
+  };
+}
+
+HidrawDeviceInfo::HidrawDeviceInfo(
+  const HidrawDeviceInstance& instance,
+  InputQueue::Backend backend)
+  : mPath(instance.mPath),
+    mFD(open(instance.mPath.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC)),
+    mProgram(instance.mProgram) {
+  const Trace::Zone traceZone {"HidrawDeviceInfo::HidrawDeviceInfo"};
+  mGuid = instance.mGuid;
+  mProgram->Describe(*this);
+  mState.Resize(mAxes.size(), mHats.size(), mButtons.size());
+  // One more byte than the largest report, so a longer one isn't truncated
+  // to a valid length
+  mReport.resize(mProgram->GetMaxReportSize() + 1);
+  if (!mFD) {
+    mName = mPath.filename().string();
+    return;
+  }
+  const auto fd = mFD.Get();
+  mName = GetString(fd, HIDIOCGRAWNAME(256));
+
+  hidraw_devinfo info {};
+  ioctl(fd, HIDIOCGRAWINFO, &info);
+  // The same format as DirectInput's product GUIDs, so results for the
+  // same model match across platforms
+  mProduct = {
+    static_cast<uint32_t>(static_cast<uint16_t>(info.vendor))
+      | (static_cast<uint32_t>(static_cast<uint16_t>(info.product)) << 16),
+    0,
+    0,
+    {0, 0, 'P', 'I', 'D', 'V', 'I', 'D'},
+  };
+
+  this->ReadInitialState();
+
+  mInput.emplace(
+    fd,
+    InputQueueSettings {
+      .mBackend = backend,
+      // Rounded up, so devices with similar reports share a queue; longer
+      // reports than `mReport` still aren't truncated to a valid length
+      .mBufferSize = std::bit_ceil(mReport.size()),
+      .mBufferCount = READ_BUFFERS,
+    });
+  if (!mInput->IsValid()) {
+    mInput.reset();
+    mFD.Reset();
+  }
+}
+
+HidrawDeviceInfo::~HidrawDeviceInfo() {
+}
+
+bool HidrawDeviceInfo::Poll() {
+  if (!mInput) {
+    return false;
+  }
+  // One report per read
+  const auto present
+    = mInput->Read([this](std::span<const std::byte> report) {
+        mProgram->Decode(report, mState);
+      });
+  if (!present) {
+    // e.g. `ENODEV` once it's unplugged
+    mInput.reset();
+    mFD.Reset();
+  }
+  return present;
+}
+
+std::optional<DeviceState> HidrawDeviceInfo::GetState(
+  std::pmr::memory_resource* resource) {
+  if (!mFD) {
+    return std::nullopt;
+  }
+  DeviceState ret {resource};
+  // Assignment keeps `resource`, unlike copy construction
+  ret = mState;
+  return ret;
+}
+
+// Devices don't send a report until something changes, so ask for each
+// one; many devices don't support this, so failures are ignored
+void HidrawDeviceInfo::ReadInitialState() {
+#ifdef HIDIOCGINPUT
+  for (const auto id: mProgram->GetReportIDs()) {
+    mReport[0] = std::byte {id};
+    const auto bytes
+      = ioctl(mFD.Get(), HIDIOCGINPUT(mReport.size()), mReport.data());
+    if (bytes <= 0) {
+      continue;
+    }
+    // Without report IDs, the report follows a 0 that isn't part of it
+    const auto report
+      = std::span {mReport}.first(static_cast<std::size_t>(bytes));
+    mProgram->Decode(id ? report : report.subspan(1), mState);
+  }
+#endif
+}
+
+}// namespace FredEmmott::ControllerTester
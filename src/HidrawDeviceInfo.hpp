@@ -0,0 +1,71 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "DeviceInfo.hpp"
+#include "HidDecodeProgram.hpp"
+#include "InputQueue.hpp"
+#include "UniqueFD.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+// Like `DIDEVICEINSTANCE`: enough to identify a device without opening it
+// for reading. The descriptor is compiled while probing, and shared with
+// every `HidrawDeviceInfo` for the node
+struct HidrawDeviceInstance {
+  std::filesystem::path mPath;
+  Guid mGuid;
+  std::shared_ptr<const HidDecodeProgram> mProgram;
+};
+
+/* A Linux HID device, read through its `/dev/hidraw*` node.
+ *
+ * Input reports are read through an `InputNode`, and decoded straight from
+ * the report descriptor, so this shows data that the kernel's drivers hide
+ * or rescale, e.g. extra axes, full precision, or vendor-specific layouts.
+ */
+struct HidrawDeviceInfo final : public DeviceInfo {
+  explicit HidrawDeviceInfo(
+    const HidrawDeviceInstance&,
+    InputQueue::Backend = InputQueue::Backend::IoUring);
+  ~HidrawDeviceInfo();
+
+  HidrawDeviceInfo() = delete;
+  HidrawDeviceInfo(const HidrawDeviceInfo&) = delete;
+  HidrawDeviceInfo(HidrawDeviceInfo&&) = default;
+
+  HidrawDeviceInfo& operator=(const HidrawDeviceInfo&) = delete;
+  HidrawDeviceInfo& operator=(HidrawDeviceInfo&&) = default;
+
+  // Nullopt if the node can't be opened, or isn't a game controller
+  static std::optional<HidrawDeviceInstance> Probe(
+    const std::filesystem::path&);
+
+  // Reads every pending report; false if the device has gone
+  bool Poll();
+  std::optional<DeviceState> GetState(std::pmr::memory_resource*);
+
+  std::filesystem::path mPath;
+
+ private:
+  UniqueFD mFD;
+  // Declared after `mFD`, as it must be closed first
+  std::optional<InputNode> mInput;
+  std::shared_ptr<const HidDecodeProgram> mProgram;
+  // Reports only contain some controls if the device has several, so this
+  // is updated in place
+  DeviceState mState;
+  std::vector<std::byte> mReport;
+
+  void ReadInitialState();
+};
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,42 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "HidrawDeviceTracker.hpp"
+
+#include <filesystem>
+#include <system_error>
+
+namespace FredEmmott::ControllerTester {
+
+HidrawDeviceTracker::HidrawDeviceTracker(InputQueue::Backend backend)
+  : mBackend(backend) {
+}
+
+Guid HidrawDeviceTracker::GetKey(const HidrawDeviceInstance& instance) {
+  return instance.mGuid;
+}
+
+Guid HidrawDeviceTracker::GetKey(const HidrawDeviceInfo& info) {
+  return info.mGuid;
+}
+
+std::vector<HidrawDeviceInstance> HidrawDeviceTracker::Enumerate() {
+  std::vector<HidrawDeviceInstance> ret;
+  std::error_code ec;
+  for (const auto& entry: std::filesystem::directory_iterator {"/dev", ec}) {
+    if (!entry.path().filename().string().starts_with("hidraw")) {
+      continue;
+    }
+    if (auto instance = HidrawDeviceInfo::Probe(entry.path())) {
+      ret.push_back(std::move(*instance));
+    }
+  }
+  return ret;
+}
+
+HidrawDeviceInfo HidrawDeviceTracker::CreateInfo(
+  const HidrawDeviceInstance& instance) {
+  return HidrawDeviceInfo {instance, mBackend};
+}
+
+}// namespace FredEmmott::ControllerTester
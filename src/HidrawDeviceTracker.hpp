@@ -0,0 +1,41 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <vector>
+
+#include "DeviceTracker.hpp"
+#include "HidrawDeviceInfo.hpp"
+#include "InputQueue.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+/* Game controllers from `/dev/hidraw*`.
+ *
+ * These nodes are usually only readable by root unless a udev rule grants
+ * access; nodes that can't be opened are skipped, like devices that aren't
+ * game controllers.
+ */
+class HidrawDeviceTracker final : public DeviceTracker<
+                                    HidrawDeviceTracker,
+                                    HidrawDeviceInfo,
+                                    HidrawDeviceInstance,
+                                    Guid> {
+ public:
+  explicit HidrawDeviceTracker(
+    InputQueue::Backend = InputQueue::Backend::IoUring);
+  virtual ~HidrawDeviceTracker() = default;
+
+  static Guid GetKey(const HidrawDeviceInstance&);
+  static Guid GetKey(const HidrawDeviceInfo&);
+
+ protected:
+  virtual std::vector<HidrawDeviceInstance> Enumerate() override;
+  virtual HidrawDeviceInfo CreateInfo(const HidrawDeviceInstance&) override;
+
+ private:
+  // For the devices' `InputNode`s
+  InputQueue::Backend mBackend;
+};
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,670 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "InputQueue.hpp"
+
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <csignal>
+#include <cstddef>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#include "Trace.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+namespace {
+
+// Linux 6.7; newer than some distributions' headers
+constexpr uint8_t OP_READ_MULTISHOT {49};
+
+// Submissions are only re-arms and cancellations, so this can be small
+constexpr uint32_t SQ_ENTRIES {64};
+constexpr uint16_t BUFFER_GROUP {0};
+// `user_data` for cancellations; keys are 32-bit
+constexpr uint64_t CANCEL_USER_DATA {~uint64_t {}};
+// Per `epoll_wait()`
+constexpr int EPOLL_EVENTS {64};
+
+// The ring's head and tail are shared with the kernel
+template <class T>
+T LoadAcquire(T& value) {
+  return std::atomic_ref<T> {value}.load(std::memory_order_acquire);
+}
+
+template <class T>
+void StoreRelease(T& value, T newValue) {
+  std::atomic_ref<T> {value}.store(newValue, std::memory_order_release);
+}
+
+// Returns -errno on failure, like the kernel
+int IoUringSetup(uint32_t entries, io_uring_params* params) {
+  const auto ret = syscall(__NR_io_uring_setup, entries, params);
+  return ret < 0 ? -errno : static_cast<int>(ret);
+}
+
+int IoUringRegister(int fd, unsigned int op, void* arg, unsigned int count) {
+  const auto ret = syscall(__NR_io_uring_register, fd, op, arg, count);
+  return ret < 0 ? -errno : static_cast<int>(ret);
+}
+
+int IoUringEnter(
+  int fd,
+  uint32_t toSubmit,
+  uint32_t minComplete,
+  uint32_t flags,
+  const void* arg,
+  std::size_t argSize) {
+  const auto ret = syscall(
+    __NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argSize);
+  return ret < 0 ? -errno : static_cast<int>(ret);
+}
+
+// A memory mapping, unmapped on destruction
+class Mapping final {
+ public:
+  Mapping() = default;
+  Mapping(void* data, std::size_t size) : mData(data), mSize(size) {
+    if (mData == MAP_FAILED) {
+      mData = nullptr;
+    }
+  }
+  ~Mapping() {
+    if (mData) {
+      munmap(mData, mSize);
+    }
+  }
+
+  Mapping(const Mapping&) = delete;
+  Mapping(Mapping&&) = delete;
+  Mapping& operator=(const Mapping&) = delete;
+  Mapping& operator=(Mapping&&) = delete;
+
+  template <class T = std::byte>
+  T* Get(std::size_t offset = 0) const {
+    return reinterpret_cast<T*>(static_cast<std::byte*>(mData) + offset);
+  }
+
+  explicit operator bool() const {
+    return mData;
+  }
+
+ private:
+  void* mData {nullptr};
+  std::size_t mSize {};
+};
+
+}// namespace
+
+struct InputQueue::Ring {
+  UniqueFD mFD;
+
+  std::unique_ptr<Mapping> mRings;
+  std::unique_ptr<Mapping> mSQEs;
+  uint32_t* mSQTail {nullptr};
+  uint32_t* mSQHead {nullptr};
+  uint32_t mSQMask {};
+  uint32_t* mSQArray {nullptr};
+  uint32_t* mSQFlags {nullptr};
+  uint32_t* mCQHead {nullptr};
+  uint32_t* mCQTail {nullptr};
+  uint32_t mCQMask {};
+  io_uring_cqe* mCQEs {nullptr};
+  uint32_t mUnsubmitted {};
+
+  // Provided buffers: the kernel picks one for each read from the ring,
+  // and they're given back once delivered
+  std::unique_ptr<Mapping> mBufferRing;
+  std::vector<std::byte> mBuffers;
+  std::size_t mBufferSize {};
+  uint16_t mBufferMask {};
+  uint16_t mBufferTail {};
+
+  static std::unique_ptr<Ring> Create(const InputQueueSettings&);
+
+  // Nullptr if the submission queue is full
+  io_uring_sqe* GetSQE();
+  void RecycleBuffer(uint16_t id);
+  void PublishBuffers();
+};
+
+std::unique_ptr<InputQueue::Ring> InputQueue::Ring::Create(
+  const InputQueueSettings& settings) {
+  auto ret = std::make_unique<Ring>();
+  const auto bufferCount = std::bit_ceil(
+    std::clamp<std::size_t>(settings.mBufferCount, 1, 1 << 15));
+
+  io_uring_params params {};
+  // Completions are only processed when we're waiting for them anyway,
+  // instead of interrupting whatever this thread is doing; the kernel
+  // flags when there are any, so idle drains don't need a syscall
+  params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SINGLE_ISSUER
+    | IORING_SETUP_DEFER_TASKRUN | IORING_SETUP_TASKRUN_FLAG;
+  // Every buffer could be full at once, plus the cancellations
+  params.cq_entries = static_cast<uint32_t>(bufferCount * 2);
+  auto fd = IoUringSetup(SQ_ENTRIES, &params);
+  if (fd == -EINVAL) {
+    // Before Linux 6.1
+    params = {};
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = static_cast<uint32_t>(bufferCount * 2);
+    fd = IoUringSetup(SQ_ENTRIES, &params);
+  }
+  if (fd < 0) {
+    return nullptr;
+  }
+  ret->mFD = UniqueFD {fd};
+  const auto required = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_EXT_ARG;
+  if ((params.features & required) != required) {
+    return nullptr;
+  }
+
+  constexpr std::size_t probeOps {256};
+  alignas(io_uring_probe) std::array<
+    std::byte,
+    sizeof(io_uring_probe) + (probeOps * sizeof(io_uring_probe_op))>
+    probeBuffer {};
+  auto probe = reinterpret_cast<io_uring_probe*>(probeBuffer.data());
+  if (
+    IoUringRegister(fd, IORING_REGISTER_PROBE, probe, probeOps) < 0
+    || probe->last_op < OP_READ_MULTISHOT
+    || !(probe->ops[OP_READ_MULTISHOT].flags & IO_URING_OP_SUPPORTED)) {
+    return nullptr;
+  }
+
+  const auto ringSize = std::max<std::size_t>(
+    params.sq_off.array + (params.sq_entries * sizeof(uint32_t)),
+    params.cq_off.cqes + (params.cq_entries * sizeof(io_uring_cqe)));
+  ret->mRings = std::make_unique<Mapping>(
+    mmap(
+      nullptr,
+      ringSize,
+      PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE,
+      fd,
+      IORING_OFF_SQ_RING),
+    ringSize);
+  const auto sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+  ret->mSQEs = std::make_unique<Mapping>(
+    mmap(
+      nullptr,
+      sqesSize,
+      PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE,
+      fd,
+      IORING_OFF_SQES),
+    sqesSize);
+  if (!(*ret->mRings && *ret->mSQEs)) {
+    return nullptr;
+  }
+  const auto& rings = *ret->mRings;
+  ret->mSQHead = rings.Get<uint32_t>(params.sq_off.head);
+  ret->mSQTail = rings.Get<uint32_t>(params.sq_off.tail);
+  ret->mSQMask = *rings.Get<uint32_t>(params.sq_off.ring_mask);
+  ret->mSQArray = rings.Get<uint32_t>(params.sq_off.array);
+  ret->mSQFlags = rings.Get<uint32_t>(params.sq_off.flags);
+  ret->mCQHead = rings.Get<uint32_t>(params.cq_off.head);
+  ret->mCQTail = rings.Get<uint32_t>(params.cq_off.tail);
+  ret->mCQMask = *rings.Get<uint32_t>(params.cq_off.ring_mask);
+  ret->mCQEs = rings.Get<io_uring_cqe>(params.cq_off.cqes);
+
+  const auto bufferRingSize = bufferCount * sizeof(io_uring_buf);
+  ret->mBufferRing = std::make_unique<Mapping>(
+    mmap(
+      nullptr,
+      bufferRingSize,
+      PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE,
+      -1,
+      0),
+    bufferRingSize);
+  if (!*ret->mBufferRing) {
+    return nullptr;
+  }
+  io_uring_buf_reg registration {};
+  registration.ring_addr
+    = reinterpret_cast<uintptr_t>(ret->mBufferRing->Get());
+  registration.ring_entries = static_cast<uint32_t>(bufferCount);
+  registration.bgid = BUFFER_GROUP;
+  if (IoUringRegister(fd, IORING_REGISTER_PBUF_RING, &registration, 1) < 0) {
+    return nullptr;
+  }
+
+  ret->mBufferSize = settings.mBufferSize;
+  ret->mBufferMask = static_cast<uint16_t>(bufferCount - 1);
+  ret->mBuffers.resize(bufferCount * settings.mBufferSize);
+  for (std::size_t i = 0; i < bufferCount; ++i) {
+    ret->RecycleBuffer(static_cast<uint16_t>(i));
+  }
+  ret->PublishBuffers();
+  return ret;
+}
+
+io_uring_sqe* InputQueue::Ring::GetSQE() {
+  const auto tail = *mSQTail;
+  if (tail - LoadAcquire(*mSQHead) > mSQMask) {
+    return nullptr;
+  }
+  const auto index = tail & mSQMask;
+  auto sqe = mSQEs->Get<io_uring_sqe>() + index;
+  std::memset(sqe, 0, sizeof(*sqe));
+  mSQArray[index] = index;
+  StoreRelease(*mSQTail, tail + 1);
+  ++mUnsubmitted;
+  return sqe;
+}
+
+void InputQueue::Ring::RecycleBuffer(uint16_t id) {
+  // Field by field: the ring's tail overlaps the first entry's `resv`
+  auto& entry
+    = mBufferRing->Get<io_uring_buf>()[mBufferTail++ & mBufferMask];
+  entry.addr = reinterpret_cast<uintptr_t>(
+    mBuffers.data() + (static_cast<std::size_t>(id) * mBufferSize));
+  entry.len = static_cast<uint32_t>(mBufferSize);
+  entry.bid = id;
+}
+
+void InputQueue::Ring::PublishBuffers() {
+  auto tail = mBufferRing->Get<uint16_t>(offsetof(io_uring_buf, resv));
+  StoreRelease(*tail, mBufferTail);
+}
+
+InputQueue::InputQueue(const InputQueueSettings& settings)
+  : mSettings(settings) {
+  if (mSettings.mBackend == Backend::IoUring) {
+    mRing = Ring::Create(mSettings);
+  }
+  if (!mRing) {
+    mSettings.mBackend = Backend::Epoll;
+    mEpoll = UniqueFD {epoll_create1(EPOLL_CLOEXEC)};
+    mReadBuffer.resize(mSettings.mBufferSize);
+  }
+}
+
+InputQueue::~InputQueue() = default;
+
+bool InputQueue::IsValid() const {
+  return mRing || mEpoll;
+}
+
+InputQueue::Backend InputQueue::GetBackend() const {
+  return mSettings.mBackend;
+}
+
+uint64_t InputQueue::GetSyscallCount() const {
+  return mSyscallCount;
+}
+
+InputQueue::Key InputQueue::AllocateKey() {
+  // With io_uring, a removed node's slot is only free once its read has
+  // finished, so its completions can't be mistaken for a new node's
+  const auto it = std::ranges::find_if(mNodes, [](const Node& node) {
+    return !(node.mActive || node.mArmed);
+  });
+  if (it != mNodes.end()) {
+    return static_cast<Key>(it - mNodes.begin());
+  }
+  mNodes.emplace_back();
+  return static_cast<Key>(mNodes.size() - 1);
+}
+
+std::optional<InputQueue::Key> InputQueue::Add(int fd, Sink sink) {
+  if (!this->IsValid()) {
+    return std::nullopt;
+  }
+  const auto key = this->AllocateKey();
+  if (mEpoll) {
+    epoll_event event {.events = EPOLLIN, .data = {.u32 = key}};
+    ++mSyscallCount;
+    if (epoll_ctl(mEpoll.Get(), EPOLL_CTL_ADD, fd, &event) < 0) {
+      return std::nullopt;
+    }
+  }
+  // With io_uring, it's armed by the next `Drain()`
+  mNodes[key] = {.mFD = fd, .mSink = std::move(sink), .mActive = true};
+  return key;
+}
+
+void InputQueue::Remove(Key key) {
+  if (key >= mNodes.size() || !mNodes[key].mActive) {
+    return;
+  }
+  auto& node = mNodes[key];
+  // The sink is kept until the slot is reused, as this may be called from
+  // it
+  node.mActive = false;
+  if (!mRing) {
+    ++mSyscallCount;
+    epoll_ctl(mEpoll.Get(), EPOLL_CTL_DEL, node.mFD, nullptr);
+    return;
+  }
+  if (!node.mArmed) {
+    return;
+  }
+  // The ring holds its own reference to the file, so closing the fd
+  // doesn't end the read; it must be cancelled, or the slot can't be
+  // reused
+  node.mCancelPending = !this->SubmitCancel(key);
+}
+
+bool InputQueue::SubmitCancel(Key key) {
+  // Submitted by the next `Drain()`
+  auto sqe = mRing->GetSQE();
+  if (!sqe) {
+    return false;
+  }
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->fd = -1;
+  sqe->addr = key;
+  sqe->user_data = CANCEL_USER_DATA;
+  return true;
+}
+
+void InputQueue::Deliver(Key key, std::span<const std::byte> data) {
+  auto& node = mNodes[key];
+  if (data.empty()) {
+    node.mActive = false;
+  }
+  node.mSink(data);
+}
+
+std::size_t InputQueue::Drain(Clock::duration timeout) {
+  const Trace::Zone traceZone {"InputQueue::Drain"};
+  if (mRing) {
+    return this->DrainRing(timeout);
+  }
+  if (mEpoll) {
+    return this->DrainEpoll(timeout);
+  }
+  return 0;
+}
+
+std::size_t InputQueue::DrainRing(Clock::duration timeout) {
+  auto& ring = *mRing;
+  for (Key key = 0; key < mNodes.size(); ++key) {
+    auto& node = mNodes[key];
+    if (node.mCancelPending) {
+      node.mCancelPending = !this->SubmitCancel(key);
+      continue;
+    }
+    if (!node.mActive || node.mArmed) {
+      continue;
+    }
+    auto sqe = ring.GetSQE();
+    if (!sqe) {
+      break;
+    }
+    sqe->opcode = OP_READ_MULTISHOT;
+    sqe->fd = node.mFD;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUFFER_GROUP;
+    // The current position; evdev and hidraw don't have any others
+    sqe->off = ~uint64_t {};
+    sqe->user_data = key;
+    node.mArmed = true;
+  }
+
+  // Without deferred task running, completions arrive without a syscall;
+  // with it, the kernel sets `IORING_SQ_TASKRUN` until we enter to collect
+  // them. A poll with nothing to submit or collect is then free
+  const auto ready = *ring.mCQHead != LoadAcquire(*ring.mCQTail);
+  const auto pending = LoadAcquire(*ring.mSQFlags)
+    & (IORING_SQ_TASKRUN | IORING_SQ_CQ_OVERFLOW);
+  const auto wait = !ready && timeout > Clock::duration::zero();
+  if (ring.mUnsubmitted || pending || wait) {
+    const auto nanos
+      = std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count();
+    const __kernel_timespec ts {
+      .tv_sec = nanos / 1'000'000'000,
+      .tv_nsec = nanos % 1'000'000'000,
+    };
+    const io_uring_getevents_arg arg {
+      .sigmask = 0,
+      .sigmask_sz = _NSIG / 8,
+      .pad = 0,
+      .ts = reinterpret_cast<uintptr_t>(&ts),
+    };
+    ++mSyscallCount;
+    const auto submitted = IoUringEnter(
+      ring.mFD.Get(),
+      ring.mUnsubmitted,
+      wait ? 1 : 0,
+      IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+      &arg,
+      sizeof(arg));
+    if (submitted > 0) {
+      ring.mUnsubmitted -= std::min<uint32_t>(submitted, ring.mUnsubmitted);
+    }
+  }
+
+  std::size_t delivered {};
+  auto head = *ring.mCQHead;
+  const auto tail = LoadAcquire(*ring.mCQTail);
+  for (; head != tail; ++head) {
+    const auto& cqe = ring.mCQEs[head & ring.mCQMask];
+    if (cqe.user_data == CANCEL_USER_DATA) {
+      continue;
+    }
+    const auto key = static_cast<Key>(cqe.user_data);
+    if (!(cqe.flags & IORING_CQE_F_MORE)) {
+      // Re-armed by the next `Drain()` if it's still active; if it was
+      // removed, there's nothing left to cancel
+      mNodes[key].mArmed = false;
+      mNodes[key].mCancelPending = false;
+    }
+    if (cqe.flags & IORING_CQE_F_BUFFER) {
+      const auto id
+        = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+      if (cqe.res > 0 && mNodes[key].mActive) {
+        const auto offset = static_cast<std::size_t>(id) * ring.mBufferSize;
+        this->Deliver(
+          key,
+          {ring.mBuffers.data() + offset, static_cast<std::size_t>(cqe.res)});
+        ++delivered;
+      }
+      ring.RecycleBuffer(id);
+    }
+    // Out of buffers, or cancelled by `Remove()`; anything else is the end
+    // of the node, e.g. `ENODEV` once it's unplugged, or end-of-file
+    if (cqe.res > 0 || cqe.res == -ENOBUFS || cqe.res == -ECANCELED) {
+      continue;
+    }
+    if (mNodes[key].mActive) {
+      this->Deliver(key, {});
+    }
+  }
+  StoreRelease(*ring.mCQHead, head);
+  ring.PublishBuffers();
+  return delivered;
+}
+
+std::size_t InputQueue::DrainEpoll(Clock::duration timeout) {
+  std::array<epoll_event, EPOLL_EVENTS> events;
+  // Rounded up, so short timeouts don't spin
+  const auto ms = std::chrono::ceil<std::chrono::milliseconds>(timeout);
+  ++mSyscallCount;
+  const auto count = epoll_wait(
+    mEpoll.Get(),
+    events.data(),
+    events.size(),
+    static_cast<int>(std::max<int64_t>(ms.count(), 0)));
+
+  std::size_t delivered {};
+  for (int i = 0; i < count; ++i) {
+    const auto key = events[i].data.u32;
+    // Until it would block; hidraw returns one report per `read()`
+    while (key < mNodes.size() && mNodes[key].mActive) {
+      ++mSyscallCount;
+      const auto bytes
+        = read(mNodes[key].mFD, mReadBuffer.data(), mReadBuffer.size());
+      if (bytes > 0) {
+        this->Deliver(
+          key, {mReadBuffer.data(), static_cast<std::size_t>(bytes)});
+        ++delivered;
+        continue;
+      }
+      if (bytes < 0 && errno == EINTR) {
+        continue;
+      }
+      if (bytes < 0 && errno == EAGAIN) {
+        break;
+      }
+      ++mSyscallCount;
+      epoll_ctl(mEpoll.Get(), EPOLL_CTL_DEL, mNodes[key].mFD, nullptr);
+      this->Deliver(key, {});
+    }
+  }
+  return delivered;
+}
+
+struct InputNode::SharedQueue {
+  explicit SharedQueue(const InputQueueSettings& settings)
+    : mSettings(settings), mQueue(settings) {
+  }
+
+  // As requested; `mQueue` may have fallen back to epoll
+  const InputQueueSettings mSettings;
+  const std::thread::id mThread {std::this_thread::get_id()};
+  // Held by every call, as nodes can be removed from any thread
+  std::mutex mMutex;
+  InputQueue mQueue;
+};
+
+InputNode::InputNode(int fd, const InputQueueSettings& settings)
+  : mFD(fd), mSettings(settings), mTarget(std::make_unique<Target>()) {
+  this->Attach();
+}
+
+InputNode::~InputNode() {
+  this->Detach();
+}
+
+InputNode& InputNode::operator=(InputNode&& other) {
+  if (this == &other) {
+    return *this;
+  }
+  this->Detach();
+  mFD = other.mFD;
+  mSettings = other.mSettings;
+  mTarget = std::move(other.mTarget);
+  mQueue = std::move(other.mQueue);
+  mKey = other.mKey;
+  return *this;
+}
+
+bool InputNode::IsValid() const {
+  return mQueue.get();
+}
+
+InputQueue::Backend InputNode::GetBackend() const {
+  return mQueue ? mQueue->mQueue.GetBackend() : InputQueue::Backend::Epoll;
+}
+
+std::shared_ptr<InputNode::SharedQueue> InputNode::GetThreadQueue(
+  const InputQueueSettings& settings) {
+  // Kept until the thread exits, and after that by any nodes that are
+  // still in them
+  thread_local std::vector<std::shared_ptr<SharedQueue>> queues;
+  const auto it = std::ranges::find_if(queues, [&settings](const auto& queue) {
+    return queue->mSettings == settings;
+  });
+  if (it != queues.end()) {
+    return *it;
+  }
+  auto ret = std::make_shared<SharedQueue>(settings);
+  if (!ret->mQueue.IsValid()) {
+    return nullptr;
+  }
+  queues.push_back(ret);
+  return ret;
+}
+
+void InputNode::Target::Deliver(std::span<const std::byte> data) {
+  if (data.empty()) {
+    mGone = true;
+    return;
+  }
+  if (mApply) {
+    mApply(mContext, data);
+    return;
+  }
+  mPending.insert(mPending.end(), data.begin(), data.end());
+  mPendingSizes.push_back(data.size());
+}
+
+void InputNode::Attach() {
+  mQueue = GetThreadQueue(mSettings);
+  if (!mQueue) {
+    return;
+  }
+  const std::unique_lock lock {mQueue->mMutex};
+  const auto key = mQueue->mQueue.Add(
+    mFD, [target = mTarget.get()](std::span<const std::byte> data) {
+      target->Deliver(data);
+    });
+  if (!key) {
+    mQueue.reset();
+    return;
+  }
+  mKey = *key;
+}
+
+void InputNode::Detach() {
+  if (!mQueue) {
+    return;
+  }
+  {
+    const std::unique_lock lock {mQueue->mMutex};
+    // Once it's gone, the queue has already removed it, and the key may
+    // belong to another node
+    if (!mTarget->mGone) {
+      mQueue->mQueue.Remove(mKey);
+    }
+  }
+  mQueue.reset();
+}
+
+bool InputNode::Drain() {
+  auto& target = *mTarget;
+  if (mQueue && mQueue->mThread != std::this_thread::get_id()) {
+    // Reads that the old queue's kernel buffers hold are lost, but the
+    // device's state is only read when it changes again, as when it's
+    // first opened. Once detached, the old queue doesn't deliver to us
+    this->Detach();
+    if (!target.mGone) {
+      this->Attach();
+    }
+  }
+
+  std::size_t offset {};
+  for (const auto size: target.mPendingSizes) {
+    target.mApply(
+      target.mContext, std::span {target.mPending}.subspan(offset, size));
+    offset += size;
+  }
+  target.mPending.clear();
+  target.mPendingSizes.clear();
+
+  if (target.mGone || !mQueue) {
+    return false;
+  }
+  {
+    const std::unique_lock lock {mQueue->mMutex};
+    mQueue->mQueue.Drain(InputQueue::Clock::duration::zero());
+  }
+  return !target.mGone;
+}
+
+}// namespace FredEmmott::ControllerTester
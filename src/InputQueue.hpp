@@ -0,0 +1,196 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <chrono>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "UniqueFD.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+struct InputQueueSettings {
+  enum class Backend {
+    IoUring,
+    Epoll,
+  };
+
+  // Falls back to epoll if io_uring isn't available
+  Backend mBackend {Backend::IoUring};
+  // Per read; the largest report or batch of events that's delivered at once
+  std::size_t mBufferSize {4096};
+  // Shared by every node; rounded up to a power of two
+  std::size_t mBufferCount {256};
+
+  bool operator==(const InputQueueSettings&) const = default;
+};
+
+/* Reads many Linux input nodes, e.g. evdev or hidraw, with as few syscalls
+ * as possible.
+ *
+ * With io_uring, each node has one multishot read that the kernel keeps
+ * re-arming, filling buffers from a ring that's registered with it once.
+ * `Drain()` makes at most one syscall to submit, wait, and collect every
+ * completion, however many nodes are ready; completions are then processed
+ * as a batch. Polling without a timeout makes no syscall at all if there's
+ * nothing to submit or collect. Multishot reads need Linux 6.7.
+ *
+ * Otherwise, it's epoll, with a `read()` per ready node.
+ *
+ * Only drain from the thread that created it; nodes can be removed from
+ * other threads if every call is serialized, e.g. by a mutex.
+ */
+class InputQueue final {
+ public:
+  using Clock = std::chrono::steady_clock;
+  using Backend = InputQueueSettings::Backend;
+  // Called from `Drain()` with the data from one read; empty if the node has
+  // gone, e.g. it was unplugged, after which it's no longer read. Sinks can
+  // remove nodes, but not add them
+  using Sink = std::function<void(std::span<const std::byte>)>;
+  using Key = uint32_t;
+
+  explicit InputQueue(const InputQueueSettings& = {});
+  ~InputQueue();
+
+  InputQueue(const InputQueue&) = delete;
+  InputQueue(InputQueue&&) = delete;
+  InputQueue& operator=(const InputQueue&) = delete;
+  InputQueue& operator=(InputQueue&&) = delete;
+
+  // False if neither backend could be set up
+  bool IsValid() const;
+  Backend GetBackend() const;
+
+  // `fd` must be non-blocking, and stay open until it's removed; nullopt if
+  // it can't be read this way
+  std::optional<Key> Add(int fd, Sink);
+  void Remove(Key);
+
+  // Waits up to `timeout` for any data, then delivers everything that's
+  // ready; returns the number of reads delivered
+  std::size_t Drain(Clock::duration timeout);
+
+  // Syscalls made by `Add()`, `Remove()`, and `Drain()`
+  uint64_t GetSyscallCount() const;
+
+ private:
+  struct Node {
+    int mFD {-1};
+    Sink mSink;
+    // False once removed; with io_uring, the slot is reused once the read
+    // has been cancelled
+    bool mActive {false};
+    bool mArmed {false};
+    // Removed while the submission queue was full; the cancellation is
+    // submitted by the next `Drain()` that has space for it
+    bool mCancelPending {false};
+  };
+
+  struct Ring;
+
+  InputQueueSettings mSettings;
+  std::unique_ptr<Ring> mRing;
+  UniqueFD mEpoll;
+  std::vector<Node> mNodes;
+  std::vector<std::byte> mReadBuffer;
+  uint64_t mSyscallCount {};
+
+  Key AllocateKey();
+  // False if the submission queue is full
+  bool SubmitCancel(Key);
+  void Deliver(Key, std::span<const std::byte>);
+  std::size_t DrainRing(Clock::duration timeout);
+  std::size_t DrainEpoll(Clock::duration timeout);
+};
+
+/* One node, for devices that are read by `Poll()`.
+ *
+ * `Read()` doesn't wait, and delivers every read that's ready from one
+ * `Drain()`; e.g. with io_uring, every pending hidraw report costs one
+ * syscall in total, instead of a `read()` each, plus one to find that
+ * there are no more.
+ *
+ * Each thread that reads nodes, e.g. a `Sampler`'s or a `PollScheduler`'s,
+ * has one `InputQueue` for each kind of node, shared by every node it
+ * reads. A `Read()` drains the whole queue, so reads for every device on
+ * the thread are collected by the same syscall; the ones for other nodes
+ * are kept until those nodes are read.
+ *
+ * Devices are usually created on another thread, and io_uring only accepts
+ * submissions from the thread that created the ring, so a node moves to
+ * the queue of whichever thread reads it.
+ */
+class InputNode final {
+ public:
+  // `fd` must be non-blocking, and stay open while this exists
+  InputNode(int fd, const InputQueueSettings&);
+  ~InputNode();
+
+  InputNode() = delete;
+  InputNode(const InputNode&) = delete;
+  InputNode(InputNode&&) = default;
+  InputNode& operator=(const InputNode&) = delete;
+  InputNode& operator=(InputNode&&);
+
+  // False if neither backend could read the node
+  bool IsValid() const;
+  InputQueue::Backend GetBackend() const;
+
+  // Calls `f(data)` with each read that's ready; false once the node has
+  // gone, e.g. it was unplugged
+  template <std::invocable<std::span<const std::byte>> F>
+  bool Read(F f) {
+    auto& target = *mTarget;
+    target.mContext = &f;
+    target.mApply = [](void* context, std::span<const std::byte> data) {
+      (*static_cast<F*>(context))(data);
+    };
+    const auto ret = this->Drain();
+    target.mContext = nullptr;
+    target.mApply = nullptr;
+    return ret;
+  }
+
+ private:
+  // Where the queue's sink delivers to; on the heap, so the sink stays
+  // valid when this is moved
+  struct Target {
+    void* mContext {nullptr};
+    void (*mApply)(void*, std::span<const std::byte>) {nullptr};
+    bool mGone {false};
+    // Reads that arrived while another node on the queue was being read
+    std::vector<std::byte> mPending;
+    std::vector<std::size_t> mPendingSizes;
+
+    void Deliver(std::span<const std::byte>);
+  };
+  struct SharedQueue;
+
+  int mFD {-1};
+  InputQueueSettings mSettings;
+  std::unique_ptr<Target> mTarget;
+  // Declared after `mTarget`, as its sink uses it
+  std::shared_ptr<SharedQueue> mQueue;
+  InputQueue::Key mKey {};
+
+  // Nullptr if neither backend works
+  static std::shared_ptr<SharedQueue> GetThreadQueue(
+    const InputQueueSettings&);
+
+  // Adds the node to this thread's queue; leaves `mQueue` null if neither
+  // backend can read the node
+  void Attach();
+  void Detach();
+  // False if the node has gone
+  bool Drain();
+};
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,414 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "LatencyComparison.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <span>
+
+#include "Trace.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+namespace {
+
+using std::chrono::microseconds;
+
+// Over 4 seconds at 1kHz; the worker thread reads several times a second
+constexpr std::size_t RING_CAPACITY {4096};
+constexpr std::size_t MAX_MEASUREMENTS {4096};
+constexpr std::chrono::hours MEASUREMENT_WINDOW {24};
+
+float ToMilliseconds(microseconds duration) {
+  return std::chrono::duration<float, std::milli>(duration).count();
+}
+
+// The control that `a` has been paired with most often
+template <class T>
+std::optional<uint32_t> GetPartner(const T& pairs, uint32_t a) {
+  std::optional<uint32_t> ret;
+  uint64_t best {};
+  for (auto it = pairs.lower_bound({a, 0});
+       it != pairs.end() && it->first.first == a;
+       ++it) {
+    if (it->second > best) {
+      best = it->second;
+      ret = it->first.second;
+    }
+  }
+  return ret;
+}
+
+// Sample-and-hold onto a uniform grid, as a fraction of the range
+void Resample(
+  const std::deque<microseconds>& times,
+  const std::deque<int32_t>& axes,
+  std::size_t axisCount,
+  std::size_t axis,
+  float range,
+  microseconds start,
+  microseconds step,
+  std::span<float> out) {
+  std::size_t i {};
+  for (std::size_t k = 0; k < out.size(); ++k) {
+    const auto time = start + (step * k);
+    while (i + 1 < times.size() && times[i + 1] <= time) {
+      ++i;
+    }
+    out[k] = axes[(i * axisCount) + axis] / range;
+  }
+}
+
+float GetMovement(std::span<const float> values) {
+  const auto [min, max] = std::ranges::minmax(values);
+  return max - min;
+}
+
+}// namespace
+
+LatencyComparison::Stream::Stream(
+  const DeviceInfo& device,
+  std::size_t capacity)
+  : mRing(
+    device.mAxes.size(),
+    device.mHats.size(),
+    device.mButtons.size(),
+    capacity) {
+  mAxisRanges.reserve(device.mAxes.size());
+  for (const auto& axis: device.mAxes) {
+    const auto range = static_cast<double>(axis.mMax) - axis.mMin;
+    mAxisRanges.push_back(static_cast<float>(std::max(1.0, range)));
+  }
+}
+
+LatencyComparison::Results::Results(std::pmr::memory_resource* resource)
+  : mButtonPairs(resource), mAxisPairs(resource) {
+}
+
+LatencyComparison::LatencyComparison(
+  const DeviceInfo& a,
+  const DeviceInfo& b,
+  const LatencyComparisonSettings& settings)
+  : mSettings(settings),
+    mA(a, RING_CAPACITY),
+    mB(b, RING_CAPACITY),
+    mButtonLatency(MEASUREMENT_WINDOW, MAX_MEASUREMENTS),
+    mAxisLatency(MEASUREMENT_WINDOW, MAX_MEASUREMENTS),
+    mThread([this](std::stop_token stop) { this->Run(stop); }) {
+}
+
+void LatencyComparison::PushA(Clock::time_point now, const DeviceState& state) {
+  mA.mRing.Push(std::chrono::duration_cast<microseconds>(now - mEpoch), state);
+}
+
+void LatencyComparison::PushB(Clock::time_point now, const DeviceState& state) {
+  mB.mRing.Push(std::chrono::duration_cast<microseconds>(now - mEpoch), state);
+}
+
+LatencyComparison::Results LatencyComparison::GetResults(
+  std::pmr::memory_resource* resource) const {
+  Results ret {resource};
+  std::lock_guard lock {mMutex};
+  ret.mButtons = mButtonLatency.GetSummary(resource);
+  ret.mAxes = mAxisLatency.GetSummary(resource);
+  for (const auto& [pair, count]: mButtonPairs) {
+    ret.mButtonPairs.push_back({pair.first, pair.second, count});
+  }
+  for (const auto& [pair, count]: mAxisPairs) {
+    ret.mAxisPairs.push_back({pair.first, pair.second, count});
+  }
+  ret.mUnmatchedEdges = mUnmatchedEdges;
+  ret.mLostSamples = mLostSamples;
+  return ret;
+}
+
+void LatencyComparison::Run(std::stop_token stop) {
+  Trace::SetThreadName("LatencyComparison");
+  const auto window = mSettings.mAxisWindow;
+  const auto maxLatency = mSettings.mMaxLatency;
+
+  while (true) {
+    {
+      std::unique_lock lock {mMutex};
+      mWake.wait_for(
+        lock, stop, mSettings.mUpdateInterval, [] { return false; });
+    }
+    if (stop.stop_requested()) {
+      return;
+    }
+
+    const Trace::Zone traceZone {"LatencyComparison::Update"};
+    this->ReadNewSamples(mA);
+    this->ReadNewSamples(mB);
+    this->MatchEdges();
+
+    if (!mWindowStart) {
+      if (mA.mTimes.empty() || mB.mTimes.empty()) {
+        continue;
+      }
+      mWindowStart
+        = std::max(mA.mTimes.front(), mB.mTimes.front() + maxLatency);
+    }
+    // B is compared up to `maxLatency` either side of A's window
+    while (mA.mLatest >= *mWindowStart + window
+           && mB.mLatest >= *mWindowStart + window + maxLatency) {
+      this->CompareAxes(*mWindowStart);
+      *mWindowStart += window;
+    }
+    // If one device stops producing samples, don't keep the other's forever
+    const auto oldestUseful
+      = std::max(mA.mLatest, mB.mLatest) - (4 * (window + maxLatency));
+    mWindowStart = std::max(*mWindowStart, oldestUseful);
+
+    this->Trim(mA, *mWindowStart);
+    this->Trim(mB, *mWindowStart - maxLatency);
+  }
+}
+
+void LatencyComparison::ReadNewSamples(Stream& stream) {
+  const auto end = stream.mRing.GetEnd();
+  const auto capacity = stream.mRing.GetCapacity();
+  uint64_t lost {};
+  if (end - stream.mNext > capacity) {
+    lost += (end - capacity) - stream.mNext;
+    stream.mNext = end - capacity;
+  }
+
+  auto& state = stream.mState;
+  for (; stream.mNext < end; ++stream.mNext) {
+    const auto time = stream.mRing.Read(stream.mNext, state);
+    if (!time) {
+      ++lost;
+      continue;
+    }
+
+    if (stream.mHavePrevious) {
+      for (std::size_t word = 0; word < state.mButtons.size(); ++word) {
+        auto changed = state.mButtons[word] ^ stream.mPreviousButtons[word];
+        while (changed) {
+          const auto bit = std::countr_zero(changed);
+          changed &= changed - 1;
+          stream.mEdges.push_back({
+            .mTime = *time,
+            .mButton = static_cast<uint32_t>(
+              (word * DeviceState::BUTTONS_PER_WORD) + bit),
+            .mPressed = ((state.mButtons[word] >> bit) & 1) != 0,
+          });
+        }
+      }
+    }
+    stream.mPreviousButtons.assign(
+      state.mButtons.begin(), state.mButtons.end());
+    stream.mHavePrevious = true;
+
+    stream.mTimes.push_back(*time);
+    stream.mAxes.insert(
+      stream.mAxes.end(), state.mAxes.begin(), state.mAxes.end());
+    stream.mLatest = *time;
+  }
+
+  if (lost) {
+    std::lock_guard lock {mMutex};
+    mLostSamples += lost;
+  }
+}
+
+void LatencyComparison::MatchEdges() {
+  const auto maxLatency = mSettings.mMaxLatency;
+  // Every edge that could match an A edge up to here has been read
+  const auto horizon = std::min(mA.mLatest, mB.mLatest) - maxLatency;
+  uint64_t unmatched {};
+
+  while (!mA.mEdges.empty() && mA.mEdges.front().mTime <= horizon) {
+    const auto edge = mA.mEdges.front();
+    mA.mEdges.pop_front();
+
+    const auto partner = GetPartner(mButtonPairs, edge.mButton);
+    auto match = mB.mEdges.end();
+    auto partnerMatch = mB.mEdges.end();
+    std::size_t candidates {};
+    for (auto it = mB.mEdges.begin(); it != mB.mEdges.end(); ++it) {
+      if (it->mTime > edge.mTime + maxLatency) {
+        break;
+      }
+      if (
+        it->mPressed != edge.mPressed
+        || it->mTime < edge.mTime - maxLatency) {
+        continue;
+      }
+      ++candidates;
+      match = it;
+      if (partner == it->mButton && partnerMatch == mB.mEdges.end()) {
+        partnerMatch = it;
+      }
+    }
+    // Chords are ambiguous until we've seen the buttons individually
+    if (partnerMatch != mB.mEdges.end()) {
+      match = partnerMatch;
+    } else if (candidates != 1) {
+      ++unmatched;
+      continue;
+    }
+
+    {
+      std::lock_guard lock {mMutex};
+      mButtonLatency.Push(ToMilliseconds(match->mTime - edge.mTime));
+      ++mButtonPairs[{edge.mButton, match->mButton}];
+    }
+    mB.mEdges.erase(match);
+  }
+
+  // Too early to match any A edge that we haven't matched yet
+  while (!mB.mEdges.empty()
+         && mB.mEdges.front().mTime < horizon - maxLatency) {
+    mB.mEdges.pop_front();
+    ++unmatched;
+  }
+
+  if (unmatched) {
+    std::lock_guard lock {mMutex};
+    mUnmatchedEdges += unmatched;
+  }
+}
+
+void LatencyComparison::CompareAxes(microseconds windowStart) {
+  const auto step = mSettings.mResolution;
+  const auto n = static_cast<std::size_t>(mSettings.mAxisWindow / step);
+  const auto lags = static_cast<std::size_t>(mSettings.mMaxLatency / step);
+  const auto aCount = mA.mAxisRanges.size();
+  const auto bCount = mB.mAxisRanges.size();
+  if (n < 2 || aCount == 0 || bCount == 0) {
+    return;
+  }
+
+  // B has `lags` extra samples either side of A's window; prefix sums give
+  // the mean and variance of any n-sample slice
+  const auto bSize = n + (2 * lags);
+  std::vector<std::vector<float>> b(bCount, std::vector<float>(bSize));
+  std::vector<std::vector<double>> bSums(bCount);
+  std::vector<std::vector<double>> bSquares(bCount);
+  std::vector<bool> bMoved(bCount);
+  for (std::size_t j = 0; j < bCount; ++j) {
+    Resample(
+      mB.mTimes,
+      mB.mAxes,
+      bCount,
+      j,
+      mB.mAxisRanges[j],
+      windowStart - (step * lags),
+      step,
+      b[j]);
+    bMoved[j] = GetMovement(b[j]) >= mSettings.mMinimumMovement;
+    auto& sums = bSums[j];
+    auto& squares = bSquares[j];
+    sums.resize(bSize + 1);
+    squares.resize(bSize + 1);
+    for (std::size_t k = 0; k < bSize; ++k) {
+      sums[k + 1] = sums[k] + b[j][k];
+      squares[k + 1] = squares[k] + (double {b[j][k]} * b[j][k]);
+    }
+  }
+
+  std::vector<float> a(n);
+  std::vector<float> scores((2 * lags) + 1);
+  for (std::size_t i = 0; i < aCount; ++i) {
+    Resample(
+      mA.mTimes,
+      mA.mAxes,
+      aCount,
+      i,
+      mA.mAxisRanges[i],
+      windowStart,
+      step,
+      a);
+    if (GetMovement(a) < mSettings.mMinimumMovement) {
+      continue;
+    }
+    double mean {};
+    for (const auto value: a) {
+      mean += value;
+    }
+    mean /= n;
+    double aSquares {};
+    for (auto& value: a) {
+      value -= static_cast<float>(mean);
+      aSquares += double {value} * value;
+    }
+
+    // Magnitude of the Pearson correlation of `a` with the B slice starting
+    // at `offset`; the sign is ignored, as axes can be inverted
+    const auto correlation = [&](std::size_t j, std::size_t offset) {
+      const auto& slice = b[j];
+      double products {};
+      for (std::size_t k = 0; k < n; ++k) {
+        products += double {a[k]} * slice[offset + k];
+      }
+      const auto sum = bSums[j][offset + n] - bSums[j][offset];
+      const auto squares = bSquares[j][offset + n] - bSquares[j][offset];
+      const auto variance = squares - ((sum * sum) / n);
+      if (variance <= 0) {
+        return 0.0f;
+      }
+      return static_cast<float>(
+        std::abs(products) / std::sqrt(aSquares * variance));
+    };
+
+    // The axis that follows this one most closely without any delay; as
+    // latencies are short compared to how long a movement takes, that's
+    // enough to find the right axis
+    auto partner = GetPartner(mAxisPairs, static_cast<uint32_t>(i));
+    if (!(partner && bMoved[*partner])) {
+      partner.reset();
+      float best {};
+      for (std::size_t j = 0; j < bCount; ++j) {
+        if (!bMoved[j]) {
+          continue;
+        }
+        const auto score = correlation(j, lags);
+        if (score > best) {
+          best = score;
+          partner = static_cast<uint32_t>(j);
+        }
+      }
+    }
+    if (!partner) {
+      continue;
+    }
+
+    for (std::size_t offset = 0; offset < scores.size(); ++offset) {
+      scores[offset] = correlation(*partner, offset);
+    }
+    const auto peak = static_cast<std::size_t>(
+      std::ranges::max_element(scores) - scores.begin());
+    // At the edge, the real peak is probably outside the search range
+    if (
+      scores[peak] < mSettings.mMinimumCorrelation || peak == 0
+      || peak + 1 == scores.size()) {
+      continue;
+    }
+    // Fit a parabola for sub-step resolution
+    const auto before = scores[peak - 1];
+    const auto after = scores[peak + 1];
+    const auto curvature = before - (2 * scores[peak]) + after;
+    const auto fraction
+      = (curvature < 0) ? (0.5f * (before - after) / curvature) : 0.0f;
+    const auto lag = (static_cast<float>(peak) - lags) + fraction;
+
+    std::lock_guard lock {mMutex};
+    mAxisLatency.Push(lag * ToMilliseconds(step));
+    ++mAxisPairs[{static_cast<uint32_t>(i), *partner}];
+  }
+}
+
+void LatencyComparison::Trim(Stream& stream, microseconds keepFrom) {
+  // Keep the last sample before `keepFrom`, as it's held until the next
+  const auto axisCount = stream.mAxisRanges.size();
+  while (stream.mTimes.size() >= 2 && stream.mTimes[1] <= keepFrom) {
+    stream.mTimes.pop_front();
+    stream.mAxes.erase(stream.mAxes.begin(), stream.mAxes.begin() + axisCount);
+  }
+}
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,153 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "DeviceInfo.hpp"
+#include "DeviceState.hpp"
+#include "PerformanceMetrics.hpp"
+#include "SampleRing.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+struct LatencyComparisonSettings {
+  // Events further apart than this aren't the same input
+  std::chrono::microseconds mMaxLatency {std::chrono::milliseconds {100}};
+  // Axis streams are compared in consecutive windows of this length
+  std::chrono::microseconds mAxisWindow {std::chrono::seconds {1}};
+  // Axis streams are resampled to this interval before being compared
+  std::chrono::microseconds mResolution {std::chrono::milliseconds {1}};
+  std::chrono::milliseconds mUpdateInterval {250};
+  // An axis must move this fraction of its range in a window to be used
+  float mMinimumMovement {0.05f};
+  // Weaker matches are assumed to be different controls
+  float mMinimumCorrelation {0.9f};
+};
+
+/* How much later device B sees the same input as device A.
+ *
+ * For example, an XInput pad through both XInput and DirectInput, or two
+ * wheelbases turned together. Each device is fed from its own `Sampler`,
+ * with timestamps from the same clock.
+ *
+ * A background thread measures the difference incrementally, in two ways:
+ * - button edges are matched to the nearest edge in the same direction on
+ *   the other device
+ * - axis streams are cross-correlated, a window at a time, with whichever
+ *   axis on the other device follows them most closely
+ *
+ * Controls don't need to have the same names, order, range, or direction;
+ * the pairings are inferred from the input.
+ */
+class LatencyComparison final {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  LatencyComparison(
+    const DeviceInfo& a,
+    const DeviceInfo& b,
+    const LatencyComparisonSettings&);
+
+  LatencyComparison() = delete;
+  LatencyComparison(const LatencyComparison&) = delete;
+  LatencyComparison(LatencyComparison&&) = delete;
+  LatencyComparison& operator=(const LatencyComparison&) = delete;
+  LatencyComparison& operator=(LatencyComparison&&) = delete;
+
+  // Each can be called from a different thread, but each must only be
+  // called from one; these never block or allocate
+  void PushA(Clock::time_point, const DeviceState&);
+  void PushB(Clock::time_point, const DeviceState&);
+
+  struct ControlPair {
+    uint32_t mA {};
+    uint32_t mB {};
+    // Measurements using this pair
+    uint64_t mCount {};
+  };
+
+  struct Results {
+    explicit Results(std::pmr::memory_resource*);
+
+    // Milliseconds that B is behind A; negative if B is ahead
+    RollingSamples::Summary mButtons;
+    RollingSamples::Summary mAxes;
+    std::pmr::vector<ControlPair> mButtonPairs;
+    std::pmr::vector<ControlPair> mAxisPairs;
+    // Edges without exactly one plausible match on the other device
+    uint64_t mUnmatchedEdges {};
+    // Samples overwritten before the worker thread read them
+    uint64_t mLostSamples {};
+  };
+  // Can be called from any thread
+  Results GetResults(
+    std::pmr::memory_resource* = std::pmr::get_default_resource()) const;
+
+ private:
+  struct Edge {
+    std::chrono::microseconds mTime {};
+    uint32_t mButton {};
+    bool mPressed {};
+  };
+
+  // Only `mRing` is used by the sampling threads
+  struct Stream {
+    Stream(const DeviceInfo&, std::size_t capacity);
+
+    std::vector<float> mAxisRanges;
+    SampleRing mRing;
+
+    uint64_t mNext {};
+    DeviceState mState;
+    std::vector<uint64_t> mPreviousButtons;
+    bool mHavePrevious {false};
+    std::chrono::microseconds mLatest {};
+    // Only what's still needed for the next window; axes are flattened
+    std::deque<std::chrono::microseconds> mTimes;
+    std::deque<int32_t> mAxes;
+    std::deque<Edge> mEdges;
+  };
+
+  LatencyComparisonSettings mSettings;
+  const Clock::time_point mEpoch {Clock::now()};
+  Stream mA;
+  Stream mB;
+
+  // Only used on the worker thread
+  std::optional<std::chrono::microseconds> mWindowStart;
+
+  mutable std::mutex mMutex;
+  std::condition_variable_any mWake;
+  // Protected by `mMutex`, except that the worker thread can read the
+  // pairs without it, as it's the only writer
+  RollingSamples mButtonLatency;
+  RollingSamples mAxisLatency;
+  using PairCounts = std::map<std::pair<uint32_t, uint32_t>, uint64_t>;
+  PairCounts mButtonPairs;
+  PairCounts mAxisPairs;
+  uint64_t mUnmatchedEdges {};
+  uint64_t mLostSamples {};
+
+  // Last, so that it's stopped before anything it uses is destroyed
+  std::jthread mThread;
+
+  void Run(std::stop_token);
+  void ReadNewSamples(Stream&);
+  void MatchEdges();
+  void CompareAxes(std::chrono::microseconds windowStart);
+  void Trim(Stream&, std::chrono::microseconds keepFrom);
+};
+
+}// namespace FredEmmott::ControllerTester
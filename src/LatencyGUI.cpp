@@ -0,0 +1,211 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "LatencyGUI.hpp"
+
+#include <cmath>
+#include <format>
+
+#include <imgui.h>
+
+#include "Config.hpp"
+#include "Trace.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+namespace {
+
+// Smaller differences are within the sampling resolution
+constexpr float SIGNIFICANT_MILLISECONDS {0.5f};
+
+void GUISummary(const char* label, const RollingSamples::Summary& summary) {
+  if (summary.mCount == 0) {
+    ImGui::TextDisabled("%s: no measurements yet", label);
+    return;
+  }
+  ImGui::Text(
+    "%s: B is %+.1f ms behind A (median of %zu); 5%%-95%%: %+.1f to %+.1f "
+    "ms; range: %+.1f to %+.1f ms",
+    label,
+    summary.mP50,
+    summary.mCount,
+    summary.mP5,
+    summary.mP95,
+    summary.mMin,
+    summary.mMax);
+}
+
+template <class T>
+void GUIPairs(
+  const char* label,
+  std::span<const LatencyComparison::ControlPair> pairs,
+  const std::vector<T>& a,
+  const std::vector<T>& b) {
+  if (pairs.empty()) {
+    return;
+  }
+  ImGui::SeparatorText(label);
+  for (const auto& pair: pairs) {
+    ImGui::BulletText(
+      "%s = %s (%llu)",
+      (pair.mA < a.size()) ? a[pair.mA].mName.c_str() : "?",
+      (pair.mB < b.size()) ? b[pair.mB].mName.c_str() : "?",
+      static_cast<unsigned long long>(pair.mCount));
+  }
+}
+
+}// namespace
+
+LatencyGUI::LatencyGUI(FrameArena& frameArena) : mFrameArena(frameArena) {
+}
+
+bool LatencyGUI::BeginTab() {
+  return ImGui::BeginTabItem("Compare latency");
+}
+
+std::optional<std::pair<std::size_t, std::size_t>> LatencyGUI::GUITabContents(
+  std::span<DeviceInfo* const> devices) {
+  const Trace::Zone traceZone {"LatencyGUI::GUITabContents"};
+  if (mSession) {
+    GUIResults();
+    ImGui::EndTabItem();
+    return std::nullopt;
+  }
+
+  ImGui::TextWrapped(
+    "Samples two devices at once, and measures how much later device B sees "
+    "the same input as device A. Select one pad through both XInput and "
+    "DirectInput, or two devices that you can move together, then press and "
+    "release buttons and move axes on both.");
+  GUIDeviceCombo("Device A", devices, mSelectedA);
+  GUIDeviceCombo("Device B", devices, mSelectedB);
+  ImGui::Checkbox("Low-jitter sampling", &mRealTime.mEnabled);
+  if (ImGui::IsItemHovered()) {
+    ImGui::SetTooltip(
+      "Pins both sampling threads to a core at real-time priority, so that "
+      "scheduler noise doesn't hide small differences. Each thread may use "
+      "most of its core while sampling.");
+  }
+
+  const auto find = [devices](const std::optional<Guid>& guid) {
+    std::optional<std::size_t> ret;
+    for (std::size_t i = 0; guid && i < devices.size(); ++i) {
+      if (devices[i]->mGuid == *guid) {
+        ret = i;
+        break;
+      }
+    }
+    return ret;
+  };
+  const auto a = find(mSelectedA);
+  const auto b = find(mSelectedB);
+
+  std::optional<std::pair<std::size_t, std::size_t>> ret;
+  ImGui::BeginDisabled(!(a && b));
+  if (ImGui::Button("Start comparison")) {
+    ret = {*a, *b};
+  }
+  ImGui::EndDisabled();
+  if (!mError.empty()) {
+    ImGui::TextColored(Config::WARNING_COLOR, "%s", mError.c_str());
+  }
+
+  ImGui::EndTabItem();
+  return ret;
+}
+
+void LatencyGUI::GUIDeviceCombo(
+  const char* label,
+  std::span<DeviceInfo* const> devices,
+  std::optional<Guid>& selected) {
+  const char* preview = "Select a device";
+  for (const auto device: devices) {
+    if (selected == device->mGuid) {
+      preview = device->mName.c_str();
+    }
+  }
+  if (!ImGui::BeginCombo(label, preview)) {
+    return;
+  }
+  for (std::size_t i = 0; i < devices.size(); ++i) {
+    const auto device = devices[i];
+    const auto isSelected = (selected == device->mGuid);
+    // Devices can have the same name, e.g. multiple vJoy devices
+    if (ImGui::Selectable(
+          std::format("{}##{}", device->mName, i).c_str(), isSelected)) {
+      selected = device->mGuid;
+    }
+    if (isSelected) {
+      ImGui::SetItemDefaultFocus();
+    }
+  }
+  ImGui::EndCombo();
+}
+
+void LatencyGUI::GUIResults() {
+  auto& session = *mSession;
+  if (ImGui::Button("Stop comparison")) {
+    mSession.reset();
+    return;
+  }
+
+  ImGui::Text("A: %s", session.mA.mName.c_str());
+  ImGui::SameLine();
+  ImGui::TextDisabled(
+    "(%llu samples)",
+    static_cast<unsigned long long>(session.mSamplerA->GetSampleCount()));
+  ImGui::Text("B: %s", session.mB.mName.c_str());
+  ImGui::SameLine();
+  ImGui::TextDisabled(
+    "(%llu samples)",
+    static_cast<unsigned long long>(session.mSamplerB->GetSampleCount()));
+  if (const auto realTime = session.mSamplerA->GetRealTimeStatus()) {
+    ImGui::TextDisabled(
+      "Low-jitter sampling: %s",
+      FormatRealTimeStatus(mRealTime, *realTime).c_str());
+  }
+
+  const auto results = session.mComparison->GetResults(&mFrameArena);
+  ImGui::SeparatorText("Latency");
+  GUISummary("Buttons", results.mButtons);
+  GUISummary("Axes", results.mAxes);
+
+  // Button edges are exact, so prefer them
+  const auto& best
+    = results.mButtons.mCount ? results.mButtons : results.mAxes;
+  if (best.mCount) {
+    const auto median = best.mP50;
+    if (std::abs(median) < SIGNIFICANT_MILLISECONDS) {
+      ImGui::Text("Neither device is measurably faster.");
+    } else {
+      ImGui::PushStyleColor(ImGuiCol_Text, Config::FULL_RANGE_COLOR);
+      ImGui::Text(
+        "%s is faster by %.1f ms.",
+        (median > 0 ? session.mA : session.mB).mName.c_str(),
+        std::abs(median));
+      ImGui::PopStyleColor();
+    }
+  }
+
+  if (results.mUnmatchedEdges) {
+    ImGui::TextDisabled(
+      "%llu button presses or releases couldn't be matched",
+      static_cast<unsigned long long>(results.mUnmatchedEdges));
+  }
+  if (results.mLostSamples) {
+    ImGui::TextColored(
+      Config::WARNING_COLOR,
+      "%llu samples were lost; the system may be overloaded",
+      static_cast<unsigned long long>(results.mLostSamples));
+  }
+
+  GUIPairs(
+    "Matched buttons",
+    results.mButtonPairs,
+    session.mA.mButtons,
+    session.mB.mButtons);
+  GUIPairs(
+    "Matched axes", results.mAxisPairs, session.mA.mAxes, session.mB.mAxes);
+}
+
+}// namespace FredEmmott::ControllerTester
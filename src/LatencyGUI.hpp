@@ -0,0 +1,147 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "DeviceInfo.hpp"
+#include "DeviceSet.hpp"
+#include "FrameArena.hpp"
+#include "Guid.hpp"
+#include "LatencyComparison.hpp"
+#include "Sampler.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+/* The 'Compare latency' tab.
+ *
+ * Samples two devices at once, e.g. one pad through both XInput and
+ * DirectInput, and shows how much later one sees the same input than the
+ * other.
+ */
+class LatencyGUI final {
+ public:
+  explicit LatencyGUI(FrameArena&);
+
+  /* `devices` is e.g. `DeviceSet::GetAllDevices()`, and `open` is e.g.
+   * `DeviceSet::OpenAnother()`.
+   *
+   * Each device is sampled through its own instance, so the two can be the
+   * same device, e.g. to check the measurement is close to zero.
+   */
+  template <Device... TInfos, class FOpen>
+  void GUITab(
+    const std::pmr::vector<DeviceRef<TInfos...>>& devices,
+    FOpen&& open) {
+    if (!this->BeginTab()) {
+      return;
+    }
+
+    std::pmr::vector<DeviceInfo*> infos {&mFrameArena};
+    infos.reserve(devices.size());
+    for (const auto& device: devices) {
+      infos.push_back(GetDeviceInfo(device));
+    }
+    // Ends the tab
+    const auto start = this->GUITabContents(infos);
+    if (!start) {
+      return;
+    }
+
+    const auto& [a, b] = *start;
+    std::visit(
+      [&]<Device TA, Device TB>(TA* deviceA, TB* deviceB) {
+        auto anotherA = open(std::as_const(*deviceA));
+        auto anotherB = open(std::as_const(*deviceB));
+        if (!(anotherA && anotherB)) {
+          mError = "Couldn't open both devices.";
+          return;
+        }
+        this->StartComparison(std::move(*anotherA), std::move(*anotherB));
+      },
+      devices[a],
+      devices[b]);
+  }
+
+ private:
+  bool BeginTab();
+  // Returns the indices of the devices to start comparing, if any
+  std::optional<std::pair<std::size_t, std::size_t>> GUITabContents(
+    std::span<DeviceInfo* const>);
+  void GUIResults();
+  void GUIDeviceCombo(
+    const char* label,
+    std::span<DeviceInfo* const>,
+    std::optional<Guid>& selected);
+
+  struct Session {
+    DeviceInfo mA;
+    DeviceInfo mB;
+    std::unique_ptr<LatencyComparison> mComparison;
+    // Declared last so they're stopped first, as they use the comparison
+    std::unique_ptr<Sampler> mSamplerA;
+    std::unique_ptr<Sampler> mSamplerB;
+  };
+
+  template <Device TA, Device TB>
+  void StartComparison(TA&& a, TB&& b) {
+    Session session;
+    session.mA = a;
+    session.mB = b;
+    session.mComparison
+      = std::make_unique<LatencyComparison>(a, b, mSettings);
+    const auto comparison = session.mComparison.get();
+    // Separate cores, so neither sampler waits for the other
+    auto realTimeA = mRealTime;
+    realTimeA.mCore = GetRealTimeCore(0);
+    auto realTimeB = mRealTime;
+    realTimeB.mCore = GetRealTimeCore(1);
+    session.mSamplerA = std::make_unique<Sampler>(
+      std::move(a),
+      mSampleInterval,
+      [comparison](
+        Sampler::Clock::time_point time,
+        const std::optional<DeviceState>& state) {
+        if (state) {
+          comparison->PushA(time, *state);
+        }
+      },
+      realTimeA);
+    session.mSamplerB = std::make_unique<Sampler>(
+      std::move(b),
+      mSampleInterval,
+      [comparison](
+        Sampler::Clock::time_point time,
+        const std::optional<DeviceState>& state) {
+        if (state) {
+          comparison->PushB(time, *state);
+        }
+      },
+      realTimeB);
+    mSession = std::move(session);
+    mError.clear();
+  }
+
+  FrameArena& mFrameArena;
+  LatencyComparisonSettings mSettings;
+  std::chrono::microseconds mSampleInterval {std::chrono::milliseconds {1}};
+  // Opt-in, as it keeps two cores busy; with the default spin on Windows,
+  // it never sleeps between 1ms samples
+  RealTimeSettings mRealTime;
+  std::optional<Guid> mSelectedA;
+  std::optional<Guid> mSelectedB;
+  std::string mError;
+  std::optional<Session> mSession;
+};
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,151 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "LayoutCache.hpp"
+
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+
+#include "MemoryMappedFile.hpp"
+#include "SerializedControls.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+namespace {
+
+constexpr std::array<char, 4> MAGIC {'F', 'C', 'T', 'L'};
+constexpr uint32_t VERSION {1};
+
+// Followed by `SerializedControl`s for the axes, then buttons, then hats,
+// then `mStringBytes` of names
+struct FileHeader {
+  std::array<char, 4> mMagic {};
+  uint32_t mVersion {};
+  Guid mProduct;
+  Guid mInstance;
+  LayoutCache::ControlCounts mCounts;
+  uint32_t mBackendFlags {};
+  uint32_t mStringBytes {};
+};
+static_assert(std::is_trivially_copyable_v<FileHeader>);
+
+void AppendHex(std::string& out, const Guid& guid) {
+  constexpr std::string_view digits {"0123456789abcdef"};
+  std::array<uint8_t, sizeof(Guid)> bytes {};
+  std::memcpy(bytes.data(), &guid, sizeof(guid));
+  for (const auto byte: bytes) {
+    out += digits[byte >> 4];
+    out += digits[byte & 0xf];
+  }
+}
+
+}// namespace
+
+LayoutCache::LayoutCache(std::filesystem::path directory)
+  : mDirectory(std::move(directory)) {
+}
+
+std::filesystem::path LayoutCache::GetPath(const Key& key) const {
+  std::string name;
+  AppendHex(name, key.mProduct);
+  name += '-';
+  AppendHex(name, key.mInstance);
+  name += ".layout";
+  return mDirectory / name;
+}
+
+std::optional<uint32_t> LayoutCache::Load(
+  const Key& key,
+  const ControlCounts& expected,
+  DeviceInfo& info) const {
+  const MemoryMappedFile file {GetPath(key)};
+  const auto data = file.GetData();
+
+  FileHeader header;
+  if (data.size() < sizeof(header)) {
+    return std::nullopt;
+  }
+  std::memcpy(&header, data.data(), sizeof(header));
+  if (
+    header.mMagic != MAGIC || header.mVersion != VERSION
+    || header.mProduct != key.mProduct || header.mInstance != key.mInstance
+    || header.mCounts != expected) {
+    return std::nullopt;
+  }
+
+  const std::size_t recordCount = static_cast<std::size_t>(expected.mAxes)
+    + expected.mButtons + expected.mHats;
+  const auto recordsSize = recordCount * sizeof(SerializedControl);
+  if (data.size() != sizeof(header) + recordsSize + header.mStringBytes) {
+    return std::nullopt;
+  }
+  const auto records = data.subspan(sizeof(header), recordsSize);
+  const std::string_view strings {
+    reinterpret_cast<const char*>(records.data() + recordsSize),
+    header.mStringBytes};
+
+  if (!DeserializeControls(
+        records,
+        strings,
+        expected.mAxes,
+        expected.mButtons,
+        expected.mHats,
+        info)) {
+    return std::nullopt;
+  }
+  return header.mBackendFlags;
+}
+
+void LayoutCache::Store(
+  const Key& key,
+  const DeviceInfo& info,
+  uint32_t backendFlags) const {
+  const auto controls = SerializeControls(info);
+
+  const FileHeader header {
+    .mMagic = MAGIC,
+    .mVersion = VERSION,
+    .mProduct = key.mProduct,
+    .mInstance = key.mInstance,
+    .mCounts = {
+      .mAxes = static_cast<uint32_t>(info.mAxes.size()),
+      .mButtons = static_cast<uint32_t>(info.mButtons.size()),
+      .mHats = static_cast<uint32_t>(info.mHats.size()),
+    },
+    .mBackendFlags = backendFlags,
+    .mStringBytes = static_cast<uint32_t>(controls.mStrings.size()),
+  };
+
+  std::error_code ec;
+  std::filesystem::create_directories(mDirectory, ec);
+  if (ec) {
+    return;
+  }
+
+  // Write then rename, so a concurrent or interrupted write is never seen
+  // as a valid entry
+  const auto path = GetPath(key);
+  auto tempPath = path;
+  tempPath += ".tmp";
+  {
+    std::ofstream f(tempPath, std::ios::binary | std::ios::trunc);
+    f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    f.write(
+      reinterpret_cast<const char*>(controls.mRecords.data()),
+      controls.mRecords.size() * sizeof(SerializedControl));
+    f.write(controls.mStrings.data(), controls.mStrings.size());
+    if (!f) {
+      f.close();
+      std::filesystem::remove(tempPath, ec);
+      return;
+    }
+  }
+  std::filesystem::rename(tempPath, path, ec);
+}
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,57 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+
+#include "DeviceInfo.hpp"
+#include "Guid.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+/* Resolved control layouts, persisted so that reconnecting a device doesn't
+ * need to enumerate and query every control again.
+ *
+ * Each device gets a small binary file in the cache directory, which is
+ * memory-mapped and validated when loaded; anything unexpected is a miss.
+ * Only the control descriptions are cached - not data offsets, which are
+ * cheap to recompute, nor any coverage state.
+ */
+class LayoutCache final {
+ public:
+  struct Key {
+    Guid mProduct;
+    Guid mInstance;
+  };
+
+  // Cheap to query from the device, and checked against the cached layout
+  struct ControlCounts {
+    uint32_t mAxes {};
+    uint32_t mButtons {};
+    uint32_t mHats {};
+
+    bool operator==(const ControlCounts&) const = default;
+  };
+
+  explicit LayoutCache(std::filesystem::path directory);
+
+  /* Replaces the controls in `info` on a hit.
+   *
+   * Returns the backend flags that were passed to `Store()`, or nullopt on
+   * a miss.
+   */
+  std::optional<uint32_t>
+  Load(const Key&, const ControlCounts& expected, DeviceInfo& info) const;
+
+  // Failures are ignored; the next `Load()` will just miss
+  void Store(const Key&, const DeviceInfo&, uint32_t backendFlags) const;
+
+ private:
+  std::filesystem::path mDirectory;
+
+  std::filesystem::path GetPath(const Key&) const;
+};
+
+}// namespace FredEmmott::ControllerTester
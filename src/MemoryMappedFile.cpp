@@ -0,0 +1,84 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "MemoryMappedFile.hpp"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace FredEmmott::ControllerTester {
+
+#ifdef _WIN32
+MemoryMappedFile::MemoryMappedFile(const std::filesystem::path& path) {
+  const auto file = CreateFileW(
+    path.c_str(),
+    GENERIC_READ,
+    FILE_SHARE_READ | FILE_SHARE_DELETE,
+    nullptr,
+    OPEN_EXISTING,
+    FILE_ATTRIBUTE_NORMAL,
+    nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return;
+  }
+
+  LARGE_INTEGER size {};
+  if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+    const auto mapping
+      = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping) {
+      mData = static_cast<const std::byte*>(
+        MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+      if (mData) {
+        mSize = static_cast<std::size_t>(size.QuadPart);
+      }
+      // The view keeps the mapping alive
+      CloseHandle(mapping);
+    }
+  }
+  CloseHandle(file);
+}
+
+MemoryMappedFile::~MemoryMappedFile() {
+  if (mData) {
+    UnmapViewOfFile(mData);
+  }
+}
+#else
+MemoryMappedFile::MemoryMappedFile(const std::filesystem::path& path) {
+  const auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return;
+  }
+
+  struct stat info {};
+  if (fstat(fd, &info) == 0 && info.st_size > 0) {
+    const auto size = static_cast<std::size_t>(info.st_size);
+    const auto data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED) {
+      mData = static_cast<const std::byte*>(data);
+      mSize = size;
+    }
+  }
+  // The mapping keeps the file alive
+  close(fd);
+}
+
+MemoryMappedFile::~MemoryMappedFile() {
+  if (mData) {
+    munmap(const_cast<std::byte*>(mData), mSize);
+  }
+}
+#endif
+
+std::span<const std::byte> MemoryMappedFile::GetData() const {
+  return {mData, mSize};
+}
+
+}// namespace FredEmmott::ControllerTester
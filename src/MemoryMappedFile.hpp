@@ -0,0 +1,34 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <span>
+
+namespace FredEmmott::ControllerTester {
+
+/* A read-only view of a whole file.
+ *
+ * If the file doesn't exist or can't be mapped, the view is empty; callers
+ * are expected to treat that the same as a missing file.
+ */
+class MemoryMappedFile final {
+ public:
+  explicit MemoryMappedFile(const std::filesystem::path&);
+  ~MemoryMappedFile();
+
+  MemoryMappedFile() = delete;
+  MemoryMappedFile(const MemoryMappedFile&) = delete;
+  MemoryMappedFile(MemoryMappedFile&&) = delete;
+  MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
+  MemoryMappedFile& operator=(MemoryMappedFile&&) = delete;
+
+  std::span<const std::byte> GetData() const;
+
+ private:
+  const std::byte* mData {nullptr};
+  std::size_t mSize {};
+};
+
+}// namespace FredEmmott::ControllerTester
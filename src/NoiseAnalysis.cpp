@@ -0,0 +1,289 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "NoiseAnalysis.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <numbers>
+
+#include "Trace.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+namespace {
+
+// Silence would otherwise be -infinity
+constexpr float MIN_AMPLITUDE {1e-10f};
+
+// `std::complex` multiplication handles infinities and NaNs, which makes it
+// a library call with most compilers; the FFT never produces them
+inline std::complex<float> Multiply(
+  const std::complex<float>& a,
+  const std::complex<float>& b) {
+  return {
+    (a.real() * b.real()) - (a.imag() * b.imag()),
+    (a.real() * b.imag()) + (a.imag() * b.real()),
+  };
+}
+
+std::vector<float> GetAxisRanges(const DeviceInfo& device) {
+  std::vector<float> ret;
+  ret.reserve(device.mAxes.size());
+  for (const auto& axis: device.mAxes) {
+    const auto range = static_cast<double>(axis.mMax) - axis.mMin;
+    ret.push_back(static_cast<float>(std::max(1.0, range)));
+  }
+  return ret;
+}
+
+}// namespace
+
+SpectrumAnalyzer::SpectrumAnalyzer(std::size_t windowSize)
+  : mWindowSize(windowSize),
+    mWindow(windowSize),
+    mTwiddles(windowSize / 2),
+    mBitReversed(windowSize),
+    mBuffer(windowSize) {
+  assert(windowSize >= 2 && std::has_single_bit(windowSize));
+  constexpr auto pi = std::numbers::pi;
+
+  double windowSum {};
+  for (std::size_t i = 0; i < windowSize; ++i) {
+    const auto value = 0.5 * (1 - std::cos((2 * pi * i) / windowSize));
+    mWindow[i] = static_cast<float>(value);
+    windowSum += value;
+  }
+  // A sine with amplitude A has a magnitude of A * windowSum / 2
+  mScale = static_cast<float>(2 / windowSum);
+
+  for (std::size_t i = 0; i < mTwiddles.size(); ++i) {
+    mTwiddles[i]
+      = std::polar(1.0f, static_cast<float>((-2 * pi * i) / windowSize));
+  }
+
+  const auto bits = std::countr_zero(windowSize);
+  for (std::size_t i = 0; i < windowSize; ++i) {
+    uint32_t reversed {};
+    for (int bit = 0; bit < bits; ++bit) {
+      if ((i >> bit) & 1) {
+        reversed |= 1u << (bits - 1 - bit);
+      }
+    }
+    mBitReversed[i] = reversed;
+  }
+}
+
+std::size_t SpectrumAnalyzer::GetWindowSize() const {
+  return mWindowSize;
+}
+
+std::size_t SpectrumAnalyzer::GetBinCount() const {
+  return (mWindowSize / 2) + 1;
+}
+
+void SpectrumAnalyzer::Analyze(
+  std::span<const float> samples,
+  std::span<float> levels) {
+  assert(samples.size() == mWindowSize);
+  assert(levels.size() == this->GetBinCount());
+  const auto n = mWindowSize;
+
+  // Remove the resting position, otherwise its window would leak into the
+  // low bins
+  double sum {};
+  for (const auto sample: samples) {
+    sum += sample;
+  }
+  const auto mean = static_cast<float>(sum / n);
+  for (std::size_t i = 0; i < n; ++i) {
+    mBuffer[mBitReversed[i]] = {(samples[i] - mean) * mWindow[i], 0};
+  }
+
+  // Iterative radix-2 decimation-in-time
+  for (std::size_t size = 2; size <= n; size *= 2) {
+    const auto half = size / 2;
+    const auto stride = n / size;
+    for (std::size_t start = 0; start < n; start += size) {
+      for (std::size_t i = 0; i < half; ++i) {
+        auto& even = mBuffer[start + i];
+        auto& odd = mBuffer[start + i + half];
+        const auto t = Multiply(mTwiddles[i * stride], odd);
+        odd = even - t;
+        even += t;
+      }
+    }
+  }
+
+  for (std::size_t bin = 0; bin < levels.size(); ++bin) {
+    const auto amplitude = std::abs(mBuffer[bin]) * mScale;
+    levels[bin] = 20 * std::log10(std::max(amplitude, MIN_AMPLITUDE));
+  }
+}
+
+AxisSpectrum::AxisSpectrum(std::pmr::memory_resource* resource)
+  : mLevels(resource), mPeaks(resource) {
+}
+
+AxisSpectrum::AxisSpectrum(
+  const AxisSpectrum& other,
+  std::pmr::memory_resource* resource)
+  : mLevels(other.mLevels, resource),
+    mBinWidth(other.mBinWidth),
+    mNoiseFloor(other.mNoiseFloor),
+    mPeaks(other.mPeaks, resource),
+    mGeneration(other.mGeneration) {
+}
+
+NoiseAnalyzer::NoiseAnalyzer(
+  const DeviceInfo& device,
+  const NoiseAnalysisSettings& settings)
+  : mSettings(settings),
+    mAxisRanges(GetAxisRanges(device)),
+    // Twice the window, so that the oldest samples in a window aren't
+    // overwritten while we're reading them
+    mRing(
+      device.mAxes.size(),
+      device.mHats.size(),
+      device.mButtons.size(),
+      settings.mWindowSize * 2),
+    mSpectra(device.mAxes.size()),
+    mThread([this](std::stop_token stop) { this->Run(stop); }) {
+}
+
+void NoiseAnalyzer::Push(Clock::time_point now, const DeviceState& state) {
+  mRing.Push(
+    std::chrono::duration_cast<std::chrono::microseconds>(now - mEpoch),
+    state);
+}
+
+AxisSpectrum NoiseAnalyzer::GetSpectrum(
+  std::size_t axis,
+  std::pmr::memory_resource* resource) const {
+  std::lock_guard lock {mMutex};
+  return {mSpectra.at(axis), resource};
+}
+
+void NoiseAnalyzer::Run(std::stop_token stop) {
+  Trace::SetThreadName("NoiseAnalyzer");
+  SpectrumAnalyzer analyzer {mSettings.mWindowSize};
+  DeviceState state;
+  std::vector<std::vector<float>> axes(
+    mAxisRanges.size(), std::vector<float>(mSettings.mWindowSize));
+  AxisSpectrum spectrum;
+  spectrum.mLevels.resize(analyzer.GetBinCount());
+  spectrum.mPeaks.reserve(MAX_PEAKS + 1);
+  std::vector<float> scratch;
+
+  while (true) {
+    {
+      std::unique_lock lock {mMutex};
+      mWake.wait_for(
+        lock, stop, mSettings.mUpdateInterval, [] { return false; });
+    }
+    if (stop.stop_requested()) {
+      return;
+    }
+
+    const Trace::Zone traceZone {"NoiseAnalyzer::Analyze"};
+    const auto sampleRate = this->TakeWindow(state, axes);
+    if (sampleRate <= 0) {
+      continue;
+    }
+    spectrum.mBinWidth = sampleRate / mSettings.mWindowSize;
+
+    for (std::size_t i = 0; i < axes.size(); ++i) {
+      analyzer.Analyze(axes[i], spectrum.mLevels);
+      this->FindPeaks(spectrum, scratch);
+
+      std::lock_guard lock {mMutex};
+      auto& published = mSpectra[i];
+      spectrum.mGeneration = published.mGeneration + 1;
+      published = spectrum;
+    }
+  }
+}
+
+float NoiseAnalyzer::TakeWindow(
+  DeviceState& state,
+  std::vector<std::vector<float>>& axes) const {
+  const auto size = mSettings.mWindowSize;
+  const auto end = mRing.GetEnd();
+  if (end < size) {
+    return 0;
+  }
+  const auto begin = end - size;
+
+  std::chrono::microseconds first {};
+  std::chrono::microseconds last {};
+  for (std::size_t i = 0; i < size; ++i) {
+    const auto time = mRing.Read(begin + i, state);
+    if (!time) {
+      // Overwritten; try again with the next window
+      return 0;
+    }
+    if (i == 0) {
+      first = *time;
+    }
+    last = *time;
+    for (std::size_t axis = 0; axis < axes.size(); ++axis) {
+      axes[axis][i] = state.mAxes[axis] / mAxisRanges[axis];
+    }
+  }
+
+  const auto seconds = std::chrono::duration<float>(last - first).count();
+  if (seconds <= 0) {
+    return 0;
+  }
+  return (size - 1) / seconds;
+}
+
+void NoiseAnalyzer::FindPeaks(
+  AxisSpectrum& spectrum,
+  std::vector<float>& scratch) const {
+  const auto& levels = spectrum.mLevels;
+  spectrum.mPeaks.clear();
+
+  const auto firstBin = std::max<std::size_t>(
+    1,
+    static_cast<std::size_t>(
+      std::ceil(mSettings.mMinimumFrequency / spectrum.mBinWidth)));
+  if (firstBin + 2 >= levels.size()) {
+    spectrum.mNoiseFloor = levels.back();
+    return;
+  }
+
+  scratch.assign(levels.begin() + firstBin, levels.end());
+  const auto median = scratch.begin() + (scratch.size() / 2);
+  std::ranges::nth_element(scratch, median);
+  spectrum.mNoiseFloor = *median;
+
+  for (std::size_t bin = firstBin; bin + 1 < levels.size(); ++bin) {
+    const auto level = levels[bin];
+    if (
+      level <= levels[bin - 1] || level < levels[bin + 1]
+      || level < spectrum.mNoiseFloor + PEAK_PROMINENCE) {
+      continue;
+    }
+    // Fit a parabola to the neighbors, as the peak is usually between bins
+    const auto before = levels[bin - 1];
+    const auto after = levels[bin + 1];
+    const auto curvature = before - (2 * level) + after;
+    const auto offset
+      = (curvature < 0) ? (0.5f * (before - after) / curvature) : 0.0f;
+
+    spectrum.mPeaks.push_back({
+      .mFrequency = (bin + offset) * spectrum.mBinWidth,
+      .mLevel = level,
+    });
+    std::ranges::sort(
+      spectrum.mPeaks, std::ranges::greater {}, &NoisePeak::mLevel);
+    if (spectrum.mPeaks.size() > MAX_PEAKS) {
+      spectrum.mPeaks.pop_back();
+    }
+  }
+}
+
+}// namespace FredEmmott::ControllerTester
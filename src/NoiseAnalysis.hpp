@@ -0,0 +1,138 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <chrono>
+#include <complex>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "DeviceInfo.hpp"
+#include "DeviceState.hpp"
+#include "SampleRing.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+/* Magnitude spectrum of fixed-size blocks of real samples.
+ *
+ * Radix-2 FFT with a Hann window; the tables are built once, so
+ * `Analyze()` doesn't allocate.
+ */
+class SpectrumAnalyzer final {
+ public:
+  // Must be a power of two
+  explicit SpectrumAnalyzer(std::size_t windowSize);
+
+  std::size_t GetWindowSize() const;
+  // Bins from 0Hz to the Nyquist frequency inclusive
+  std::size_t GetBinCount() const;
+
+  /* `levels` must have `GetBinCount()` elements.
+   *
+   * Levels are in dB relative to a sine wave with an amplitude of 1, so a
+   * sine covering a range of 1 is -6dB.
+   */
+  void Analyze(std::span<const float> samples, std::span<float> levels);
+
+ private:
+  std::size_t mWindowSize {};
+  std::vector<float> mWindow;
+  // Converts a windowed FFT magnitude to an amplitude
+  float mScale {};
+  std::vector<std::complex<float>> mTwiddles;
+  std::vector<uint32_t> mBitReversed;
+  std::vector<std::complex<float>> mBuffer;
+};
+
+struct NoiseAnalysisSettings {
+  // A power of two; at 1kHz, 1024 samples are about 1s, for 1Hz resolution
+  std::size_t mWindowSize {1024};
+  std::chrono::milliseconds mUpdateInterval {250};
+  // Lower frequencies are from the control being moved, so aren't noise
+  float mMinimumFrequency {15};
+};
+
+struct NoisePeak {
+  float mFrequency {};
+  // dB, as `SpectrumAnalyzer::Analyze()`, relative to the axis range
+  float mLevel {};
+};
+
+struct AxisSpectrum {
+  explicit AxisSpectrum(
+    std::pmr::memory_resource* = std::pmr::get_default_resource());
+  AxisSpectrum(const AxisSpectrum&, std::pmr::memory_resource*);
+
+  // Per bin, relative to the axis range
+  std::pmr::vector<float> mLevels;
+  float mBinWidth {};
+  // The median level from `mMinimumFrequency` up
+  float mNoiseFloor {};
+  // Strongest first; only peaks well above the noise floor
+  std::pmr::vector<NoisePeak> mPeaks;
+  // Incremented each time the axis is analyzed; 0 if it hasn't been yet
+  uint64_t mGeneration {};
+};
+
+/* The noise spectrum of every axis, from a sliding window of samples.
+ *
+ * Samples are kept in a `SampleRing`; a background thread takes a window
+ * from it every `mUpdateInterval`, and analyzes each axis in turn. Each
+ * axis costs one FFT of `mWindowSize` per interval, however many axes the
+ * device has, and results are published as each axis is finished.
+ *
+ * The sample rate is measured from each window's timestamps, so it should
+ * be fed from a `Sampler` rather than once per frame.
+ */
+class NoiseAnalyzer final {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr std::size_t MAX_PEAKS {3};
+  // How far above the noise floor a peak must be to be reported
+  static constexpr float PEAK_PROMINENCE {12};
+
+  NoiseAnalyzer(const DeviceInfo&, const NoiseAnalysisSettings&);
+
+  NoiseAnalyzer() = delete;
+  NoiseAnalyzer(const NoiseAnalyzer&) = delete;
+  NoiseAnalyzer(NoiseAnalyzer&&) = delete;
+  NoiseAnalyzer& operator=(const NoiseAnalyzer&) = delete;
+  NoiseAnalyzer& operator=(NoiseAnalyzer&&) = delete;
+
+  // Call for every sample, from a single thread; this never blocks or
+  // allocates
+  void Push(Clock::time_point, const DeviceState&);
+
+  // Can be called from any thread; only waits for a copy, never for an FFT
+  AxisSpectrum GetSpectrum(
+    std::size_t axis,
+    std::pmr::memory_resource* = std::pmr::get_default_resource()) const;
+
+ private:
+  NoiseAnalysisSettings mSettings;
+  std::vector<float> mAxisRanges;
+  SampleRing mRing;
+  const Clock::time_point mEpoch {Clock::now()};
+
+  mutable std::mutex mMutex;
+  std::condition_variable_any mWake;
+  std::vector<AxisSpectrum> mSpectra;
+
+  // Last, so that it's stopped before anything it uses is destroyed
+  std::jthread mThread;
+
+  void Run(std::stop_token);
+  // Returns the sample rate, or 0 if there aren't enough samples yet
+  float TakeWindow(DeviceState& scratch, std::vector<std::vector<float>>& axes)
+    const;
+  void FindPeaks(AxisSpectrum&, std::vector<float>& scratch) const;
+};
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,76 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "PerformanceMetrics.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace FredEmmott::ControllerTester {
+
+RollingSamples::RollingSamples(Clock::duration window, std::size_t capacity)
+  : mWindow(window), mSamples(capacity) {
+}
+
+void RollingSamples::Push(float value, Clock::time_point now) {
+  if (mSamples.empty()) {
+    return;
+  }
+  mSamples[mNext] = {now, value};
+  mNext = (mNext + 1) % mSamples.size();
+  mCount = std::min(mCount + 1, mSamples.size());
+}
+
+RollingSamples::Summary RollingSamples::GetSummary(
+  std::pmr::memory_resource* resource,
+  Clock::time_point now) const {
+  if (mCount == 0) {
+    return {};
+  }
+
+  const auto newest = (mNext + mSamples.size() - 1) % mSamples.size();
+  Summary ret {.mLatest = mSamples[newest].mValue};
+
+  std::pmr::vector<float> values {resource};
+  values.reserve(mCount);
+  const auto oldest = (mNext + mSamples.size() - mCount) % mSamples.size();
+  for (std::size_t i = 0; i < mCount; ++i) {
+    const auto& sample = mSamples[(oldest + i) % mSamples.size()];
+    if (now - sample.mTime > mWindow) {
+      continue;
+    }
+    values.push_back(sample.mValue);
+  }
+  if (values.empty()) {
+    return ret;
+  }
+
+  std::ranges::sort(values);
+  // Nearest-rank percentiles
+  const auto percentile = [&values](float p) {
+    const auto rank = static_cast<std::size_t>(
+      std::ceil((p / 100.0f) * static_cast<float>(values.size())));
+    return values[std::clamp<std::size_t>(rank, 1, values.size()) - 1];
+  };
+
+  ret.mCount = values.size();
+  ret.mMin = values.front();
+  ret.mP5 = percentile(5);
+  ret.mP50 = percentile(50);
+  ret.mP95 = percentile(95);
+  ret.mP99 = percentile(99);
+  ret.mMax = values.back();
+  return ret;
+}
+
+ScopedTimer::ScopedTimer(RollingSamples& samples)
+  : mSamples(samples), mStart(RollingSamples::Clock::now()) {
+}
+
+ScopedTimer::~ScopedTimer() {
+  const auto now = RollingSamples::Clock::now();
+  mSamples.Push(
+    std::chrono::duration<float, std::milli>(now - mStart).count(), now);
+}
+
+}// namespace FredEmmott::ControllerTester
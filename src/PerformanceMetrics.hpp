@@ -0,0 +1,69 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+namespace FredEmmott::ControllerTester {
+
+/* A fixed-capacity history of timestamped values, for rolling percentiles.
+ *
+ * Storage is allocated once; `Push()` overwrites the oldest sample when the
+ * buffer is full, and samples older than the window are ignored by
+ * `GetSummary()`.
+ */
+class RollingSamples final {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  RollingSamples(Clock::duration window, std::size_t capacity);
+
+  void Push(float value, Clock::time_point now = Clock::now());
+
+  struct Summary {
+    std::size_t mCount {};
+    float mLatest {};
+    float mMin {};
+    float mP5 {};
+    float mP50 {};
+    float mP95 {};
+    float mP99 {};
+    float mMax {};
+  };
+  // The resource is only used for scratch space
+  Summary GetSummary(
+    std::pmr::memory_resource*,
+    Clock::time_point now = Clock::now()) const;
+
+ private:
+  struct Sample {
+    Clock::time_point mTime;
+    float mValue;
+  };
+  Clock::duration mWindow;
+  std::vector<Sample> mSamples;
+  std::size_t mNext {};
+  std::size_t mCount {};
+};
+
+// Pushes the elapsed time in milliseconds when destroyed
+class ScopedTimer final {
+ public:
+  explicit ScopedTimer(RollingSamples&);
+  ~ScopedTimer();
+
+  ScopedTimer() = delete;
+  ScopedTimer(const ScopedTimer&) = delete;
+  ScopedTimer(ScopedTimer&&) = delete;
+  ScopedTimer& operator=(const ScopedTimer&) = delete;
+  ScopedTimer& operator=(ScopedTimer&&) = delete;
+
+ private:
+  RollingSamples& mSamples;
+  RollingSamples::Clock::time_point mStart;
+};
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,225 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "PollScheduler.hpp"
+
+#include <algorithm>
+
+#include "Trace.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+namespace {
+
+// How long to sleep with no devices at all
+constexpr std::chrono::milliseconds EMPTY_WAIT {100};
+
+bool IsSameState(const DeviceState& a, const DeviceState& b) {
+  return std::ranges::equal(a.mAxes, b.mAxes)
+    && std::ranges::equal(a.mHats, b.mHats)
+    && std::ranges::equal(a.mButtons, b.mButtons);
+}
+
+// Unlike assignment, keeps `to`'s memory resource
+void CopyState(const DeviceState& from, DeviceState& to) {
+  to.mAxes.assign(from.mAxes.begin(), from.mAxes.end());
+  to.mHats.assign(from.mHats.begin(), from.mHats.end());
+  to.mButtons.assign(from.mButtons.begin(), from.mButtons.end());
+}
+
+}// namespace
+
+PollScheduler::PolledDevice::PolledDevice(Callback callback)
+  : mCallback(std::move(callback)) {
+}
+
+PollScheduler::PolledDevice::~PolledDevice() = default;
+
+PollScheduler::PolledDevice::Stats PollScheduler::PolledDevice::GetStats()
+  const {
+  const auto updateInterval
+    = mStatsUpdateInterval.load(std::memory_order_relaxed);
+  return {
+    .mPollInterval = std::chrono::nanoseconds {
+      mStatsPollInterval.load(std::memory_order_relaxed)},
+    .mUpdateInterval = updateInterval
+      ? std::optional<Clock::duration> {std::chrono::nanoseconds {
+        updateInterval}}
+      : std::nullopt,
+    .mIdle = mStatsIdle.load(std::memory_order_relaxed),
+    .mPollCount = mPollCount.load(std::memory_order_relaxed),
+    .mChangeCount = mChangeCount.load(std::memory_order_relaxed),
+  };
+}
+
+PollScheduler::PollScheduler(const PollSchedulerSettings& settings)
+  : mSettings(settings),
+    mWheel(settings.mTick),
+    mThread([this](std::stop_token stop) { this->Run(stop); }) {
+}
+
+PollScheduler::~PollScheduler() = default;
+
+void PollScheduler::Enqueue(std::unique_ptr<PolledDevice> device) {
+  std::unique_lock lock(mMutex);
+  mAdded.push_back(std::move(device));
+  mChanged = true;
+  mWakeup.notify_all();
+}
+
+void PollScheduler::Remove(PolledDevice* device) {
+  std::unique_lock lock(mMutex);
+  mRemoved.push_back(device);
+  mChanged = true;
+  const auto generation = mGeneration;
+  mWakeup.notify_all();
+  mWakeup.wait(lock, [=, this] { return mGeneration > generation; });
+}
+
+void PollScheduler::Run(std::stop_token stop) {
+  Trace::SetThreadName("PollScheduler");
+  // Enough for the largest DirectInput state; states are decoded into
+  // this instead of the heap
+  alignas(std::max_align_t) std::array<std::byte, 4096> buffer;
+
+  std::unique_lock lock(mMutex);
+  while (!stop.stop_requested()) {
+    this->ApplyChanges(Clock::now());
+    lock.unlock();
+
+    mWheel.Advance(Clock::now(), [this, &buffer](TimerWheel::Timer& timer) {
+      std::pmr::monotonic_buffer_resource resource {
+        buffer.data(), buffer.size()};
+      this->Poll(static_cast<PolledDevice&>(timer), &resource);
+    });
+
+    lock.lock();
+    if (mChanged) {
+      continue;
+    }
+    const auto next = mWheel.GetNextDeadline();
+    mWakeup.wait_until(
+      lock, stop, next.value_or(Clock::now() + EMPTY_WAIT), [this] {
+        return mChanged;
+      });
+  }
+
+  for (auto& device: mDevices) {
+    mWheel.Cancel(*device);
+  }
+}
+
+void PollScheduler::ApplyChanges(Clock::time_point now) {
+  if (!mChanged) {
+    return;
+  }
+
+  for (auto& device: mAdded) {
+    device->mLastChange = now;
+    device->mNext = now;
+    device->mInterval = mSettings.mMinInterval;
+    mWheel.Schedule(*device, now);
+    mDevices.push_back(std::move(device));
+  }
+  mAdded.clear();
+
+  for (auto removed: mRemoved) {
+    const auto it = std::ranges::find_if(mDevices, [removed](auto& device) {
+      return device.get() == removed;
+    });
+    if (it == mDevices.end()) {
+      continue;
+    }
+    mWheel.Cancel(**it);
+    mDevices.erase(it);
+  }
+  mRemoved.clear();
+
+  mChanged = false;
+  ++mGeneration;
+  mWakeup.notify_all();
+}
+
+void PollScheduler::Poll(
+  PolledDevice& device,
+  std::pmr::memory_resource* resource) {
+  const Trace::Zone traceZone {"PollScheduler::Poll"};
+  const auto state = device.Read(resource);
+  const auto now = Clock::now();
+  device.mPollCount.fetch_add(1, std::memory_order_relaxed);
+  mPollCount.fetch_add(1, std::memory_order_relaxed);
+
+  bool changed = false;
+  if (!state) {
+    // The next successful read is a new first state
+    device.mPrevious.reset();
+    device.mCallback(now, state);
+  } else if (!device.mPrevious) {
+    device.mPrevious.emplace();
+    CopyState(*state, *device.mPrevious);
+    changed = true;
+  } else if (!IsSameState(*state, *device.mPrevious)) {
+    // Each change was seen up to a poll interval after it happened, so
+    // gaps are off by up to that much either way; without centering the
+    // error, the shortest gap underestimates, and polling speeds up further
+    device.mGaps[device.mNextGap]
+      = (now - device.mLastChange) + (device.mInterval / 2);
+    device.mNextGap = (device.mNextGap + 1) % device.mGaps.size();
+    device.mGapCount = std::min(device.mGapCount + 1, device.mGaps.size());
+    CopyState(*state, *device.mPrevious);
+    changed = true;
+  }
+
+  if (changed) {
+    device.mLastChange = now;
+    device.mChangeCount.fetch_add(1, std::memory_order_relaxed);
+    device.mCallback(now, state);
+  }
+
+  const auto update = GetUpdateInterval(device);
+  const auto active = update
+    ? std::clamp(
+      std::chrono::duration_cast<Clock::duration>(
+        *update / mSettings.mRateMultiple),
+      mSettings.mMinInterval,
+      std::max(mSettings.mMinInterval, mSettings.mMaxActiveInterval))
+    : mSettings.mMinInterval;
+  const auto idle = now - device.mLastChange >= mSettings.mIdleAfter;
+  if (idle) {
+    device.mInterval = std::clamp(
+      device.mInterval * 2,
+      active,
+      std::max(active, mSettings.mMaxIdleInterval));
+  } else {
+    device.mInterval = active;
+  }
+
+  device.mNext += device.mInterval;
+  if (device.mNext < now) {
+    // Skip the missed deadlines rather than polling in a burst
+    device.mNext = now;
+  }
+  mWheel.Schedule(device, device.mNext);
+
+  device.mStatsPollInterval.store(
+    std::chrono::nanoseconds {device.mInterval}.count(),
+    std::memory_order_relaxed);
+  device.mStatsUpdateInterval.store(
+    update ? std::chrono::nanoseconds {*update}.count() : 0,
+    std::memory_order_relaxed);
+  device.mStatsIdle.store(idle, std::memory_order_relaxed);
+}
+
+std::optional<PollScheduler::Clock::duration>
+PollScheduler::GetUpdateInterval(const PolledDevice& device) {
+  if (device.mGapCount == 0) {
+    return std::nullopt;
+  }
+  // Changes can't be closer together than the device's update interval;
+  // when polling faster than it updates, the shortest gap is the best
+  // estimate
+  return *std::ranges::min_element(
+    device.mGaps.begin(), device.mGaps.begin() + device.mGapCount);
+}
+
+}// namespace FredEmmott::ControllerTester
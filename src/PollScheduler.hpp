@@ -0,0 +1,193 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "DeviceInfo.hpp"
+#include "DeviceState.hpp"
+#include "TimerResolution.hpp"
+#include "TimerWheel.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+struct PollSchedulerSettings {
+  using Clock = std::chrono::steady_clock;
+
+  // Polls per update, once a device's update rate is known
+  float mRateMultiple {2.0f};
+  // Also used until a device's update rate is known
+  Clock::duration mMinInterval {std::chrono::microseconds {250}};
+  // The slowest polling for a device that's changing
+  Clock::duration mMaxActiveInterval {std::chrono::milliseconds {8}};
+  // Without changes for this long, polling slows down...
+  Clock::duration mIdleAfter {std::chrono::seconds {1}};
+  // ... by doubling the interval, up to this
+  Clock::duration mMaxIdleInterval {std::chrono::milliseconds {100}};
+  // Deadlines are rounded up to this
+  Clock::duration mTick {std::chrono::microseconds {100}};
+};
+
+/* Polls any number of devices from one thread, each at a multiple of the
+ * rate it actually updates at.
+ *
+ * A 125hz button box doesn't need polling as often as a 1khz wheel; each
+ * device's update interval is estimated from the shortest of its recent
+ * gaps between changes, and it's polled `mRateMultiple` times per update.
+ * Devices that stop changing are polled less and less often, and return to
+ * their full rate as soon as anything changes.
+ *
+ * Deadlines are kept in a `TimerWheel`, so the scheduling cost per poll
+ * doesn't grow with the number of devices.
+ */
+class PollScheduler final {
+ public:
+  using Clock = std::chrono::steady_clock;
+  // Called on the scheduler thread whenever a device's state changes,
+  // including its first state, and for every read that fails
+  using Callback = std::function<
+    void(Clock::time_point, const std::optional<DeviceState>&)>;
+
+  class PolledDevice : private TimerWheel::Timer {
+   public:
+    virtual ~PolledDevice();
+
+    PolledDevice(const PolledDevice&) = delete;
+    PolledDevice(PolledDevice&&) = delete;
+    PolledDevice& operator=(const PolledDevice&) = delete;
+    PolledDevice& operator=(PolledDevice&&) = delete;
+
+    struct Stats {
+      Clock::duration mPollInterval {};
+      // Nullopt until there have been enough changes to estimate it
+      std::optional<Clock::duration> mUpdateInterval;
+      bool mIdle {false};
+      uint64_t mPollCount {};
+      uint64_t mChangeCount {};
+    };
+    Stats GetStats() const;
+
+   protected:
+    explicit PolledDevice(Callback);
+
+   private:
+    friend class PollScheduler;
+
+    static constexpr std::size_t GAP_COUNT {16};
+
+    Callback mCallback;
+    // Only used on the scheduler thread
+    std::optional<DeviceState> mPrevious;
+    Clock::time_point mLastChange {};
+    Clock::time_point mNext {};
+    Clock::duration mInterval {};
+    std::array<Clock::duration, GAP_COUNT> mGaps {};
+    std::size_t mGapCount {};
+    std::size_t mNextGap {};
+
+    // For `GetStats()`, in nanoseconds; 0 if unknown
+    std::atomic<int64_t> mStatsPollInterval {0};
+    std::atomic<int64_t> mStatsUpdateInterval {0};
+    std::atomic<bool> mStatsIdle {false};
+    std::atomic<uint64_t> mPollCount {0};
+    std::atomic<uint64_t> mChangeCount {0};
+
+    virtual std::optional<DeviceState> Read(std::pmr::memory_resource*) = 0;
+  };
+
+  PollScheduler(const PollSchedulerSettings& = {});
+  ~PollScheduler();
+
+  PollScheduler(const PollScheduler&) = delete;
+  PollScheduler(PollScheduler&&) = delete;
+  PollScheduler& operator=(const PollScheduler&) = delete;
+  PollScheduler& operator=(PollScheduler&&) = delete;
+
+  // Takes ownership of the device, as backends aren't thread-safe; use
+  // `DeviceTracker::OpenAnother()` for a device that the GUI is also showing.
+  //
+  // Returns a handle for `Remove()` and stats, valid until `Remove()`.
+  template <Device T>
+  PolledDevice* Add(T&& device, Callback callback) {
+    auto owned
+      = std::make_unique<Polled<T>>(std::move(device), std::move(callback));
+    auto ret = owned.get();
+    this->Enqueue(std::move(owned));
+    return ret;
+  }
+
+  // Blocks until the device has been destroyed, and the callback won't be
+  // called again; don't call this from a callback.
+  void Remove(PolledDevice*);
+
+  const PollSchedulerSettings& GetSettings() const {
+    return mSettings;
+  }
+
+  // Total across all devices
+  uint64_t GetPollCount() const {
+    return mPollCount.load(std::memory_order_relaxed);
+  }
+
+ private:
+  template <Device T>
+  class Polled final : public PolledDevice {
+   public:
+    Polled(T&& device, Callback callback)
+      : PolledDevice(std::move(callback)), mDevice(std::move(device)) {
+    }
+
+   private:
+    T mDevice;
+
+    std::optional<DeviceState> Read(
+      std::pmr::memory_resource* resource) override {
+      mDevice.Poll();
+      return mDevice.GetState(resource);
+    }
+  };
+
+  const PollSchedulerSettings mSettings;
+  TimerResolution mTimerResolution;
+  std::atomic<uint64_t> mPollCount {0};
+
+  std::mutex mMutex;
+  std::condition_variable_any mWakeup;
+  // Protected by `mMutex`
+  std::vector<std::unique_ptr<PolledDevice>> mAdded;
+  std::vector<PolledDevice*> mRemoved;
+  bool mChanged {false};
+  // Incremented each time `mAdded` and `mRemoved` are applied
+  uint64_t mGeneration {};
+
+  // Only used on the scheduler thread
+  std::vector<std::unique_ptr<PolledDevice>> mDevices;
+  TimerWheel mWheel;
+
+  // Last, so that it's stopped before anything it uses is destroyed
+  std::jthread mThread;
+
+  void Enqueue(std::unique_ptr<PolledDevice>);
+
+  void Run(std::stop_token);
+  // Call with `mMutex` held
+  void ApplyChanges(Clock::time_point now);
+  void Poll(PolledDevice&, std::pmr::memory_resource*);
+  static std::optional<Clock::duration> GetUpdateInterval(
+    const PolledDevice&);
+};
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,296 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "RealTimeThread.hpp"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+
+#include <avrt.h>
+#include <intrin.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace FredEmmott::ControllerTester {
+
+namespace {
+
+// Enough for the sampling loop and a backend's calls
+constexpr std::size_t STACK_PREFAULT_BYTES {64 * 1024};
+// Smallest common page size; touching more often is harmless
+constexpr std::size_t PAGE_BYTES {4096};
+
+#ifdef __linux__
+// Above most threaded IRQ handlers' default of 50, so the sampler isn't
+// held up by unrelated devices, but below the kernel's own watchdogs
+constexpr int FIFO_PRIORITY {60};
+#endif
+
+void CpuRelax() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  _mm_pause();
+#elif defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#else
+  std::this_thread::yield();
+#endif
+}
+
+// Touch the stack now, so the sampling loop doesn't page-fault on it later
+#ifdef _MSC_VER
+__declspec(noinline)
+#else
+[[gnu::noinline]]
+#endif
+void PrefaultStack() {
+  std::byte stack[STACK_PREFAULT_BYTES];
+  volatile std::byte* touch = stack;
+  for (std::size_t i = 0; i < STACK_PREFAULT_BYTES; i += PAGE_BYTES) {
+    touch[i] = std::byte {};
+  }
+}
+
+void Prefault(std::span<std::byte> buffer) {
+  for (std::size_t i = 0; i < buffer.size(); i += PAGE_BYTES) {
+    // Write the existing value, so that copy-on-write pages are copied too
+    auto& byte = *static_cast<volatile std::byte*>(buffer.data() + i);
+    byte = byte;
+  }
+}
+
+float Percentile(std::span<const float> sorted, float percentile) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  const auto index = static_cast<std::size_t>(
+    (percentile / 100) * static_cast<float>(sorted.size() - 1));
+  return sorted[index];
+}
+
+}// namespace
+
+unsigned int GetRealTimeCore(std::size_t index) {
+  const auto cores = std::max(1u, std::thread::hardware_concurrency());
+  return cores - 1 - static_cast<unsigned int>(index % cores);
+}
+
+std::string FormatRealTimeStatus(
+  const RealTimeSettings& settings,
+  const RealTimeStatus& status) {
+  std::string ret;
+  const auto append = [&ret](bool requested, bool applied, const char* what) {
+    if (!requested) {
+      return;
+    }
+    if (!ret.empty()) {
+      ret += ", ";
+    }
+    if (!applied) {
+      ret += "no ";
+    }
+    ret += what;
+  };
+  append(settings.mPinToCore, status.mPinned, "pinned");
+  append(settings.mRealTimePriority, status.mRealTimePriority, "priority");
+  append(settings.mLockMemory, status.mMemoryLocked, "locked");
+  return ret.empty() ? "none" : ret;
+}
+
+struct RealTimeThread::Previous {
+#ifdef _WIN32
+  DWORD_PTR mAffinity {};
+  int mPriority {THREAD_PRIORITY_NORMAL};
+  HANDLE mTask {nullptr};
+#elif defined(__linux__)
+  cpu_set_t mAffinity {};
+  int mPolicy {SCHED_OTHER};
+  sched_param mParam {};
+#endif
+};
+
+RealTimeThread::RealTimeThread(
+  const RealTimeSettings& settings,
+  std::span<std::byte> buffer)
+  : mSettings(settings), mPrevious(std::make_unique<Previous>()) {
+  if (settings.mPinToCore) {
+    this->Pin(settings.mCore.value_or(GetRealTimeCore(0)));
+  }
+  if (settings.mRealTimePriority) {
+    this->RaisePriority();
+  }
+  if (settings.mLockMemory) {
+    this->LockMemory(buffer);
+  }
+}
+
+RealTimeThread::~RealTimeThread() {
+#ifdef _WIN32
+  if (mStatus.mMemoryLocked) {
+    VirtualUnlock(mLocked.data(), mLocked.size());
+  }
+  if (mPrevious->mTask) {
+    AvRevertMmThreadCharacteristics(mPrevious->mTask);
+  } else if (mStatus.mRealTimePriority) {
+    SetThreadPriority(GetCurrentThread(), mPrevious->mPriority);
+  }
+  if (mStatus.mPinned) {
+    SetThreadAffinityMask(GetCurrentThread(), mPrevious->mAffinity);
+  }
+#elif defined(__linux__)
+  if (mStatus.mMemoryLocked) {
+    munlock(mLocked.data(), mLocked.size());
+  }
+  if (mStatus.mRealTimePriority) {
+    pthread_setschedparam(
+      pthread_self(), mPrevious->mPolicy, &mPrevious->mParam);
+  }
+  if (mStatus.mPinned) {
+    pthread_setaffinity_np(
+      pthread_self(), sizeof(mPrevious->mAffinity), &mPrevious->mAffinity);
+  }
+#endif
+}
+
+void RealTimeThread::Pin(unsigned int core) {
+#ifdef _WIN32
+  if (core >= sizeof(DWORD_PTR) * 8) {
+    return;
+  }
+  const auto previous = SetThreadAffinityMask(
+    GetCurrentThread(), static_cast<DWORD_PTR>(1) << core);
+  if (previous) {
+    mPrevious->mAffinity = previous;
+    mStatus.mPinned = true;
+  }
+#elif defined(__linux__)
+  if (core >= CPU_SETSIZE) {
+    return;
+  }
+  if (
+    pthread_getaffinity_np(
+      pthread_self(), sizeof(mPrevious->mAffinity), &mPrevious->mAffinity)
+    != 0) {
+    return;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(core, &set);
+  mStatus.mPinned
+    = pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#endif
+}
+
+void RealTimeThread::RaisePriority() {
+#ifdef _WIN32
+  // MMCSS raises the priority further than a normal process can, and
+  // keeps it there while the thread is busy
+  DWORD taskIndex {};
+  mPrevious->mTask = AvSetMmThreadCharacteristicsW(L"Pro Audio", &taskIndex);
+  if (mPrevious->mTask) {
+    AvSetMmThreadPriority(mPrevious->mTask, AVRT_PRIORITY_CRITICAL);
+    mStatus.mRealTimePriority = true;
+    return;
+  }
+  mPrevious->mPriority = GetThreadPriority(GetCurrentThread());
+  mStatus.mRealTimePriority
+    = SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+#elif defined(__linux__)
+  if (
+    pthread_getschedparam(
+      pthread_self(), &mPrevious->mPolicy, &mPrevious->mParam)
+    != 0) {
+    return;
+  }
+  sched_param param {};
+  param.sched_priority = std::clamp(
+    FIFO_PRIORITY,
+    sched_get_priority_min(SCHED_FIFO),
+    sched_get_priority_max(SCHED_FIFO));
+  mStatus.mRealTimePriority
+    = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+#endif
+}
+
+void RealTimeThread::LockMemory(std::span<std::byte> buffer) {
+  PrefaultStack();
+  Prefault(buffer);
+  if (buffer.empty()) {
+    return;
+  }
+#ifdef _WIN32
+  mStatus.mMemoryLocked = VirtualLock(buffer.data(), buffer.size());
+#elif defined(__linux__)
+  mStatus.mMemoryLocked = mlock(buffer.data(), buffer.size()) == 0;
+#endif
+  if (mStatus.mMemoryLocked) {
+    mLocked = buffer;
+  }
+}
+
+void RealTimeThread::WaitUntil(Clock::time_point deadline) const {
+  const auto spinFrom = deadline - mSettings.mSpinBefore;
+  if (Clock::now() < spinFrom) {
+    std::this_thread::sleep_until(spinFrom);
+  }
+  while (Clock::now() < deadline) {
+    CpuRelax();
+  }
+}
+
+JitterReport MeasureJitter(
+  const RealTimeSettings& settings,
+  RealTimeSettings::Clock::duration interval,
+  RealTimeSettings::Clock::duration duration) {
+  using Clock = RealTimeSettings::Clock;
+  const auto count = static_cast<std::size_t>(duration / interval);
+  // Allocated up front, so that recording doesn't allocate
+  std::vector<float> lateness(count);
+
+  JitterReport ret {.mStatus = {}, .mCount = count};
+  std::thread thread([&]() {
+    std::optional<RealTimeThread> realTime;
+    if (settings.mEnabled) {
+      realTime.emplace(
+        settings, std::as_writable_bytes(std::span {lateness}));
+      ret.mStatus = realTime->GetStatus();
+    }
+
+    auto next = Clock::now() + interval;
+    for (auto& late: lateness) {
+      if (realTime) {
+        realTime->WaitUntil(next);
+      } else {
+        std::this_thread::sleep_until(next);
+      }
+      const auto now = Clock::now();
+      late = std::chrono::duration<float, std::micro>(now - next).count();
+      next += interval;
+      if (next <= now) {
+        ++ret.mMissed;
+        // Skip the missed deadlines, rather than waking in a burst
+        while (next <= now) {
+          next += interval;
+        }
+      }
+    }
+  });
+  thread.join();
+
+  std::ranges::sort(lateness);
+  ret.mP50 = Percentile(lateness, 50);
+  ret.mP90 = Percentile(lateness, 90);
+  ret.mP99 = Percentile(lateness, 99);
+  ret.mP999 = Percentile(lateness, 99.9f);
+  ret.mMax = lateness.empty() ? 0 : lateness.back();
+  return ret;
+}
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,127 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+
+namespace FredEmmott::ControllerTester {
+
+struct RealTimeSettings {
+  using Clock = std::chrono::steady_clock;
+
+  // Sleeping can overshoot by about this much; it's much coarser on Windows
+  static constexpr Clock::duration DEFAULT_SPIN {
+#ifdef _WIN32
+    std::chrono::microseconds {1500}
+#else
+    std::chrono::microseconds {200}
+#endif
+  };
+
+  // Off by default, as it can use a whole core
+  bool mEnabled {false};
+  // Nullopt for `GetRealTimeCore(0)`; threads that run at the same time
+  // should use different cores, or they delay each other
+  std::optional<unsigned int> mCore;
+  bool mPinToCore {true};
+  // SCHED_FIFO on Linux, which usually needs CAP_SYS_NICE or an rtprio
+  // limit; MMCSS on Windows, falling back to time-critical priority
+  bool mRealTimePriority {true};
+  // Pre-fault the stack, and lock the thread's buffers into memory
+  bool mLockMemory {true};
+  // Sleep until this long before each deadline, then spin; zero to only
+  // sleep, or at least the interval to only spin
+  Clock::duration mSpinBefore {DEFAULT_SPIN};
+};
+
+// What could actually be applied; e.g. real-time priority usually needs
+// extra privileges
+struct RealTimeStatus {
+  bool mPinned {false};
+  bool mRealTimePriority {false};
+  bool mMemoryLocked {false};
+};
+
+// Counting down from the highest-numbered core, which is usually the least
+// busy, e.g. as core 0 often handles more interrupts
+unsigned int GetRealTimeCore(std::size_t index);
+
+// e.g. "pinned, no priority, locked", for what was requested
+std::string FormatRealTimeStatus(
+  const RealTimeSettings&,
+  const RealTimeStatus&);
+
+/* Applies `RealTimeSettings` to the current thread until destroyed, for
+ * low-jitter sampling.
+ *
+ * Anything that can't be applied is skipped, and left out of the status;
+ * the thread's previous affinity and priority are restored on destruction,
+ * so this must be destroyed on the same thread.
+ */
+class RealTimeThread final {
+ public:
+  using Clock = RealTimeSettings::Clock;
+
+  // `buffer` is e.g. the thread's scratch space; it's locked if requested
+  explicit RealTimeThread(
+    const RealTimeSettings&,
+    std::span<std::byte> buffer = {});
+  ~RealTimeThread();
+
+  RealTimeThread() = delete;
+  RealTimeThread(const RealTimeThread&) = delete;
+  RealTimeThread(RealTimeThread&&) = delete;
+  RealTimeThread& operator=(const RealTimeThread&) = delete;
+  RealTimeThread& operator=(RealTimeThread&&) = delete;
+
+  RealTimeStatus GetStatus() const {
+    return mStatus;
+  }
+
+  // Sleeps, then spins for the last `mSpinBefore`
+  void WaitUntil(Clock::time_point deadline) const;
+
+ private:
+  // Platform-specific state to restore
+  struct Previous;
+
+  const RealTimeSettings mSettings;
+  RealTimeStatus mStatus;
+  std::unique_ptr<Previous> mPrevious;
+  std::span<std::byte> mLocked;
+
+  void Pin(unsigned int core);
+  void RaisePriority();
+  void LockMemory(std::span<std::byte> buffer);
+};
+
+/* How late a thread wakes up for a series of deadlines, e.g. to compare
+ * `RealTimeSettings` on the same machine.
+ *
+ * Percentiles and the maximum are in microseconds after each deadline; a
+ * deadline is missed if the next one was already due.
+ */
+struct JitterReport {
+  RealTimeStatus mStatus;
+  std::size_t mCount {};
+  std::size_t mMissed {};
+  float mP50 {};
+  float mP90 {};
+  float mP99 {};
+  float mP999 {};
+  float mMax {};
+};
+
+// Blocks for `duration`, waking every `interval` on a new thread;
+// `mEnabled` selects between `RealTimeThread` and a plain sleep
+JitterReport MeasureJitter(
+  const RealTimeSettings&,
+  RealTimeSettings::Clock::duration interval,
+  RealTimeSettings::Clock::duration duration);
+
+}// namespace FredEmmott::ControllerTester
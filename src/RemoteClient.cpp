@@ -0,0 +1,309 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "RemoteClient.hpp"
+
+#include <array>
+
+#include "Trace.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+namespace {
+
+constexpr std::chrono::seconds PING_INTERVAL {1};
+constexpr std::chrono::milliseconds POLL_INTERVAL {50};
+constexpr std::size_t RECEIVE_CHUNK_BYTES {64 * 1024};
+
+}// namespace
+
+RemoteClient::RemoteClient(const std::string& host, uint16_t port)
+  : mHost(host),
+    mPort(port),
+    mLatency(std::chrono::seconds {10}, 8192),
+    mThread([this](std::stop_token stop) { this->Run(stop); }) {
+}
+
+RemoteClient::~RemoteClient() = default;
+
+RemoteClient::Status RemoteClient::GetStatus() const {
+  std::unique_lock lock(mMutex);
+  return mStatus;
+}
+
+std::vector<RemoteClient::Device> RemoteClient::GetDevices() const {
+  std::unique_lock lock(mMutex);
+  std::vector<Device> ret;
+  ret.reserve(mDevices.size());
+  for (const auto& [id, device]: mDevices) {
+    ret.push_back({id, device.mInfo});
+  }
+  return ret;
+}
+
+uint64_t RemoteClient::GetDeviceGeneration() const {
+  std::unique_lock lock(mMutex);
+  return mDeviceGeneration;
+}
+
+std::optional<DeviceState> RemoteClient::GetState(
+  uint32_t id,
+  std::pmr::memory_resource* resource) const {
+  std::unique_lock lock(mMutex);
+  const auto it = mDevices.find(id);
+  if (it == mDevices.end() || !it->second.mState) {
+    return std::nullopt;
+  }
+  const auto& latest = *it->second.mState;
+  DeviceState ret {resource};
+  ret.mAxes.assign(latest.mAxes.begin(), latest.mAxes.end());
+  ret.mHats.assign(latest.mHats.begin(), latest.mHats.end());
+  ret.mButtons.assign(latest.mButtons.begin(), latest.mButtons.end());
+  return ret;
+}
+
+RemoteClient::Stats RemoteClient::GetStats(
+  std::pmr::memory_resource* resource) const {
+  std::unique_lock lock(mMutex);
+  return {
+    .mStatus = mStatus,
+    .mBytesReceived = mBytesReceived,
+    .mSamplesReceived = mSamplesReceived,
+    .mSamplesSummarized = mSamplesSummarized,
+    .mSummariesReceived = mSummariesReceived,
+    .mLatency = mLatency.GetSummary(resource),
+    .mRoundTrip = mRoundTrip,
+  };
+}
+
+int64_t RemoteClient::GetTime(Clock::time_point time) const {
+  return std::chrono::duration_cast<std::chrono::microseconds>(time - mEpoch)
+    .count();
+}
+
+void RemoteClient::Run(std::stop_token stop) {
+  Trace::SetThreadName("RemoteClient");
+
+  mSocket = Socket::Connect(mHost, mPort, stop);
+  if (!mSocket.IsValid()) {
+    std::unique_lock lock(mMutex);
+    mStatus = Status::Disconnected;
+    return;
+  }
+
+  auto nextPing = Clock::now();
+  while (!stop.stop_requested()) {
+    if (mHello && Clock::now() >= nextPing) {
+      this->SendPing();
+      nextPing += PING_INTERVAL;
+    }
+    while (!mPending.empty()) {
+      // Failures are reported by `Receive()`
+      const auto sent = mSocket.Send(mPending);
+      if (!(sent && *sent > 0)) {
+        break;
+      }
+      mPending.erase(mPending.begin(), mPending.begin() + *sent);
+    }
+
+    std::array requests {Socket::PollRequest {
+      .mSocket = &mSocket,
+      .mWantWrite = !mPending.empty(),
+    }};
+    Socket::Poll(requests, POLL_INTERVAL);
+    if (requests.front().mReadable && !this->Receive()) {
+      break;
+    }
+  }
+
+  mSocket = {};
+  std::unique_lock lock(mMutex);
+  mStatus = Status::Disconnected;
+  for (auto& [id, device]: mDevices) {
+    device.mState = std::nullopt;
+  }
+}
+
+void RemoteClient::SendPing() {
+  RemoteMessageWriter writer {mPending, RemoteMessageType::Ping};
+  writer.WriteSignedVarint(this->GetTime(Clock::now()));
+}
+
+bool RemoteClient::Receive() {
+  while (true) {
+    const auto buffer = mReceived.GetWritableSpace(RECEIVE_CHUNK_BYTES);
+    const auto received = mSocket.Receive(buffer);
+    if (!received) {
+      return false;
+    }
+    if (*received == 0) {
+      break;
+    }
+    mReceived.Commit(*received);
+    std::unique_lock lock(mMutex);
+    mBytesReceived += *received;
+  }
+
+  while (const auto message = mReceived.Next()) {
+    if (!this->HandleMessage(*message)) {
+      return false;
+    }
+  }
+  return !mReceived.IsCorrupt();
+}
+
+bool RemoteClient::HandleMessage(const RemoteMessage& message) {
+  if (!mHello) {
+    if (
+      message.mType != RemoteMessageType::Hello
+      || !ReadRemoteHello(message.mBody)) {
+      return false;
+    }
+    mHello = true;
+    std::unique_lock lock(mMutex);
+    mStatus = Status::Connected;
+    return true;
+  }
+
+  switch (message.mType) {
+    case RemoteMessageType::DeviceAdded:
+      return this->HandleDeviceAdded(message.mBody);
+    case RemoteMessageType::DeviceRemoved:
+      return this->HandleDeviceRemoved(message.mBody);
+    case RemoteMessageType::Samples:
+      return this->HandleSamples(message.mBody);
+    case RemoteMessageType::Summary:
+      return this->HandleSummary(message.mBody);
+    case RemoteMessageType::Pong:
+      return this->HandlePong(message.mBody);
+    default:
+      // Ignore types from newer servers
+      return true;
+  }
+}
+
+bool RemoteClient::HandleDeviceAdded(std::span<const std::byte> body) {
+  uint32_t id {};
+  auto info = ReadRemoteDeviceAdded(body, id);
+  if (!info) {
+    return false;
+  }
+
+  DeviceState reference;
+  reference.Resize(
+    info->mAxes.size(), info->mHats.size(), info->mButtons.size());
+  mReferences.insert_or_assign(id, std::move(reference));
+
+  std::unique_lock lock(mMutex);
+  mDevices.insert_or_assign(
+    id,
+    DeviceEntry {
+      .mInfo = std::move(*info),
+      .mState = std::nullopt,
+    });
+  ++mDeviceGeneration;
+  return true;
+}
+
+bool RemoteClient::HandleDeviceRemoved(std::span<const std::byte> body) {
+  RemoteMessageReader reader {body};
+  const auto id = reader.ReadU32();
+  if (!reader.IsValid()) {
+    return false;
+  }
+  mReferences.erase(id);
+
+  std::unique_lock lock(mMutex);
+  mDevices.erase(id);
+  ++mDeviceGeneration;
+  return true;
+}
+
+bool RemoteClient::HandleSamples(std::span<const std::byte> body) {
+  const auto now = Clock::now();
+  RemoteMessageReader reader {body};
+  const auto id = reader.ReadU32();
+  const auto reference = mReferences.find(id);
+  if (!reader.IsValid() || reference == mReferences.end()) {
+    return false;
+  }
+
+  mDecoded = reference->second;
+  int64_t time {};
+  std::unique_lock lock(mMutex);
+  uint64_t count {};
+  while (!reader.IsAtEnd()) {
+    time += reader.ReadSignedVarint();
+    reader.ReadStateDelta(mDecoded);
+    if (!reader.IsValid()) {
+      return false;
+    }
+    this->PushLatency(time, now);
+    ++count;
+  }
+  mSamplesReceived += count;
+  if (count > 0) {
+    mDevices.at(id).mState = mDecoded;
+  }
+  return true;
+}
+
+bool RemoteClient::HandleSummary(std::span<const std::byte> body) {
+  const auto now = Clock::now();
+  RemoteMessageReader reader {body};
+  const auto id = reader.ReadU32();
+  const auto reference = mReferences.find(id);
+  if (!reader.IsValid() || reference == mReferences.end()) {
+    return false;
+  }
+
+  mDecoded = reference->second;
+  const auto count = reader.ReadVarint();
+  const auto time = reader.ReadSignedVarint();
+  reader.ReadStateDelta(mDecoded);
+  // Each axis's range; not shown yet, but validated
+  for (std::size_t i = 0; i < mDecoded.mAxes.size() * 2; ++i) {
+    reader.ReadSignedVarint();
+  }
+  if (!(reader.IsValid() && reader.IsAtEnd())) {
+    return false;
+  }
+
+  std::unique_lock lock(mMutex);
+  this->PushLatency(time, now);
+  mSamplesSummarized += count;
+  ++mSummariesReceived;
+  mDevices.at(id).mState = mDecoded;
+  return true;
+}
+
+bool RemoteClient::HandlePong(std::span<const std::byte> body) {
+  const auto now = this->GetTime(Clock::now());
+  RemoteMessageReader reader {body};
+  const auto sent = reader.ReadSignedVarint();
+  const auto serverTime = reader.ReadSignedVarint();
+  if (!reader.IsValid() || sent > now) {
+    return false;
+  }
+
+  const std::chrono::microseconds roundTrip {now - sent};
+  std::unique_lock lock(mMutex);
+  if (mRoundTrip && roundTrip > *mRoundTrip) {
+    return true;
+  }
+  // Assume the server replied halfway through the round trip
+  mRoundTrip = roundTrip;
+  mClockOffset = serverTime - (sent + (roundTrip.count() / 2));
+  return true;
+}
+
+void RemoteClient::PushLatency(int64_t serverTime, Clock::time_point now) {
+  if (!mClockOffset) {
+    return;
+  }
+  const auto localTime = serverTime - *mClockOffset;
+  mLatency.Push(
+    static_cast<float>(this->GetTime(now) - localTime) / 1000.0f, now);
+}
+
+}// namespace FredEmmott::ControllerTester
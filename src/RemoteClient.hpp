@@ -0,0 +1,140 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DeviceInfo.hpp"
+#include "DeviceState.hpp"
+#include "PerformanceMetrics.hpp"
+#include "RemoteProtocol.hpp"
+#include "Socket.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+/* Receives devices and samples from a `RemoteServer`.
+ *
+ * Connects and decodes on its own thread; everything else only reads the
+ * decoded results, so it can be called from the GUI thread or `Sampler`s.
+ *
+ * The server's clock is estimated from the ping with the lowest round-trip
+ * time, so that end-to-end latency - from the server's sample time to when
+ * the sample is decoded here - can be measured across machines.
+ */
+class RemoteClient final {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  RemoteClient(const std::string& host, uint16_t port);
+  ~RemoteClient();
+
+  RemoteClient() = delete;
+  RemoteClient(const RemoteClient&) = delete;
+  RemoteClient(RemoteClient&&) = delete;
+  RemoteClient& operator=(const RemoteClient&) = delete;
+  RemoteClient& operator=(RemoteClient&&) = delete;
+
+  enum class Status {
+    Connecting,
+    Connected,
+    Disconnected,
+  };
+  Status GetStatus() const;
+
+  struct Device {
+    uint32_t mID {};
+    DeviceInfo mInfo;
+  };
+  std::vector<Device> GetDevices() const;
+  // Changes whenever a device is added or removed
+  uint64_t GetDeviceGeneration() const;
+
+  // The latest state; nullopt if there isn't one yet, or the device was
+  // removed
+  std::optional<DeviceState> GetState(
+    uint32_t id,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+    const;
+
+  struct Stats {
+    Status mStatus {};
+    uint64_t mBytesReceived {};
+    uint64_t mSamplesReceived {};
+    // Samples the server replaced with summaries, as the connection couldn't
+    // keep up
+    uint64_t mSamplesSummarized {};
+    uint64_t mSummariesReceived {};
+    // Milliseconds from when the server sampled to when the sample was
+    // decoded, including batching
+    RollingSamples::Summary mLatency;
+    // Of the ping used for the clock estimate; nullopt until the first pong
+    std::optional<std::chrono::microseconds> mRoundTrip;
+  };
+  // The resource is only used for scratch space
+  Stats GetStats(
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+    const;
+
+ private:
+  struct DeviceEntry {
+    DeviceInfo mInfo;
+    std::optional<DeviceState> mState;
+  };
+
+  const Clock::time_point mEpoch {Clock::now()};
+  const std::string mHost;
+  const uint16_t mPort;
+
+  mutable std::mutex mMutex;
+  // Protected by `mMutex`
+  Status mStatus {Status::Connecting};
+  std::map<uint32_t, DeviceEntry> mDevices;
+  uint64_t mDeviceGeneration {};
+  RollingSamples mLatency;
+  uint64_t mBytesReceived {};
+  uint64_t mSamplesReceived {};
+  uint64_t mSamplesSummarized {};
+  uint64_t mSummariesReceived {};
+  std::optional<std::chrono::microseconds> mRoundTrip;
+
+  // Only used on the worker thread
+  Socket mSocket;
+  RemoteMessageBuffer mReceived;
+  std::vector<std::byte> mPending;
+  bool mHello {false};
+  // Control counts for decoding, and the state each batch starts from
+  std::map<uint32_t, DeviceState> mReferences;
+  DeviceState mDecoded;
+  // Server time minus our time, in microseconds
+  std::optional<int64_t> mClockOffset;
+
+  // Last, so that it's stopped before anything it uses is destroyed
+  std::jthread mThread;
+
+  int64_t GetTime(Clock::time_point) const;
+
+  void Run(std::stop_token);
+  void SendPing();
+  // False if the stream is invalid
+  bool Receive();
+  bool HandleMessage(const RemoteMessage&);
+  bool HandleDeviceAdded(std::span<const std::byte> body);
+  bool HandleDeviceRemoved(std::span<const std::byte> body);
+  bool HandleSamples(std::span<const std::byte> body);
+  bool HandleSummary(std::span<const std::byte> body);
+  bool HandlePong(std::span<const std::byte> body);
+  // `serverTime` is microseconds since the server's epoch; call with
+  // `mMutex` held
+  void PushLatency(int64_t serverTime, Clock::time_point now);
+};
+
+}// namespace FredEmmott::ControllerTester
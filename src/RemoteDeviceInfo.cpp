@@ -0,0 +1,31 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#include "RemoteDeviceInfo.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+RemoteDeviceInfo::RemoteDeviceInfo(
+  const std::shared_ptr<RemoteClient>& client,
+  uint32_t id,
+  const DeviceInfo& remote)
+  : DeviceInfo(remote), mClient(client), mID(id) {
+  mName += " (remote)";
+  // The viewer can be on the same machine, e.g. over loopback; keep results,
+  // captures, and shared feeds separate from the local device's, by XORing
+  // with 'REMT'
+  mGuid.mData1 ^= 0x52454d54;
+}
+
+RemoteDeviceInfo::~RemoteDeviceInfo() {
+}
+
+bool RemoteDeviceInfo::Poll() {
+  return mClient->GetStatus() == RemoteClient::Status::Connected;
+}
+
+std::optional<DeviceState> RemoteDeviceInfo::GetState(
+  std::pmr::memory_resource* resource) {
+  return mClient->GetState(mID, resource);
+}
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,40 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "DeviceInfo.hpp"
+#include "RemoteClient.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+/* A device on another machine, from a `RemoteServer`.
+ *
+ * States are the latest that the `RemoteClient` has decoded, so polling
+ * this faster than the server's batch interval shows the same state
+ * several times.
+ */
+struct RemoteDeviceInfo final : public DeviceInfo {
+  RemoteDeviceInfo(
+    const std::shared_ptr<RemoteClient>& client,
+    uint32_t id,
+    const DeviceInfo& remote);
+  ~RemoteDeviceInfo();
+
+  RemoteDeviceInfo() = delete;
+  RemoteDeviceInfo(const RemoteDeviceInfo&) = delete;
+  RemoteDeviceInfo(RemoteDeviceInfo&&) = default;
+
+  RemoteDeviceInfo& operator=(const RemoteDeviceInfo&) = delete;
+  RemoteDeviceInfo& operator=(RemoteDeviceInfo&&) = default;
+
+  bool Poll();
+  std::optional<DeviceState> GetState(std::pmr::memory_resource*);
+
+  std::shared_ptr<RemoteClient> mClient;
+  uint32_t mID {};
+};
+
+}// namespace FredEmmott::ControllerTester
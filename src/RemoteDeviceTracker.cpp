@@ -0,0 +1,79 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "RemoteDeviceTracker.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <mutex>
+#include <utility>
+
+namespace FredEmmott::ControllerTester {
+
+RemoteDeviceKey RemoteDeviceTracker::GetKey(const RemoteDeviceKey& key) {
+  return key;
+}
+
+RemoteDeviceKey RemoteDeviceTracker::GetKey(const RemoteDeviceInfo& info) {
+  return {info.mClient.get(), info.mID};
+}
+
+void RemoteDeviceTracker::Connect(const std::string& host, uint16_t port) {
+  auto client = std::make_shared<RemoteClient>(host, port);
+  {
+    std::unique_lock lock(mEnumerationMutex);
+    std::swap(mClient, client);
+  }
+  mDeviceGeneration = 0;
+  this->MarkStale();
+}
+
+void RemoteDeviceTracker::Disconnect() {
+  // Devices that are still open, e.g. by a `Sampler`, keep the connection
+  // until they're closed
+  std::shared_ptr<RemoteClient> client;
+  {
+    std::unique_lock lock(mEnumerationMutex);
+    std::swap(mClient, client);
+  }
+  this->MarkStale();
+}
+
+RemoteClient* RemoteDeviceTracker::GetClient() const {
+  return mClient.get();
+}
+
+void RemoteDeviceTracker::Update() {
+  if (!mClient) {
+    return;
+  }
+  const auto generation = mClient->GetDeviceGeneration();
+  if (generation != mDeviceGeneration) {
+    mDeviceGeneration = generation;
+    this->MarkStale();
+  }
+}
+
+std::vector<RemoteDeviceKey> RemoteDeviceTracker::Enumerate() {
+  mEnumerated.clear();
+  if (mClient) {
+    mEnumerated = mClient->GetDevices();
+  }
+
+  std::vector<RemoteDeviceKey> ret;
+  ret.reserve(mEnumerated.size());
+  for (const auto& device: mEnumerated) {
+    ret.emplace_back(mClient.get(), device.mID);
+  }
+  return ret;
+}
+
+RemoteDeviceInfo RemoteDeviceTracker::CreateInfo(const RemoteDeviceKey& key) {
+  assert(key.first == mClient.get());
+  const auto it = std::ranges::find(
+    mEnumerated, key.second, &RemoteClient::Device::mID);
+  assert(it != mEnumerated.end());
+  return {mClient, it->mID, it->mInfo};
+}
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,58 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "DeviceTracker.hpp"
+#include "RemoteClient.hpp"
+#include "RemoteDeviceInfo.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+// Identifies a device from a specific connection, as servers reuse IDs
+using RemoteDeviceKey = std::pair<const RemoteClient*, uint32_t>;
+
+/* The devices from a `RemoteServer`, if connected to one.
+ *
+ * They're shown and tested like local devices.
+ */
+class RemoteDeviceTracker final : public DeviceTracker<
+                                    RemoteDeviceTracker,
+                                    RemoteDeviceInfo,
+                                    RemoteDeviceKey,
+                                    RemoteDeviceKey> {
+ public:
+  virtual ~RemoteDeviceTracker() = default;
+
+  // Device IDs are only meaningful for one connection
+  static constexpr bool RETAIN_COVERAGE {false};
+
+  static RemoteDeviceKey GetKey(const RemoteDeviceKey&);
+  static RemoteDeviceKey GetKey(const RemoteDeviceInfo&);
+
+  // Replaces any existing connection; the new one is made in the background
+  void Connect(const std::string& host, uint16_t port);
+  void Disconnect();
+  // Nullptr if not connected or connecting
+  RemoteClient* GetClient() const;
+
+  // Call regularly, e.g. once per frame, to pick up devices that the server
+  // added or removed
+  void Update();
+
+ protected:
+  virtual std::vector<RemoteDeviceKey> Enumerate() override;
+  virtual RemoteDeviceInfo CreateInfo(const RemoteDeviceKey&) override;
+
+ private:
+  std::shared_ptr<RemoteClient> mClient;
+  uint64_t mDeviceGeneration {};
+  // From the last `Enumerate()`, for `CreateInfo()`
+  std::vector<RemoteClient::Device> mEnumerated;
+};
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,207 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "RemoteGUI.hpp"
+
+#include <imgui.h>
+
+#include "Config.hpp"
+#include "Trace.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+namespace {
+
+constexpr float KIBIBYTE {1024.0f};
+
+const char* GetStatusText(RemoteClient::Status status) {
+  switch (status) {
+    case RemoteClient::Status::Connecting:
+      return "Connecting...";
+    case RemoteClient::Status::Connected:
+      return "Connected";
+    case RemoteClient::Status::Disconnected:
+      return "Disconnected";
+  }
+  return "?";
+}
+
+}// namespace
+
+void RemoteGUI::Rate::Update(uint64_t count) {
+  const auto now = std::chrono::steady_clock::now();
+  if (mSince == std::chrono::steady_clock::time_point {} || count < mCount) {
+    mSince = now;
+    mCount = count;
+    mPerSecond = 0;
+    return;
+  }
+  const auto elapsed = std::chrono::duration<double>(now - mSince).count();
+  if (elapsed < 1) {
+    return;
+  }
+  mPerSecond = static_cast<double>(count - mCount) / elapsed;
+  mSince = now;
+  mCount = count;
+}
+
+RemoteGUI::RemoteGUI(FrameArena& frameArena) : mFrameArena(frameArena) {
+}
+
+void RemoteGUI::GUITab(RemoteDeviceTracker& tracker) {
+  if (!ImGui::BeginTabItem("Remote")) {
+    return;
+  }
+  const Trace::Zone traceZone {"RemoteGUI::GUITab"};
+
+  ImGui::TextWrapped(
+    "Test devices that are plugged into another computer, e.g. a test rig: "
+    "share them from the instance on that computer, then connect to it "
+    "here. Its devices are shown as extra tabs.");
+
+  ImGui::SeparatorText("Share this computer's devices");
+  this->GUIServer();
+  ImGui::SeparatorText("View another computer's devices");
+  this->GUIClient(tracker);
+
+  if (!mError.empty()) {
+    ImGui::TextColored(Config::WARNING_COLOR, "%s", mError.c_str());
+  }
+  ImGui::EndTabItem();
+}
+
+void RemoteGUI::GUIServer() {
+  if (!mServer) {
+    ImGui::InputScalar(
+      "Port##Server", ImGuiDataType_U16, &mServerSettings.mPort);
+    ImGui::SliderFloat(
+      "Fastest poll interval (ms)", &mFastestPollMS, 0.25f, 20.0f, "%.2f");
+    if (ImGui::IsItemHovered()) {
+      ImGui::SetTooltip(
+        "Each device is polled twice as often as it updates, down to this "
+        "interval; idle devices are polled less often.");
+    }
+    ImGui::SliderInt("Batch interval (ms)", &mBatchIntervalMS, 1, 100);
+    if (ImGui::IsItemHovered()) {
+      ImGui::SetTooltip(
+        "Samples are sent in batches; longer intervals use less bandwidth, "
+        "but add up to this much latency.");
+    }
+    ImGui::Checkbox(
+      "Only allow viewers on this computer", &mServerSettings.mLoopbackOnly);
+    if (ImGui::Button("Start sharing")) {
+      this->StartServer();
+    }
+    return;
+  }
+
+  const auto stats = mServer->GetStats();
+  mServerBytes.Update(stats.mBytesSent);
+  mServerSamples.Update(stats.mSamplesSent);
+  mServerPolls.Update(mPublisher->GetScheduler().GetPollCount());
+  ImGui::Text(
+    "Sharing %zu devices on port %u with %zu viewers",
+    mPublisher->GetDeviceCount(),
+    static_cast<unsigned int>(mServer->GetPort()),
+    stats.mClientCount);
+  ImGui::Text(
+    "%.0f polls/s, %.0f changes/s, %.1f KiB/s",
+    mServerPolls.mPerSecond,
+    mServerSamples.mPerSecond,
+    mServerBytes.mPerSecond / KIBIBYTE);
+  if (stats.mSummarizedClientCount) {
+    ImGui::TextColored(
+      Config::WARNING_COLOR,
+      "%zu viewers can't keep up, and are getting summaries instead of "
+      "every sample",
+      stats.mSummarizedClientCount);
+  }
+  if (stats.mSamplesLost) {
+    ImGui::TextColored(
+      Config::WARNING_COLOR,
+      "%llu samples were lost; the system may be overloaded",
+      static_cast<unsigned long long>(stats.mSamplesLost));
+  }
+  if (ImGui::Button("Stop sharing")) {
+    this->StopServer();
+  }
+}
+
+void RemoteGUI::GUIClient(RemoteDeviceTracker& tracker) {
+  const auto client = tracker.GetClient();
+  if (!client) {
+    ImGui::InputText("Computer", mHost.data(), mHost.size());
+    ImGui::InputScalar("Port##Client", ImGuiDataType_U16, &mPort);
+    ImGui::BeginDisabled(mHost.front() == '\0');
+    if (ImGui::Button("Connect")) {
+      mClientBytes = {};
+      mClientSamples = {};
+      mClientSummarized = {};
+      tracker.Connect(mHost.data(), mPort);
+    }
+    ImGui::EndDisabled();
+    return;
+  }
+
+  const auto stats = client->GetStats(&mFrameArena);
+  mClientBytes.Update(stats.mBytesReceived);
+  mClientSamples.Update(stats.mSamplesReceived);
+  mClientSummarized.Update(stats.mSamplesSummarized);
+  ImGui::Text("%s: %s", mHost.data(), GetStatusText(stats.mStatus));
+  ImGui::Text(
+    "%.0f samples/s, %.1f KiB/s",
+    mClientSamples.mPerSecond,
+    mClientBytes.mPerSecond / KIBIBYTE);
+  if (stats.mLatency.mCount) {
+    ImGui::Text(
+      "Latency: %.1f ms median, %.1f ms p99, %.1f ms max",
+      stats.mLatency.mP50,
+      stats.mLatency.mP99,
+      stats.mLatency.mMax);
+    if (ImGui::IsItemHovered()) {
+      ImGui::SetTooltip(
+        "From when the other computer read the device, to when it was "
+        "received here, including batching. Clocks are synchronized to "
+        "within half of the %.1f ms round-trip time.",
+        stats.mRoundTrip ? stats.mRoundTrip->count() / 1000.0f : 0.0f);
+    }
+  }
+  if (mClientSummarized.mPerSecond > 0) {
+    ImGui::TextColored(
+      Config::WARNING_COLOR,
+      "The connection can't keep up; only showing the latest state of each "
+      "device.");
+  }
+  if (ImGui::Button("Disconnect")) {
+    tracker.Disconnect();
+  }
+}
+
+void RemoteGUI::StartServer() {
+  mServerSettings.mBatchInterval
+    = std::chrono::milliseconds {mBatchIntervalMS};
+  auto server = std::make_unique<RemoteServer>(mServerSettings);
+  if (!server->IsListening()) {
+    mError = "Couldn't listen on the port; it may already be in use.";
+    return;
+  }
+  mError.clear();
+  mServerBytes = {};
+  mServerSamples = {};
+  mServerPolls = {};
+  mServer = std::move(server);
+  mPublisher = std::make_unique<RemotePublisher>(
+    *mServer,
+    PollSchedulerSettings {
+      .mMinInterval
+      = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<float, std::milli> {mFastestPollMS}),
+    });
+}
+
+void RemoteGUI::StopServer() {
+  mPublisher.reset();
+  mServer.reset();
+}
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,76 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "FrameArena.hpp"
+#include "RemoteDeviceTracker.hpp"
+#include "RemotePublisher.hpp"
+#include "RemoteServer.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+/* The 'Remote' tab.
+ *
+ * Either streams this machine's devices to other instances, e.g. on a test
+ * rig, or shows the devices of another instance, as if they were local.
+ */
+class RemoteGUI final {
+ public:
+  explicit RemoteGUI(FrameArena&);
+
+  // Call every frame, whether or not the tab is visible
+  template <class TDeviceSet>
+  void Update(TDeviceSet& devices) {
+    devices.template GetTracker<RemoteDeviceTracker>().Update();
+    if (mPublisher) {
+      mPublisher->Update(devices);
+    }
+  }
+
+  void GUITab(RemoteDeviceTracker&);
+
+ private:
+  void GUIServer();
+  void GUIClient(RemoteDeviceTracker&);
+  void StartServer();
+  void StopServer();
+
+  // For per-second rates
+  struct Rate {
+    std::chrono::steady_clock::time_point mSince {};
+    uint64_t mCount {};
+    double mPerSecond {};
+
+    void Update(uint64_t count);
+  };
+
+  FrameArena& mFrameArena;
+
+  RemoteServerSettings mServerSettings;
+  int mBatchIntervalMS {5};
+  float mFastestPollMS {1.0f};
+  std::unique_ptr<RemoteServer> mServer;
+  // Declared after the server, so it's stopped first
+  std::unique_ptr<RemotePublisher> mPublisher;
+  Rate mServerBytes;
+  Rate mServerSamples;
+  Rate mServerPolls;
+
+  std::array<char, 256> mHost {"localhost"};
+  uint16_t mPort {DEFAULT_REMOTE_PORT};
+  Rate mClientBytes;
+  Rate mClientSamples;
+  Rate mClientSummarized;
+
+  std::string mError;
+};
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,341 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "RemoteProtocol.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstring>
+#include <string>
+
+#include "SerializedControls.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+// Integers are copied as-is
+static_assert(std::endian::native == std::endian::little);
+
+namespace {
+
+// Bounds the size of device descriptions from a corrupt or hostile stream;
+// DirectInput allows far fewer
+constexpr uint32_t MAX_CONTROLS {4096};
+
+constexpr uint64_t ZigZag(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1)
+    ^ static_cast<uint64_t>(value >> 63);
+}
+
+constexpr int64_t UnZigZag(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+/* Calls `f(index, change)` for each value that differs, in index order.
+ *
+ * Changes are already encoded, as signed changes are zigzagged.
+ */
+template <class F>
+void ForEachChange(
+  const DeviceState& previous,
+  const DeviceState& current,
+  F&& f) {
+  std::size_t index {};
+  for (std::size_t i = 0; i < current.mAxes.size(); ++i, ++index) {
+    if (current.mAxes[i] != previous.mAxes[i]) {
+      f(index,
+        ZigZag(static_cast<int64_t>(current.mAxes[i]) - previous.mAxes[i]));
+    }
+  }
+  for (std::size_t i = 0; i < current.mHats.size(); ++i, ++index) {
+    if (current.mHats[i] != previous.mHats[i]) {
+      f(index,
+        ZigZag(static_cast<int64_t>(current.mHats[i]) - previous.mHats[i]));
+    }
+  }
+  for (std::size_t i = 0; i < current.mButtons.size(); ++i, ++index) {
+    if (current.mButtons[i] != previous.mButtons[i]) {
+      f(index, current.mButtons[i] ^ previous.mButtons[i]);
+    }
+  }
+}
+
+}// namespace
+
+RemoteMessageWriter::RemoteMessageWriter(
+  std::vector<std::byte>& out,
+  RemoteMessageType type)
+  : mOut(out), mStart(out.size()) {
+  mOut.resize(mStart + REMOTE_MESSAGE_HEADER_SIZE);
+  mOut[mStart + sizeof(uint32_t)] = static_cast<std::byte>(type);
+}
+
+RemoteMessageWriter::~RemoteMessageWriter() {
+  const auto size
+    = static_cast<uint32_t>(mOut.size() - mStart - sizeof(uint32_t));
+  std::memcpy(mOut.data() + mStart, &size, sizeof(size));
+}
+
+void RemoteMessageWriter::WriteU32(uint32_t value) {
+  this->WriteBytes(std::as_bytes(std::span {&value, 1}));
+}
+
+void RemoteMessageWriter::WriteGuid(const Guid& value) {
+  this->WriteBytes(std::as_bytes(std::span {&value, 1}));
+}
+
+void RemoteMessageWriter::WriteBytes(std::span<const std::byte> bytes) {
+  mOut.insert(mOut.end(), bytes.begin(), bytes.end());
+}
+
+void RemoteMessageWriter::WriteVarint(uint64_t value) {
+  while (value >= 0x80) {
+    mOut.push_back(static_cast<std::byte>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  mOut.push_back(static_cast<std::byte>(value));
+}
+
+void RemoteMessageWriter::WriteSignedVarint(int64_t value) {
+  this->WriteVarint(ZigZag(value));
+}
+
+void RemoteMessageWriter::WriteStateDelta(
+  const DeviceState& previous,
+  const DeviceState& current) {
+  assert(previous.mAxes.size() == current.mAxes.size());
+  assert(previous.mHats.size() == current.mHats.size());
+  assert(previous.mButtons.size() == current.mButtons.size());
+
+  std::size_t count {};
+  ForEachChange(previous, current, [&count](auto, auto) { ++count; });
+  this->WriteVarint(count);
+
+  std::size_t next {};
+  ForEachChange(
+    previous, current, [this, &next](std::size_t index, uint64_t change) {
+      this->WriteVarint(index - next);
+      this->WriteVarint(change);
+      next = index + 1;
+    });
+}
+
+RemoteMessageReader::RemoteMessageReader(std::span<const std::byte> body)
+  : mBody(body) {
+}
+
+bool RemoteMessageReader::IsValid() const {
+  return mValid;
+}
+
+bool RemoteMessageReader::IsAtEnd() const {
+  return mOffset == mBody.size();
+}
+
+uint32_t RemoteMessageReader::ReadU32() {
+  uint32_t ret {};
+  const auto bytes = this->ReadBytes(sizeof(ret));
+  if (!bytes.empty()) {
+    std::memcpy(&ret, bytes.data(), sizeof(ret));
+  }
+  return ret;
+}
+
+Guid RemoteMessageReader::ReadGuid() {
+  Guid ret;
+  const auto bytes = this->ReadBytes(sizeof(ret));
+  if (!bytes.empty()) {
+    std::memcpy(&ret, bytes.data(), sizeof(ret));
+  }
+  return ret;
+}
+
+std::span<const std::byte> RemoteMessageReader::ReadBytes(std::size_t count) {
+  if (!mValid || count > mBody.size() - mOffset) {
+    mValid = false;
+    return {};
+  }
+  const auto ret = mBody.subspan(mOffset, count);
+  mOffset += count;
+  return ret;
+}
+
+uint64_t RemoteMessageReader::ReadVarint() {
+  uint64_t ret {};
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (!mValid || mOffset >= mBody.size()) {
+      mValid = false;
+      return 0;
+    }
+    const auto byte = static_cast<uint8_t>(mBody[mOffset++]);
+    ret |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return ret;
+    }
+  }
+  // Too long to be a 64-bit value
+  mValid = false;
+  return 0;
+}
+
+int64_t RemoteMessageReader::ReadSignedVarint() {
+  return UnZigZag(this->ReadVarint());
+}
+
+void RemoteMessageReader::ReadStateDelta(DeviceState& state) {
+  const auto axisCount = state.mAxes.size();
+  const auto hatCount = state.mHats.size();
+  const auto valueCount = axisCount + hatCount + state.mButtons.size();
+
+  const auto count = this->ReadVarint();
+  if (count > valueCount) {
+    mValid = false;
+    return;
+  }
+  std::size_t next {};
+  for (uint64_t i = 0; i < count && mValid; ++i) {
+    const auto gap = this->ReadVarint();
+    const auto change = this->ReadVarint();
+    if (gap >= valueCount - next) {
+      mValid = false;
+      return;
+    }
+    const auto index = next + static_cast<std::size_t>(gap);
+    next = index + 1;
+
+    if (index < axisCount) {
+      auto& value = state.mAxes[index];
+      value = static_cast<int32_t>(value + UnZigZag(change));
+    } else if (index < axisCount + hatCount) {
+      auto& value = state.mHats[index - axisCount];
+      value = static_cast<int32_t>(value + UnZigZag(change));
+    } else {
+      state.mButtons[index - axisCount - hatCount] ^= change;
+    }
+  }
+}
+
+void WriteRemoteHello(std::vector<std::byte>& out) {
+  RemoteMessageWriter writer {out, RemoteMessageType::Hello};
+  writer.WriteBytes(std::as_bytes(std::span {REMOTE_MAGIC}));
+  writer.WriteU32(REMOTE_VERSION);
+}
+
+bool ReadRemoteHello(std::span<const std::byte> body) {
+  RemoteMessageReader reader {body};
+  const auto magic = reader.ReadBytes(REMOTE_MAGIC.size());
+  const auto version = reader.ReadU32();
+  return reader.IsValid()
+    && std::ranges::equal(magic, std::as_bytes(std::span {REMOTE_MAGIC}))
+    && version == REMOTE_VERSION;
+}
+
+void WriteRemoteDeviceAdded(
+  std::vector<std::byte>& out,
+  uint32_t id,
+  const DeviceInfo& device) {
+  const auto controls = SerializeControls(device);
+  RemoteMessageWriter writer {out, RemoteMessageType::DeviceAdded};
+  writer.WriteU32(id);
+  writer.WriteGuid(device.mGuid);
+  writer.WriteGuid(device.mProduct);
+  writer.WriteU32(static_cast<uint32_t>(device.mAxes.size()));
+  writer.WriteU32(static_cast<uint32_t>(device.mButtons.size()));
+  writer.WriteU32(static_cast<uint32_t>(device.mHats.size()));
+  writer.WriteU32(static_cast<uint32_t>(device.mName.size()));
+  writer.WriteU32(static_cast<uint32_t>(controls.mStrings.size()));
+  writer.WriteBytes(std::as_bytes(std::span {controls.mRecords}));
+  writer.WriteBytes(std::as_bytes(std::span {device.mName}));
+  writer.WriteBytes(std::as_bytes(std::span {controls.mStrings}));
+}
+
+std::optional<DeviceInfo> ReadRemoteDeviceAdded(
+  std::span<const std::byte> body,
+  uint32_t& id) {
+  RemoteMessageReader reader {body};
+  id = reader.ReadU32();
+  DeviceInfo ret;
+  ret.mGuid = reader.ReadGuid();
+  ret.mProduct = reader.ReadGuid();
+  const auto axisCount = reader.ReadU32();
+  const auto buttonCount = reader.ReadU32();
+  const auto hatCount = reader.ReadU32();
+  const auto nameBytes = reader.ReadU32();
+  const auto stringBytes = reader.ReadU32();
+  if (
+    !reader.IsValid() || axisCount > MAX_CONTROLS
+    || buttonCount > MAX_CONTROLS || hatCount > MAX_CONTROLS) {
+    return std::nullopt;
+  }
+
+  const auto records = reader.ReadBytes(
+    (axisCount + buttonCount + hatCount) * sizeof(SerializedControl));
+  const auto name = reader.ReadBytes(nameBytes);
+  const auto strings = reader.ReadBytes(stringBytes);
+  if (!(reader.IsValid() && reader.IsAtEnd())) {
+    return std::nullopt;
+  }
+  if (!DeserializeControls(
+        records,
+        {reinterpret_cast<const char*>(strings.data()), strings.size()},
+        axisCount,
+        buttonCount,
+        hatCount,
+        ret)) {
+    return std::nullopt;
+  }
+  ret.mName.assign(reinterpret_cast<const char*>(name.data()), name.size());
+  return ret;
+}
+
+std::span<std::byte> RemoteMessageBuffer::GetWritableSpace(
+  std::size_t minimum) {
+  if (mBuffer.size() - mEnd < minimum) {
+    // Move what's left of the current message to the front first
+    std::copy(
+      mBuffer.begin() + mBegin, mBuffer.begin() + mEnd, mBuffer.begin());
+    mEnd -= mBegin;
+    mBegin = 0;
+    if (mBuffer.size() - mEnd < minimum) {
+      mBuffer.resize(std::max(mEnd + minimum, mBuffer.size() * 2));
+    }
+  }
+  return std::span {mBuffer}.subspan(mEnd);
+}
+
+void RemoteMessageBuffer::Commit(std::size_t count) {
+  assert(count <= mBuffer.size() - mEnd);
+  mEnd += count;
+}
+
+std::optional<RemoteMessage> RemoteMessageBuffer::Next() {
+  if (mCorrupt || mEnd - mBegin < REMOTE_MESSAGE_HEADER_SIZE) {
+    return std::nullopt;
+  }
+  uint32_t size {};
+  std::memcpy(&size, mBuffer.data() + mBegin, sizeof(size));
+  if (size == 0 || size > MAX_REMOTE_MESSAGE_SIZE) {
+    mCorrupt = true;
+    return std::nullopt;
+  }
+  if (mEnd - mBegin < sizeof(size) + size) {
+    return std::nullopt;
+  }
+
+  const auto message = std::span {mBuffer}.subspan(mBegin, sizeof(size) + size);
+  mBegin += message.size();
+  if (mBegin == mEnd) {
+    mBegin = 0;
+    mEnd = 0;
+  }
+  return RemoteMessage {
+    .mType = static_cast<RemoteMessageType>(message[sizeof(size)]),
+    .mBody = message.subspan(REMOTE_MESSAGE_HEADER_SIZE),
+  };
+}
+
+bool RemoteMessageBuffer::IsCorrupt() const {
+  return mCorrupt;
+}
+
+}// namespace FredEmmott::ControllerTester
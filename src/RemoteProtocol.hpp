@@ -0,0 +1,149 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "DeviceInfo.hpp"
+#include "DeviceState.hpp"
+#include "Guid.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+/* The stream between a `RemoteServer` and `RemoteClient`s.
+ *
+ * Every message is a little-endian `uint32_t` size of the rest of the
+ * message, a `RemoteMessageType`, then the body:
+ * - Hello: 'FCTR', `uint32_t` version
+ * - DeviceAdded: `uint32_t` ID, unit and product `Guid`s, `uint32_t` axis,
+ *   button, and hat counts, `uint32_t` name and string table sizes, the
+ *   `SerializedControl`s, the name, then the string table
+ * - DeviceRemoved: `uint32_t` ID
+ * - Samples: `uint32_t` ID, then samples until the end of the message; each
+ *   is the time delta and state delta from the previous one
+ * - Summary: `uint32_t` ID, how many samples it replaces, the time and state
+ *   of the last one, then the minimum and maximum of each axis
+ * - Ping: the viewer's time
+ * - Pong: the viewer's time from the ping, then the server's time
+ *
+ * Counts are varints, and times are signed varints of microseconds since
+ * the sender's epoch. Batches are self-contained: the first sample in each
+ * `Samples` or `Summary` is relative to time 0 and the state from
+ * `DeviceState::Resize()`, so the server can switch a viewer between them,
+ * or drop messages, at any time.
+ *
+ * A state delta is the number of changed values, then for each, the gap
+ * from the previous changed index, and the change: axes and hats are signed
+ * differences, and button words are XORed. Indices are axes, then hats,
+ * then button words.
+ */
+enum class RemoteMessageType : uint8_t {
+  Hello = 1,
+  DeviceAdded,
+  DeviceRemoved,
+  Samples,
+  Summary,
+  Ping,
+  Pong,
+};
+
+constexpr std::array<char, 4> REMOTE_MAGIC {'F', 'C', 'T', 'R'};
+constexpr uint32_t REMOTE_VERSION {1};
+constexpr uint16_t DEFAULT_REMOTE_PORT {47474};
+// Size, then type
+constexpr std::size_t REMOTE_MESSAGE_HEADER_SIZE {5};
+// Larger messages are treated as a corrupt stream
+constexpr std::size_t MAX_REMOTE_MESSAGE_SIZE {16 * 1024 * 1024};
+
+// Appends one message; the size is filled in when this is destroyed
+class RemoteMessageWriter final {
+ public:
+  RemoteMessageWriter(std::vector<std::byte>& out, RemoteMessageType);
+  ~RemoteMessageWriter();
+
+  RemoteMessageWriter() = delete;
+  RemoteMessageWriter(const RemoteMessageWriter&) = delete;
+  RemoteMessageWriter(RemoteMessageWriter&&) = delete;
+  RemoteMessageWriter& operator=(const RemoteMessageWriter&) = delete;
+  RemoteMessageWriter& operator=(RemoteMessageWriter&&) = delete;
+
+  void WriteU32(uint32_t);
+  void WriteGuid(const Guid&);
+  void WriteBytes(std::span<const std::byte>);
+  void WriteVarint(uint64_t);
+  void WriteSignedVarint(int64_t);
+  void WriteStateDelta(const DeviceState& previous, const DeviceState& current);
+
+ private:
+  std::vector<std::byte>& mOut;
+  std::size_t mStart {};
+};
+
+// Reads a message body; reading past the end marks the reader as invalid
+class RemoteMessageReader final {
+ public:
+  explicit RemoteMessageReader(std::span<const std::byte> body);
+
+  // False if anything so far was truncated or out of range
+  bool IsValid() const;
+  bool IsAtEnd() const;
+
+  uint32_t ReadU32();
+  Guid ReadGuid();
+  std::span<const std::byte> ReadBytes(std::size_t);
+  uint64_t ReadVarint();
+  int64_t ReadSignedVarint();
+  // Applies a delta to `state`, which must already have the right sizes
+  void ReadStateDelta(DeviceState& state);
+
+ private:
+  std::span<const std::byte> mBody;
+  std::size_t mOffset {};
+  bool mValid {true};
+};
+
+void WriteRemoteHello(std::vector<std::byte>& out);
+bool ReadRemoteHello(std::span<const std::byte> body);
+
+void WriteRemoteDeviceAdded(
+  std::vector<std::byte>& out,
+  uint32_t id,
+  const DeviceInfo&);
+// Nullopt if the body is invalid
+std::optional<DeviceInfo> ReadRemoteDeviceAdded(
+  std::span<const std::byte> body,
+  uint32_t& id);
+
+struct RemoteMessage {
+  RemoteMessageType mType {};
+  std::span<const std::byte> mBody;
+};
+
+// Splits a byte stream into messages
+class RemoteMessageBuffer final {
+ public:
+  // Space for at least `minimum` bytes; call `Commit()` with how many were
+  // written
+  std::span<std::byte> GetWritableSpace(std::size_t minimum);
+  void Commit(std::size_t);
+
+  // Nullopt if there's no complete message; the body is valid until the
+  // next call to any method
+  std::optional<RemoteMessage> Next();
+  // True if a message header is invalid; the stream can't be recovered
+  bool IsCorrupt() const;
+
+ private:
+  std::vector<std::byte> mBuffer;
+  std::size_t mBegin {};
+  std::size_t mEnd {};
+  bool mCorrupt {false};
+};
+
+}// namespace FredEmmott::ControllerTester
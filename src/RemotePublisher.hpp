@@ -0,0 +1,119 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <algorithm>
+#include <concepts>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Guid.hpp"
+#include "PollScheduler.hpp"
+#include "RemoteDeviceInfo.hpp"
+#include "RemoteServer.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+/* Publishes every local device in a `DeviceSet` to a `RemoteServer`.
+ *
+ * Devices are opened again with `DeviceSet::OpenAnother()`, and polled by a
+ * shared `PollScheduler`; each change is pushed to the server. Devices from
+ * other servers aren't published again.
+ */
+class RemotePublisher final {
+ public:
+  RemotePublisher(
+    RemoteServer& server,
+    const PollSchedulerSettings& settings = {})
+    : mServer(server), mScheduler(std::make_unique<PollScheduler>(settings)) {
+  }
+
+  ~RemotePublisher() {
+    // Stop pushing before the server forgets the devices
+    mScheduler.reset();
+    for (auto& device: mDevices) {
+      mServer.RemoveDevice(device.mHandle);
+    }
+  }
+
+  RemotePublisher() = delete;
+  RemotePublisher(const RemotePublisher&) = delete;
+  RemotePublisher(RemotePublisher&&) = delete;
+  RemotePublisher& operator=(const RemotePublisher&) = delete;
+  RemotePublisher& operator=(RemotePublisher&&) = delete;
+
+  // Call regularly, e.g. once per frame, to add and remove devices
+  template <class TDeviceSet>
+  void Update(TDeviceSet& devices) {
+    for (auto& device: mDevices) {
+      device.mSeen = false;
+    }
+
+    devices.ForEachDevice([this, &devices]<Device T>(T& device) {
+      if constexpr (std::same_as<T, RemoteDeviceInfo>) {
+        return;
+      } else {
+        const auto it = std::ranges::find(
+          mDevices, device.mGuid, &PublishedDevice::mGuid);
+        if (it != mDevices.end()) {
+          it->mSeen = true;
+          return;
+        }
+        auto another = devices.OpenAnother(std::as_const(device));
+        if (!another) {
+          return;
+        }
+        const auto handle = mServer.AddDevice(*another);
+        auto& server = mServer;
+        mDevices.push_back({
+          .mGuid = device.mGuid,
+          .mHandle = handle,
+          .mPolled = mScheduler->Add(
+            std::move(*another),
+            [&server, handle](
+              PollScheduler::Clock::time_point time,
+              const std::optional<DeviceState>& state) {
+              if (state) {
+                server.Push(handle, time, *state);
+              }
+            }),
+          .mSeen = true,
+        });
+      }
+    });
+
+    std::erase_if(mDevices, [this](auto& device) {
+      if (device.mSeen) {
+        return false;
+      }
+      // Stop pushing before the server forgets the device
+      mScheduler->Remove(device.mPolled);
+      mServer.RemoveDevice(device.mHandle);
+      return true;
+    });
+  }
+
+  std::size_t GetDeviceCount() const {
+    return mDevices.size();
+  }
+
+  const PollScheduler& GetScheduler() const {
+    return *mScheduler;
+  }
+
+ private:
+  struct PublishedDevice {
+    Guid mGuid;
+    RemoteServer::Device* mHandle {nullptr};
+    PollScheduler::PolledDevice* mPolled {nullptr};
+    bool mSeen {false};
+  };
+
+  RemoteServer& mServer;
+  std::unique_ptr<PollScheduler> mScheduler;
+  std::vector<PublishedDevice> mDevices;
+};
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,412 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "RemoteServer.hpp"
+
+#include <algorithm>
+#include <utility>
+
+#include "Trace.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+namespace {
+
+// Enough for a few batches at 8khz, even with a long batch interval
+constexpr std::size_t RING_CAPACITY {1024};
+// Upper bound on how long the worker takes to notice a stop request or a
+// new viewer
+constexpr std::chrono::milliseconds MAX_POLL_INTERVAL {50};
+constexpr std::size_t RECEIVE_CHUNK_BYTES {4096};
+
+}// namespace
+
+class RemoteServer::Device final {
+ public:
+  Device(uint32_t id, const DeviceInfo& info)
+    : mID(id),
+      mInfo(info),
+      mRing(
+        info.mAxes.size(),
+        info.mHats.size(),
+        info.mButtons.size(),
+        RING_CAPACITY) {
+    mReference.Resize(
+      info.mAxes.size(), info.mHats.size(), info.mButtons.size());
+    mLatest = mReference;
+  }
+
+  Device() = delete;
+  Device(const Device&) = delete;
+  Device(Device&&) = delete;
+  Device& operator=(const Device&) = delete;
+  Device& operator=(Device&&) = delete;
+
+  const uint32_t mID;
+  const DeviceInfo mInfo;
+  SampleRing mRing;
+
+  // The rest is only used on the worker thread
+  bool mAnnounced {false};
+  // The next sequence number to encode
+  uint64_t mNext {};
+  // Each batch starts from this, so that any batch can be decoded alone
+  DeviceState mReference;
+  DeviceState mPrevious;
+  DeviceState mCurrent;
+
+  // Since the last summary
+  uint64_t mSummaryCount {};
+  std::chrono::microseconds mLatestTime {};
+  DeviceState mLatest;
+  std::vector<int32_t> mAxisMin;
+  std::vector<int32_t> mAxisMax;
+
+  void Summarize(std::chrono::microseconds time, const DeviceState& state) {
+    if (mSummaryCount++ == 0) {
+      mAxisMin.assign(state.mAxes.begin(), state.mAxes.end());
+      mAxisMax.assign(state.mAxes.begin(), state.mAxes.end());
+    } else {
+      for (std::size_t i = 0; i < state.mAxes.size(); ++i) {
+        mAxisMin[i] = std::min(mAxisMin[i], state.mAxes[i]);
+        mAxisMax[i] = std::max(mAxisMax[i], state.mAxes[i]);
+      }
+    }
+    mLatestTime = time;
+    mLatest = state;
+  }
+};
+
+struct RemoteServer::Client final {
+  Socket mSocket;
+  // Whole messages; the first `mSent` bytes have already been sent
+  std::vector<std::byte> mPending;
+  std::size_t mSent {};
+  bool mSummarize {false};
+  RemoteMessageBuffer mReceived;
+  bool mClosed {false};
+
+  std::size_t GetPendingBytes() const {
+    return mPending.size() - mSent;
+  }
+
+  void Queue(std::span<const std::byte> bytes) {
+    if (mSent == mPending.size()) {
+      mPending.clear();
+      mSent = 0;
+    } else if (mSent > mPending.size() / 2) {
+      mPending.erase(mPending.begin(), mPending.begin() + mSent);
+      mSent = 0;
+    }
+    mPending.insert(mPending.end(), bytes.begin(), bytes.end());
+  }
+};
+
+RemoteServer::RemoteServer(const RemoteServerSettings& settings)
+  : mSettings(settings),
+    mListener(Socket::Listen(settings.mPort, settings.mLoopbackOnly)) {
+  if (!mListener.IsValid()) {
+    return;
+  }
+  mPort = mListener.GetLocalPort();
+  mThread = std::jthread {[this](std::stop_token stop) { this->Run(stop); }};
+}
+
+RemoteServer::~RemoteServer() = default;
+
+bool RemoteServer::IsListening() const {
+  return mListener.IsValid();
+}
+
+uint16_t RemoteServer::GetPort() const {
+  return mPort;
+}
+
+RemoteServer::Device* RemoteServer::AddDevice(const DeviceInfo& info) {
+  std::unique_lock lock(mMutex);
+  auto device = std::make_unique<Device>(mNextDeviceID++, info);
+  const auto ret = device.get();
+  mDevices.push_back(std::move(device));
+  return ret;
+}
+
+void RemoteServer::RemoveDevice(Device* device) {
+  std::unique_lock lock(mMutex);
+  const auto it = std::ranges::find(
+    mDevices, device, [](const auto& it) { return it.get(); });
+  if (it == mDevices.end()) {
+    return;
+  }
+  mRemovedDevices.push_back(std::move(*it));
+  mDevices.erase(it);
+}
+
+void RemoteServer::Push(
+  Device* device,
+  Clock::time_point time,
+  const DeviceState& state) {
+  device->mRing.Push(this->GetTime(time), state);
+}
+
+RemoteServer::Stats RemoteServer::GetStats() const {
+  std::unique_lock lock(mMutex);
+  return mStats;
+}
+
+std::chrono::microseconds RemoteServer::GetTime(Clock::time_point time) const {
+  return std::chrono::duration_cast<std::chrono::microseconds>(time - mEpoch);
+}
+
+void RemoteServer::Run(std::stop_token stop) {
+  Trace::SetThreadName("RemoteServer");
+
+  auto nextBatch = Clock::now() + mSettings.mBatchInterval;
+  mNextSummary = Clock::now() + mSettings.mSummaryInterval;
+  std::vector<Socket::PollRequest> requests;
+  while (!stop.stop_requested()) {
+    requests.clear();
+    requests.push_back({.mSocket = &mListener});
+    for (const auto& client: mClients) {
+      requests.push_back({
+        .mSocket = &client->mSocket,
+        .mWantWrite = client->GetPendingBytes() > 0,
+      });
+    }
+    const auto timeout = std::clamp(
+      std::chrono::ceil<std::chrono::milliseconds>(nextBatch - Clock::now()),
+      std::chrono::milliseconds::zero(),
+      MAX_POLL_INTERVAL);
+    Socket::Poll(requests, timeout);
+
+    if (requests.front().mReadable) {
+      this->AcceptClients();
+    }
+    this->ReceiveFromClients();
+
+    const auto now = Clock::now();
+    if (now >= nextBatch) {
+      const Trace::Zone traceZone {"RemoteServer::Batch"};
+      nextBatch += mSettings.mBatchInterval;
+      if (nextBatch < now) {
+        // Skip missed batches; the next one includes their samples
+        nextBatch = now + mSettings.mBatchInterval;
+      }
+      const auto summaryDue = now >= mNextSummary;
+      if (summaryDue) {
+        mNextSummary = now + mSettings.mSummaryInterval;
+      }
+
+      this->UpdateDevices();
+      this->EncodeBatch();
+      if (summaryDue) {
+        this->EncodeSummaries();
+      }
+      this->SendToClients(summaryDue);
+    }
+
+    this->FlushClients();
+    std::erase_if(mClients, [](const auto& client) { return client->mClosed; });
+
+    mWorkerStats.mClientCount = mClients.size();
+    mWorkerStats.mSummarizedClientCount = std::ranges::count_if(
+      mClients, [](const auto& client) { return client->mSummarize; });
+    std::unique_lock lock(mMutex);
+    mStats = mWorkerStats;
+  }
+}
+
+void RemoteServer::AcceptClients() {
+  while (true) {
+    auto socket = mListener.Accept();
+    if (!socket.IsValid()) {
+      return;
+    }
+    socket.SetSendBufferSize(mSettings.mSendBufferBytes);
+    auto client = std::make_unique<Client>();
+    client->mSocket = std::move(socket);
+
+    std::vector<std::byte> hello;
+    WriteRemoteHello(hello);
+    for (const auto device: mActiveDevices) {
+      if (device->mAnnounced) {
+        WriteRemoteDeviceAdded(hello, device->mID, device->mInfo);
+      }
+    }
+    client->Queue(hello);
+    mClients.push_back(std::move(client));
+  }
+}
+
+void RemoteServer::ReceiveFromClients() {
+  std::vector<std::byte> replies;
+  for (const auto& client: mClients) {
+    while (true) {
+      const auto buffer
+        = client->mReceived.GetWritableSpace(RECEIVE_CHUNK_BYTES);
+      const auto received = client->mSocket.Receive(buffer);
+      if (!received) {
+        client->mClosed = true;
+        break;
+      }
+      if (*received == 0) {
+        break;
+      }
+      client->mReceived.Commit(*received);
+    }
+
+    replies.clear();
+    while (const auto message = client->mReceived.Next()) {
+      if (message->mType != RemoteMessageType::Ping) {
+        continue;
+      }
+      RemoteMessageReader reader {message->mBody};
+      const auto viewerTime = reader.ReadSignedVarint();
+      if (!reader.IsValid()) {
+        client->mClosed = true;
+        break;
+      }
+      RemoteMessageWriter writer {replies, RemoteMessageType::Pong};
+      writer.WriteSignedVarint(viewerTime);
+      writer.WriteSignedVarint(this->GetTime(Clock::now()).count());
+    }
+    if (client->mReceived.IsCorrupt()) {
+      client->mClosed = true;
+    }
+    if (!replies.empty()) {
+      client->Queue(replies);
+    }
+  }
+}
+
+void RemoteServer::UpdateDevices() {
+  mAnnouncements.clear();
+
+  std::vector<std::unique_ptr<Device>> removed;
+  {
+    std::unique_lock lock(mMutex);
+    mActiveDevices.clear();
+    for (const auto& device: mDevices) {
+      mActiveDevices.push_back(device.get());
+    }
+    removed.swap(mRemovedDevices);
+  }
+
+  for (const auto& device: removed) {
+    if (device->mAnnounced) {
+      RemoteMessageWriter writer {
+        mAnnouncements, RemoteMessageType::DeviceRemoved};
+      writer.WriteU32(device->mID);
+    }
+  }
+  for (const auto device: mActiveDevices) {
+    if (!device->mAnnounced) {
+      WriteRemoteDeviceAdded(mAnnouncements, device->mID, device->mInfo);
+      device->mAnnounced = true;
+    }
+  }
+}
+
+void RemoteServer::EncodeBatch() {
+  mBatch.clear();
+  mBatchSampleCount = 0;
+  for (const auto device: mActiveDevices) {
+    auto& ring = device->mRing;
+    const auto end = ring.GetEnd();
+    const auto capacity = ring.GetCapacity();
+    if (end - device->mNext > capacity) {
+      mWorkerStats.mSamplesLost += end - device->mNext - capacity;
+      device->mNext = end - capacity;
+    }
+    if (device->mNext == end) {
+      continue;
+    }
+
+    RemoteMessageWriter writer {mBatch, RemoteMessageType::Samples};
+    writer.WriteU32(device->mID);
+    device->mPrevious = device->mReference;
+    std::chrono::microseconds previousTime {};
+    for (auto sequence = device->mNext; sequence < end; ++sequence) {
+      const auto time = ring.Read(sequence, device->mCurrent);
+      if (!time) {
+        // Overwritten while we were catching up
+        ++mWorkerStats.mSamplesLost;
+        continue;
+      }
+      writer.WriteSignedVarint((*time - previousTime).count());
+      writer.WriteStateDelta(device->mPrevious, device->mCurrent);
+      device->Summarize(*time, device->mCurrent);
+      std::swap(device->mPrevious, device->mCurrent);
+      previousTime = *time;
+      ++mBatchSampleCount;
+    }
+    device->mNext = end;
+  }
+}
+
+void RemoteServer::EncodeSummaries() {
+  mSummaries.clear();
+  mSummarySampleCount = 0;
+  for (const auto device: mActiveDevices) {
+    if (device->mSummaryCount == 0) {
+      continue;
+    }
+    RemoteMessageWriter writer {mSummaries, RemoteMessageType::Summary};
+    writer.WriteU32(device->mID);
+    writer.WriteVarint(device->mSummaryCount);
+    writer.WriteSignedVarint(device->mLatestTime.count());
+    writer.WriteStateDelta(device->mReference, device->mLatest);
+    for (std::size_t i = 0; i < device->mAxisMin.size(); ++i) {
+      writer.WriteSignedVarint(device->mAxisMin[i]);
+      writer.WriteSignedVarint(device->mAxisMax[i]);
+    }
+    mSummarySampleCount += device->mSummaryCount;
+    device->mSummaryCount = 0;
+  }
+}
+
+void RemoteServer::SendToClients(bool summaryDue) {
+  const auto maxPending = mSettings.mMaxPendingBytes;
+  for (const auto& client: mClients) {
+    // Always sent, as later messages refer to them
+    client->Queue(mAnnouncements);
+
+    const auto pending = client->GetPendingBytes();
+    if (client->mSummarize && pending <= maxPending / 4) {
+      client->mSummarize = false;
+    } else if (!client->mSummarize && pending > maxPending) {
+      client->mSummarize = true;
+    }
+
+    if (!client->mSummarize) {
+      client->Queue(mBatch);
+      mWorkerStats.mSamplesSent += mBatchSampleCount;
+      continue;
+    }
+    // If even summaries aren't getting through, skip them rather than
+    // buffering without limit
+    if (summaryDue && pending < maxPending * 4) {
+      client->Queue(mSummaries);
+      mWorkerStats.mSamplesSummarized += mSummarySampleCount;
+    }
+  }
+}
+
+void RemoteServer::FlushClients() {
+  for (const auto& client: mClients) {
+    while (client->GetPendingBytes() > 0) {
+      const auto sent = client->mSocket.Send(
+        std::span {client->mPending}.subspan(client->mSent));
+      if (!sent) {
+        client->mClosed = true;
+        break;
+      }
+      if (*sent == 0) {
+        break;
+      }
+      client->mSent += *sent;
+      mWorkerStats.mBytesSent += *sent;
+    }
+  }
+}
+
+}// namespace FredEmmott::ControllerTester
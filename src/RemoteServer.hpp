@@ -0,0 +1,130 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "DeviceInfo.hpp"
+#include "DeviceState.hpp"
+#include "RemoteProtocol.hpp"
+#include "SampleRing.hpp"
+#include "Socket.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+struct RemoteServerSettings {
+  uint16_t mPort {DEFAULT_REMOTE_PORT};
+  bool mLoopbackOnly {false};
+  // Longer intervals send fewer, larger messages, adding up to this much
+  // latency
+  std::chrono::microseconds mBatchInterval {std::chrono::milliseconds {5}};
+  // Viewers with more than this waiting to be sent get summaries instead
+  // of samples, until they catch up
+  std::size_t mMaxPendingBytes {256 * 1024};
+  // What the OS can buffer for each viewer on top of that
+  std::size_t mSendBufferBytes {64 * 1024};
+  std::chrono::milliseconds mSummaryInterval {100};
+};
+
+/* Streams devices' layouts and samples to `RemoteClient`s over TCP.
+ *
+ * Samples are pushed into a lock-free ring per device, e.g. by `Sampler`s;
+ * a background thread encodes each device's new samples once per batch
+ * interval, and sends the same bytes to every viewer.
+ *
+ * A viewer whose connection can't keep up is sent a summary of each device
+ * every summary interval instead - the latest state, and each axis's range
+ * - until its backlog drains.
+ */
+class RemoteServer final {
+ public:
+  using Clock = std::chrono::steady_clock;
+  class Device;
+
+  explicit RemoteServer(const RemoteServerSettings&);
+  ~RemoteServer();
+
+  RemoteServer() = delete;
+  RemoteServer(const RemoteServer&) = delete;
+  RemoteServer(RemoteServer&&) = delete;
+  RemoteServer& operator=(const RemoteServer&) = delete;
+  RemoteServer& operator=(RemoteServer&&) = delete;
+
+  // False if the port couldn't be opened
+  bool IsListening() const;
+  // Useful if the settings asked for port 0
+  uint16_t GetPort() const;
+
+  // Returns a handle for `Push()`, valid until `RemoveDevice()`
+  Device* AddDevice(const DeviceInfo&);
+  // Call after the last `Push()` for this device has returned
+  void RemoveDevice(Device*);
+
+  // Can be called from a different thread for each device, but only one
+  // thread per device; never blocks or allocates
+  void Push(Device*, Clock::time_point, const DeviceState&);
+
+  struct Stats {
+    std::size_t mClientCount {};
+    // Viewers currently receiving summaries instead of samples
+    std::size_t mSummarizedClientCount {};
+    uint64_t mBytesSent {};
+    // Per viewer
+    uint64_t mSamplesSent {};
+    uint64_t mSamplesSummarized {};
+    // Overwritten in a device's ring before they were encoded
+    uint64_t mSamplesLost {};
+  };
+  Stats GetStats() const;
+
+ private:
+  struct Client;
+
+  RemoteServerSettings mSettings;
+  const Clock::time_point mEpoch {Clock::now()};
+  Socket mListener;
+  uint16_t mPort {};
+
+  mutable std::mutex mMutex;
+  // Protected by `mMutex`
+  std::vector<std::unique_ptr<Device>> mDevices;
+  // Kept until the worker thread has told viewers they're gone
+  std::vector<std::unique_ptr<Device>> mRemovedDevices;
+  uint32_t mNextDeviceID {1};
+  Stats mStats;
+
+  // Only used on the worker thread
+  std::vector<std::unique_ptr<Client>> mClients;
+  // A copy of `mDevices`, taken once per batch
+  std::vector<Device*> mActiveDevices;
+  std::vector<std::byte> mAnnouncements;
+  std::vector<std::byte> mBatch;
+  uint64_t mBatchSampleCount {};
+  std::vector<std::byte> mSummaries;
+  uint64_t mSummarySampleCount {};
+  Clock::time_point mNextSummary {};
+  Stats mWorkerStats;
+
+  // Last, so that it's stopped before anything it uses is destroyed
+  std::jthread mThread;
+
+  std::chrono::microseconds GetTime(Clock::time_point) const;
+
+  void Run(std::stop_token);
+  void AcceptClients();
+  void ReceiveFromClients();
+  void UpdateDevices();
+  void EncodeBatch();
+  void EncodeSummaries();
+  void SendToClients(bool summaryDue);
+  void FlushClients();
+};
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,523 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "ResultsDatabase.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <tuple>
+#include <type_traits>
+
+#include "ControlAnalysis.hpp"
+#include "DeviceState.hpp"
+#include "MemoryMappedFile.hpp"
+#include "Trace.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+namespace {
+
+constexpr std::array<char, 4> MAGIC {'F', 'C', 'T', 'R'};
+constexpr uint32_t VERSION {1};
+
+struct FileHeader {
+  std::array<char, 4> mMagic {};
+  uint32_t mVersion {};
+};
+static_assert(sizeof(FileHeader) == 8);
+
+constexpr uint32_t RECORD_PASSED {1};
+
+// Followed by the axes, hats, seen-on button words, then seen-off button
+// words; records start on an 8-byte boundary
+struct RecordHeader {
+  // Including this header and any padding
+  uint32_t mSize {};
+  // Of everything after this field
+  uint32_t mChecksum {};
+  Guid mProduct;
+  Guid mUnit;
+  // Microseconds since the epoch
+  int64_t mTime {};
+  uint32_t mAxisCount {};
+  uint32_t mHatCount {};
+  uint32_t mButtonCount {};
+  uint32_t mFlags {};
+  ResultsDatabase::TimingStats mPoll;
+  ResultsDatabase::TimingStats mGetState;
+};
+static_assert(std::is_trivially_copyable_v<RecordHeader>);
+static_assert(sizeof(RecordHeader) % 8 == 0);
+static_assert(std::is_trivially_copyable_v<ResultsDatabase::AxisResult>);
+static_assert(std::is_trivially_copyable_v<ResultsDatabase::HatResult>);
+
+constexpr std::size_t AlignRecord(std::size_t size) {
+  return (size + 7) & ~std::size_t {7};
+}
+
+struct RecordLayout {
+  std::size_t mAxesOffset {};
+  std::size_t mHatsOffset {};
+  std::size_t mSeenOnOffset {};
+  std::size_t mSeenOffOffset {};
+  std::size_t mWordCount {};
+  std::size_t mSize {};
+};
+
+constexpr RecordLayout
+GetRecordLayout(std::size_t axes, std::size_t hats, std::size_t buttons) {
+  RecordLayout ret {};
+  ret.mAxesOffset = sizeof(RecordHeader);
+  ret.mHatsOffset
+    = ret.mAxesOffset + (axes * sizeof(ResultsDatabase::AxisResult));
+  ret.mSeenOnOffset = AlignRecord(
+    ret.mHatsOffset + (hats * sizeof(ResultsDatabase::HatResult)));
+  ret.mWordCount = DeviceState::GetButtonWordCount(buttons);
+  ret.mSeenOffOffset = ret.mSeenOnOffset + (ret.mWordCount * sizeof(uint64_t));
+  ret.mSize = ret.mSeenOffOffset + (ret.mWordCount * sizeof(uint64_t));
+  return ret;
+}
+
+// FNV-1a; this is only to catch torn or damaged records
+uint32_t GetChecksum(std::span<const std::byte> bytes) {
+  uint32_t hash {2166136261};
+  for (const auto byte: bytes) {
+    hash ^= std::to_integer<uint8_t>(byte);
+    hash *= 16777619;
+  }
+  return hash;
+}
+
+std::span<const std::byte> GetChecksummedBytes(
+  std::span<const std::byte> record) {
+  constexpr auto skip = offsetof(RecordHeader, mChecksum) + sizeof(uint32_t);
+  return record.subspan(skip);
+}
+
+int64_t ToMicroseconds(ResultsDatabase::Clock::time_point time) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+           time.time_since_epoch())
+    .count();
+}
+
+ResultsDatabase::Clock::time_point FromMicroseconds(int64_t time) {
+  return ResultsDatabase::Clock::time_point {
+    std::chrono::duration_cast<ResultsDatabase::Clock::duration>(
+      std::chrono::microseconds {time})};
+}
+
+// The header of the record at `offset`, if it's valid
+std::optional<RecordHeader> ReadRecord(
+  std::span<const std::byte> data,
+  uint64_t offset) {
+  RecordHeader record;
+  if (offset > data.size() || data.size() - offset < sizeof(record)) {
+    return std::nullopt;
+  }
+  std::memcpy(&record, data.data() + offset, sizeof(record));
+  if (
+    record.mSize < sizeof(RecordHeader) || record.mSize % 8
+    || record.mSize > data.size() - offset) {
+    return std::nullopt;
+  }
+  const auto layout = GetRecordLayout(
+    record.mAxisCount, record.mHatCount, record.mButtonCount);
+  if (layout.mSize != record.mSize) {
+    return std::nullopt;
+  }
+  const auto bytes = data.subspan(offset, record.mSize);
+  if (GetChecksum(GetChecksummedBytes(bytes)) != record.mChecksum) {
+    return std::nullopt;
+  }
+  return record;
+}
+
+template <class T>
+std::span<const T> GetArray(
+  std::span<const std::byte> record,
+  std::size_t offset,
+  std::size_t count) {
+  // Record offsets are 8-byte aligned, and mappings are page-aligned
+  return {reinterpret_cast<const T*>(record.data() + offset), count};
+}
+
+}// namespace
+
+const ResultsDatabase::AxisResult* ResultsDatabase::ResultView::FindAxis(
+  const Guid& type) const {
+  const auto it = std::ranges::find(mAxes, type, &AxisResult::mType);
+  if (it == mAxes.end()) {
+    return nullptr;
+  }
+  return &*it;
+}
+
+bool ResultsDatabase::ResultView::IsButtonSeenOn(std::size_t index) const {
+  return (mButtonsSeenOn[index / DeviceState::BUTTONS_PER_WORD]
+          >> (index % DeviceState::BUTTONS_PER_WORD))
+    & 1;
+}
+
+bool ResultsDatabase::ResultView::IsButtonSeenOff(std::size_t index) const {
+  return (mButtonsSeenOff[index / DeviceState::BUTTONS_PER_WORD]
+          >> (index % DeviceState::BUTTONS_PER_WORD))
+    & 1;
+}
+
+ResultsDatabase::ResultsDatabase(std::filesystem::path path, Mode mode)
+  : mPath(std::move(path)), mMode(mode) {
+  this->Load();
+}
+
+ResultsDatabase::~ResultsDatabase() = default;
+
+void ResultsDatabase::Load() {
+  const Trace::Zone traceZone {"ResultsDatabase::Load"};
+  std::error_code ec;
+  if (mMode == Mode::ReadOnly) {
+    if (!std::filesystem::exists(mPath, ec)) {
+      return;
+    }
+  } else if (
+    // An empty file is most likely from a crash while creating it
+    !std::filesystem::exists(mPath, ec)
+    || std::filesystem::file_size(mPath, ec) == 0) {
+    std::filesystem::create_directories(mPath.parent_path(), ec);
+    const FileHeader header {.mMagic = MAGIC, .mVersion = VERSION};
+    std::ofstream f(mPath, std::ios::binary);
+    f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (f) {
+      mFileSize = sizeof(header);
+      mWritable = true;
+    }
+    return;
+  }
+
+  uint64_t validSize {};
+  {
+    const MemoryMappedFile file {mPath};
+    const auto data = file.GetData();
+
+    FileHeader header;
+    if (data.size() < sizeof(header)) {
+      return;
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (header.mMagic != MAGIC || header.mVersion != VERSION) {
+      return;
+    }
+
+    uint64_t offset {sizeof(header)};
+    validSize = offset;
+    bool skipping {false};
+    while (offset < data.size()) {
+      const auto record = ReadRecord(data, offset);
+      if (!record) {
+        // Records are 8-byte aligned, so resynchronize by looking for a
+        // valid one at each 8-byte boundary
+        skipping = true;
+        offset += 8;
+        continue;
+      }
+      if (skipping) {
+        ++mCorruptResultCount;
+        skipping = false;
+      }
+      // Sorted once below; inserting each in order would be O(n^2)
+      mByProduct.push_back(
+        {.mKey = record->mProduct, .mTime = record->mTime, .mOffset = offset});
+      mByUnit.push_back(
+        {.mKey = record->mUnit, .mTime = record->mTime, .mOffset = offset});
+      offset += record->mSize;
+      validSize = offset;
+    }
+    std::ranges::sort(mByProduct);
+    std::ranges::sort(mByUnit);
+
+    // For a reader, this may be a record that's being appended
+    mDamagedTailSize = data.size() - validSize;
+    mFileSize = validSize;
+    if (mMode == Mode::ReadOnly) {
+      return;
+    }
+    if (mDamagedTailSize && !this->MoveDamagedTail(data, validSize)) {
+      return;
+    }
+  }
+
+  if (mDamagedTailSize) {
+    // Otherwise, new records would follow the damaged tail, and be lost
+    std::filesystem::resize_file(mPath, validSize, ec);
+    if (ec) {
+      return;
+    }
+  }
+  mWritable = true;
+}
+
+bool ResultsDatabase::MoveDamagedTail(
+  std::span<const std::byte> data,
+  uint64_t validSize) {
+  auto name = mPath.filename();
+  name += "." + std::to_string(ToMicroseconds(Clock::now())) + ".damaged";
+  const auto path = mPath.parent_path() / name;
+
+  const auto tail = data.subspan(validSize);
+  std::ofstream f(path, std::ios::binary);
+  f.write(reinterpret_cast<const char*>(tail.data()), tail.size());
+  f.flush();
+  if (!f) {
+    return false;
+  }
+  mDamagedTailPath = path;
+  return true;
+}
+
+void ResultsDatabase::AddToIndex(
+  const Guid& product,
+  const Guid& unit,
+  int64_t time,
+  uint64_t offset) {
+  // Usually the newest, so usually appended
+  const auto insert = [](auto& index, const IndexEntry& entry) {
+    index.insert(std::ranges::upper_bound(index, entry), entry);
+  };
+  insert(mByProduct, {.mKey = product, .mTime = time, .mOffset = offset});
+  insert(mByUnit, {.mKey = unit, .mTime = time, .mOffset = offset});
+}
+
+bool ResultsDatabase::Append(const UnitResult& result) {
+  const Trace::Zone traceZone {"ResultsDatabase::Append"};
+  if (!mWritable) {
+    return false;
+  }
+
+  const auto layout = GetRecordLayout(
+    result.mAxes.size(), result.mHats.size(), result.mButtonCount);
+  if (
+    result.mButtonsSeenOn.size() != layout.mWordCount
+    || result.mButtonsSeenOff.size() != layout.mWordCount) {
+    return false;
+  }
+
+  RecordHeader header {
+    .mSize = static_cast<uint32_t>(layout.mSize),
+    .mProduct = result.mProduct,
+    .mUnit = result.mUnit,
+    .mTime = ToMicroseconds(result.mTime),
+    .mAxisCount = static_cast<uint32_t>(result.mAxes.size()),
+    .mHatCount = static_cast<uint32_t>(result.mHats.size()),
+    .mButtonCount = static_cast<uint32_t>(result.mButtonCount),
+    .mFlags = result.mPassed ? RECORD_PASSED : 0,
+    .mPoll = result.mPoll,
+    .mGetState = result.mGetState,
+  };
+
+  std::vector<std::byte> buffer(layout.mSize);
+  const auto copy = [&buffer](std::size_t offset, const auto& range) {
+    std::memcpy(
+      buffer.data() + offset,
+      std::ranges::data(range),
+      std::ranges::size(range) * sizeof(*std::ranges::data(range)));
+  };
+  copy(layout.mAxesOffset, result.mAxes);
+  copy(layout.mHatsOffset, result.mHats);
+  copy(layout.mSeenOnOffset, result.mButtonsSeenOn);
+  copy(layout.mSeenOffOffset, result.mButtonsSeenOff);
+  std::memcpy(buffer.data(), &header, sizeof(header));
+  header.mChecksum = GetChecksum(GetChecksummedBytes(buffer));
+  std::memcpy(buffer.data(), &header, sizeof(header));
+
+  {
+    std::ofstream f(mPath, std::ios::binary | std::ios::app);
+    f.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+    f.flush();
+    if (!f) {
+      f.close();
+      std::error_code ec;
+      std::filesystem::resize_file(mPath, mFileSize, ec);
+      return false;
+    }
+  }
+
+  this->AddToIndex(result.mProduct, result.mUnit, header.mTime, mFileSize);
+  mFileSize += layout.mSize;
+  return true;
+}
+
+std::span<const std::byte> ResultsDatabase::GetMappedData() {
+  if (mMappedSize != mFileSize) {
+    // Release the old mapping first, so we're never holding two
+    mMapping.reset();
+    mMapping = std::make_unique<MemoryMappedFile>(mPath);
+    mMappedSize = mFileSize;
+  }
+  if (!mMapping) {
+    // Read-only, and the file doesn't exist
+    return {};
+  }
+  return mMapping->GetData();
+}
+
+ResultsDatabase::ResultView ResultsDatabase::GetView(
+  std::span<const std::byte> data,
+  uint64_t offset) const {
+  RecordHeader header;
+  std::memcpy(&header, data.data() + offset, sizeof(header));
+  const auto record = data.subspan(offset, header.mSize);
+  const auto layout = GetRecordLayout(
+    header.mAxisCount, header.mHatCount, header.mButtonCount);
+
+  const auto words = layout.mWordCount;
+  return {
+    .mProduct = header.mProduct,
+    .mUnit = header.mUnit,
+    .mTime = FromMicroseconds(header.mTime),
+    .mPassed = (header.mFlags & RECORD_PASSED) != 0,
+    .mPoll = header.mPoll,
+    .mGetState = header.mGetState,
+    .mAxes = GetArray<AxisResult>(
+      record, layout.mAxesOffset, header.mAxisCount),
+    .mHats = GetArray<HatResult>(record, layout.mHatsOffset, header.mHatCount),
+    .mButtonsSeenOn = GetArray<uint64_t>(record, layout.mSeenOnOffset, words),
+    .mButtonsSeenOff = GetArray<uint64_t>(record, layout.mSeenOffOffset, words),
+    .mButtonCount = header.mButtonCount,
+  };
+}
+
+std::vector<ResultsDatabase::ResultView> ResultsDatabase::Find(
+  const Query& query) {
+  const Trace::Zone traceZone {"ResultsDatabase::Find"};
+  const auto since = ToMicroseconds(query.mSince);
+  const auto until = ToMicroseconds(query.mUntil);
+
+  // Everything in `matches` is for a single key, and already in time order,
+  // unless there's no product or unit filter
+  std::span<const IndexEntry> matches {mByProduct};
+  std::vector<IndexEntry> unordered;
+  const auto getRange
+    = [since, until](std::span<const IndexEntry> index, const Guid& key) {
+        const auto begin = std::ranges::lower_bound(
+          index, IndexEntry {.mKey = key, .mTime = since, .mOffset = 0});
+        const auto end = std::ranges::upper_bound(
+          index,
+          IndexEntry {.mKey = key, .mTime = until, .mOffset = UINT64_MAX});
+        return std::span {begin, end};
+      };
+  if (query.mUnit) {
+    matches = getRange(mByUnit, *query.mUnit);
+  } else if (query.mProduct) {
+    matches = getRange(mByProduct, *query.mProduct);
+  } else {
+    for (const auto& entry: mByProduct) {
+      if (entry.mTime >= since && entry.mTime <= until) {
+        unordered.push_back(entry);
+      }
+    }
+    std::ranges::sort(unordered, [](const auto& a, const auto& b) {
+      return std::tie(a.mTime, a.mOffset) < std::tie(b.mTime, b.mOffset);
+    });
+    matches = unordered;
+  }
+
+  const auto data = this->GetMappedData();
+  std::vector<ResultView> ret;
+  ret.reserve(std::min(matches.size(), query.mMaxResults));
+  // Walk backwards so `mMaxResults` keeps the newest
+  for (auto it = matches.rbegin(); it != matches.rend(); ++it) {
+    if (ret.size() >= query.mMaxResults) {
+      break;
+    }
+    if (it->mOffset + sizeof(RecordHeader) > data.size()) {
+      // Mapping failed
+      continue;
+    }
+    auto view = this->GetView(data, it->mOffset);
+    if (query.mUnit && query.mProduct && view.mProduct != *query.mProduct) {
+      continue;
+    }
+    ret.push_back(view);
+  }
+  std::ranges::reverse(ret);
+  return ret;
+}
+
+std::size_t ResultsDatabase::GetResultCount() const {
+  return mByProduct.size();
+}
+
+std::size_t ResultsDatabase::GetCorruptResultCount() const {
+  return mCorruptResultCount;
+}
+
+uint64_t ResultsDatabase::GetDamagedTailSize() const {
+  return mDamagedTailSize;
+}
+
+std::filesystem::path ResultsDatabase::GetDamagedTailPath() const {
+  return mDamagedTailPath;
+}
+
+ResultsDatabase::UnitResult MakeUnitResult(
+  const DeviceInfo& device,
+  const ResultsDatabase::TimingStats& poll,
+  const ResultsDatabase::TimingStats& getState,
+  ResultsDatabase::Clock::time_point time) {
+  ResultsDatabase::UnitResult ret {
+    .mProduct = device.mProduct,
+    .mUnit = device.mGuid,
+    .mTime = time,
+    .mPassed = IsFullyTested(device),
+    .mPoll = poll,
+    .mGetState = getState,
+  };
+
+  ret.mAxes.reserve(device.mAxes.size());
+  for (const auto& axis: device.mAxes) {
+    ret.mAxes.push_back({
+      .mType = axis.mGuid,
+      .mMin = axis.mMin,
+      .mMax = axis.mMax,
+      .mMinSeen = axis.mMinSeen,
+      .mMaxSeen = axis.mMaxSeen,
+    });
+  }
+
+  ret.mHats.reserve(device.mHats.size());
+  for (const auto& hat: device.mHats) {
+    const uint16_t required
+      = (hat.mType == HatType::Other) ? 0 : GetHatFullRangeFlags(hat.mType);
+    ret.mHats.push_back({
+      .mType = hat.mGuid,
+      .mSeenFlags = hat.mSeenFlags,
+      .mRequiredFlags = required,
+    });
+  }
+
+  const auto wordCount
+    = DeviceState::GetButtonWordCount(device.mButtons.size());
+  ret.mButtonCount = device.mButtons.size();
+  ret.mButtonsSeenOn.resize(wordCount);
+  ret.mButtonsSeenOff.resize(wordCount);
+  for (std::size_t i = 0; i < device.mButtons.size(); ++i) {
+    const auto& button = device.mButtons[i];
+    const auto word = i / DeviceState::BUTTONS_PER_WORD;
+    const auto bit = uint64_t {1} << (i % DeviceState::BUTTONS_PER_WORD);
+    if (button.mSeenOn) {
+      ret.mButtonsSeenOn[word] |= bit;
+    }
+    if (button.mSeenOff) {
+      ret.mButtonsSeenOff[word] |= bit;
+    }
+  }
+
+  return ret;
+}
+
+}// namespace FredEmmott::ControllerTester
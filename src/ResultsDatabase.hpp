@@ -0,0 +1,182 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "DeviceInfo.hpp"
+#include "Guid.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+class MemoryMappedFile;
+
+/* Per-unit test results, for comparing many units of the same product.
+ *
+ * Results are appended to a single file, which is memory-mapped for
+ * queries. Indices by product and by unit are built when the file is
+ * opened, and kept up to date by `Append()`.
+ *
+ * Damaged records are skipped when the file is opened. If the file ends
+ * with a damaged or partially-written record, e.g. after a crash, a writer
+ * moves that tail to a separate file before it appends anything; it's
+ * never deleted.
+ *
+ * There must only be one writer per file, but any number of read-only
+ * instances, which never change the file.
+ */
+class ResultsDatabase final {
+ public:
+  using Clock = std::chrono::system_clock;
+
+  // Latency percentiles, in milliseconds
+  struct TimingStats {
+    float mP50 {};
+    float mP99 {};
+    float mMax {};
+  };
+
+  struct AxisResult {
+    Guid mType;
+    int32_t mMin {};
+    int32_t mMax {};
+    int32_t mMinSeen {};
+    int32_t mMaxSeen {};
+  };
+
+  struct HatResult {
+    Guid mType;
+    uint16_t mSeenFlags {};
+    uint16_t mRequiredFlags {};
+  };
+
+  struct UnitResult {
+    Guid mProduct;
+    Guid mUnit;
+    Clock::time_point mTime;
+    bool mPassed {false};
+    TimingStats mPoll;
+    TimingStats mGetState;
+
+    std::vector<AxisResult> mAxes {};
+    std::vector<HatResult> mHats {};
+    // One bit per button, in `DeviceState` order
+    std::vector<uint64_t> mButtonsSeenOn {};
+    std::vector<uint64_t> mButtonsSeenOff {};
+    std::size_t mButtonCount {};
+  };
+
+  // Points into the mapped file; invalidated by `Append()`
+  struct ResultView {
+    Guid mProduct;
+    Guid mUnit;
+    Clock::time_point mTime;
+    bool mPassed {false};
+    TimingStats mPoll;
+    TimingStats mGetState;
+
+    std::span<const AxisResult> mAxes;
+    std::span<const HatResult> mHats;
+    std::span<const uint64_t> mButtonsSeenOn;
+    std::span<const uint64_t> mButtonsSeenOff;
+    std::size_t mButtonCount {};
+
+    // The first axis of this type, if any
+    const AxisResult* FindAxis(const Guid& type) const;
+    bool IsButtonSeenOn(std::size_t index) const;
+    bool IsButtonSeenOff(std::size_t index) const;
+  };
+
+  struct Query {
+    std::optional<Guid> mProduct {};
+    std::optional<Guid> mUnit {};
+    Clock::time_point mSince {Clock::time_point::min()};
+    Clock::time_point mUntil {Clock::time_point::max()};
+    // Keep only the most recent results
+    std::size_t mMaxResults {SIZE_MAX};
+  };
+
+  enum class Mode {
+    // Creates the file if needed
+    ReadWrite,
+    // e.g. for queries while the app is appending to the file
+    ReadOnly,
+  };
+
+  explicit ResultsDatabase(std::filesystem::path, Mode = Mode::ReadWrite);
+  ~ResultsDatabase();
+
+  ResultsDatabase() = delete;
+  ResultsDatabase(const ResultsDatabase&) = delete;
+  ResultsDatabase(ResultsDatabase&&) = delete;
+  ResultsDatabase& operator=(const ResultsDatabase&) = delete;
+  ResultsDatabase& operator=(ResultsDatabase&&) = delete;
+
+  // Returns false if the result couldn't be written, or this is read-only
+  bool Append(const UnitResult&);
+
+  // Oldest first
+  std::vector<ResultView> Find(const Query&);
+
+  std::size_t GetResultCount() const;
+  // Damaged records or runs of records that were skipped when the file was
+  // opened, not including a damaged tail
+  std::size_t GetCorruptResultCount() const;
+  // Bytes after the last valid record when the file was opened; for a
+  // writer, these have been moved to `GetDamagedTailPath()`
+  uint64_t GetDamagedTailSize() const;
+  std::filesystem::path GetDamagedTailPath() const;
+
+ private:
+  struct IndexEntry {
+    Guid mKey;
+    int64_t mTime {};
+    uint64_t mOffset {};
+
+    auto operator<=>(const IndexEntry&) const = default;
+  };
+
+  std::filesystem::path mPath;
+  Mode mMode {Mode::ReadWrite};
+  uint64_t mFileSize {};
+  // False if read-only, the file has an unknown format, or it couldn't be
+  // created or repaired
+  bool mWritable {false};
+  std::size_t mCorruptResultCount {};
+  uint64_t mDamagedTailSize {};
+  std::filesystem::path mDamagedTailPath;
+  // Sorted by key, then time
+  std::vector<IndexEntry> mByProduct;
+  std::vector<IndexEntry> mByUnit;
+
+  std::unique_ptr<MemoryMappedFile> mMapping;
+  uint64_t mMappedSize {};
+
+  void Load();
+  // Moves everything after `validSize` to `mDamagedTailPath`
+  bool MoveDamagedTail(std::span<const std::byte> data, uint64_t validSize);
+  void AddToIndex(
+    const Guid& product,
+    const Guid& unit,
+    int64_t time,
+    uint64_t offset);
+  std::span<const std::byte> GetMappedData();
+  ResultView GetView(std::span<const std::byte> data, uint64_t offset) const;
+};
+
+// A result for the current state of `device`; it passes if
+// `IsFullyTested()`
+ResultsDatabase::UnitResult MakeUnitResult(
+  const DeviceInfo& device,
+  const ResultsDatabase::TimingStats& poll,
+  const ResultsDatabase::TimingStats& getState,
+  ResultsDatabase::Clock::time_point time = ResultsDatabase::Clock::now());
+
+}// namespace FredEmmott::ControllerTester
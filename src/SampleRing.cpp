@@ -0,0 +1,175 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "SampleRing.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+
+namespace FredEmmott::ControllerTester {
+
+// Other processes may use the ring, so it can't rely on a lock table
+static_assert(std::atomic<uint64_t>::is_always_lock_free);
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t));
+
+namespace {
+
+constexpr uint64_t Pack(int32_t low, int32_t high) {
+  return static_cast<uint64_t>(static_cast<uint32_t>(low))
+    | (static_cast<uint64_t>(static_cast<uint32_t>(high)) << 32);
+}
+
+constexpr int32_t Unpack(uint64_t word, std::size_t half) {
+  return static_cast<int32_t>(static_cast<uint32_t>(word >> (half * 32)));
+}
+
+}// namespace
+
+SampleRing::SampleRing(
+  std::size_t axisCount,
+  std::size_t hatCount,
+  std::size_t buttonCount,
+  std::size_t minimumCapacity)
+  : mAxisCount(axisCount),
+    mHatCount(hatCount),
+    mButtonWordCount(DeviceState::GetButtonWordCount(buttonCount)),
+    mWordsPerSample(GetWordsPerSample(axisCount, hatCount, buttonCount)),
+    mCapacity(std::bit_ceil(std::max<std::size_t>(minimumCapacity, 1))) {
+  const auto size
+    = GetStorageWordCount(axisCount, hatCount, buttonCount, mCapacity);
+  // Value-initialized, i.e. zeroed
+  mOwnedStorage = std::make_unique<std::atomic<uint64_t>[]>(size);
+  this->Attach({mOwnedStorage.get(), size});
+}
+
+SampleRing::SampleRing(
+  std::size_t axisCount,
+  std::size_t hatCount,
+  std::size_t buttonCount,
+  std::size_t capacity,
+  std::span<std::atomic<uint64_t>> storage)
+  : mAxisCount(axisCount),
+    mHatCount(hatCount),
+    mButtonWordCount(DeviceState::GetButtonWordCount(buttonCount)),
+    mWordsPerSample(GetWordsPerSample(axisCount, hatCount, buttonCount)),
+    mCapacity(capacity) {
+  assert(std::has_single_bit(capacity));
+  assert(
+    storage.size()
+    == GetStorageWordCount(axisCount, hatCount, buttonCount, capacity));
+  this->Attach(storage);
+}
+
+void SampleRing::Attach(std::span<std::atomic<uint64_t>> storage) {
+  mClaimed = &storage[0];
+  mEnd = &storage[HEADER_WORDS / 2];
+  mWords = &storage[HEADER_WORDS];
+}
+
+std::size_t SampleRing::GetWordsPerSample(
+  std::size_t axisCount,
+  std::size_t hatCount,
+  std::size_t buttonCount) {
+  return 1 + ((axisCount + hatCount + 1) / 2)
+    + DeviceState::GetButtonWordCount(buttonCount);
+}
+
+std::size_t SampleRing::GetStorageWordCount(
+  std::size_t axisCount,
+  std::size_t hatCount,
+  std::size_t buttonCount,
+  std::size_t capacity) {
+  return HEADER_WORDS
+    + (capacity * GetWordsPerSample(axisCount, hatCount, buttonCount));
+}
+
+void SampleRing::Push(
+  std::chrono::microseconds time,
+  const DeviceState& state) {
+  assert(state.mAxes.size() == mAxisCount);
+  assert(state.mHats.size() == mHatCount);
+  assert(state.mButtons.size() == mButtonWordCount);
+
+  const auto sequence = mEnd->load(std::memory_order_relaxed);
+  // Readers check this after reading, to detect that they may have read a
+  // partially-overwritten sample
+  mClaimed->store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  auto words = &mWords[(sequence & (mCapacity - 1)) * mWordsPerSample];
+  (words++)->store(
+    static_cast<uint64_t>(time.count()), std::memory_order_relaxed);
+
+  const auto valueCount = mAxisCount + mHatCount;
+  const auto value = [&state, this](std::size_t i) {
+    if (i < mAxisCount) {
+      return state.mAxes[i];
+    }
+    return (i - mAxisCount < mHatCount) ? state.mHats[i - mAxisCount] : 0;
+  };
+  for (std::size_t i = 0; i < valueCount; i += 2) {
+    (words++)->store(Pack(value(i), value(i + 1)), std::memory_order_relaxed);
+  }
+  for (const auto buttons: state.mButtons) {
+    (words++)->store(buttons, std::memory_order_relaxed);
+  }
+
+  mEnd->store(sequence + 1, std::memory_order_release);
+}
+
+uint64_t SampleRing::GetEnd() const {
+  return mEnd->load(std::memory_order_acquire);
+}
+
+std::size_t SampleRing::GetCapacity() const {
+  return mCapacity;
+}
+
+std::optional<std::chrono::microseconds> SampleRing::Read(
+  uint64_t sequence,
+  DeviceState& state) const {
+  if (sequence >= mEnd->load(std::memory_order_acquire)) {
+    return std::nullopt;
+  }
+  // Overwritten by the sample `mCapacity` later
+  const auto overwrittenAt = sequence + mCapacity + 1;
+  if (mClaimed->load(std::memory_order_relaxed) >= overwrittenAt) {
+    return std::nullopt;
+  }
+
+  state.mAxes.resize(mAxisCount);
+  state.mHats.resize(mHatCount);
+  state.mButtons.resize(mButtonWordCount);
+
+  auto words = &mWords[(sequence & (mCapacity - 1)) * mWordsPerSample];
+  const std::chrono::microseconds time {
+    static_cast<int64_t>((words++)->load(std::memory_order_relaxed))};
+
+  const auto valueCount = mAxisCount + mHatCount;
+  uint64_t word {};
+  for (std::size_t i = 0; i < valueCount; ++i) {
+    if (i % 2 == 0) {
+      word = (words++)->load(std::memory_order_relaxed);
+    }
+    const auto value = Unpack(word, i % 2);
+    if (i < mAxisCount) {
+      state.mAxes[i] = value;
+    } else {
+      state.mHats[i - mAxisCount] = value;
+    }
+  }
+  for (auto& buttons: state.mButtons) {
+    buttons = (words++)->load(std::memory_order_relaxed);
+  }
+
+  // Pairs with the fence in `Push()`: if any of the loads above saw a newer
+  // sample's data, this sees that sample's claim
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (mClaimed->load(std::memory_order_relaxed) >= overwrittenAt) {
+    return std::nullopt;
+  }
+  return time;
+}
+
+}// namespace FredEmmott::ControllerTester
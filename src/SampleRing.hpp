@@ -0,0 +1,113 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+
+#include "DeviceState.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+/* The most recent states of one device, without locks.
+ *
+ * There is a single writer, which never waits: when the ring is full, the
+ * oldest sample is overwritten. Any number of readers can read any sample
+ * that is still in the ring; reads are validated with sequence counters, so
+ * a reader never sees a sample that was overwritten while it was reading.
+ *
+ * The storage can be provided by the caller, e.g. to share the ring with
+ * other processes; see `GetStorageWordCount()` for the layout.
+ */
+class SampleRing final {
+ public:
+  // The capacity is rounded up to a power of two
+  SampleRing(
+    std::size_t axisCount,
+    std::size_t hatCount,
+    std::size_t buttonCount,
+    std::size_t minimumCapacity);
+  /* Uses `storage` instead of allocating, e.g. shared memory.
+   *
+   * `capacity` must be a power of two, and `storage` must be
+   * `GetStorageWordCount()` words, zeroed before the first `Push()`; it is
+   * never written to by the constructor, so a reader can attach to a ring
+   * that is already in use.
+   */
+  SampleRing(
+    std::size_t axisCount,
+    std::size_t hatCount,
+    std::size_t buttonCount,
+    std::size_t capacity,
+    std::span<std::atomic<uint64_t>> storage);
+
+  /* The storage needed for a ring with exactly `capacity` samples:
+   * - word 0: one past the last sample that the writer has started writing
+   * - word `HEADER_WORDS / 2`: one past the last sample that is completely
+   *   written
+   * - from word `HEADER_WORDS`: `capacity` samples, each of
+   *   `GetWordsPerSample()` words; sample `n` is at index `n % capacity`
+   */
+  static std::size_t GetStorageWordCount(
+    std::size_t axisCount,
+    std::size_t hatCount,
+    std::size_t buttonCount,
+    std::size_t capacity);
+  /* A sample is its time in microseconds, then its axes and hats packed two
+   * per word - low half first, padded with zero - then its button words.
+   */
+  static std::size_t GetWordsPerSample(
+    std::size_t axisCount,
+    std::size_t hatCount,
+    std::size_t buttonCount);
+
+  // The two counters are on separate cache lines, so that readers polling
+  // `GetEnd()` don't slow down the writer's claim
+  static constexpr std::size_t HEADER_WORDS {16};
+
+  SampleRing() = delete;
+  SampleRing(const SampleRing&) = delete;
+  SampleRing(SampleRing&&) = delete;
+  SampleRing& operator=(const SampleRing&) = delete;
+  SampleRing& operator=(SampleRing&&) = delete;
+
+  // Writer only; `state` must have the same control counts as the ring
+  void Push(std::chrono::microseconds time, const DeviceState& state);
+
+  // The sequence number of the next `Push()`
+  uint64_t GetEnd() const;
+  std::size_t GetCapacity() const;
+
+  /* Returns the time that was pushed with the sample; `state` is resized.
+   *
+   * Nullopt if the sample hasn't been pushed yet, or has been overwritten.
+   */
+  std::optional<std::chrono::microseconds> Read(
+    uint64_t sequence,
+    DeviceState& state) const;
+
+ private:
+  std::size_t mAxisCount {};
+  std::size_t mHatCount {};
+  std::size_t mButtonWordCount {};
+  // The time, then axes and hats packed two per word, then buttons
+  std::size_t mWordsPerSample {};
+  std::size_t mCapacity {};
+
+  // Empty if the storage was provided by the caller
+  std::unique_ptr<std::atomic<uint64_t>[]> mOwnedStorage;
+  // One past the last sample that the writer has started writing
+  std::atomic<uint64_t>* mClaimed {nullptr};
+  // One past the last sample that is completely written
+  std::atomic<uint64_t>* mEnd {nullptr};
+  std::atomic<uint64_t>* mWords {nullptr};
+
+  void Attach(std::span<std::atomic<uint64_t>> storage);
+};
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,141 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory_resource>
+#include <optional>
+#include <thread>
+#include <utility>
+
+#include "DeviceInfo.hpp"
+#include "DeviceState.hpp"
+#include "RealTimeThread.hpp"
+#include "TimerResolution.hpp"
+#include "Trace.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+/* Reads a device on its own thread, at a fixed interval.
+ *
+ * The sampler takes ownership of the device, as backends aren't
+ * thread-safe; use `DeviceTracker::OpenAnother()` to sample a device that
+ * the GUI is also showing.
+ *
+ * With `RealTimeSettings::mEnabled`, the thread is pinned, prioritized, and
+ * spins for the end of each wait, for lower jitter in latency measurements.
+ */
+class Sampler final {
+ public:
+  using Clock = std::chrono::steady_clock;
+  // Called on the sampling thread for every sample; nullopt if the device
+  // couldn't be read
+  using Callback = std::function<
+    void(Clock::time_point, const std::optional<DeviceState>&)>;
+
+  template <Device T>
+  Sampler(
+    T&& device,
+    Clock::duration interval,
+    Callback callback,
+    const RealTimeSettings& realTime = {})
+    : mInterval(interval),
+      mRealTime(realTime),
+      mCallback(std::move(callback)),
+      mThread([this, device = std::move(device)](
+                std::stop_token stop) mutable { this->Run(stop, device); }) {
+  }
+
+  Sampler() = delete;
+  Sampler(const Sampler&) = delete;
+  Sampler(Sampler&&) = delete;
+  Sampler& operator=(const Sampler&) = delete;
+  Sampler& operator=(Sampler&&) = delete;
+
+  Clock::duration GetInterval() const {
+    return mInterval;
+  }
+
+  uint64_t GetSampleCount() const {
+    return mSampleCount.load(std::memory_order_relaxed);
+  }
+
+  uint64_t GetFailureCount() const {
+    return mFailureCount.load(std::memory_order_relaxed);
+  }
+
+  // Samples that finished after the next one was due
+  uint64_t GetOverrunCount() const {
+    return mOverrunCount.load(std::memory_order_relaxed);
+  }
+
+  const RealTimeSettings& GetRealTimeSettings() const {
+    return mRealTime;
+  }
+
+  // Nullopt if real-time mode is disabled, or the thread hasn't started yet
+  std::optional<RealTimeStatus> GetRealTimeStatus() const {
+    return mRealTimeStatus.load(std::memory_order_acquire);
+  }
+
+ private:
+  TimerResolution mTimerResolution;
+  Clock::duration mInterval;
+  RealTimeSettings mRealTime;
+  Callback mCallback;
+  std::atomic<std::optional<RealTimeStatus>> mRealTimeStatus;
+  std::atomic<uint64_t> mSampleCount {0};
+  std::atomic<uint64_t> mFailureCount {0};
+  std::atomic<uint64_t> mOverrunCount {0};
+  // Last, so that it's stopped before anything it uses is destroyed
+  std::jthread mThread;
+
+  template <Device T>
+  void Run(std::stop_token stop, T& device) {
+    Trace::SetThreadName("Sampler: " + device.mName);
+    // Enough for the largest DirectInput state; states are decoded into
+    // this instead of the heap
+    alignas(std::max_align_t) std::array<std::byte, 4096> buffer;
+
+    std::optional<RealTimeThread> realTime;
+    if (mRealTime.mEnabled) {
+      realTime.emplace(mRealTime, buffer);
+      mRealTimeStatus.store(realTime->GetStatus(), std::memory_order_release);
+    }
+
+    auto next = Clock::now();
+    while (!stop.stop_requested()) {
+      {
+        const Trace::Zone traceZone {"Sampler::Sample"};
+        std::pmr::monotonic_buffer_resource resource {
+          buffer.data(), buffer.size()};
+        device.Poll();
+        const auto state = device.GetState(&resource);
+        mCallback(Clock::now(), state);
+        (state ? mSampleCount : mFailureCount)
+          .fetch_add(1, std::memory_order_relaxed);
+      }
+
+      next += mInterval;
+      const auto now = Clock::now();
+      if (next < now) {
+        // Skip the missed deadlines rather than sampling in a burst
+        mOverrunCount.fetch_add(1, std::memory_order_relaxed);
+        next = now;
+        continue;
+      }
+      if (realTime) {
+        realTime->WaitUntil(next);
+      } else {
+        std::this_thread::sleep_until(next);
+      }
+    }
+  }
+};
+
+}// namespace FredEmmott::ControllerTester
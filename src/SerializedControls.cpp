@@ -0,0 +1,112 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "SerializedControls.hpp"
+
+#include <cstring>
+
+namespace FredEmmott::ControllerTester {
+
+namespace {
+
+void AddControl(
+  SerializedControls& out,
+  const std::string& name,
+  const Guid& type,
+  int32_t min,
+  int32_t max,
+  uint32_t hatType) {
+  out.mRecords.push_back(SerializedControl {
+    .mType = type,
+    .mMin = min,
+    .mMax = max,
+    .mHatType = hatType,
+    .mNameOffset = static_cast<uint32_t>(out.mStrings.size()),
+    .mNameLength = static_cast<uint32_t>(name.size()),
+  });
+  out.mStrings += name;
+}
+
+}// namespace
+
+SerializedControls SerializeControls(const DeviceInfo& info) {
+  SerializedControls ret;
+  ret.mRecords.reserve(
+    info.mAxes.size() + info.mButtons.size() + info.mHats.size());
+  for (const auto& axis: info.mAxes) {
+    AddControl(ret, axis.mName, axis.mGuid, axis.mMin, axis.mMax, 0);
+  }
+  for (const auto& button: info.mButtons) {
+    AddControl(ret, button.mName, button.mGuid, 0, 0, 0);
+  }
+  for (const auto& hat: info.mHats) {
+    AddControl(
+      ret, hat.mName, hat.mGuid, 0, 0, static_cast<uint32_t>(hat.mType));
+  }
+  return ret;
+}
+
+bool DeserializeControls(
+  std::span<const std::byte> records,
+  std::string_view strings,
+  std::size_t axisCount,
+  std::size_t buttonCount,
+  std::size_t hatCount,
+  DeviceInfo& info) {
+  const auto recordCount = axisCount + buttonCount + hatCount;
+  if (records.size() != recordCount * sizeof(SerializedControl)) {
+    return false;
+  }
+
+  std::vector<AxisInfo> axes;
+  std::vector<ButtonInfo> buttons;
+  std::vector<HatInfo> hats;
+  axes.reserve(axisCount);
+  buttons.reserve(buttonCount);
+  hats.reserve(hatCount);
+
+  for (std::size_t i = 0; i < recordCount; ++i) {
+    SerializedControl record;
+    std::memcpy(
+      &record, records.data() + (i * sizeof(record)), sizeof(record));
+    if (
+      record.mNameOffset > strings.size()
+      || record.mNameLength > strings.size() - record.mNameOffset) {
+      return false;
+    }
+    std::string name {strings.substr(record.mNameOffset, record.mNameLength)};
+
+    if (i < axisCount) {
+      axes.push_back(AxisInfo {
+        .mName = std::move(name),
+        .mGuid = record.mType,
+        .mMin = record.mMin,
+        .mMax = record.mMax,
+      });
+      continue;
+    }
+    if (i < axisCount + buttonCount) {
+      buttons.push_back(ButtonInfo {
+        .mName = std::move(name),
+        .mGuid = record.mType,
+      });
+      continue;
+    }
+
+    if (record.mHatType > static_cast<uint32_t>(HatType::Other)) {
+      return false;
+    }
+    hats.push_back(HatInfo {
+      .mName = std::move(name),
+      .mGuid = record.mType,
+      .mType = static_cast<HatType>(record.mHatType),
+    });
+  }
+
+  info.mAxes = std::move(axes);
+  info.mButtons = std::move(buttons);
+  info.mHats = std::move(hats);
+  return true;
+}
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,56 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "DeviceInfo.hpp"
+#include "Guid.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+/* Control descriptions, as stored in files such as layout caches and
+ * captures.
+ *
+ * Records are fixed-size, for the axes, then buttons, then hats; names are
+ * in a separate string table.
+ */
+struct SerializedControl {
+  Guid mType;
+  int32_t mMin {};
+  int32_t mMax {};
+  uint32_t mHatType {};
+  // Into the string table
+  uint32_t mNameOffset {};
+  uint32_t mNameLength {};
+};
+static_assert(std::is_trivially_copyable_v<SerializedControl>);
+
+struct SerializedControls {
+  std::vector<SerializedControl> mRecords;
+  std::string mStrings;
+};
+
+SerializedControls SerializeControls(const DeviceInfo&);
+
+/* Replaces the controls in `info`.
+ *
+ * `records` is `axes + buttons + hats` packed records, not necessarily
+ * aligned. Returns false, leaving `info` unchanged, if any record is
+ * invalid.
+ */
+bool DeserializeControls(
+  std::span<const std::byte> records,
+  std::string_view strings,
+  std::size_t axes,
+  std::size_t buttons,
+  std::size_t hats,
+  DeviceInfo& info);
+
+}// namespace FredEmmott::ControllerTester
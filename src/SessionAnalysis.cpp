@@ -0,0 +1,122 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "SessionAnalysis.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+
+#include "ControlAnalysis.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+double AxisNoise::GetRMS() const {
+  if (mSamples == 0) {
+    return 0;
+  }
+  return std::sqrt(mSumOfSquares / static_cast<double>(mSamples));
+}
+
+SessionAnalyzer::SessionAnalyzer(
+  DeviceInfo& device,
+  const AnalysisThresholds& thresholds)
+  : mDevice(device),
+    mThresholds(thresholds),
+    mAxisNoise(device.mAxes.size()),
+    mButtonBounce(device.mButtons.size()),
+    mLastTransitions(device.mButtons.size()) {
+  mNoiseLimits.reserve(device.mAxes.size());
+  for (const auto& axis: device.mAxes) {
+    const auto range = static_cast<double>(axis.mMax) - axis.mMin;
+    mNoiseLimits.push_back(
+      static_cast<int32_t>(std::max(0.0, range * thresholds.mNoiseFraction)));
+  }
+}
+
+void SessionAnalyzer::Push(
+  std::chrono::microseconds time,
+  const DeviceState& state) {
+  assert(state.mAxes.size() == mDevice.mAxes.size());
+  assert(state.mHats.size() == mDevice.mHats.size());
+  const bool first = (mSampleCount++ == 0);
+
+  for (std::size_t i = 0; i < mDevice.mAxes.size(); ++i) {
+    const auto value = state.mAxes[i];
+    UpdateAxisExtents(mDevice.mAxes[i], value);
+    if (first) {
+      continue;
+    }
+    const auto delta
+      = std::abs(static_cast<int64_t>(value) - mPrevious.mAxes[i]);
+    if (delta > mNoiseLimits[i]) {
+      continue;
+    }
+    auto& noise = mAxisNoise[i];
+    noise.mSumOfSquares += static_cast<double>(delta * delta);
+    ++noise.mSamples;
+    noise.mMaxDelta = std::max(noise.mMaxDelta, static_cast<int32_t>(delta));
+  }
+
+  for (std::size_t i = 0; i < mDevice.mHats.size(); ++i) {
+    UpdateHatSeen(mDevice.mHats[i], state.mHats[i]);
+  }
+
+  if (first) {
+    for (std::size_t i = 0; i < mDevice.mButtons.size(); ++i) {
+      UpdateButtonSeen(mDevice.mButtons[i], state.IsButtonPressed(i));
+    }
+  } else {
+    // Coverage can only change when a button does, so only visit those
+    for (std::size_t word = 0; word < state.mButtons.size(); ++word) {
+      auto changed = state.mButtons[word] ^ mPrevious.mButtons[word];
+      while (changed) {
+        const auto bit = static_cast<std::size_t>(std::countr_zero(changed));
+        changed &= changed - 1;
+        const auto index = (word * DeviceState::BUTTONS_PER_WORD) + bit;
+        const auto pressed = state.IsButtonPressed(index);
+        UpdateButtonSeen(mDevice.mButtons[index], pressed);
+        if (pressed) {
+          ++mButtonBounce[index].mPresses;
+        }
+        this->PushButtonTransition(index, time);
+      }
+    }
+  }
+
+  mPrevious.mAxes.assign(state.mAxes.begin(), state.mAxes.end());
+  mPrevious.mHats.assign(state.mHats.begin(), state.mHats.end());
+  mPrevious.mButtons.assign(state.mButtons.begin(), state.mButtons.end());
+}
+
+void SessionAnalyzer::PushButtonTransition(
+  std::size_t index,
+  std::chrono::microseconds time) {
+  auto& last = mLastTransitions[index];
+  if (last) {
+    const auto interval = time - *last;
+    auto& bounce = mButtonBounce[index];
+    if (interval < mThresholds.mBounceWindow) {
+      ++bounce.mBounces;
+    }
+    bounce.mShortestInterval = bounce.mShortestInterval
+      ? std::min(*bounce.mShortestInterval, interval)
+      : interval;
+  }
+  last = time;
+}
+
+std::size_t SessionAnalyzer::GetSampleCount() const {
+  return mSampleCount;
+}
+
+const std::vector<AxisNoise>& SessionAnalyzer::GetAxisNoise() const {
+  return mAxisNoise;
+}
+
+const std::vector<ButtonBounce>& SessionAnalyzer::GetButtonBounce() const {
+  return mButtonBounce;
+}
+
+}// namespace FredEmmott::ControllerTester
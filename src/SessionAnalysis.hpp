@@ -0,0 +1,78 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "DeviceInfo.hpp"
+#include "DeviceState.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+struct AnalysisThresholds {
+  // A button changing state again within this time is a bounce
+  std::chrono::microseconds mBounceWindow {std::chrono::milliseconds {5}};
+  // Sample-to-sample axis changes up to this fraction of the range are
+  // treated as noise rather than movement
+  float mNoiseFraction {0.01f};
+};
+
+struct AxisNoise {
+  // Root-mean-square of sample-to-sample changes within the noise threshold,
+  // in device units
+  double GetRMS() const;
+
+  double mSumOfSquares {};
+  uint64_t mSamples {};
+  int32_t mMaxDelta {};
+};
+
+struct ButtonBounce {
+  uint32_t mPresses {};
+  uint32_t mBounces {};
+  // Between any two transitions; nullopt if there were fewer than two
+  std::optional<std::chrono::microseconds> mShortestInterval;
+};
+
+/* Coverage, bounce, and noise for a sequence of states from one device.
+ *
+ * Coverage is tracked in the device's own `AxisInfo` etc, with the same
+ * functions as the GUI, so results match what the GUI would have shown for
+ * the same samples.
+ */
+class SessionAnalyzer final {
+ public:
+  SessionAnalyzer(DeviceInfo&, const AnalysisThresholds&);
+
+  SessionAnalyzer() = delete;
+  SessionAnalyzer(const SessionAnalyzer&) = delete;
+  SessionAnalyzer(SessionAnalyzer&&) = delete;
+  SessionAnalyzer& operator=(const SessionAnalyzer&) = delete;
+  SessionAnalyzer& operator=(SessionAnalyzer&&) = delete;
+
+  // `time` must not decrease
+  void Push(std::chrono::microseconds time, const DeviceState&);
+
+  std::size_t GetSampleCount() const;
+  const std::vector<AxisNoise>& GetAxisNoise() const;
+  const std::vector<ButtonBounce>& GetButtonBounce() const;
+
+ private:
+  DeviceInfo& mDevice;
+  AnalysisThresholds mThresholds;
+  std::vector<int32_t> mNoiseLimits;
+
+  std::size_t mSampleCount {};
+  DeviceState mPrevious;
+  std::vector<AxisNoise> mAxisNoise;
+  std::vector<ButtonBounce> mButtonBounce;
+  std::vector<std::optional<std::chrono::microseconds>> mLastTransitions;
+
+  void PushButtonTransition(std::size_t index, std::chrono::microseconds time);
+};
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,218 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "SharedMemory.hpp"
+
+#include <cerrno>
+#include <cstdint>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace FredEmmott::ControllerTester {
+
+#ifdef _WIN32
+namespace {
+
+std::wstring GetMappingName(std::string_view name) {
+  // Per-session, so this doesn't need `SeCreateGlobalPrivilege`
+  std::wstring ret {L"Local\\"};
+  ret.append(name.begin(), name.end());
+  return ret;
+}
+
+std::error_code GetLastWin32Error() {
+  return {static_cast<int>(GetLastError()), std::system_category()};
+}
+
+}// namespace
+
+SharedMemory::SharedMemory(
+  std::string_view name,
+  std::size_t size,
+  IsAbandoned) {
+  const auto mapping = CreateFileMappingW(
+    INVALID_HANDLE_VALUE,
+    nullptr,
+    PAGE_READWRITE,
+    static_cast<DWORD>(static_cast<uint64_t>(size) >> 32),
+    static_cast<DWORD>(size),
+    GetMappingName(name).c_str());
+  if (!mapping) {
+    mError = GetLastWin32Error();
+    return;
+  }
+  if (GetLastError() == ERROR_ALREADY_EXISTS) {
+    CloseHandle(mapping);
+    mError = std::make_error_code(std::errc::file_exists);
+    return;
+  }
+  // Pagefile-backed mappings are zero-filled
+  mData = static_cast<std::byte*>(
+    MapViewOfFile(mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, size));
+  if (!mData) {
+    mError = GetLastWin32Error();
+    CloseHandle(mapping);
+    return;
+  }
+  // Unlike a file, the mapping must stay open for other processes to find it
+  mMapping = mapping;
+  mSize = size;
+  mIsWritable = true;
+}
+
+SharedMemory::SharedMemory(std::string_view name) {
+  const auto mapping
+    = OpenFileMappingW(FILE_MAP_READ, FALSE, GetMappingName(name).c_str());
+  if (!mapping) {
+    mError = GetLastWin32Error();
+    return;
+  }
+  mData
+    = static_cast<std::byte*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+  if (!mData) {
+    mError = GetLastWin32Error();
+  }
+  // The view keeps the mapping alive
+  CloseHandle(mapping);
+  if (!mData) {
+    return;
+  }
+  // Views are rounded up to whole pages; the owner's header has the exact
+  // size
+  MEMORY_BASIC_INFORMATION info {};
+  if (VirtualQuery(mData, &info, sizeof(info)) == 0) {
+    mError = GetLastWin32Error();
+    UnmapViewOfFile(mData);
+    mData = nullptr;
+    return;
+  }
+  mSize = info.RegionSize;
+}
+
+SharedMemory::~SharedMemory() {
+  if (mData) {
+    UnmapViewOfFile(mData);
+  }
+  if (mMapping) {
+    CloseHandle(mMapping);
+  }
+}
+#else
+namespace {
+
+std::string GetObjectName(std::string_view name) {
+  std::string ret {"/"};
+  ret.append(name);
+  return ret;
+}
+
+std::error_code GetLastPosixError() {
+  return {errno, std::generic_category()};
+}
+
+int CreateObject(const std::string& objectName) {
+  // `O_EXCL`, so another process's region is never replaced
+  return shm_open(
+    objectName.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0600);
+}
+
+}// namespace
+
+SharedMemory::SharedMemory(
+  std::string_view name,
+  std::size_t size,
+  IsAbandoned isAbandoned) {
+  const auto objectName = GetObjectName(name);
+  auto fd = CreateObject(objectName);
+  if (fd == -1 && errno == EEXIST && isAbandoned) {
+    if (isAbandoned(SharedMemory {name}.GetData())) {
+      // Readers that still have the old region mapped keep their view
+      shm_unlink(objectName.c_str());
+      fd = CreateObject(objectName);
+    } else {
+      errno = EEXIST;
+    }
+  }
+  if (fd == -1) {
+    mError = GetLastPosixError();
+    return;
+  }
+  // Extending the object zero-fills it
+  if (ftruncate(fd, static_cast<off_t>(size)) == 0) {
+    const auto data
+      = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data != MAP_FAILED) {
+      mData = static_cast<std::byte*>(data);
+      mSize = size;
+      mIsWritable = true;
+      mName = objectName;
+    }
+  }
+  if (!mData) {
+    mError = GetLastPosixError();
+  }
+  close(fd);
+  if (!mData) {
+    shm_unlink(objectName.c_str());
+  }
+}
+
+SharedMemory::SharedMemory(std::string_view name) {
+  const auto fd
+    = shm_open(GetObjectName(name).c_str(), O_RDONLY | O_CLOEXEC, 0);
+  if (fd == -1) {
+    mError = GetLastPosixError();
+    return;
+  }
+
+  struct stat info {};
+  if (fstat(fd, &info) == 0 && info.st_size > 0) {
+    const auto size = static_cast<std::size_t>(info.st_size);
+    const auto data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data != MAP_FAILED) {
+      mData = static_cast<std::byte*>(data);
+      mSize = size;
+    }
+  }
+  if (!mData) {
+    // Also for an empty region, where `errno` isn't set
+    mError = std::make_error_code(std::errc::no_such_file_or_directory);
+  }
+  // The mapping keeps the object alive
+  close(fd);
+}
+
+SharedMemory::~SharedMemory() {
+  if (mData) {
+    munmap(mData, mSize);
+  }
+  // Existing mappings stay valid; this only stops new readers finding it
+  if (!mName.empty()) {
+    shm_unlink(mName.c_str());
+  }
+}
+#endif
+
+std::span<const std::byte> SharedMemory::GetData() const {
+  return {mData, mSize};
+}
+
+std::span<std::byte> SharedMemory::GetWritableData() const {
+  if (!mIsWritable) {
+    return {};
+  }
+  return {mData, mSize};
+}
+
+std::error_code SharedMemory::GetError() const {
+  return mError;
+}
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,69 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+namespace FredEmmott::ControllerTester {
+
+/* A named region of memory that other processes can map.
+ *
+ * This is POSIX shared memory, or a pagefile-backed file mapping on Windows.
+ * The name should be a plain identifier; it's decorated as each platform
+ * requires.
+ *
+ * If the region can't be created or opened, the view is empty; callers are
+ * expected to treat that the same as there being nothing to share.
+ */
+class SharedMemory final {
+ public:
+  // Given an existing region's contents; true if the process that created
+  // it has gone without removing it
+  using IsAbandoned = bool (*)(std::span<const std::byte>);
+
+  /* Creates a zeroed, writable region.
+   *
+   * Fails if a region with the same name exists, as it may be in use by
+   * another process. On Windows, a region is destroyed with its last
+   * handle; on POSIX, a region left over from a process that crashed lasts
+   * until it's removed, so it's replaced if `isAbandoned` says so.
+   */
+  SharedMemory(
+    std::string_view name,
+    std::size_t size,
+    IsAbandoned isAbandoned = nullptr);
+  // Opens an existing region, read-only
+  explicit SharedMemory(std::string_view name);
+  ~SharedMemory();
+
+  SharedMemory() = delete;
+  SharedMemory(const SharedMemory&) = delete;
+  SharedMemory(SharedMemory&&) = delete;
+  SharedMemory& operator=(const SharedMemory&) = delete;
+  SharedMemory& operator=(SharedMemory&&) = delete;
+
+  std::span<const std::byte> GetData() const;
+  // Empty unless this process created the region
+  std::span<std::byte> GetWritableData() const;
+  // Why the view is empty; `std::errc::file_exists` if the region already
+  // existed when creating it
+  std::error_code GetError() const;
+
+ private:
+  std::byte* mData {nullptr};
+  std::size_t mSize {};
+  bool mIsWritable {false};
+  std::error_code mError;
+#ifdef _WIN32
+  void* mMapping {nullptr};
+#else
+  // Set if this process created the region, and should remove it
+  std::string mName;
+#endif
+};
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,437 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "SharedSampleFeed.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <span>
+
+#include "SerializedControls.hpp"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+namespace FredEmmott::ControllerTester {
+
+namespace {
+
+// Keeps the ring's counters off the cache lines of the header, which
+// readers only load once
+constexpr std::size_t RING_ALIGNMENT {64};
+
+// Readers can't retry forever if the writer crashed mid-update
+constexpr std::size_t DIRECTORY_READ_ATTEMPTS {1000};
+
+constexpr std::size_t AlignRing(std::size_t size) {
+  return (size + RING_ALIGNMENT - 1) & ~(RING_ALIGNMENT - 1);
+}
+
+// Readers map feeds read-only; loads don't write, but `atomic_ref<const T>`
+// isn't available until C++26
+template <class T>
+std::atomic_ref<T> AtomicRef(const T& value) {
+  return std::atomic_ref<T> {const_cast<T&>(value)};
+}
+
+uint32_t GetProcessID() {
+#ifdef _WIN32
+  return static_cast<uint32_t>(GetCurrentProcessId());
+#else
+  return static_cast<uint32_t>(getpid());
+#endif
+}
+
+// Only POSIX needs to know: a Windows region is destroyed with the last
+// process that has it open
+bool IsProcessRunning(uint32_t processID) {
+#ifdef _WIN32
+  return true;
+#else
+  // 0 would signal our own process group; the header isn't filled in yet
+  if (processID == 0) {
+    return true;
+  }
+  // `EPERM` is a process that we can't signal, but it's running
+  return !(kill(static_cast<pid_t>(processID), 0) == -1 && errno == ESRCH);
+#endif
+}
+
+// For `SharedMemory`: a region whose writer crashed, so it was never removed
+template <class T>
+bool IsAbandoned(std::span<const std::byte> data) {
+  if (data.size() < sizeof(T)) {
+    return false;
+  }
+  const auto& header = *reinterpret_cast<const T*>(data.data());
+  if (
+    header.mMagic != T::MAGIC
+    || AtomicRef(header.mVersion).load(std::memory_order_acquire)
+      != T::VERSION) {
+    return false;
+  }
+  return !IsProcessRunning(header.mWriterProcessID);
+}
+
+// The writer of a version 1 directory can't be found, and this version can't
+// read it anyway
+bool IsDirectoryAbandoned(std::span<const std::byte> data) {
+  if (data.size() >= 2 * sizeof(uint32_t)) {
+    const auto& header
+      = *reinterpret_cast<const SharedFeedDirectoryHeader*>(data.data());
+    if (
+      header.mMagic == SharedFeedDirectoryHeader::MAGIC
+      && AtomicRef(header.mVersion).load(std::memory_order_acquire) == 1) {
+      return true;
+    }
+  }
+  return IsAbandoned<SharedFeedDirectoryHeader>(data);
+}
+
+std::span<std::atomic<uint64_t>> GetRingStorage(
+  std::span<const std::byte> feed,
+  const SharedFeedHeader& header) {
+  const auto words = SampleRing::GetStorageWordCount(
+    header.mAxisCount, header.mHatCount, header.mButtonCount, header.mCapacity);
+  return {
+    reinterpret_cast<std::atomic<uint64_t>*>(
+      const_cast<std::byte*>(feed.data() + header.mRingOffset)),
+    words,
+  };
+}
+
+}// namespace
+
+std::string GetSharedFeedName(const Guid& unit) {
+  constexpr std::string_view digits {"0123456789abcdef"};
+  std::string ret {"freds-controller-tester-feed-"};
+  std::array<uint8_t, sizeof(Guid)> bytes {};
+  std::memcpy(bytes.data(), &unit, sizeof(unit));
+  for (const auto byte: bytes) {
+    ret += digits[byte >> 4];
+    ret += digits[byte & 0xf];
+  }
+  return ret;
+}
+
+SharedFeedDirectory::SharedFeedDirectory()
+  : mMemory(
+    SHARED_FEED_DIRECTORY_NAME,
+    sizeof(SharedFeedDirectoryHeader),
+    &IsDirectoryAbandoned) {
+  const auto data = mMemory.GetWritableData();
+  if (data.empty()) {
+    return;
+  }
+  mHeader = new (data.data()) SharedFeedDirectoryHeader {
+    .mMagic = SharedFeedDirectoryHeader::MAGIC,
+    .mWriterProcessID = GetProcessID(),
+  };
+  AtomicRef(mHeader->mVersion)
+    .store(SharedFeedDirectoryHeader::VERSION, std::memory_order_release);
+}
+
+bool SharedFeedDirectory::IsValid() const {
+  return mHeader;
+}
+
+void SharedFeedDirectory::Add(const Guid& unit) {
+  if (std::ranges::find(mUnits, unit) == mUnits.end()) {
+    mUnits.push_back(unit);
+    this->Publish();
+  }
+}
+
+void SharedFeedDirectory::Remove(const Guid& unit) {
+  if (std::erase(mUnits, unit)) {
+    this->Publish();
+  }
+}
+
+void SharedFeedDirectory::Publish() {
+  if (!mHeader) {
+    return;
+  }
+  auto sequence = AtomicRef(mHeader->mSequence);
+  const auto before = sequence.load(std::memory_order_relaxed);
+  sequence.store(before + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  const auto count
+    = std::min(mUnits.size(), SharedFeedDirectoryHeader::MAX_FEEDS);
+  AtomicRef(mHeader->mCount).store(count, std::memory_order_relaxed);
+  for (std::size_t i = 0; i < count; ++i) {
+    const auto words = std::bit_cast<std::array<uint64_t, 2>>(mUnits[i]);
+    for (std::size_t j = 0; j < words.size(); ++j) {
+      AtomicRef(mHeader->mUnits[i][j])
+        .store(words[j], std::memory_order_relaxed);
+    }
+  }
+
+  sequence.store(before + 2, std::memory_order_release);
+}
+
+std::vector<Guid> GetSharedFeeds() {
+  const SharedMemory memory {SHARED_FEED_DIRECTORY_NAME};
+  const auto data = memory.GetData();
+  if (data.size() < sizeof(SharedFeedDirectoryHeader)) {
+    return {};
+  }
+  const auto& header
+    = *reinterpret_cast<const SharedFeedDirectoryHeader*>(data.data());
+  if (
+    AtomicRef(header.mVersion).load(std::memory_order_acquire)
+      != SharedFeedDirectoryHeader::VERSION
+    || header.mMagic != SharedFeedDirectoryHeader::MAGIC) {
+    return {};
+  }
+
+  std::vector<Guid> ret;
+  ret.reserve(SharedFeedDirectoryHeader::MAX_FEEDS);
+  for (std::size_t attempt = 0; attempt < DIRECTORY_READ_ATTEMPTS;
+       ++attempt) {
+    const auto before
+      = AtomicRef(header.mSequence).load(std::memory_order_acquire);
+    if (before % 2) {
+      continue;
+    }
+    const auto count = std::min<std::size_t>(
+      AtomicRef(header.mCount).load(std::memory_order_relaxed),
+      SharedFeedDirectoryHeader::MAX_FEEDS);
+    ret.clear();
+    for (std::size_t i = 0; i < count; ++i) {
+      std::array<uint64_t, 2> words {};
+      for (std::size_t j = 0; j < words.size(); ++j) {
+        words[j]
+          = AtomicRef(header.mUnits[i][j]).load(std::memory_order_relaxed);
+      }
+      ret.push_back(std::bit_cast<Guid>(words));
+    }
+    // As `SampleRing::Read()`
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (AtomicRef(header.mSequence).load(std::memory_order_relaxed) == before) {
+      return ret;
+    }
+  }
+  return {};
+}
+
+SharedFeedWriter::SharedFeedWriter(
+  const DeviceInfo& device,
+  std::size_t minimumCapacity,
+  SharedFeedDirectory* directory)
+  : mUnit(device.mGuid), mDirectory(directory) {
+  const auto axisCount = device.mAxes.size();
+  const auto buttonCount = device.mButtons.size();
+  const auto hatCount = device.mHats.size();
+  const auto capacity
+    = std::bit_ceil(std::max<std::size_t>(minimumCapacity, 1));
+
+  const auto controls = SerializeControls(device);
+  const auto recordsSize
+    = controls.mRecords.size() * sizeof(SerializedControl);
+  const auto ringOffset = AlignRing(
+    sizeof(SharedFeedHeader) + recordsSize + device.mName.size()
+    + controls.mStrings.size());
+  const auto ringWords = SampleRing::GetStorageWordCount(
+    axisCount, hatCount, buttonCount, capacity);
+  const auto size = ringOffset + (ringWords * sizeof(uint64_t));
+
+  mMemory.emplace(
+    GetSharedFeedName(device.mGuid), size, &IsAbandoned<SharedFeedHeader>);
+  const auto data = mMemory->GetWritableData();
+  if (data.empty()) {
+    return;
+  }
+
+  const auto epoch = std::chrono::system_clock::now()
+    - std::chrono::duration_cast<std::chrono::system_clock::duration>(
+      Clock::now() - mEpoch);
+  mHeader = new (data.data()) SharedFeedHeader {
+    .mMagic = SharedFeedHeader::MAGIC,
+    .mWriterProcessID = GetProcessID(),
+    .mProduct = device.mProduct,
+    .mUnit = device.mGuid,
+    .mEpoch = std::chrono::duration_cast<std::chrono::microseconds>(
+                epoch.time_since_epoch())
+                .count(),
+    .mAxisCount = static_cast<uint32_t>(axisCount),
+    .mButtonCount = static_cast<uint32_t>(buttonCount),
+    .mHatCount = static_cast<uint32_t>(hatCount),
+    .mNameBytes = static_cast<uint32_t>(device.mName.size()),
+    .mStringBytes = static_cast<uint32_t>(controls.mStrings.size()),
+    .mCapacity = static_cast<uint32_t>(capacity),
+    .mWordsPerSample = static_cast<uint32_t>(
+      SampleRing::GetWordsPerSample(axisCount, hatCount, buttonCount)),
+    .mRingOffset = ringOffset,
+    .mSize = size,
+  };
+
+  auto it = data.data() + sizeof(SharedFeedHeader);
+  std::memcpy(it, controls.mRecords.data(), recordsSize);
+  it += recordsSize;
+  std::memcpy(it, device.mName.data(), device.mName.size());
+  it += device.mName.size();
+  std::memcpy(it, controls.mStrings.data(), controls.mStrings.size());
+
+  // The new region is zeroed, which is an empty ring
+  mRing.emplace(
+    axisCount, hatCount, buttonCount, capacity, GetRingStorage(data, *mHeader));
+  AtomicRef(mHeader->mVersion)
+    .store(SharedFeedHeader::VERSION, std::memory_order_release);
+
+  if (mDirectory) {
+    mDirectory->Add(mUnit);
+  }
+}
+
+SharedFeedWriter::~SharedFeedWriter() {
+  if (!mHeader) {
+    return;
+  }
+  AtomicRef(mHeader->mClosed).store(1, std::memory_order_release);
+  if (mDirectory) {
+    mDirectory->Remove(mUnit);
+  }
+}
+
+bool SharedFeedWriter::IsValid() const {
+  return mHeader;
+}
+
+std::error_code SharedFeedWriter::GetError() const {
+  return mMemory ? mMemory->GetError() : std::error_code {};
+}
+
+void SharedFeedWriter::Push(Clock::time_point time, const DeviceState& state) {
+  if (!mRing) {
+    return;
+  }
+  mRing->Push(
+    std::chrono::duration_cast<std::chrono::microseconds>(time - mEpoch),
+    state);
+}
+
+SharedFeedReader::SharedFeedReader(const Guid& unit)
+  : mMemory(GetSharedFeedName(unit)) {
+  const auto data = mMemory.GetData();
+  if (data.size() < sizeof(SharedFeedHeader)) {
+    return;
+  }
+  const auto& header = *reinterpret_cast<const SharedFeedHeader*>(data.data());
+  if (
+    AtomicRef(header.mVersion).load(std::memory_order_acquire)
+      != SharedFeedHeader::VERSION
+    || header.mMagic != SharedFeedHeader::MAGIC) {
+    return;
+  }
+
+  // Don't trust anything that would take us outside of the mapping
+  const std::size_t recordCount = static_cast<std::size_t>(header.mAxisCount)
+    + header.mButtonCount + header.mHatCount;
+  const auto recordsSize = recordCount * sizeof(SerializedControl);
+  const auto wordsPerSample = SampleRing::GetWordsPerSample(
+    header.mAxisCount, header.mHatCount, header.mButtonCount);
+  if (
+    header.mSize > data.size() || recordsSize > header.mSize
+    || header.mWordsPerSample != wordsPerSample
+    || !std::has_single_bit(header.mCapacity)
+    || header.mCapacity > header.mSize / (wordsPerSample * sizeof(uint64_t))) {
+    return;
+  }
+  const auto minimumRingOffset = sizeof(header) + recordsSize
+    + header.mNameBytes + header.mStringBytes;
+  const auto ringSize = sizeof(uint64_t)
+    * SampleRing::GetStorageWordCount(
+      header.mAxisCount,
+      header.mHatCount,
+      header.mButtonCount,
+      header.mCapacity);
+  if (
+    header.mRingOffset < minimumRingOffset
+    || header.mRingOffset % RING_ALIGNMENT != 0
+    || header.mRingOffset > header.mSize
+    || ringSize > header.mSize - header.mRingOffset) {
+    return;
+  }
+
+  const auto records = data.subspan(sizeof(header), recordsSize);
+  const std::string_view name {
+    reinterpret_cast<const char*>(records.data() + recordsSize),
+    header.mNameBytes};
+  const std::string_view strings {
+    name.data() + name.size(), header.mStringBytes};
+  if (!DeserializeControls(
+        records,
+        strings,
+        header.mAxisCount,
+        header.mButtonCount,
+        header.mHatCount,
+        mDeviceInfo)) {
+    return;
+  }
+  mDeviceInfo.mName = std::string {name};
+  mDeviceInfo.mGuid = header.mUnit;
+  mDeviceInfo.mProduct = header.mProduct;
+
+  mRing.emplace(
+    header.mAxisCount,
+    header.mHatCount,
+    header.mButtonCount,
+    header.mCapacity,
+    GetRingStorage(data, header));
+  mHeader = &header;
+}
+
+bool SharedFeedReader::IsValid() const {
+  return mHeader;
+}
+
+bool SharedFeedReader::IsClosed() const {
+  return mHeader
+    && AtomicRef(mHeader->mClosed).load(std::memory_order_acquire) != 0;
+}
+
+const DeviceInfo& SharedFeedReader::GetDeviceInfo() const {
+  return mDeviceInfo;
+}
+
+std::chrono::system_clock::time_point SharedFeedReader::GetEpoch() const {
+  if (!mHeader) {
+    return {};
+  }
+  return std::chrono::system_clock::time_point {
+    std::chrono::duration_cast<std::chrono::system_clock::duration>(
+      std::chrono::microseconds {mHeader->mEpoch})};
+}
+
+uint32_t SharedFeedReader::GetWriterProcessID() const {
+  return mHeader ? mHeader->mWriterProcessID : 0;
+}
+
+uint64_t SharedFeedReader::GetEnd() const {
+  return mRing ? mRing->GetEnd() : 0;
+}
+
+std::size_t SharedFeedReader::GetCapacity() const {
+  return mRing ? mRing->GetCapacity() : 0;
+}
+
+std::optional<std::chrono::microseconds> SharedFeedReader::Read(
+  uint64_t sequence,
+  DeviceState& state) const {
+  if (!mRing) {
+    return std::nullopt;
+  }
+  return mRing->Read(sequence, state);
+}
+
+}// namespace FredEmmott::ControllerTester
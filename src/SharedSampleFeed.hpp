@@ -0,0 +1,203 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#include "DeviceInfo.hpp"
+#include "DeviceState.hpp"
+#include "Guid.hpp"
+#include "SampleRing.hpp"
+#include "SharedMemory.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+/* The start of each device's shared-memory feed, named by
+ * `GetSharedFeedName()`.
+ *
+ * Followed by:
+ * - `SerializedControl`s for the axes, then buttons, then hats
+ * - `mNameBytes` of device name
+ * - `mStringBytes` of control names
+ * - padding to a 64-byte boundary, at `mRingOffset`
+ * - a `SampleRing`'s storage; see `SampleRing::GetStorageWordCount()`
+ *
+ * The writer fills in everything else before storing `mVersion` with
+ * release semantics; readers must load it with acquire semantics, and
+ * ignore the feed unless it's `VERSION`.
+ */
+struct SharedFeedHeader {
+  static constexpr std::array<char, 4> MAGIC {'F', 'C', 'T', 'F'};
+  static constexpr uint32_t VERSION {1};
+
+  std::array<char, 4> mMagic {};
+  uint32_t mVersion {};
+  // Set to 1 when the writer stops; samples already written stay readable
+  uint32_t mClosed {};
+  uint32_t mWriterProcessID {};
+  Guid mProduct;
+  Guid mUnit;
+  // Sample times are microseconds since this, which is microseconds since
+  // the Unix epoch
+  int64_t mEpoch {};
+  uint32_t mAxisCount {};
+  uint32_t mButtonCount {};
+  uint32_t mHatCount {};
+  uint32_t mNameBytes {};
+  uint32_t mStringBytes {};
+  uint32_t mCapacity {};
+  uint32_t mWordsPerSample {};
+  uint32_t mReserved {};
+  uint64_t mRingOffset {};
+  // Of the whole feed
+  uint64_t mSize {};
+};
+static_assert(std::is_trivially_copyable_v<SharedFeedHeader>);
+static_assert(sizeof(SharedFeedHeader) % 8 == 0);
+
+/* The list of current feeds, named by `SHARED_FEED_DIRECTORY_NAME`.
+ *
+ * This is needed as Windows can't enumerate named mappings. It's published
+ * like the feeds, then updated as a sequence lock: `mSequence` is odd while
+ * `mCount` and `mUnits` are being changed, so readers retry if it's odd, or
+ * if it changed while they were reading.
+ */
+struct SharedFeedDirectoryHeader {
+  static constexpr std::array<char, 4> MAGIC {'F', 'C', 'T', 'D'};
+  // Version 1 didn't have `mWriterProcessID`
+  static constexpr uint32_t VERSION {2};
+  static constexpr std::size_t MAX_FEEDS {64};
+
+  std::array<char, 4> mMagic {};
+  uint32_t mVersion {};
+  uint32_t mWriterProcessID {};
+  uint32_t mReserved {};
+  uint64_t mSequence {};
+  uint64_t mCount {};
+  // `Guid`s as pairs of words, so they can be read with atomic loads
+  std::array<std::array<uint64_t, 2>, MAX_FEEDS> mUnits {};
+};
+static_assert(std::is_trivially_copyable_v<SharedFeedDirectoryHeader>);
+
+constexpr std::string_view SHARED_FEED_DIRECTORY_NAME {
+  "freds-controller-tester-feeds"};
+std::string GetSharedFeedName(const Guid& unit);
+
+// Writer for `SharedFeedDirectoryHeader`; only used from one thread
+class SharedFeedDirectory final {
+ public:
+  SharedFeedDirectory();
+
+  SharedFeedDirectory(const SharedFeedDirectory&) = delete;
+  SharedFeedDirectory(SharedFeedDirectory&&) = delete;
+  SharedFeedDirectory& operator=(const SharedFeedDirectory&) = delete;
+  SharedFeedDirectory& operator=(SharedFeedDirectory&&) = delete;
+
+  // False if another running process already has a directory
+  bool IsValid() const;
+
+  // Feeds past `MAX_FEEDS` aren't listed, but can still be opened by GUID
+  void Add(const Guid& unit);
+  void Remove(const Guid& unit);
+
+ private:
+  SharedMemory mMemory;
+  SharedFeedDirectoryHeader* mHeader {nullptr};
+  std::vector<Guid> mUnits;
+
+  void Publish();
+};
+
+// The units listed in the directory; empty if there's no directory
+std::vector<Guid> GetSharedFeeds();
+
+/* Publishes every sample of one device for other processes.
+ *
+ * Samples are written once, into a `SampleRing` in shared memory; readers
+ * map it read-only, and read it without copies, locks, or system calls.
+ * Readers can't slow down the writer; a reader that falls more than the
+ * capacity behind loses samples, and can tell from the sequence numbers.
+ */
+class SharedFeedWriter final {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  // The capacity is rounded up to a power of two
+  SharedFeedWriter(
+    const DeviceInfo&,
+    std::size_t minimumCapacity,
+    SharedFeedDirectory* = nullptr);
+  ~SharedFeedWriter();
+
+  SharedFeedWriter() = delete;
+  SharedFeedWriter(const SharedFeedWriter&) = delete;
+  SharedFeedWriter(SharedFeedWriter&&) = delete;
+  SharedFeedWriter& operator=(const SharedFeedWriter&) = delete;
+  SharedFeedWriter& operator=(SharedFeedWriter&&) = delete;
+
+  // False if the shared memory couldn't be created, e.g. because another
+  // running process is already sharing this unit
+  bool IsValid() const;
+  // See `SharedMemory::GetError()`
+  std::error_code GetError() const;
+
+  // Only call from one thread; never blocks or allocates. `state` must have
+  // the same control counts as the device
+  void Push(Clock::time_point, const DeviceState& state);
+
+ private:
+  Guid mUnit;
+  SharedFeedDirectory* mDirectory {nullptr};
+  const Clock::time_point mEpoch {Clock::now()};
+  std::optional<SharedMemory> mMemory;
+  SharedFeedHeader* mHeader {nullptr};
+  std::optional<SampleRing> mRing;
+};
+
+// A read-only view of a `SharedFeedWriter`'s feed, possibly in another
+// process
+class SharedFeedReader final {
+ public:
+  explicit SharedFeedReader(const Guid& unit);
+
+  SharedFeedReader() = delete;
+  SharedFeedReader(const SharedFeedReader&) = delete;
+  SharedFeedReader(SharedFeedReader&&) = delete;
+  SharedFeedReader& operator=(const SharedFeedReader&) = delete;
+  SharedFeedReader& operator=(SharedFeedReader&&) = delete;
+
+  // False if there's no feed for the unit, or it's from another version
+  bool IsValid() const;
+  // True once the writer has stopped
+  bool IsClosed() const;
+
+  // Controls, with no coverage; includes the name and GUIDs
+  const DeviceInfo& GetDeviceInfo() const;
+  // Sample times are relative to this
+  std::chrono::system_clock::time_point GetEpoch() const;
+  uint32_t GetWriterProcessID() const;
+
+  // As `SampleRing`
+  uint64_t GetEnd() const;
+  std::size_t GetCapacity() const;
+  std::optional<std::chrono::microseconds> Read(
+    uint64_t sequence,
+    DeviceState& state) const;
+
+ private:
+  SharedMemory mMemory;
+  const SharedFeedHeader* mHeader {nullptr};
+  DeviceInfo mDeviceInfo;
+  std::optional<SampleRing> mRing;
+};
+
+}// namespace FredEmmott::ControllerTester
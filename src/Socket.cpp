@@ -0,0 +1,393 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "Socket.hpp"
+
+#include <cerrno>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <WinSock2.h>
+#include <WS2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace FredEmmott::ControllerTester {
+
+namespace {
+
+#ifdef _WIN32
+using NativeHandle = SOCKET;
+using PollFD = WSAPOLLFD;
+using SocketLength = int;
+constexpr int SEND_FLAGS {0};
+
+void EnsureInitialized() {
+  static const bool initialized = [] {
+    WSADATA data {};
+    return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+  }();
+  (void)initialized;
+}
+
+bool IsWouldBlock() {
+  return WSAGetLastError() == WSAEWOULDBLOCK;
+}
+
+bool IsConnectInProgress() {
+  return WSAGetLastError() == WSAEWOULDBLOCK;
+}
+
+void CloseNative(NativeHandle handle) {
+  closesocket(handle);
+}
+
+void SetNonBlocking(NativeHandle handle) {
+  u_long enabled {1};
+  ioctlsocket(handle, FIONBIO, &enabled);
+}
+
+int PollNative(PollFD* fds, std::size_t count, int timeout) {
+  return WSAPoll(fds, static_cast<ULONG>(count), timeout);
+}
+#else
+using NativeHandle = int;
+using PollFD = pollfd;
+using SocketLength = socklen_t;
+// Writing to a closed connection should be an error, not a signal
+constexpr int SEND_FLAGS {MSG_NOSIGNAL};
+
+void EnsureInitialized() {
+}
+
+bool IsWouldBlock() {
+  return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+}
+
+bool IsConnectInProgress() {
+  return errno == EINPROGRESS;
+}
+
+void CloseNative(NativeHandle handle) {
+  close(handle);
+}
+
+void SetNonBlocking(NativeHandle handle) {
+  fcntl(handle, F_SETFL, fcntl(handle, F_GETFL) | O_NONBLOCK);
+}
+
+int PollNative(PollFD* fds, std::size_t count, int timeout) {
+  return poll(fds, static_cast<nfds_t>(count), timeout);
+}
+#endif
+
+// How often waits check whether they've been cancelled
+constexpr std::chrono::milliseconds CANCEL_INTERVAL {50};
+
+struct FreeAddresses {
+  void operator()(addrinfo* addresses) const {
+    freeaddrinfo(addresses);
+  }
+};
+using Addresses = std::unique_ptr<addrinfo, FreeAddresses>;
+
+Addresses Resolve(const std::string& host, uint16_t port, int flags) {
+  addrinfo hints {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_protocol = IPPROTO_TCP;
+  hints.ai_flags = flags;
+  addrinfo* addresses {nullptr};
+  if (
+    getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses)
+    != 0) {
+    return {};
+  }
+  return Addresses {addresses};
+}
+
+/* `getaddrinfo()` can't be cancelled, and can block for as long as the DNS
+ * server takes; names are resolved on another thread, which is abandoned if
+ * `stop` is requested.
+ */
+Addresses Resolve(
+  const std::string& host,
+  uint16_t port,
+  std::stop_token stop) {
+  // Addresses don't need a lookup
+  if (auto addresses = Resolve(host, port, AI_NUMERICHOST)) {
+    return addresses;
+  }
+
+  struct Result {
+    std::mutex mMutex;
+    std::condition_variable_any mResolved;
+    // Protected by `mMutex`
+    bool mDone {false};
+    Addresses mAddresses;
+  };
+  auto result = std::make_shared<Result>();
+  std::thread([result, host, port]() {
+    auto addresses = Resolve(host, port, 0);
+    std::unique_lock lock(result->mMutex);
+    result->mAddresses = std::move(addresses);
+    result->mDone = true;
+    result->mResolved.notify_all();
+  }).detach();
+
+  std::unique_lock lock(result->mMutex);
+  if (!result->mResolved.wait(lock, stop, [&result] {
+        return result->mDone;
+      })) {
+    return {};
+  }
+  return std::move(result->mAddresses);
+}
+
+// `handle` must be non-blocking, with a connection in progress
+bool WaitForConnection(NativeHandle handle, std::stop_token stop) {
+  while (!stop.stop_requested()) {
+    PollFD fd {};
+    fd.fd = handle;
+    fd.events = POLLOUT;
+    const auto ready = PollNative(
+      &fd, 1, static_cast<int>(CANCEL_INTERVAL.count()));
+    if (ready < 0) {
+      return false;
+    }
+    if (ready == 0) {
+      continue;
+    }
+    int error {};
+    SocketLength length {sizeof(error)};
+    getsockopt(
+      handle,
+      SOL_SOCKET,
+      SO_ERROR,
+      reinterpret_cast<char*>(&error),
+      &length);
+    return error == 0;
+  }
+  return false;
+}
+
+}// namespace
+
+Socket::Socket(Handle handle) : mHandle(handle) {
+}
+
+Socket::~Socket() {
+  this->Close();
+}
+
+Socket::Socket(Socket&& other) noexcept
+  : mHandle(std::exchange(other.mHandle, INVALID_HANDLE)) {
+}
+
+Socket& Socket::operator=(Socket&& other) noexcept {
+  if (this != &other) {
+    this->Close();
+    mHandle = std::exchange(other.mHandle, INVALID_HANDLE);
+  }
+  return *this;
+}
+
+void Socket::Close() {
+  if (mHandle != INVALID_HANDLE) {
+    CloseNative(static_cast<NativeHandle>(mHandle));
+    mHandle = INVALID_HANDLE;
+  }
+}
+
+void Socket::Configure() {
+  const auto handle = static_cast<NativeHandle>(mHandle);
+  SetNonBlocking(handle);
+  // Batching is done by the protocol; don't add Nagle's delay on top
+  int enabled {1};
+  setsockopt(
+    handle,
+    IPPROTO_TCP,
+    TCP_NODELAY,
+    reinterpret_cast<const char*>(&enabled),
+    sizeof(enabled));
+}
+
+Socket Socket::Listen(uint16_t port, bool loopbackOnly) {
+  EnsureInitialized();
+  const auto handle = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  Socket ret {static_cast<Handle>(handle)};
+  if (!ret.IsValid()) {
+    return {};
+  }
+#ifndef _WIN32
+  // Allow restarting while old connections are in TIME_WAIT
+  int enabled {1};
+  setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, &enabled, sizeof(enabled));
+#endif
+
+  sockaddr_in address {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(loopbackOnly ? INADDR_LOOPBACK : INADDR_ANY);
+  if (
+    bind(handle, reinterpret_cast<const sockaddr*>(&address), sizeof(address))
+      != 0
+    || listen(handle, SOMAXCONN) != 0) {
+    return {};
+  }
+  ret.Configure();
+  return ret;
+}
+
+Socket Socket::Connect(
+  const std::string& host,
+  uint16_t port,
+  std::stop_token stop) {
+  EnsureInitialized();
+  const auto addresses = Resolve(host, port, stop);
+
+  for (auto it = addresses.get(); it && !stop.stop_requested();
+       it = it->ai_next) {
+    const auto handle = socket(it->ai_family, it->ai_socktype, it->ai_protocol);
+    Socket candidate {static_cast<Handle>(handle)};
+    if (!candidate.IsValid()) {
+      continue;
+    }
+    // Non-blocking, so that the connection can be abandoned
+    candidate.Configure();
+    const auto connected
+      = connect(handle, it->ai_addr, static_cast<SocketLength>(it->ai_addrlen))
+      == 0;
+    if (
+      connected
+      || (IsConnectInProgress() && WaitForConnection(handle, stop))) {
+      return candidate;
+    }
+  }
+  return {};
+}
+
+bool Socket::IsValid() const {
+  // Both `INVALID_SOCKET` and a file descriptor of -1
+  return mHandle != INVALID_HANDLE;
+}
+
+uint16_t Socket::GetLocalPort() const {
+  sockaddr_storage address {};
+  SocketLength length {sizeof(address)};
+  if (
+    getsockname(
+      static_cast<NativeHandle>(mHandle),
+      reinterpret_cast<sockaddr*>(&address),
+      &length)
+    != 0) {
+    return 0;
+  }
+  if (address.ss_family == AF_INET6) {
+    return ntohs(reinterpret_cast<const sockaddr_in6&>(address).sin6_port);
+  }
+  return ntohs(reinterpret_cast<const sockaddr_in&>(address).sin_port);
+}
+
+void Socket::SetSendBufferSize(std::size_t bytes) {
+  const auto size = static_cast<int>(bytes);
+  setsockopt(
+    static_cast<NativeHandle>(mHandle),
+    SOL_SOCKET,
+    SO_SNDBUF,
+    reinterpret_cast<const char*>(&size),
+    sizeof(size));
+}
+
+Socket Socket::Accept() const {
+  const auto handle
+    = accept(static_cast<NativeHandle>(mHandle), nullptr, nullptr);
+  Socket ret {static_cast<Handle>(handle)};
+  if (ret.IsValid()) {
+    ret.Configure();
+  }
+  return ret;
+}
+
+std::optional<std::size_t> Socket::Send(std::span<const std::byte> data) {
+  if (!this->IsValid()) {
+    return std::nullopt;
+  }
+  const auto sent = send(
+    static_cast<NativeHandle>(mHandle),
+    reinterpret_cast<const char*>(data.data()),
+    static_cast<int>(data.size()),
+    SEND_FLAGS);
+  if (sent >= 0) {
+    return static_cast<std::size_t>(sent);
+  }
+  if (IsWouldBlock()) {
+    return 0;
+  }
+  return std::nullopt;
+}
+
+std::optional<std::size_t> Socket::Receive(std::span<std::byte> buffer) {
+  if (!this->IsValid()) {
+    return std::nullopt;
+  }
+  const auto received = recv(
+    static_cast<NativeHandle>(mHandle),
+    reinterpret_cast<char*>(buffer.data()),
+    static_cast<int>(buffer.size()),
+    0);
+  if (received > 0) {
+    return static_cast<std::size_t>(received);
+  }
+  if (received < 0 && IsWouldBlock()) {
+    return 0;
+  }
+  // 0 is an orderly shutdown
+  return std::nullopt;
+}
+
+void Socket::Poll(
+  std::span<PollRequest> requests,
+  std::chrono::milliseconds timeout) {
+  std::vector<PollFD> fds;
+  fds.reserve(requests.size());
+  for (const auto& request: requests) {
+    PollFD fd {};
+    fd.fd = static_cast<NativeHandle>(request.mSocket->mHandle);
+    fd.events = POLLIN;
+    if (request.mWantWrite) {
+      fd.events |= POLLOUT;
+    }
+    fds.push_back(fd);
+  }
+
+  if (PollNative(fds.data(), fds.size(), static_cast<int>(timeout.count()))
+      <= 0) {
+    for (auto& request: requests) {
+      request.mReadable = false;
+      request.mWritable = false;
+    }
+    return;
+  }
+
+  for (std::size_t i = 0; i < requests.size(); ++i) {
+    const auto events = fds[i].revents;
+    requests[i].mReadable = events & (POLLIN | POLLHUP | POLLERR | POLLNVAL);
+    requests[i].mWritable = events & POLLOUT;
+  }
+}
+
+}// namespace FredEmmott::ControllerTester
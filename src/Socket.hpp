@@ -0,0 +1,77 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <stop_token>
+#include <string>
+
+namespace FredEmmott::ControllerTester {
+
+/* A non-blocking TCP socket; Winsock or BSD sockets.
+ *
+ * Failures leave the socket invalid, rather than throwing; callers are
+ * expected to treat that the same as the other end going away.
+ */
+class Socket final {
+ public:
+  Socket() = default;
+  ~Socket();
+
+  Socket(const Socket&) = delete;
+  Socket& operator=(const Socket&) = delete;
+  Socket(Socket&&) noexcept;
+  Socket& operator=(Socket&&) noexcept;
+
+  // Port 0 picks any free port; see `GetLocalPort()`
+  static Socket Listen(uint16_t port, bool loopbackOnly);
+  // Waits until connected, the connection fails, or `stop` is requested
+  static Socket Connect(
+    const std::string& host,
+    uint16_t port,
+    std::stop_token stop = {});
+
+  bool IsValid() const;
+  uint16_t GetLocalPort() const;
+  // Limits how much the OS buffers for sending; by default, it can grow
+  // large enough to hide a slow connection for several seconds
+  void SetSendBufferSize(std::size_t bytes);
+
+  // An invalid socket if there's no pending connection
+  Socket Accept() const;
+
+  /* These return how many bytes were transferred; 0 if the call would
+   * block, and nullopt if the connection is closed or failed.
+   */
+  std::optional<std::size_t> Send(std::span<const std::byte>);
+  std::optional<std::size_t> Receive(std::span<std::byte>);
+
+  struct PollRequest {
+    Socket* mSocket {nullptr};
+    bool mWantWrite {false};
+
+    // Results
+    bool mReadable {false};
+    bool mWritable {false};
+  };
+  // Waits until any socket is ready, or the timeout; closed or failed
+  // sockets are readable, so that `Receive()` reports them
+  static void Poll(std::span<PollRequest>, std::chrono::milliseconds timeout);
+
+ private:
+  // A `SOCKET` on Windows, or a file descriptor elsewhere
+  using Handle = std::uintptr_t;
+  static constexpr Handle INVALID_HANDLE {~Handle {0}};
+
+  explicit Socket(Handle);
+  void Close();
+  void Configure();
+
+  Handle mHandle {INVALID_HANDLE};
+};
+
+}// namespace FredEmmott::ControllerTester
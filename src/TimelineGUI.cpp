@@ -0,0 +1,447 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "TimelineGUI.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <format>
+
+#include <imgui.h>
+
+#include "Config.hpp"
+#include "ControlAnalysis.hpp"
+#include "Trace.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+namespace {
+
+using std::chrono::microseconds;
+
+constexpr microseconds MIN_VIEW_LENGTH {10};
+constexpr microseconds DEFAULT_VIEW_LENGTH {std::chrono::seconds {10}};
+// View length multiplier per mouse wheel step
+constexpr float ZOOM_STEP {0.8f};
+// Minimum pixels between time labels
+constexpr float TICK_SPACING {120.0f};
+// In lines of text
+constexpr float LABEL_WIDTH {12.0f};
+constexpr float AXIS_HEIGHT {3.0f};
+// Recording stops here; a noisy axis costs ~30MiB per hour at 1kHz
+constexpr std::size_t MAX_SESSION_BYTES {1024 * 1024 * 1024};
+// Warn when the session is this close to the limit
+constexpr std::size_t WARN_SESSION_BYTES {MAX_SESSION_BYTES / 4 * 3};
+
+// 1, 2, or 5 times a power of 10, and at least `minimum`
+microseconds GetTickStep(microseconds minimum) {
+  for (int64_t power = 1;; power *= 10) {
+    for (const auto multiple: {1, 2, 5}) {
+      if (power * multiple >= minimum.count()) {
+        return microseconds {power * multiple};
+      }
+    }
+  }
+}
+
+// Only as precise as `step`
+std::string FormatTime(microseconds time, microseconds step) {
+  if (step >= std::chrono::seconds {1}) {
+    const auto hours = std::chrono::floor<std::chrono::hours>(time);
+    const auto minutes = std::chrono::floor<std::chrono::minutes>(time - hours);
+    const auto seconds
+      = std::chrono::floor<std::chrono::seconds>(time - hours - minutes);
+    return std::format(
+      "{}:{:02}:{:02}", hours.count(), minutes.count(), seconds.count());
+  }
+  const auto digits = (step >= std::chrono::milliseconds {1}) ? 3 : 6;
+  return std::format(
+    "{:.{}f}s", std::chrono::duration<double>(time).count(), digits);
+}
+
+const char* GetHatDirectionName(int32_t value) {
+  constexpr std::array names {"N", "NE", "E", "SE", "S", "SW", "W", "NW"};
+  return names[static_cast<std::size_t>((value + 2250) / 4500) % names.size()];
+}
+
+// Maps session time to screen X, clamped to the trace area, so very long
+// spans don't lose precision as floats
+struct TimeScale {
+  float mLeft {};
+  float mWidth {};
+  microseconds mBegin {};
+  microseconds mLength {};
+
+  float GetX(microseconds time) const {
+    const auto fraction = static_cast<double>((time - mBegin).count())
+      / static_cast<double>(mLength.count());
+    return mLeft
+      + (static_cast<float>(std::clamp(fraction, 0.0, 1.0)) * mWidth);
+  }
+
+  microseconds GetTime(float x) const {
+    const auto fraction = static_cast<double>((x - mLeft) / mWidth);
+    return mBegin
+      + microseconds {static_cast<int64_t>(
+        fraction * static_cast<double>(mLength.count()))};
+  }
+};
+
+}// namespace
+
+TimelineGUI::TimelineGUI(FrameArena& frameArena) : mFrameArena(frameArena) {
+}
+
+bool TimelineGUI::BeginTab() {
+  return ImGui::BeginTabItem("Timeline");
+}
+
+std::pmr::vector<std::size_t> TimelineGUI::GUITabContents(
+  std::span<DeviceInfo* const> devices) {
+  const Trace::Zone traceZone {"TimelineGUI::GUITabContents"};
+  std::pmr::vector<std::size_t> ret {&mFrameArena};
+  if (mSession) {
+    GUISession();
+    ImGui::EndTabItem();
+    return ret;
+  }
+
+  ImGui::TextWrapped(
+    "Records every control of the selected devices, then shows them on one "
+    "timeline, like a logic analyzer. Scroll over the traces to zoom, and "
+    "drag to move through the recording.");
+
+  std::pmr::vector<std::size_t> selected {&mFrameArena};
+  for (std::size_t i = 0; i < devices.size(); ++i) {
+    const auto device = devices[i];
+    const auto it = std::ranges::find(mSelected, device->mGuid);
+    auto isSelected = (it != mSelected.end());
+    // Devices can have the same name, e.g. multiple vJoy devices
+    if (ImGui::Checkbox(
+          std::format("{}##{}", device->mName, i).c_str(), &isSelected)) {
+      if (isSelected) {
+        mSelected.push_back(device->mGuid);
+      } else {
+        mSelected.erase(it);
+      }
+    }
+    if (isSelected) {
+      selected.push_back(i);
+    }
+  }
+
+  ImGui::BeginDisabled(selected.empty());
+  if (ImGui::Button("Start recording")) {
+    ret = std::move(selected);
+  }
+  ImGui::EndDisabled();
+  if (!mError.empty()) {
+    ImGui::TextColored(Config::WARNING_COLOR, "%s", mError.c_str());
+  }
+
+  ImGui::EndTabItem();
+  return ret;
+}
+
+void TimelineGUI::ResetView() {
+  mViewBegin = {};
+  mViewLength = DEFAULT_VIEW_LENGTH;
+  mFollow = true;
+  mDragging = false;
+}
+
+void TimelineGUI::StopRecording() {
+  for (auto& it: mSession->mRecordings) {
+    it.mSampler.reset();
+  }
+  mFollow = false;
+}
+
+void TimelineGUI::GUISession() {
+  auto& session = *mSession;
+  microseconds end {};
+  std::size_t runs {};
+  std::size_t bytes {};
+  for (const auto& it: session.mRecordings) {
+    end = std::max(end, it.mIndex->GetEnd());
+    runs += it.mIndex->GetRunCount();
+    bytes += it.mIndex->GetMemoryUsage();
+  }
+
+  auto recording = static_cast<bool>(session.mRecordings.front().mSampler);
+  if (recording && bytes >= MAX_SESSION_BYTES) {
+    this->StopRecording();
+    session.mReachedLimit = true;
+    recording = false;
+  }
+  if (recording) {
+    if (ImGui::Button("Stop recording")) {
+      this->StopRecording();
+    }
+  } else if (ImGui::Button("New recording")) {
+    mSession.reset();
+    return;
+  }
+
+  ImGui::SameLine();
+  if (ImGui::Button("Show all")) {
+    mFollow = false;
+    mViewBegin = {};
+    mViewLength = std::max(end, MIN_VIEW_LENGTH);
+  }
+  ImGui::SameLine();
+  ImGui::BeginDisabled(!recording);
+  ImGui::Checkbox("Follow", &mFollow);
+  ImGui::EndDisabled();
+  ImGui::SameLine();
+  ImGui::TextDisabled(
+    "%s; %zu changes (%.1f MiB)",
+    FormatTime(end, std::chrono::seconds {1}).c_str(),
+    runs,
+    static_cast<double>(bytes) / (1024 * 1024));
+  if (session.mReachedLimit) {
+    ImGui::TextColored(
+      Config::WARNING_COLOR,
+      "Recording stopped, as the session reached the %zu MiB limit.",
+      MAX_SESSION_BYTES / (1024 * 1024));
+  } else if (recording && bytes >= WARN_SESSION_BYTES) {
+    ImGui::TextColored(
+      Config::WARNING_COLOR,
+      "Recording will stop when the session reaches %zu MiB.",
+      MAX_SESSION_BYTES / (1024 * 1024));
+  }
+
+  GUITimeline();
+}
+
+void TimelineGUI::GUITimeline() {
+  const Trace::Zone traceZone {"TimelineGUI::GUITimeline"};
+  auto& session = *mSession;
+  microseconds end {};
+  for (const auto& it: session.mRecordings) {
+    end = std::max(end, it.mIndex->GetEnd());
+  }
+
+  // Scrolling the mouse wheel zooms instead
+  ImGui::BeginChild(
+    "##Timeline", {-FLT_MIN, 0}, false, ImGuiWindowFlags_NoScrollWithMouse);
+
+  const auto& io = ImGui::GetIO();
+  const auto& style = ImGui::GetStyle();
+  const auto lineHeight = ImGui::GetTextLineHeight();
+  const auto labelWidth = lineHeight * LABEL_WIDTH;
+  const auto origin = ImGui::GetCursorScreenPos();
+  const auto width
+    = std::max(1.0f, ImGui::GetContentRegionAvail().x - labelWidth);
+  const auto windowPos = ImGui::GetWindowPos();
+  const auto windowSize = ImGui::GetWindowSize();
+
+  // Input
+  const auto traceLeft = origin.x + labelWidth;
+  const auto hovered = ImGui::IsWindowHovered()
+    && io.MousePos.x >= traceLeft && io.MousePos.x < traceLeft + width;
+  TimeScale scale {traceLeft, width, mViewBegin, mViewLength};
+  if (hovered && io.MouseWheel != 0) {
+    // Keep the time under the cursor where it is
+    const auto anchor = scale.GetTime(io.MousePos.x);
+    const auto fraction = (io.MousePos.x - traceLeft) / width;
+    mViewLength = std::clamp(
+      microseconds {static_cast<int64_t>(
+        static_cast<double>(mViewLength.count())
+        * std::pow(ZOOM_STEP, io.MouseWheel))},
+      MIN_VIEW_LENGTH,
+      std::max(end, DEFAULT_VIEW_LENGTH));
+    mViewBegin = anchor
+      - microseconds {static_cast<int64_t>(
+        fraction * static_cast<float>(mViewLength.count()))};
+  }
+  if (hovered && ImGui::IsMouseClicked(ImGuiMouseButton_Left)) {
+    mDragging = true;
+  }
+  if (!ImGui::IsMouseDown(ImGuiMouseButton_Left)) {
+    mDragging = false;
+  }
+  if (mDragging && io.MouseDelta.x != 0) {
+    mFollow = false;
+    mViewBegin -= microseconds {static_cast<int64_t>(
+      (io.MouseDelta.x / width) * static_cast<float>(mViewLength.count()))};
+  }
+  if (mFollow) {
+    mViewBegin = end - mViewLength;
+  }
+  mViewBegin = std::clamp(
+    mViewBegin, microseconds {}, std::max(microseconds {}, end - mViewLength));
+  scale.mBegin = mViewBegin;
+
+  const auto viewEnd = mViewBegin + mViewLength;
+  // One span per pixel at most
+  const auto resolution = std::max(
+    microseconds {1},
+    microseconds {static_cast<int64_t>(
+      static_cast<float>(mViewLength.count()) / width)});
+
+  auto drawList = ImGui::GetWindowDrawList();
+  const auto textColor = ImGui::GetColorU32(ImGuiCol_Text);
+  const auto disabledColor = ImGui::GetColorU32(ImGuiCol_TextDisabled);
+  const auto activeColor = ImGui::GetColorU32(ImGuiCol_ButtonActive);
+  const auto mergedColor = ImGui::GetColorU32(ImGuiCol_TextDisabled, 0.5f);
+  const auto gridColor = ImGui::GetColorU32(ImGuiCol_Separator, 0.5f);
+  const auto plotColor = ImGui::GetColorU32(ImGuiCol_PlotLines);
+
+  // Time labels
+  const auto tickStep = GetTickStep(microseconds {static_cast<int64_t>(
+    (TICK_SPACING / width) * static_cast<float>(mViewLength.count()))});
+  std::pmr::vector<float> gridLines {&mFrameArena};
+  for (auto tick = (mViewBegin / tickStep) * tickStep; tick < viewEnd;
+       tick += tickStep) {
+    if (tick < mViewBegin) {
+      continue;
+    }
+    const auto x = scale.GetX(tick);
+    gridLines.push_back(x);
+    drawList->AddText(
+      {x + style.ItemInnerSpacing.x, origin.y},
+      disabledColor,
+      FormatTime(tick, tickStep).c_str());
+  }
+  ImGui::Dummy({labelWidth + width, lineHeight + style.ItemSpacing.y});
+
+  // Rows that aren't visible are skipped before querying the index
+  const auto beginRow = [&](const std::string& label, float height) {
+    const auto pos = ImGui::GetCursorScreenPos();
+    ImGui::Dummy({labelWidth + width, height});
+    if (!ImGui::IsItemVisible()) {
+      return std::optional<ImVec2> {};
+    }
+    drawList->PushClipRect(
+      pos, {pos.x + labelWidth - style.ItemInnerSpacing.x, pos.y + height});
+    drawList->AddText(pos, textColor, label.c_str());
+    drawList->PopClipRect();
+    return std::optional {pos};
+  };
+
+  for (const auto& recording: session.mRecordings) {
+    const auto& info = recording.mInfo;
+    const auto& index = *recording.mIndex;
+    ImGui::SeparatorText(info.mName.c_str());
+
+    for (std::size_t i = 0; i < info.mAxes.size(); ++i) {
+      const auto& axis = info.mAxes[i];
+      const auto height = lineHeight * AXIS_HEIGHT;
+      const auto pos = beginRow(axis.mName, height);
+      if (!pos) {
+        continue;
+      }
+      const auto min = static_cast<double>(axis.mMin);
+      const auto range = std::max(1.0, static_cast<double>(axis.mMax) - min);
+      const auto getY = [&](int32_t value) {
+        const auto fraction = std::clamp((value - min) / range, 0.0, 1.0);
+        return pos->y + height - static_cast<float>(fraction * height);
+      };
+      std::optional<float> previousY;
+      for (const auto& span: index.GetSpans(
+             TimelineIndex::Kind::Axis,
+             i,
+             mViewBegin,
+             viewEnd,
+             resolution,
+             &mFrameArena)) {
+        const auto x0 = scale.GetX(span.mStart);
+        const auto x1 = std::max(x0 + 1, scale.GetX(span.mEnd));
+        if (span.IsMerged()) {
+          drawList->AddRectFilled(
+            {x0, getY(span.mMax)}, {x1, getY(span.mMin) + 1}, plotColor);
+          previousY.reset();
+          continue;
+        }
+        const auto y = getY(span.mMin);
+        if (previousY) {
+          drawList->AddLine({x0, *previousY}, {x0, y}, plotColor);
+        }
+        drawList->AddLine({x0, y}, {x1, y}, plotColor);
+        previousY = y;
+      }
+    }
+
+    for (std::size_t i = 0; i < info.mHats.size(); ++i) {
+      const auto pos = beginRow(info.mHats[i].mName, lineHeight);
+      if (!pos) {
+        continue;
+      }
+      const auto bottom = pos->y + lineHeight;
+      for (const auto& span: index.GetSpans(
+             TimelineIndex::Kind::Hat,
+             i,
+             mViewBegin,
+             viewEnd,
+             resolution,
+             &mFrameArena)) {
+        const auto x0 = scale.GetX(span.mStart);
+        const auto x1 = std::max(x0 + 1, scale.GetX(span.mEnd));
+        if (span.IsMerged()) {
+          drawList->AddRectFilled({x0, pos->y}, {x1, bottom}, mergedColor);
+          continue;
+        }
+        if (IsHatCentered(span.mMin)) {
+          drawList->AddLine({x0, bottom - 1}, {x1, bottom - 1}, textColor);
+          continue;
+        }
+        drawList->AddRectFilled({x0, pos->y}, {x1, bottom}, activeColor);
+        drawList->AddRect({x0, pos->y}, {x1, bottom}, textColor);
+        const auto name = GetHatDirectionName(span.mMin);
+        if (
+          ImGui::CalcTextSize(name).x + (2 * style.ItemInnerSpacing.x)
+          < x1 - x0) {
+          drawList->AddText(
+            {x0 + style.ItemInnerSpacing.x, pos->y}, textColor, name);
+        }
+      }
+    }
+
+    for (std::size_t i = 0; i < info.mButtons.size(); ++i) {
+      const auto pos = beginRow(info.mButtons[i].mName, lineHeight);
+      if (!pos) {
+        continue;
+      }
+      const auto top = pos->y + 1;
+      const auto bottom = pos->y + lineHeight - 1;
+      for (const auto& span: index.GetSpans(
+             TimelineIndex::Kind::Button,
+             i,
+             mViewBegin,
+             viewEnd,
+             resolution,
+             &mFrameArena)) {
+        const auto x0 = scale.GetX(span.mStart);
+        const auto x1 = std::max(x0 + 1, scale.GetX(span.mEnd));
+        if (span.IsMerged()) {
+          drawList->AddRectFilled({x0, top}, {x1, bottom}, mergedColor);
+        } else if (span.mMin) {
+          drawList->AddRectFilled({x0, top}, {x1, bottom}, activeColor);
+          drawList->AddLine({x0, top}, {x1, top}, textColor);
+        } else {
+          drawList->AddLine({x0, bottom}, {x1, bottom}, textColor);
+        }
+      }
+    }
+  }
+
+  // Grid and cursor, over every visible row
+  const auto gridTop = windowPos.y;
+  const auto gridBottom = windowPos.y + windowSize.y;
+  for (const auto x: gridLines) {
+    drawList->AddLine({x, gridTop}, {x, gridBottom}, gridColor);
+  }
+  if (hovered && !mDragging) {
+    drawList->AddLine(
+      {io.MousePos.x, gridTop}, {io.MousePos.x, gridBottom}, textColor);
+    ImGui::SetTooltip(
+      "%s",
+      FormatTime(scale.GetTime(io.MousePos.x), microseconds {1}).c_str());
+  }
+
+  ImGui::EndChild();
+}
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,149 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <format>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "DeviceInfo.hpp"
+#include "DeviceSet.hpp"
+#include "FrameArena.hpp"
+#include "Guid.hpp"
+#include "Sampler.hpp"
+#include "TimelineIndex.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+/* The 'Timeline' tab.
+ *
+ * Records every control of a set of devices for the whole session, and
+ * shows them like a logic analyzer, on one time axis: buttons as digital
+ * traces, hats as bands, and axes as analog traces.
+ *
+ * Each frame only asks the `TimelineIndex` for the visible part of the
+ * visible rows, at one span per pixel, so zooming out to the whole session
+ * costs about the same as zooming in to a few milliseconds.
+ */
+class TimelineGUI final {
+ public:
+  explicit TimelineGUI(FrameArena&);
+
+  /* `devices` is e.g. `DeviceSet::GetAllDevices()`, and `open` is e.g.
+   * `DeviceSet::OpenAnother()`.
+   *
+   * Each device is sampled through its own instance, so recording doesn't
+   * affect the other tabs.
+   */
+  template <Device... TInfos, class FOpen>
+  void GUITab(
+    const std::pmr::vector<DeviceRef<TInfos...>>& devices,
+    FOpen&& open) {
+    if (!this->BeginTab()) {
+      return;
+    }
+
+    std::pmr::vector<DeviceInfo*> infos {&mFrameArena};
+    infos.reserve(devices.size());
+    for (const auto& device: devices) {
+      infos.push_back(GetDeviceInfo(device));
+    }
+    // Ends the tab
+    const auto start = this->GUITabContents(infos);
+    if (start.empty()) {
+      return;
+    }
+
+    Session session;
+    for (const auto i: start) {
+      const auto opened = std::visit(
+        [&]<Device T>(T* device) {
+          auto another = open(std::as_const(*device));
+          if (!another) {
+            mError = std::format("Couldn't open {}.", device->mName);
+            return false;
+          }
+          this->AddRecording(session, std::move(*another));
+          return true;
+        },
+        devices[i]);
+      if (!opened) {
+        return;
+      }
+    }
+    mSession = std::move(session);
+    mError.clear();
+    this->ResetView();
+  }
+
+ private:
+  using Clock = Sampler::Clock;
+
+  bool BeginTab();
+  // Returns the indices of the devices to start recording, if any
+  std::pmr::vector<std::size_t> GUITabContents(std::span<DeviceInfo* const>);
+  void GUISession();
+  void GUITimeline();
+  void ResetView();
+  void StopRecording();
+
+  struct Recording {
+    DeviceInfo mInfo;
+    std::unique_ptr<TimelineIndex> mIndex;
+    // Declared last so it's stopped first, as it uses the index; reset when
+    // recording stops
+    std::unique_ptr<Sampler> mSampler;
+  };
+
+  struct Session {
+    Clock::time_point mStart {Clock::now()};
+    std::vector<Recording> mRecordings;
+    // Set if recording was stopped by `MAX_SESSION_BYTES`
+    bool mReachedLimit {false};
+  };
+
+  template <Device T>
+  void AddRecording(Session& session, T&& device) {
+    auto& recording = session.mRecordings.emplace_back();
+    recording.mInfo = device;
+    recording.mIndex = std::make_unique<TimelineIndex>(device);
+    const auto index = recording.mIndex.get();
+    const auto start = session.mStart;
+    recording.mSampler = std::make_unique<Sampler>(
+      std::move(device),
+      mSampleInterval,
+      [index, start](
+        Clock::time_point time, const std::optional<DeviceState>& state) {
+        if (state) {
+          index->Push(
+            std::chrono::duration_cast<std::chrono::microseconds>(
+              time - start),
+            *state);
+        }
+      });
+  }
+
+  FrameArena& mFrameArena;
+  std::chrono::microseconds mSampleInterval {std::chrono::milliseconds {1}};
+  std::vector<Guid> mSelected;
+  std::string mError;
+  std::optional<Session> mSession;
+
+  // The visible part of the session
+  std::chrono::microseconds mViewBegin {};
+  std::chrono::microseconds mViewLength {};
+  // Keep the latest samples in view while recording
+  bool mFollow {true};
+  bool mDragging {false};
+};
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,270 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "TimelineIndex.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <iterator>
+#include <limits>
+
+namespace FredEmmott::ControllerTester {
+
+TimelineIndex::TimelineIndex(const DeviceInfo& device)
+  : mAxisCount(device.mAxes.size()),
+    mHatCount(device.mHats.size()),
+    mButtonCount(device.mButtons.size()),
+    mTracks(mAxisCount + mHatCount + mButtonCount),
+    mPreviousButtons(DeviceState::GetButtonWordCount(mButtonCount)) {
+}
+
+void TimelineIndex::Push(
+  std::chrono::microseconds time,
+  const DeviceState& state) {
+  const std::unique_lock lock {mMutex};
+  mEnd = std::max(mEnd, time);
+
+  const auto axisCount = std::min(mAxisCount, state.mAxes.size());
+  for (std::size_t i = 0; i < axisCount; ++i) {
+    mRunCount += mTracks[i].Push(time, state.mAxes[i]);
+  }
+  const auto hatCount = std::min(mHatCount, state.mHats.size());
+  for (std::size_t i = 0; i < hatCount; ++i) {
+    mRunCount += mTracks[mAxisCount + i].Push(time, state.mHats[i]);
+  }
+
+  // Most samples don't change any buttons, so only look at the ones that
+  // did
+  const auto firstButton = mAxisCount + mHatCount;
+  const auto wordCount
+    = std::min(mPreviousButtons.size(), state.mButtons.size());
+  for (std::size_t word = 0; word < wordCount; ++word) {
+    const auto bits = state.mButtons[word];
+    auto changed = mHavePrevious ? (bits ^ mPreviousButtons[word])
+                                 : std::numeric_limits<uint64_t>::max();
+    mPreviousButtons[word] = bits;
+    while (changed) {
+      const auto bit = static_cast<std::size_t>(std::countr_zero(changed));
+      changed &= changed - 1;
+      const auto index = (word * DeviceState::BUTTONS_PER_WORD) + bit;
+      if (index >= mButtonCount) {
+        break;
+      }
+      mRunCount += mTracks[firstButton + index].Push(
+        time, static_cast<int32_t>((bits >> bit) & 1));
+    }
+  }
+  mHavePrevious = true;
+}
+
+std::pmr::vector<TimelineSpan> TimelineIndex::GetSpans(
+  Kind kind,
+  std::size_t index,
+  std::chrono::microseconds begin,
+  std::chrono::microseconds end,
+  std::chrono::microseconds resolution,
+  std::pmr::memory_resource* resource) const {
+  std::pmr::vector<TimelineSpan> ret {resource};
+  switch (kind) {
+    case Kind::Axis:
+      if (index >= mAxisCount) {
+        return ret;
+      }
+      break;
+    case Kind::Hat:
+      if (index >= mHatCount) {
+        return ret;
+      }
+      index += mAxisCount;
+      break;
+    case Kind::Button:
+      if (index >= mButtonCount) {
+        return ret;
+      }
+      index += mAxisCount + mHatCount;
+      break;
+  }
+
+  const std::unique_lock lock {mMutex};
+  const auto& track = mTracks[index];
+  if (track.mSize == 0 || begin >= end) {
+    return ret;
+  }
+
+  // The last run that starts by `time`, if it's not before `first`;
+  // otherwise, the run before `first`
+  const auto findLastStartingBy
+    = [&track](std::size_t first, std::chrono::microseconds time) {
+        return track.FindFirstStartingAfter(first, time) - 1;
+      };
+
+  // The run that `begin` is in, or the first run
+  auto i = track.GetStart(0) < begin ? findLastStartingBy(0, begin) : 0;
+  auto start = track.GetStart(i);
+  while (i < track.mSize && start < end) {
+    const auto runEnd
+      = (i + 1 < track.mSize) ? track.GetStart(i + 1) : mEnd;
+    const auto last = (runEnd - start < resolution)
+      ? findLastStartingBy(i + 1, start + resolution)
+      : i;
+    if (last == i) {
+      const auto value = track.GetValue(i);
+      ret.push_back({start, runEnd, value, value});
+      ++i;
+      start = runEnd;
+      continue;
+    }
+    const auto range = track.GetRange(i, last);
+    const auto lastStart = track.GetStart(last);
+    ret.push_back({start, lastStart, range.mMin, range.mMax});
+    i = last;
+    start = lastStart;
+  }
+  return ret;
+}
+
+std::chrono::microseconds TimelineIndex::GetEnd() const {
+  const std::unique_lock lock {mMutex};
+  return mEnd;
+}
+
+std::size_t TimelineIndex::GetRunCount() const {
+  const std::unique_lock lock {mMutex};
+  return mRunCount;
+}
+
+std::size_t TimelineIndex::GetMemoryUsage() const {
+  const std::unique_lock lock {mMutex};
+  std::size_t ret {mTracks.capacity() * sizeof(Track)};
+  for (const auto& track: mTracks) {
+    ret += track.mChunks.capacity() * sizeof(track.mChunks.front());
+    ret += track.mChunks.size() * sizeof(Chunk);
+  }
+  return ret;
+}
+
+bool TimelineIndex::Track::Push(std::chrono::microseconds time, int32_t value) {
+  if (mSize && GetValue(mSize - 1) == value) {
+    return false;
+  }
+
+  auto chunk = mChunks.empty() ? nullptr : mChunks.back().get();
+  if (
+    (!chunk) || chunk->mSize == CHUNK_RUNS
+    || (time - chunk->mBase).count() > std::numeric_limits<uint32_t>::max()) {
+    chunk = mChunks.emplace_back(std::make_unique<Chunk>()).get();
+    chunk->mBase = time;
+    chunk->mFirstRun = mSize;
+  }
+
+  const auto i = chunk->mSize++;
+  chunk->mOffsets[i] = static_cast<uint32_t>((time - chunk->mBase).count());
+  chunk->mValues[i] = value;
+  auto& block = chunk->mBlocks[i / BLOCK_RUNS];
+  if (i % BLOCK_RUNS == 0) {
+    block = {value, value};
+  } else {
+    block.mMin = std::min(block.mMin, value);
+    block.mMax = std::max(block.mMax, value);
+  }
+  ++mSize;
+  return true;
+}
+
+std::size_t TimelineIndex::Track::GetChunkIndex(std::size_t run) const {
+  // Chunks are only short if there was a long gap, so this is usually the
+  // first guess
+  const auto guess = std::min(run / CHUNK_RUNS, mChunks.size() - 1);
+  if (const auto& chunk = *mChunks[guess];
+      chunk.mFirstRun <= run && run < chunk.mFirstRun + chunk.mSize) {
+    return guess;
+  }
+  const auto it = std::ranges::upper_bound(
+    mChunks, run, {}, [](const auto& chunk) { return chunk->mFirstRun; });
+  return static_cast<std::size_t>(it - mChunks.begin()) - 1;
+}
+
+const TimelineIndex::Chunk& TimelineIndex::Track::GetChunk(
+  std::size_t run) const {
+  return *mChunks[GetChunkIndex(run)];
+}
+
+std::chrono::microseconds TimelineIndex::Track::GetStart(
+  std::size_t run) const {
+  const auto& chunk = GetChunk(run);
+  return chunk.mBase
+    + std::chrono::microseconds {chunk.mOffsets[run - chunk.mFirstRun]};
+}
+
+int32_t TimelineIndex::Track::GetValue(std::size_t run) const {
+  const auto& chunk = GetChunk(run);
+  return chunk.mValues[run - chunk.mFirstRun];
+}
+
+std::size_t TimelineIndex::Track::FindFirstStartingAfter(
+  std::size_t first,
+  std::chrono::microseconds time) const {
+  if (first >= mSize) {
+    return mSize;
+  }
+  // Runs in chunks before the last chunk that starts by `time` start by
+  // it too, and runs in later chunks don't
+  const auto firstChunk = mChunks.begin() + GetChunkIndex(first);
+  const auto next = std::upper_bound(
+    firstChunk,
+    mChunks.end(),
+    time,
+    [](std::chrono::microseconds time, const std::unique_ptr<Chunk>& chunk) {
+      return time < chunk->mBase;
+    });
+  if (next == firstChunk) {
+    return first;
+  }
+  const auto& chunk = **std::prev(next);
+  const auto offset = (time - chunk.mBase).count();
+  if (offset > std::numeric_limits<uint32_t>::max()) {
+    return chunk.mFirstRun + chunk.mSize;
+  }
+  const auto from = chunk.mOffsets.begin()
+    + static_cast<std::ptrdiff_t>(std::max(first, chunk.mFirstRun)
+                                  - chunk.mFirstRun);
+  const auto it = std::upper_bound(
+    from,
+    chunk.mOffsets.begin() + static_cast<std::ptrdiff_t>(chunk.mSize),
+    static_cast<uint32_t>(offset));
+  return chunk.mFirstRun
+    + static_cast<std::size_t>(it - chunk.mOffsets.begin());
+}
+
+TimelineIndex::Block TimelineIndex::Track::GetRange(
+  std::size_t first,
+  std::size_t last) const {
+  Block ret {
+    std::numeric_limits<int32_t>::max(),
+    std::numeric_limits<int32_t>::min(),
+  };
+  const auto add = [&ret](int32_t min, int32_t max) {
+    ret.mMin = std::min(ret.mMin, min);
+    ret.mMax = std::max(ret.mMax, max);
+  };
+
+  while (first < last) {
+    const auto& chunk = GetChunk(first);
+    auto i = first - chunk.mFirstRun;
+    const auto chunkLast = std::min(last - chunk.mFirstRun, chunk.mSize);
+    for (; i < chunkLast && (i % BLOCK_RUNS); ++i) {
+      add(chunk.mValues[i], chunk.mValues[i]);
+    }
+    for (; i + BLOCK_RUNS <= chunkLast; i += BLOCK_RUNS) {
+      const auto& block = chunk.mBlocks[i / BLOCK_RUNS];
+      add(block.mMin, block.mMax);
+    }
+    for (; i < chunkLast; ++i) {
+      add(chunk.mValues[i], chunk.mValues[i]);
+    }
+    first = chunk.mFirstRun + chunkLast;
+  }
+  return ret;
+}
+
+}// namespace FredEmmott::ControllerTester
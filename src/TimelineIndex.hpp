@@ -0,0 +1,142 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <vector>
+
+#include "DeviceInfo.hpp"
+#include "DeviceState.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+// Part of a control's timeline; `mMin` and `mMax` are equal unless several
+// values were merged, because they were all shorter than the resolution
+struct TimelineSpan {
+  std::chrono::microseconds mStart {};
+  std::chrono::microseconds mEnd {};
+  int32_t mMin {};
+  int32_t mMax {};
+
+  bool IsMerged() const {
+    return mMin != mMax;
+  }
+};
+
+/* Every value that each of a device's controls has had in a session.
+ *
+ * Each control is stored as runs: a value, and the time it changed to it.
+ * Samples that don't change a control cost nothing, so a session can be
+ * hours long; axes are stored the same way as buttons and hats, so a noisy
+ * axis costs a run per sample - 8 bytes.
+ *
+ * Runs are stored in fixed-size chunks, which are never moved, so `Push()`
+ * never copies the session while other threads wait for it.
+ *
+ * `GetSpans()` finds the first visible run with a binary search, and skips
+ * over runs that are shorter than the resolution with another, so its cost
+ * depends on the visible transitions and the resolution, not the length of
+ * the session.
+ */
+class TimelineIndex final {
+ public:
+  explicit TimelineIndex(const DeviceInfo&);
+
+  TimelineIndex() = delete;
+  TimelineIndex(const TimelineIndex&) = delete;
+  TimelineIndex(TimelineIndex&&) = delete;
+  TimelineIndex& operator=(const TimelineIndex&) = delete;
+  TimelineIndex& operator=(TimelineIndex&&) = delete;
+
+  enum class Kind : uint8_t {
+    Axis,
+    Hat,
+    Button,
+  };
+
+  // Time since the start of the session, which must not decrease; can be
+  // called from any thread
+  void Push(std::chrono::microseconds time, const DeviceState&);
+
+  // The spans that overlap `[begin, end)`, in order; spans aren't clipped.
+  // A run that's shorter than `resolution` is merged with the other runs
+  // that start within `resolution` of it. Can be called from any thread.
+  std::pmr::vector<TimelineSpan> GetSpans(
+    Kind,
+    std::size_t index,
+    std::chrono::microseconds begin,
+    std::chrono::microseconds end,
+    std::chrono::microseconds resolution,
+    std::pmr::memory_resource* = std::pmr::get_default_resource()) const;
+
+  // The time of the latest sample; the last run of each control ends here
+  std::chrono::microseconds GetEnd() const;
+  std::size_t GetRunCount() const;
+  std::size_t GetMemoryUsage() const;
+
+ private:
+  // The range of `BLOCK_RUNS` consecutive runs, so merged spans don't need
+  // to look at every run they contain
+  struct Block {
+    int32_t mMin {};
+    int32_t mMax {};
+  };
+  static constexpr std::size_t BLOCK_RUNS {64};
+  static constexpr std::size_t CHUNK_RUNS {BLOCK_RUNS * 16};
+
+  /* Consecutive runs; each lasts until the next run starts, or the end of
+   * the session.
+   *
+   * Run starts are offsets from the chunk's first run, so a chunk is ended
+   * early if a run starts more than ~71 minutes after that.
+   */
+  struct Chunk {
+    std::chrono::microseconds mBase {};
+    // Of the chunk's first run, in the track
+    std::size_t mFirstRun {};
+    std::size_t mSize {};
+    std::array<uint32_t, CHUNK_RUNS> mOffsets {};
+    std::array<int32_t, CHUNK_RUNS> mValues {};
+    std::array<Block, CHUNK_RUNS / BLOCK_RUNS> mBlocks {};
+  };
+
+  struct Track {
+    std::vector<std::unique_ptr<Chunk>> mChunks;
+    std::size_t mSize {};
+
+    // False if the value hasn't changed
+    bool Push(std::chrono::microseconds time, int32_t value);
+
+    std::size_t GetChunkIndex(std::size_t run) const;
+    const Chunk& GetChunk(std::size_t run) const;
+    std::chrono::microseconds GetStart(std::size_t run) const;
+    int32_t GetValue(std::size_t run) const;
+    // The first run from `first` onwards that starts after `time`, or
+    // `mSize`
+    std::size_t FindFirstStartingAfter(
+      std::size_t first,
+      std::chrono::microseconds time) const;
+    // Of runs `[first, last)`
+    Block GetRange(std::size_t first, std::size_t last) const;
+  };
+
+  const std::size_t mAxisCount {};
+  const std::size_t mHatCount {};
+  const std::size_t mButtonCount {};
+
+  mutable std::mutex mMutex;
+  // Axes, then hats, then buttons
+  std::vector<Track> mTracks;
+  std::chrono::microseconds mEnd {};
+  std::size_t mRunCount {};
+  std::vector<uint64_t> mPreviousButtons;
+  bool mHavePrevious {false};
+};
+
+}// namespace FredEmmott::ControllerTester
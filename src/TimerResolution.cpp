@@ -0,0 +1,26 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "TimerResolution.hpp"
+
+#ifdef _WIN32
+#include <Windows.h>
+
+#include <timeapi.h>
+#endif
+
+namespace FredEmmott::ControllerTester {
+
+TimerResolution::TimerResolution() {
+#ifdef _WIN32
+  timeBeginPeriod(1);
+#endif
+}
+
+TimerResolution::~TimerResolution() {
+#ifdef _WIN32
+  timeEndPeriod(1);
+#endif
+}
+
+}// namespace FredEmmott::ControllerTester
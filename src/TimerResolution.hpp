@@ -0,0 +1,20 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+namespace FredEmmott::ControllerTester {
+
+// Requests 1ms timer resolution on Windows while alive, as the default is
+// too coarse for sleeping between polls
+class TimerResolution final {
+ public:
+  TimerResolution();
+  ~TimerResolution();
+
+  TimerResolution(const TimerResolution&) = delete;
+  TimerResolution(TimerResolution&&) = delete;
+  TimerResolution& operator=(const TimerResolution&) = delete;
+  TimerResolution& operator=(TimerResolution&&) = delete;
+};
+
+}// namespace FredEmmott::ControllerTester
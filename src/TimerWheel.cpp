@@ -0,0 +1,184 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "TimerWheel.hpp"
+
+#include <bit>
+
+namespace FredEmmott::ControllerTester {
+
+namespace {
+
+constexpr uint64_t SLOT_MASK {TimerWheel::SLOTS - 1};
+// Ticks covered by every level together
+constexpr uint64_t WHEEL_MASK
+  = (uint64_t {1} << (TimerWheel::SLOT_BITS * TimerWheel::LEVELS)) - 1;
+
+}// namespace
+
+TimerWheel::TimerWheel(Clock::duration tick, Clock::time_point start)
+  : mStart(start), mTick(tick) {
+  for (auto& level: mSlots) {
+    for (auto& slot: level) {
+      MakeEmpty(slot);
+    }
+  }
+  MakeEmpty(mOverflow);
+}
+
+void TimerWheel::Schedule(Timer& timer, Clock::time_point deadline) {
+  this->Cancel(timer);
+  this->Insert(
+    timer, std::max(this->ToTick(deadline, /* roundUp = */ true), mNow + 1));
+  ++mCount;
+}
+
+void TimerWheel::Cancel(Timer& timer) {
+  if (!timer.IsScheduled()) {
+    return;
+  }
+  Unlink(timer);
+  --mCount;
+  if (timer.mLevel >= LEVELS) {
+    return;
+  }
+  const auto& slot = mSlots[timer.mLevel][timer.mSlot];
+  if (slot.mNext == &slot) {
+    mOccupied[timer.mLevel] &= ~(uint64_t {1} << timer.mSlot);
+  }
+}
+
+std::optional<TimerWheel::Clock::time_point> TimerWheel::GetNextDeadline()
+  const {
+  // A lower level's slots all come before the next slot of any higher
+  // level, so the first level with anything ahead of now has the earliest
+  for (std::size_t level = 0; level < LEVELS; ++level) {
+    const auto shift = SLOT_BITS * level;
+    const auto index = (mNow >> shift) & SLOT_MASK;
+    // Slots at or before now have already expired or cascaded
+    const auto ahead = index == SLOT_MASK
+      ? 0
+      : mOccupied[level] & ~((uint64_t {2} << index) - 1);
+    if (!ahead) {
+      continue;
+    }
+    const auto blockMask = (uint64_t {1} << (shift + SLOT_BITS)) - 1;
+    const uint64_t slot = std::countr_zero(ahead);
+    return this->ToTime((mNow & ~blockMask) + (slot << shift));
+  }
+  if (mOverflow.mNext != &mOverflow) {
+    return this->ToTime((mNow | WHEEL_MASK) + 1);
+  }
+  return std::nullopt;
+}
+
+std::size_t TimerWheel::GetTimerCount() const {
+  return mCount;
+}
+
+uint64_t TimerWheel::ToTick(Clock::time_point time, bool roundUp) const {
+  if (time <= mStart) {
+    return 0;
+  }
+  const auto elapsed = time - mStart;
+  const auto ticks = static_cast<uint64_t>(elapsed / mTick);
+  if (roundUp && (elapsed % mTick) != Clock::duration::zero()) {
+    return ticks + 1;
+  }
+  return ticks;
+}
+
+TimerWheel::Clock::time_point TimerWheel::ToTime(uint64_t tick) const {
+  return mStart + (mTick * tick);
+}
+
+bool TimerWheel::HasLevel0AfterNow() const {
+  const auto index = mNow & SLOT_MASK;
+  if (index == SLOT_MASK) {
+    // The next tick is a new block, which might need a cascade
+    return true;
+  }
+  return mOccupied[0] & ~((uint64_t {2} << index) - 1);
+}
+
+void TimerWheel::Insert(Timer& timer, uint64_t deadline) {
+  timer.mDeadline = deadline;
+  const auto differs = deadline ^ mNow;
+  // Only during a cascade: due now, so goes in the slot about to expire
+  const std::size_t level
+    = differs ? (std::bit_width(differs) - 1) / SLOT_BITS : 0;
+  if (level >= LEVELS) {
+    timer.mLevel = LEVELS;
+    timer.mSlot = 0;
+    Link(mOverflow, timer);
+    return;
+  }
+  const auto slot = (deadline >> (SLOT_BITS * level)) & SLOT_MASK;
+  timer.mLevel = static_cast<uint8_t>(level);
+  timer.mSlot = static_cast<uint8_t>(slot);
+  Link(mSlots[level][slot], timer);
+  mOccupied[level] |= uint64_t {1} << slot;
+}
+
+void TimerWheel::MakeEmpty(Timer& list) {
+  list.mPrevious = &list;
+  list.mNext = &list;
+}
+
+void TimerWheel::Link(Timer& list, Timer& timer) {
+  timer.mPrevious = list.mPrevious;
+  timer.mNext = &list;
+  list.mPrevious->mNext = &timer;
+  list.mPrevious = &timer;
+}
+
+void TimerWheel::Unlink(Timer& timer) {
+  timer.mPrevious->mNext = timer.mNext;
+  timer.mNext->mPrevious = timer.mPrevious;
+  timer.mPrevious = nullptr;
+  timer.mNext = nullptr;
+}
+
+void TimerWheel::TakeSlot(std::size_t level, std::size_t slot, Timer& out) {
+  auto& list = (level >= LEVELS) ? mOverflow : mSlots[level][slot];
+  if (list.mNext == &list) {
+    MakeEmpty(out);
+    return;
+  }
+  out.mNext = list.mNext;
+  out.mPrevious = list.mPrevious;
+  out.mNext->mPrevious = &out;
+  out.mPrevious->mNext = &out;
+  MakeEmpty(list);
+  if (level < LEVELS) {
+    mOccupied[level] &= ~(uint64_t {1} << slot);
+  }
+}
+
+void TimerWheel::Cascade() {
+  // Highest first, so that timers can move down several levels at once
+  if ((mNow & WHEEL_MASK) == 0) {
+    Timer pending;
+    this->TakeSlot(LEVELS, 0, pending);
+    this->Reinsert(pending);
+  }
+  for (std::size_t level = LEVELS - 1; level > 0; --level) {
+    const auto shift = SLOT_BITS * level;
+    if ((mNow & ((uint64_t {1} << shift) - 1)) != 0) {
+      continue;
+    }
+    Timer pending;
+    this->TakeSlot(level, (mNow >> shift) & SLOT_MASK, pending);
+    this->Reinsert(pending);
+  }
+}
+
+void TimerWheel::Reinsert(Timer& list) {
+  while (list.mNext != &list) {
+    auto& timer = *list.mNext;
+    Unlink(timer);
+    this->Insert(timer, timer.mDeadline);
+  }
+}
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,139 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+namespace FredEmmott::ControllerTester {
+
+/* Deadlines for any number of timers, with constant-time scheduling.
+ *
+ * A hierarchical timing wheel: each level has 64 slots, each 64 times
+ * longer than the level below's. A timer goes in the highest level at which
+ * its deadline differs from the current tick, and moves down a level each
+ * time the level below wraps, until it expires from level 0.
+ *
+ * Scheduling, cancelling, and expiring a timer are O(1) regardless of how
+ * many timers there are; advancing time is O(1) per 64 ticks when nothing
+ * expires. Deadlines are rounded up to whole ticks, so timers never expire
+ * early.
+ *
+ * Not thread-safe.
+ */
+class TimerWheel final {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr std::size_t SLOT_BITS {6};
+  static constexpr std::size_t SLOTS {1 << SLOT_BITS};
+  static constexpr std::size_t LEVELS {4};
+
+  // Embedded in the caller's objects, which must not move while scheduled;
+  // cancel before destroying
+  class Timer {
+   public:
+    Timer() = default;
+
+    Timer(const Timer&) = delete;
+    Timer(Timer&&) = delete;
+    Timer& operator=(const Timer&) = delete;
+    Timer& operator=(Timer&&) = delete;
+
+    bool IsScheduled() const {
+      return mNext != nullptr;
+    }
+
+   private:
+    friend class TimerWheel;
+
+    // Circular, through the slot's sentinel
+    Timer* mPrevious {nullptr};
+    Timer* mNext {nullptr};
+    uint64_t mDeadline {};
+    // `LEVELS` for the overflow list
+    uint8_t mLevel {};
+    uint8_t mSlot {};
+  };
+
+  TimerWheel(Clock::duration tick, Clock::time_point start = Clock::now());
+
+  TimerWheel() = delete;
+  TimerWheel(const TimerWheel&) = delete;
+  TimerWheel(TimerWheel&&) = delete;
+  TimerWheel& operator=(const TimerWheel&) = delete;
+  TimerWheel& operator=(TimerWheel&&) = delete;
+
+  // Reschedules the timer if it's already scheduled; deadlines that have
+  // already passed expire on the next `Advance()`
+  void Schedule(Timer&, Clock::time_point deadline);
+  void Cancel(Timer&);
+
+  // Calls `f(Timer&)` for each timer that's due, in deadline order to the
+  // nearest tick; `f` can schedule or cancel any timer
+  template <class F>
+  void Advance(Clock::time_point now, F&& f) {
+    const auto target = this->ToTick(now, /* roundUp = */ false);
+    while (mNow < target) {
+      // Skip ticks with nothing to expire or cascade
+      if (!this->HasLevel0AfterNow()) {
+        mNow = std::min(target, mNow | (SLOTS - 1));
+        if (mNow == target) {
+          return;
+        }
+      }
+      ++mNow;
+      this->Cascade();
+
+      Timer expired;
+      this->TakeSlot(0, mNow & (SLOTS - 1), expired);
+      while (expired.mNext != &expired) {
+        auto& timer = *expired.mNext;
+        Unlink(timer);
+        --mCount;
+        f(timer);
+      }
+    }
+  }
+
+  // When the earliest timer is due, or when timers need to move between
+  // levels; nullopt if nothing is scheduled
+  std::optional<Clock::time_point> GetNextDeadline() const;
+
+  std::size_t GetTimerCount() const;
+
+ private:
+  Clock::time_point mStart;
+  Clock::duration mTick;
+  // Every tick up to and including this one has been processed
+  uint64_t mNow {};
+  std::size_t mCount {};
+
+  // Sentinels; each slot is a circular list
+  std::array<std::array<Timer, SLOTS>, LEVELS> mSlots;
+  // Bit `n` is set if slot `n` is non-empty
+  std::array<uint64_t, LEVELS> mOccupied {};
+  // Timers beyond the top level's range
+  Timer mOverflow;
+
+  uint64_t ToTick(Clock::time_point, bool roundUp) const;
+  Clock::time_point ToTime(uint64_t tick) const;
+
+  bool HasLevel0AfterNow() const;
+  void Insert(Timer&, uint64_t deadline);
+  static void MakeEmpty(Timer& list);
+  static void Link(Timer& list, Timer&);
+  static void Unlink(Timer&);
+  // Moves every timer in a slot to the sentinel `out`
+  void TakeSlot(std::size_t level, std::size_t slot, Timer& out);
+  // Moves timers down to lower levels if a level just wrapped
+  void Cascade();
+  // Empties `list` into the wheel, by deadline
+  void Reinsert(Timer& list);
+};
+
+}// namespace FredEmmott::ControllerTester
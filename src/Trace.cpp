@@ -0,0 +1,299 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace FredEmmott::ControllerTester::Trace {
+
+namespace {
+
+// ~1.5MB per thread
+constexpr std::size_t EVENTS_PER_THREAD {64 * 1024};
+
+std::atomic<bool> gEnabled {false};
+const auto gEpoch = std::chrono::steady_clock::now();
+
+int64_t Now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now() - gEpoch)
+    .count();
+}
+
+struct Event {
+  // Atomic so that the writer can overwrite events while they're being read;
+  // relaxed atomic stores are plain stores on x86 and ARM64
+  std::atomic<const char*> mName;
+  std::atomic<int64_t> mBegin;
+  std::atomic<int64_t> mEnd;
+};
+
+struct ThreadBuffer {
+  ThreadBuffer(uint32_t threadID) : mThreadID(threadID) {
+  }
+
+  const uint32_t mThreadID;
+  /* Only allocated once the thread records an event, as most threads are
+   * named but never traced.
+   *
+   * Only set by the owning thread, or once it has exited; other threads
+   * must hold the registry's mutex to copy it.
+   */
+  std::shared_ptr<Event[]> mEvents;
+  // Total written; the write position is `mWritten % EVENTS_PER_THREAD`
+  std::atomic<uint64_t> mWritten {};
+  // Guarded by the registry's mutex
+  bool mExited {false};
+
+  std::mutex mNameMutex;
+  std::string mName;
+};
+
+struct Registry {
+  std::mutex mMutex;
+  // Live threads, then threads that have exited but whose events haven't
+  // been reused yet
+  std::vector<std::shared_ptr<ThreadBuffer>> mBuffers;
+  uint32_t mNextThreadID {1};
+};
+
+Registry& GetRegistry() {
+  static Registry sRegistry;
+  return sRegistry;
+}
+
+// Unregisters the thread's buffer when the thread exits
+struct ThreadBufferOwner {
+  ThreadBufferOwner() = default;
+  ~ThreadBufferOwner() {
+    if (!mBuffer) {
+      return;
+    }
+    auto& registry = GetRegistry();
+    std::unique_lock lock(registry.mMutex);
+    if (mBuffer->mEvents) {
+      // Keep its events until another thread needs the space
+      mBuffer->mExited = true;
+      return;
+    }
+    std::erase(registry.mBuffers, mBuffer);
+  }
+
+  ThreadBufferOwner(const ThreadBufferOwner&) = delete;
+  ThreadBufferOwner(ThreadBufferOwner&&) = delete;
+  ThreadBufferOwner& operator=(const ThreadBufferOwner&) = delete;
+  ThreadBufferOwner& operator=(ThreadBufferOwner&&) = delete;
+
+  std::shared_ptr<ThreadBuffer> mBuffer;
+};
+
+ThreadBuffer& GetThreadBuffer() {
+  // Owned by the registry too, so that events from threads that have exited
+  // are still written out
+  thread_local ThreadBufferOwner tOwner;
+  if (!tOwner.mBuffer) {
+    auto& registry = GetRegistry();
+    std::unique_lock lock(registry.mMutex);
+    tOwner.mBuffer
+      = std::make_shared<ThreadBuffer>(registry.mNextThreadID++);
+    registry.mBuffers.push_back(tOwner.mBuffer);
+  }
+  return *tOwner.mBuffer;
+}
+
+/* Takes the events of the thread that exited first, if they aren't being
+ * written out, so memory use is bounded by the number of threads that
+ * record at the same time, not by the number that ever have.
+ */
+void AllocateEvents(ThreadBuffer& buffer) {
+  auto& registry = GetRegistry();
+  std::unique_lock lock(registry.mMutex);
+  const auto reusable = std::ranges::find_if(
+    registry.mBuffers, [](const std::shared_ptr<ThreadBuffer>& it) {
+      return it->mExited && it->mEvents.use_count() == 1;
+    });
+  if (reusable == registry.mBuffers.end()) {
+    buffer.mEvents.reset(new Event[EVENTS_PER_THREAD] {});
+    return;
+  }
+  buffer.mEvents = std::move((*reusable)->mEvents);
+  registry.mBuffers.erase(reusable);
+}
+
+void Record(const char* name, int64_t begin, int64_t end) {
+  auto& buffer = GetThreadBuffer();
+  if (!buffer.mEvents) [[unlikely]] {
+    AllocateEvents(buffer);
+  }
+  const auto index = buffer.mWritten.load(std::memory_order_relaxed);
+  auto& event = buffer.mEvents[index % EVENTS_PER_THREAD];
+  event.mName.store(name, std::memory_order_relaxed);
+  event.mBegin.store(begin, std::memory_order_relaxed);
+  event.mEnd.store(end, std::memory_order_relaxed);
+  buffer.mWritten.store(index + 1, std::memory_order_release);
+}
+
+void WriteJSONString(std::ostream& out, std::string_view str) {
+  out << '"';
+  for (const auto c: str) {
+    switch (c) {
+      case '"':
+        out << "\\\"";
+        break;
+      case '\\':
+        out << "\\\\";
+        break;
+      case '\n':
+        out << "\\n";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          continue;
+        }
+        out << c;
+    }
+  }
+  out << '"';
+}
+
+// Chrome traces use microseconds
+void WriteMicroseconds(std::ostream& out, int64_t nanoseconds) {
+  const auto fill = out.fill('0');
+  out << (nanoseconds / 1000) << '.' << std::setw(3) << (nanoseconds % 1000);
+  out.fill(fill);
+}
+
+struct CopiedEvent {
+  const char* mName;
+  int64_t mBegin;
+  int64_t mEnd;
+};
+
+std::vector<CopiedEvent> CopyEvents(
+  ThreadBuffer& buffer,
+  const std::shared_ptr<Event[]>& events) {
+  if (!events) {
+    return {};
+  }
+  constexpr auto capacity = EVENTS_PER_THREAD;
+  const auto end = buffer.mWritten.load(std::memory_order_acquire);
+  const auto begin = (end > capacity) ? (end - capacity) : 0;
+
+  std::vector<CopiedEvent> ret;
+  ret.reserve(end - begin);
+  for (auto i = begin; i < end; ++i) {
+    const auto& event = events[i % capacity];
+    ret.push_back({
+      event.mName.load(std::memory_order_relaxed),
+      event.mBegin.load(std::memory_order_relaxed),
+      event.mEnd.load(std::memory_order_relaxed),
+    });
+  }
+
+  // Drop anything the writer may have overwritten while we were copying;
+  // the slot of event `written` may be part-way through being overwritten,
+  // as the count is only published after the event is written
+  std::atomic_thread_fence(std::memory_order_acquire);
+  const auto written = buffer.mWritten.load(std::memory_order_relaxed);
+  if (written >= capacity) {
+    const auto firstValid = written - capacity + 1;
+    if (firstValid > begin) {
+      const auto overwritten
+        = std::min<uint64_t>(firstValid - begin, ret.size());
+      ret.erase(ret.begin(), ret.begin() + overwritten);
+    }
+  }
+  return ret;
+}
+
+}// namespace
+
+void SetEnabled(bool enabled) {
+  gEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool IsEnabled() {
+  return gEnabled.load(std::memory_order_relaxed);
+}
+
+void SetThreadName(std::string name) {
+  auto& buffer = GetThreadBuffer();
+  std::unique_lock lock(buffer.mNameMutex);
+  buffer.mName = std::move(name);
+}
+
+Zone::Zone(const char* name) {
+  if (!gEnabled.load(std::memory_order_relaxed)) {
+    return;
+  }
+  mName = name;
+  mBegin = Now();
+}
+
+Zone::~Zone() {
+  if (!mName) {
+    return;
+  }
+  Record(mName, mBegin, Now());
+}
+
+void WriteChromeTrace(std::ostream& out) {
+  // Copying the events' owners stops them being reused while they're read
+  std::vector<
+    std::pair<std::shared_ptr<ThreadBuffer>, std::shared_ptr<Event[]>>>
+    buffers;
+  {
+    auto& registry = GetRegistry();
+    std::unique_lock lock(registry.mMutex);
+    buffers.reserve(registry.mBuffers.size());
+    for (const auto& buffer: registry.mBuffers) {
+      buffers.emplace_back(buffer, buffer->mEvents);
+    }
+  }
+
+  out << R"({"displayTimeUnit":"ns","traceEvents":[)";
+  bool first = true;
+  const auto separator = [&first, &out]() {
+    if (first) {
+      first = false;
+    } else {
+      out << ",\n";
+    }
+  };
+
+  for (const auto& [buffer, events]: buffers) {
+    {
+      std::unique_lock lock(buffer->mNameMutex);
+      if (!buffer->mName.empty()) {
+        separator();
+        out << R"({"ph":"M","pid":1,"tid":)" << buffer->mThreadID
+            << R"(,"name":"thread_name","args":{"name":)";
+        WriteJSONString(out, buffer->mName);
+        out << "}}";
+      }
+    }
+
+    for (const auto& event: CopyEvents(*buffer, events)) {
+      separator();
+      out << R"({"ph":"X","pid":1,"tid":)" << buffer->mThreadID
+          << R"(,"ts":)";
+      WriteMicroseconds(out, event.mBegin);
+      out << R"(,"dur":)";
+      WriteMicroseconds(out, event.mEnd - event.mBegin);
+      out << R"(,"name":)";
+      WriteJSONString(out, event.mName);
+      out << '}';
+    }
+  }
+  out << "]}\n";
+}
+
+}// namespace FredEmmott::ControllerTester::Trace
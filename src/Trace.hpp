@@ -0,0 +1,52 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace FredEmmott::ControllerTester::Trace {
+
+/* Recording is off by default; while it's off, a `Zone` costs a single
+ * relaxed atomic load.
+ *
+ * When on, each thread records into its own fixed-size ring buffer, without
+ * locks; the oldest events are overwritten if they are not written out in
+ * time. Buffers are allocated by a thread's first event, and the buffers of
+ * threads that have exited are kept until another thread needs one.
+ */
+void SetEnabled(bool);
+bool IsEnabled();
+
+// Shown in trace viewers instead of the numeric thread ID
+void SetThreadName(std::string name);
+
+/* Records a complete event covering the lifetime of this object.
+ *
+ * `name` must outlive the trace, e.g. a string literal.
+ */
+class Zone final {
+ public:
+  explicit Zone(const char* name);
+  ~Zone();
+
+  Zone() = delete;
+  Zone(const Zone&) = delete;
+  Zone(Zone&&) = delete;
+  Zone& operator=(const Zone&) = delete;
+  Zone& operator=(Zone&&) = delete;
+
+ private:
+  const char* mName {nullptr};
+  int64_t mBegin {};
+};
+
+/* Write every buffered event from every thread in the Chrome Trace Event
+ * format.
+ *
+ * This can be loaded by `chrome://tracing` or https://ui.perfetto.dev
+ */
+void WriteChromeTrace(std::ostream&);
+
+}// namespace FredEmmott::ControllerTester::Trace
@@ -0,0 +1,106 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "Trigger.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+
+#include "ControlAnalysis.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+const char* GetTriggerReasonName(TriggerReason reason) {
+  switch (reason) {
+    case TriggerReason::AxisJump:
+      return "axis-jump";
+    case TriggerReason::ButtonChange:
+      return "button-change";
+    case TriggerReason::HatLeavesCenter:
+      return "hat-leaves-center";
+    case TriggerReason::OutOfRange:
+      return "out-of-range";
+  }
+  return "unknown";
+}
+
+TriggerEvaluator::TriggerEvaluator(
+  const DeviceInfo& device,
+  const TriggerConditions& conditions)
+  : mButtonChange(conditions.mButtonChange),
+    mHatLeavesCenter(conditions.mHatLeavesCenter),
+    mOutOfRange(conditions.mOutOfRange) {
+  mAxes.reserve(device.mAxes.size());
+  for (const auto& axis: device.mAxes) {
+    const auto range = static_cast<double>(axis.mMax) - axis.mMin;
+    // At least 1, so that a tiny threshold doesn't mean 'never'
+    const auto jump = (conditions.mAxisJump > 0)
+      ? std::max<int64_t>(1, std::llround(range * conditions.mAxisJump))
+      : 0;
+    mAxes.push_back({
+      .mMin = axis.mMin,
+      .mMax = axis.mMax,
+      .mJump = jump,
+    });
+  }
+}
+
+std::optional<TriggerEvent> TriggerEvaluator::Evaluate(
+  const DeviceState& previous,
+  const DeviceState& current) const {
+  assert(current.mAxes.size() == mAxes.size());
+  assert(previous.mAxes.size() == mAxes.size());
+
+  for (std::size_t i = 0; i < mAxes.size(); ++i) {
+    const auto& limits = mAxes[i];
+    if (limits.mJump == 0) {
+      continue;
+    }
+    const auto delta
+      = std::abs(static_cast<int64_t>(current.mAxes[i]) - previous.mAxes[i]);
+    if (delta > limits.mJump) {
+      return TriggerEvent {TriggerReason::AxisJump, i};
+    }
+  }
+
+  if (mButtonChange) {
+    for (std::size_t word = 0; word < current.mButtons.size(); ++word) {
+      const auto changed = current.mButtons[word] ^ previous.mButtons[word];
+      if (changed) {
+        return TriggerEvent {
+          TriggerReason::ButtonChange,
+          (word * DeviceState::BUTTONS_PER_WORD)
+            + static_cast<std::size_t>(std::countr_zero(changed)),
+        };
+      }
+    }
+  }
+
+  if (mHatLeavesCenter) {
+    for (std::size_t i = 0; i < current.mHats.size(); ++i) {
+      if (
+        IsHatCentered(previous.mHats[i]) && !IsHatCentered(current.mHats[i])) {
+        return TriggerEvent {TriggerReason::HatLeavesCenter, i};
+      }
+    }
+  }
+
+  if (mOutOfRange) {
+    const auto outOfRange = [](const AxisLimits& limits, int32_t value) {
+      return value < limits.mMin || value > limits.mMax;
+    };
+    for (std::size_t i = 0; i < mAxes.size(); ++i) {
+      if (
+        outOfRange(mAxes[i], current.mAxes[i])
+        && !outOfRange(mAxes[i], previous.mAxes[i])) {
+        return TriggerEvent {TriggerReason::OutOfRange, i};
+      }
+    }
+  }
+
+  return std::nullopt;
+}
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,71 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "DeviceInfo.hpp"
+#include "DeviceState.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+struct TriggerConditions {
+  // An axis changing by more than this fraction of its range between two
+  // samples; 0 to disable
+  float mAxisJump {0.25f};
+  bool mButtonChange {false};
+  bool mHatLeavesCenter {false};
+  // An axis leaving its `mMin..mMax`
+  bool mOutOfRange {true};
+};
+
+enum class TriggerReason {
+  AxisJump,
+  ButtonChange,
+  HatLeavesCenter,
+  OutOfRange,
+};
+
+// Suitable for file names
+const char* GetTriggerReasonName(TriggerReason);
+
+struct TriggerEvent {
+  TriggerReason mReason {};
+  // Index into `DeviceInfo::mAxes`, `mButtons`, or `mHats`
+  std::size_t mControl {};
+};
+
+/* Checks each sample against the previous one.
+ *
+ * Every condition is edge-triggered: e.g. an axis that stays out of range
+ * only triggers once, when it leaves the range.
+ *
+ * This copies what it needs from the `DeviceInfo`, so it can be used on a
+ * thread that doesn't own the device.
+ */
+class TriggerEvaluator final {
+ public:
+  TriggerEvaluator(const DeviceInfo&, const TriggerConditions&);
+
+  // The first condition that matches, in the order of `TriggerReason`
+  std::optional<TriggerEvent> Evaluate(
+    const DeviceState& previous,
+    const DeviceState& current) const;
+
+ private:
+  struct AxisLimits {
+    int32_t mMin {};
+    int32_t mMax {};
+    // 0 if disabled
+    int64_t mJump {};
+  };
+  std::vector<AxisLimits> mAxes;
+  bool mButtonChange {false};
+  bool mHatLeavesCenter {false};
+  bool mOutOfRange {false};
+};
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,161 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "TriggeredCapture.hpp"
+
+#include <algorithm>
+#include <string>
+
+#include "Capture.hpp"
+#include "Trace.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+namespace {
+
+std::size_t GetRingCapacity(const TriggeredCaptureSettings& settings) {
+  const auto interval
+    = std::max(settings.mSampleInterval, std::chrono::microseconds {1});
+  const auto window = settings.mPreTrigger + settings.mPostTrigger;
+  // Twice the window, so the writer has time to read the start of the window
+  // before it's overwritten
+  return static_cast<std::size_t>(2 * ((window / interval) + 1));
+}
+
+}// namespace
+
+TriggeredCapture::TriggeredCapture(
+  const DeviceInfo& device,
+  std::filesystem::path pathPrefix,
+  const TriggeredCaptureSettings& settings)
+  : mDevice(device),
+    mPathPrefix(std::move(pathPrefix)),
+    mSettings(settings),
+    mEvaluator(device, settings.mConditions),
+    mRing(
+      device.mAxes.size(),
+      device.mHats.size(),
+      device.mButtons.size(),
+      GetRingCapacity(settings)),
+    mWriter([this](std::stop_token stop) { this->Run(stop); }) {
+  // So that `Push()` never allocates
+  mPrevious.Resize(
+    device.mAxes.size(), device.mHats.size(), device.mButtons.size());
+}
+
+TriggeredCapture::~TriggeredCapture() {
+  mWriter.request_stop();
+  // Wake it up; it checks for a stop request before handling a request
+  mRequested.fetch_add(1);
+  mRequested.notify_one();
+}
+
+void TriggeredCapture::Push(Clock::time_point now, const DeviceState& state) {
+  const auto time
+    = std::chrono::duration_cast<std::chrono::microseconds>(now - mEpoch);
+  const auto sequence = mRing.GetEnd();
+  mRing.Push(time, state);
+
+  if (mHavePrevious && !mCollecting) {
+    if (const auto event = mEvaluator.Evaluate(mPrevious, state)) {
+      mTriggerCount.fetch_add(1, std::memory_order_relaxed);
+      mCollecting = Request {
+        .mTriggerSequence = sequence,
+        .mTriggerTime = time,
+        .mEvent = *event,
+      };
+    }
+  }
+
+  if (
+    mCollecting
+    && (time - mCollecting->mTriggerTime) >= mSettings.mPostTrigger) {
+    mCollecting->mEnd = sequence + 1;
+    // Only one capture is written at a time; if the writer is still busy,
+    // drop this one rather than waiting
+    if (
+      mRequested.load(std::memory_order_relaxed)
+      == mCompleted.load(std::memory_order_acquire)) {
+      mRequest = *mCollecting;
+      mRequested.fetch_add(1, std::memory_order_release);
+      mRequested.notify_one();
+    } else {
+      mDroppedTriggerCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    mCollecting.reset();
+  }
+
+  mPrevious.mAxes.assign(state.mAxes.begin(), state.mAxes.end());
+  mPrevious.mHats.assign(state.mHats.begin(), state.mHats.end());
+  mPrevious.mButtons.assign(state.mButtons.begin(), state.mButtons.end());
+  mHavePrevious = true;
+}
+
+uint64_t TriggeredCapture::GetTriggerCount() const {
+  return mTriggerCount.load(std::memory_order_relaxed);
+}
+
+uint64_t TriggeredCapture::GetCaptureCount() const {
+  return mCaptureCount.load(std::memory_order_relaxed);
+}
+
+uint64_t TriggeredCapture::GetDroppedTriggerCount() const {
+  return mDroppedTriggerCount.load(std::memory_order_relaxed);
+}
+
+uint64_t TriggeredCapture::GetLostSampleCount() const {
+  return mLostSampleCount.load(std::memory_order_relaxed);
+}
+
+void TriggeredCapture::Run(std::stop_token stop) {
+  Trace::SetThreadName("TriggeredCapture");
+  uint64_t handled {0};
+  while (true) {
+    mRequested.wait(handled, std::memory_order_acquire);
+    if (stop.stop_requested()) {
+      return;
+    }
+    this->Write(mRequest, ++handled);
+    mCompleted.store(handled, std::memory_order_release);
+  }
+}
+
+void TriggeredCapture::Write(const Request& request, uint64_t index) {
+  const Trace::Zone traceZone {"TriggeredCapture::Write"};
+  DeviceState state;
+
+  // Find the start of the pre-trigger window; this stops early if the start
+  // has already been overwritten
+  auto begin = request.mTriggerSequence;
+  const auto earliest = request.mTriggerTime - mSettings.mPreTrigger;
+  while (begin > 0) {
+    const auto time = mRing.Read(begin - 1, state);
+    if (!(time && *time >= earliest)) {
+      break;
+    }
+    --begin;
+  }
+
+  auto path = mPathPrefix;
+  path += "-" + std::to_string(index) + "-"
+    + GetTriggerReasonName(request.mEvent.mReason) + ".fctcap";
+
+  std::optional<CaptureWriter> writer;
+  for (auto sequence = begin; sequence < request.mEnd; ++sequence) {
+    const auto time = mRing.Read(sequence, state);
+    if (!time) {
+      mLostSampleCount.fetch_add(1, std::memory_order_relaxed);
+      continue;
+    }
+    if (!writer) {
+      writer.emplace(path, mDevice, mEpoch + *time);
+    }
+    writer->Append(mEpoch + *time, state);
+  }
+
+  if (writer && writer->IsValid()) {
+    mCaptureCount.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+}// namespace FredEmmott::ControllerTester
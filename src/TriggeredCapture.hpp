@@ -0,0 +1,106 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <thread>
+
+#include "DeviceInfo.hpp"
+#include "DeviceState.hpp"
+#include "SampleRing.hpp"
+#include "Trigger.hpp"
+
+namespace FredEmmott::ControllerTester {
+
+struct TriggeredCaptureSettings {
+  TriggerConditions mConditions;
+  std::chrono::microseconds mPreTrigger {std::chrono::milliseconds {500}};
+  std::chrono::microseconds mPostTrigger {std::chrono::milliseconds {500}};
+  // The expected time between samples; used to size the ring buffer
+  std::chrono::microseconds mSampleInterval {std::chrono::milliseconds {1}};
+};
+
+/* Like an oscilloscope's single-shot mode, re-armed after each capture.
+ *
+ * The most recent samples are kept in a `SampleRing`; when a trigger
+ * condition matches, the samples from `mPreTrigger` before it to
+ * `mPostTrigger` after it are written to a capture file by a background
+ * thread, while sampling continues.
+ *
+ * Files are named `{pathPrefix}-{n}-{reason}.fctcap`.
+ */
+class TriggeredCapture final {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  TriggeredCapture(
+    const DeviceInfo&,
+    std::filesystem::path pathPrefix,
+    const TriggeredCaptureSettings&);
+  ~TriggeredCapture();
+
+  TriggeredCapture() = delete;
+  TriggeredCapture(const TriggeredCapture&) = delete;
+  TriggeredCapture(TriggeredCapture&&) = delete;
+  TriggeredCapture& operator=(const TriggeredCapture&) = delete;
+  TriggeredCapture& operator=(TriggeredCapture&&) = delete;
+
+  /* Call for every sample, from a single thread.
+   *
+   * This never blocks, allocates, or does I/O, so it's suitable for the
+   * sampling loop. Must not be called during or after destruction.
+   */
+  void Push(Clock::time_point, const DeviceState&);
+
+  // These can be called from any thread
+
+  uint64_t GetTriggerCount() const;
+  uint64_t GetCaptureCount() const;
+  // Triggers that fired while the previous capture was still being written
+  uint64_t GetDroppedTriggerCount() const;
+  // Samples that were overwritten before they could be written out
+  uint64_t GetLostSampleCount() const;
+
+ private:
+  DeviceInfo mDevice;
+  std::filesystem::path mPathPrefix;
+  TriggeredCaptureSettings mSettings;
+  TriggerEvaluator mEvaluator;
+  SampleRing mRing;
+  const Clock::time_point mEpoch {Clock::now()};
+
+  // Only used by `Push()`
+  DeviceState mPrevious;
+  bool mHavePrevious {false};
+  struct Request {
+    uint64_t mTriggerSequence {};
+    uint64_t mEnd {};
+    std::chrono::microseconds mTriggerTime {};
+    TriggerEvent mEvent;
+  };
+  // The trigger that we're waiting for post-trigger samples for
+  std::optional<Request> mCollecting;
+
+  // Written by `Push()` before incrementing `mRequested`; read by the
+  // writer thread after it sees the increment
+  Request mRequest;
+  std::atomic<uint64_t> mRequested {0};
+  std::atomic<uint64_t> mCompleted {0};
+
+  std::atomic<uint64_t> mTriggerCount {0};
+  std::atomic<uint64_t> mCaptureCount {0};
+  std::atomic<uint64_t> mDroppedTriggerCount {0};
+  std::atomic<uint64_t> mLostSampleCount {0};
+
+  // Last, so that it's stopped before anything it uses is destroyed
+  std::jthread mWriter;
+
+  void Run(std::stop_token);
+  void Write(const Request&, uint64_t index);
+};
+
+}// namespace FredEmmott::ControllerTester
@@ -0,0 +1,55 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <unistd.h>
+
+#include <utility>
+
+namespace FredEmmott::ControllerTester {
+
+// An owned POSIX file descriptor; closed on destruction
+class UniqueFD final {
+ public:
+  UniqueFD() = default;
+  explicit UniqueFD(int fd) : mFD(fd) {
+  }
+
+  ~UniqueFD() {
+    this->Reset();
+  }
+
+  UniqueFD(const UniqueFD&) = delete;
+  UniqueFD& operator=(const UniqueFD&) = delete;
+
+  UniqueFD(UniqueFD&& other) noexcept : mFD(std::exchange(other.mFD, -1)) {
+  }
+
+  UniqueFD& operator=(UniqueFD&& other) noexcept {
+    if (this != &other) {
+      this->Reset();
+      mFD = std::exchange(other.mFD, -1);
+    }
+    return *this;
+  }
+
+  int Get() const {
+    return mFD;
+  }
+
+  explicit operator bool() const {
+    return mFD >= 0;
+  }
+
+  void Reset() {
+    if (mFD >= 0) {
+      close(mFD);
+      mFD = -1;
+    }
+  }
+
+ private:
+  int mFD {-1};
+};
+
+}// namespace FredEmmott::ControllerTester
@@ -20,13 +20,10 @@ struct XInputDeviceInfo final : public DeviceInfo {
   XInputDeviceInfo& operator=(const XInputDeviceInfo&) = delete;
   XInputDeviceInfo& operator=(XInputDeviceInfo&&) = default;
 
-  virtual bool Poll() override;
-  virtual std::vector<std::byte> GetState() override;
+  bool Poll();
+  std::optional<DeviceState> GetState(std::pmr::memory_resource*);
 
   DWORD mUserIndex;
-
- private:
-  struct EmulatedDIState;
 };
 
 }// namespace FredEmmott::ControllerTester
\ No newline at end of file
@@ -16,6 +16,9 @@ class XInputDeviceTracker final
  public:
   virtual ~XInputDeviceTracker() = default;
 
+  // User indices are slots, not controllers
+  static constexpr bool RETAIN_COVERAGE {false};
+
   static DWORD GetKey(DWORD);
   static DWORD GetKey(const XInputDeviceInfo&);
 
@@ -0,0 +1,158 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "FixedLayout.hpp"
+
+namespace FredEmmott::ControllerTester::XInput {
+
+// Same layout as `XINPUT_GAMEPAD`, without needing <Xinput.h>
+struct Gamepad {
+  uint16_t mButtons {};
+  uint8_t mLeftTrigger {};
+  uint8_t mRightTrigger {};
+  int16_t mThumbLX {};
+  int16_t mThumbLY {};
+  int16_t mThumbRX {};
+  int16_t mThumbRY {};
+};
+static_assert(sizeof(Gamepad) == 12);
+
+// `XINPUT_GAMEPAD_*`
+enum GamepadButton : uint16_t {
+  DPAD_UP = 0x0001,
+  DPAD_DOWN = 0x0002,
+  DPAD_LEFT = 0x0004,
+  DPAD_RIGHT = 0x0008,
+  START = 0x0010,
+  BACK = 0x0020,
+  LEFT_THUMB = 0x0040,
+  RIGHT_THUMB = 0x0080,
+  LEFT_SHOULDER = 0x0100,
+  RIGHT_SHOULDER = 0x0200,
+  A = 0x1000,
+  B = 0x2000,
+  X = 0x4000,
+  Y = 0x8000,
+};
+
+// Where each control would be in a DirectInput-style state buffer; XInput
+// states are decoded by `Decode()`, but these are still the controls'
+// `mDataOffset`s
+struct EmulatedDIState {
+  int32_t mLeftX;
+  int32_t mLeftY;
+  int32_t mRightX;
+  int32_t mRightY;
+  int32_t mLeftTrigger;
+  int32_t mRightTrigger;
+
+  int32_t mHat;
+
+  uint8_t mButtonA;
+  uint8_t mButtonB;
+  uint8_t mButtonX;
+  uint8_t mButtonY;
+
+  uint8_t mButtonLeftShoulder;
+  uint8_t mButtonRightShoulder;
+
+  uint8_t mButtonLeftStick;
+  uint8_t mButtonRightStick;
+
+  uint8_t mButtonBack;
+  uint8_t mButtonStart;
+};
+
+constexpr FixedLayout<6, 10, 1> LAYOUT {
+  .mAxes = {{
+    {"Left Thumb X", -32768, 32767, offsetof(EmulatedDIState, mLeftX)},
+    {"Left Thumb Y", -32768, 32767, offsetof(EmulatedDIState, mLeftY)},
+    {"Right Thumb X", -32768, 32767, offsetof(EmulatedDIState, mRightX)},
+    {"Right Thumb Y", -32768, 32767, offsetof(EmulatedDIState, mRightY)},
+    {"Left Trigger", 0, 255, offsetof(EmulatedDIState, mLeftTrigger)},
+    {"Right Trigger", 0, 255, offsetof(EmulatedDIState, mRightTrigger)},
+  }},
+  .mButtons = {{
+    {"A", offsetof(EmulatedDIState, mButtonA)},
+    {"B", offsetof(EmulatedDIState, mButtonB)},
+    {"X", offsetof(EmulatedDIState, mButtonX)},
+    {"Y", offsetof(EmulatedDIState, mButtonY)},
+    {"Left Shoulder", offsetof(EmulatedDIState, mButtonLeftShoulder)},
+    {"Right Shoulder", offsetof(EmulatedDIState, mButtonRightShoulder)},
+    {"Left Stick", offsetof(EmulatedDIState, mButtonLeftStick)},
+    {"Right Stick", offsetof(EmulatedDIState, mButtonRightStick)},
+    {"Back", offsetof(EmulatedDIState, mButtonBack)},
+    {"Start", offsetof(EmulatedDIState, mButtonStart)},
+  }},
+  .mHats = {{
+    {"D-Pad", HatType::EightWay, offsetof(EmulatedDIState, mHat)},
+  }},
+};
+
+using State = FixedState<decltype(LAYOUT)>;
+
+// Same order as `LAYOUT.mButtons`
+constexpr std::array<uint16_t, LAYOUT.BUTTON_COUNT> BUTTON_FLAGS {
+  A,
+  B,
+  X,
+  Y,
+  LEFT_SHOULDER,
+  RIGHT_SHOULDER,
+  LEFT_THUMB,
+  RIGHT_THUMB,
+  BACK,
+  START,
+};
+
+constexpr uint16_t DPAD_MASK {DPAD_UP | DPAD_DOWN | DPAD_LEFT | DPAD_RIGHT};
+static_assert(DPAD_MASK == 0xf);
+
+// Hat value for every combination of D-Pad bits; impossible combinations
+// are centered
+constexpr auto HAT_VALUES = []() {
+  std::array<int32_t, DPAD_MASK + 1> ret {};
+  ret.fill(-1);
+  ret[DPAD_UP] = 0;
+  ret[DPAD_UP | DPAD_RIGHT] = 4500;
+  ret[DPAD_RIGHT] = 9000;
+  ret[DPAD_DOWN | DPAD_RIGHT] = 13500;
+  ret[DPAD_DOWN] = 18000;
+  ret[DPAD_DOWN | DPAD_LEFT] = 22500;
+  ret[DPAD_LEFT] = 27000;
+  ret[DPAD_UP | DPAD_LEFT] = 31500;
+  return ret;
+}();
+
+/* Decode without any loops or branches over the layout.
+ *
+ * Everything the generic path reads from `AxisInfo::mDataOffset` etc is a
+ * constant here, so this compiles to straight-line code.
+ */
+constexpr State Decode(const Gamepad& gamepad) {
+  static_assert(LAYOUT.BUTTON_WORD_COUNT == 1);
+  return {
+    .mAxes = {
+      gamepad.mThumbLX,
+      gamepad.mThumbLY,
+      gamepad.mThumbRX,
+      gamepad.mThumbRY,
+      gamepad.mLeftTrigger,
+      gamepad.mRightTrigger,
+    },
+    .mHats = {HAT_VALUES[gamepad.mButtons & DPAD_MASK]},
+    .mButtons = {[buttons = gamepad.mButtons]<std::size_t... I>(
+                   std::index_sequence<I...>) {
+      return ((static_cast<uint64_t>((buttons & BUTTON_FLAGS[I]) != 0) << I)
+              | ...);
+    }(std::make_index_sequence<BUTTON_FLAGS.size()> {})},
+  };
+}
+
+}// namespace FredEmmott::ControllerTester::XInput
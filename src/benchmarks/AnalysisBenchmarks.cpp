@@ -0,0 +1,323 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <bit>
+#include <vector>
+
+#include "BenchmarkAllocations.hpp"
+#include "ControlAnalysis.hpp"
+#include "DecodePlan.hpp"
+#include "HidDecodeProgram.hpp"
+#include "NoiseAnalysis.hpp"
+#include "SyntheticDevice.hpp"
+#include "XInputLayout.hpp"
+
+namespace FredEmmott::ControllerTester::Benchmarks {
+
+namespace {
+
+// Enough distinct states to defeat branch prediction learning the sequence
+constexpr std::size_t STATE_COUNT {256};
+
+std::vector<std::vector<std::byte>> MakeStates(SyntheticDeviceInfo& device) {
+  std::vector<std::vector<std::byte>> ret;
+  for (std::size_t i = 0; i < STATE_COUNT; ++i) {
+    auto& state = ret.emplace_back(device.GetStateSize());
+    device.NextState(state);
+  }
+  return ret;
+}
+
+}// namespace
+
+// Convert a raw state buffer to a `DeviceState` with the generic decoder
+static void BM_DecodeState(
+  benchmark::State& state,
+  const SyntheticLayout& layout) {
+  SyntheticDeviceInfo device {0, layout};
+  const auto states = MakeStates(device);
+  DeviceState decoded;
+
+  std::size_t i {};
+  const auto allocations = GetAllocationStats();
+  for (auto _: state) {
+    DecodeState(device, states[i++ % STATE_COUNT], decoded);
+    benchmark::DoNotOptimize(decoded.mAxes.data());
+    benchmark::DoNotOptimize(decoded.mHats.data());
+    benchmark::DoNotOptimize(decoded.mButtons.data());
+  }
+  ReportAllocations(state, allocations);
+  state.SetItemsProcessed(
+    state.iterations()
+    * (device.mAxes.size() + device.mHats.size() + device.mButtons.size()));
+}
+BENCHMARK_CAPTURE(BM_DecodeState, xinput_shaped, XINPUT_SHAPED);
+BENCHMARK_CAPTURE(BM_DecodeState, directinput_128, DIRECTINPUT_128);
+
+// The same work with a plan compiled from the layout
+static void BM_DecodePlan(
+  benchmark::State& state,
+  const SyntheticLayout& layout) {
+  SyntheticDeviceInfo device {0, layout};
+  const auto states = MakeStates(device);
+  const DecodePlan plan {device};
+  DeviceState decoded;
+
+  std::size_t i {};
+  const auto allocations = GetAllocationStats();
+  for (auto _: state) {
+    plan.Decode(states[i++ % STATE_COUNT], decoded);
+    benchmark::DoNotOptimize(decoded.mAxes.data());
+    benchmark::DoNotOptimize(decoded.mHats.data());
+    benchmark::DoNotOptimize(decoded.mButtons.data());
+  }
+  ReportAllocations(state, allocations);
+  state.SetItemsProcessed(
+    state.iterations()
+    * (device.mAxes.size() + device.mHats.size() + device.mButtons.size()));
+  state.counters["runs"] = static_cast<double>(plan.GetRunCount());
+}
+BENCHMARK_CAPTURE(BM_DecodePlan, xinput_shaped, XINPUT_SHAPED);
+BENCHMARK_CAPTURE(BM_DecodePlan, directinput_128, DIRECTINPUT_128);
+
+// The same work for a real XInput layout, with the compile-time decoder
+static void BM_XInputDecode(benchmark::State& state) {
+  std::vector<XInput::Gamepad> gamepads(STATE_COUNT);
+  uint32_t random {1};
+  for (auto& gamepad: gamepads) {
+    std::array<std::byte, sizeof(XInput::Gamepad)> bytes {};
+    for (auto& byte: bytes) {
+      // xorshift32
+      random ^= random << 13;
+      random ^= random >> 17;
+      random ^= random << 5;
+      byte = static_cast<std::byte>(random);
+    }
+    gamepad = std::bit_cast<XInput::Gamepad>(bytes);
+  }
+  DeviceState decoded;
+
+  std::size_t i {};
+  const auto allocations = GetAllocationStats();
+  for (auto _: state) {
+    XInput::Decode(gamepads[i++ % STATE_COUNT]).CopyTo(decoded);
+    benchmark::DoNotOptimize(decoded.mAxes.data());
+    benchmark::DoNotOptimize(decoded.mHats.data());
+    benchmark::DoNotOptimize(decoded.mButtons.data());
+  }
+  ReportAllocations(state, allocations);
+  state.SetItemsProcessed(
+    state.iterations()
+    * (XInput::LAYOUT.AXIS_COUNT + XInput::LAYOUT.HAT_COUNT
+       + XInput::LAYOUT.BUTTON_COUNT));
+}
+BENCHMARK(BM_XInputDecode);
+
+// A HOTAS-like joystick: report 1 has three 16-bit axes, a 16-bit throttle,
+// an 8-way hat, and 32 buttons; report 2 has two signed 12-bit axes
+constexpr uint8_t HOTAS_DESCRIPTOR[] {
+  0x05, 0x01,// Usage Page (Generic Desktop)
+  0x09, 0x04,// Usage (Joystick)
+  0xa1, 0x01,// Collection (Application)
+  0x85, 0x01,// Report ID (1)
+  0x09, 0x30,// Usage (X)
+  0x09, 0x31,// Usage (Y)
+  0x09, 0x35,// Usage (Rz)
+  0x15, 0x00,// Logical Minimum (0)
+  0x27, 0xff, 0xff, 0x00, 0x00,// Logical Maximum (65535)
+  0x75, 0x10,// Report Size (16)
+  0x95, 0x03,// Report Count (3)
+  0x81, 0x02,// Input (Data, Variable, Absolute)
+  0x05, 0x02,// Usage Page (Simulation)
+  0x09, 0xbb,// Usage (Throttle)
+  0x95, 0x01,// Report Count (1)
+  0x81, 0x02,// Input (Data, Variable, Absolute)
+  0x05, 0x01,// Usage Page (Generic Desktop)
+  0x09, 0x39,// Usage (Hat Switch)
+  0x25, 0x07,// Logical Maximum (7)
+  0x75, 0x04,// Report Size (4)
+  0x81, 0x42,// Input (Data, Variable, Absolute, Null State)
+  0x81, 0x03,// Input (Constant)
+  0x05, 0x09,// Usage Page (Button)
+  0x19, 0x01,// Usage Minimum (1)
+  0x29, 0x20,// Usage Maximum (32)
+  0x25, 0x01,// Logical Maximum (1)
+  0x75, 0x01,// Report Size (1)
+  0x95, 0x20,// Report Count (32)
+  0x81, 0x02,// Input (Data, Variable, Absolute)
+  0x85, 0x02,// Report ID (2)
+  0x05, 0x01,// Usage Page (Generic Desktop)
+  0x09, 0x36,// Usage (Slider)
+  0x09, 0x37,// Usage (Dial)
+  0x16, 0x00, 0xf8,// Logical Minimum (-2048)
+  0x26, 0xff, 0x07,// Logical Maximum (2047)
+  0x75, 0x0c,// Report Size (12)
+  0x95, 0x02,// Report Count (2)
+  0x81, 0x02,// Input (Data, Variable, Absolute)
+  0xc0,// End Collection
+};
+
+// Decode HID input reports with a program compiled from the descriptor
+static void BM_HidDecodeProgram(benchmark::State& state) {
+  const HidDecodeProgram program {std::as_bytes(std::span {HOTAS_DESCRIPTOR})};
+  std::vector<std::vector<std::byte>> reports;
+  uint32_t random {1};
+  for (std::size_t i = 0; i < STATE_COUNT; ++i) {
+    auto& report = reports.emplace_back(program.GetMaxReportSize());
+    for (auto& byte: report) {
+      // xorshift32
+      random ^= random << 13;
+      random ^= random >> 17;
+      random ^= random << 5;
+      byte = static_cast<std::byte>(random);
+    }
+    report[0] = std::byte {1};
+  }
+  DeviceState decoded;
+  DeviceInfo device;
+  program.Describe(device);
+
+  std::size_t i {};
+  const auto allocations = GetAllocationStats();
+  for (auto _: state) {
+    benchmark::DoNotOptimize(
+      program.Decode(reports[i++ % STATE_COUNT], decoded));
+    benchmark::DoNotOptimize(decoded.mAxes.data());
+    benchmark::DoNotOptimize(decoded.mHats.data());
+    benchmark::DoNotOptimize(decoded.mButtons.data());
+  }
+  ReportAllocations(state, allocations);
+  // Report 1's controls
+  state.SetItemsProcessed(
+    state.iterations()
+    * ((device.mAxes.size() - 2) + device.mHats.size()
+       + device.mButtons.size()));
+  state.counters["instructions"]
+    = static_cast<double>(program.GetInstructionCount());
+}
+BENCHMARK(BM_HidDecodeProgram);
+
+// Arg: history length in samples
+static void BM_AxisHistoryAppend(benchmark::State& state) {
+  const auto historyLength = static_cast<std::size_t>(state.range(0));
+  AxisInfo axis {.mName = "Axis", .mMin = 0, .mMax = 65535};
+  UpdateAxisHistory(axis, 0, historyLength);
+
+  int32_t value {};
+  const auto allocations = GetAllocationStats();
+  for (auto _: state) {
+    UpdateAxisHistory(axis, value, historyLength);
+    value = (value + 257) & 0xffff;
+  }
+  benchmark::DoNotOptimize(axis.mValues.data());
+  ReportAllocations(state, allocations);
+}
+BENCHMARK(BM_AxisHistoryAppend)
+  ->ArgName("samples")
+  ->Arg(300)// AXIS_HISTORY_FRAMES at 60FPS
+  ->Arg(1000)
+  ->Arg(5000);
+
+// Seen extents, tested-range and position classification, and percentage
+static void BM_AxisExtentsAndClassification(
+  benchmark::State& state,
+  const SyntheticLayout& layout) {
+  SyntheticDeviceInfo device {0, layout};
+  const auto states = MakeStates(device);
+
+  std::size_t i {};
+  const auto allocations = GetAllocationStats();
+  for (auto _: state) {
+    const auto buf = states[i++ % STATE_COUNT].data();
+    for (auto& axis: device.mAxes) {
+      const auto value = GetAxisValue(buf, axis);
+      UpdateAxisExtents(axis, value);
+      benchmark::DoNotOptimize(GetTestedRange(axis));
+      benchmark::DoNotOptimize(GetAxisPosition(axis, value));
+      benchmark::DoNotOptimize(GetAxisPercent(axis, value));
+    }
+  }
+  ReportAllocations(state, allocations);
+  state.SetItemsProcessed(state.iterations() * device.mAxes.size());
+}
+BENCHMARK_CAPTURE(
+  BM_AxisExtentsAndClassification,
+  xinput_shaped,
+  XINPUT_SHAPED);
+BENCHMARK_CAPTURE(
+  BM_AxisExtentsAndClassification,
+  directinput_128,
+  DIRECTINPUT_128);
+
+static void BM_HatDecode(benchmark::State& state) {
+  SyntheticDeviceInfo device {0, DIRECTINPUT_128};
+  const auto states = MakeStates(device);
+
+  std::size_t i {};
+  const auto allocations = GetAllocationStats();
+  for (auto _: state) {
+    const auto buf = states[i++ % STATE_COUNT].data();
+    for (auto& hat: device.mHats) {
+      const auto value = GetHatValue(buf, hat);
+      benchmark::DoNotOptimize(IsHatCentered(value));
+      UpdateHatSeen(hat, value);
+      benchmark::DoNotOptimize(
+        (hat.mSeenFlags & GetHatFullRangeFlags(hat.mType)));
+    }
+  }
+  ReportAllocations(state, allocations);
+  state.SetItemsProcessed(state.iterations() * device.mHats.size());
+}
+BENCHMARK(BM_HatDecode);
+
+static void BM_ButtonUpdate(
+  benchmark::State& state,
+  const SyntheticLayout& layout) {
+  SyntheticDeviceInfo device {0, layout};
+  const auto states = MakeStates(device);
+
+  std::size_t i {};
+  const auto allocations = GetAllocationStats();
+  for (auto _: state) {
+    const auto buf = states[i++ % STATE_COUNT].data();
+    for (auto& button: device.mButtons) {
+      UpdateButtonSeen(button, IsButtonPressed(buf, button));
+    }
+  }
+  benchmark::DoNotOptimize(device.mButtons.data());
+  ReportAllocations(state, allocations);
+  state.SetItemsProcessed(state.iterations() * device.mButtons.size());
+}
+BENCHMARK_CAPTURE(BM_ButtonUpdate, xinput_shaped, XINPUT_SHAPED);
+BENCHMARK_CAPTURE(BM_ButtonUpdate, directinput_128, DIRECTINPUT_128);
+
+// One axis's share of a noise analysis update
+// Arg: window size in samples
+static void BM_SpectrumAnalyze(benchmark::State& state) {
+  const auto windowSize = static_cast<std::size_t>(state.range(0));
+  SpectrumAnalyzer analyzer {windowSize};
+  std::vector<float> samples(windowSize);
+  uint32_t random {1};
+  for (auto& sample: samples) {
+    random = (random * 1664525) + 1013904223;
+    sample = static_cast<float>(random >> 8) / (1 << 24);
+  }
+  std::vector<float> levels(analyzer.GetBinCount());
+
+  const auto allocations = GetAllocationStats();
+  for (auto _: state) {
+    analyzer.Analyze(samples, levels);
+    benchmark::DoNotOptimize(levels.data());
+  }
+  ReportAllocations(state, allocations);
+}
+BENCHMARK(BM_SpectrumAnalyze)
+  ->ArgName("samples")
+  ->Arg(256)
+  ->Arg(1024)
+  ->Arg(4096);
+
+}// namespace FredEmmott::ControllerTester::Benchmarks
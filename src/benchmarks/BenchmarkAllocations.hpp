@@ -0,0 +1,26 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <benchmark/benchmark.h>
+
+#include "AllocationCounter.hpp"
+
+namespace FredEmmott::ControllerTester::Benchmarks {
+
+/* Adds `allocs/op` and `alloc bytes/op` counters.
+ *
+ * Take the snapshot immediately before the benchmark loop, and call this
+ * immediately after it.
+ */
+inline void ReportAllocations(
+  benchmark::State& state,
+  const AllocationStats& before) {
+  const auto delta = GetAllocationStats() - before;
+  state.counters["allocs/op"] = benchmark::Counter(
+    static_cast<double>(delta.mCount), benchmark::Counter::kAvgIterations);
+  state.counters["alloc bytes/op"] = benchmark::Counter(
+    static_cast<double>(delta.mBytes), benchmark::Counter::kAvgIterations);
+}
+
+}// namespace FredEmmott::ControllerTester::Benchmarks
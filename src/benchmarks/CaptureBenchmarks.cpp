@@ -0,0 +1,132 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include <benchmark/benchmark.h>
+
+#include <filesystem>
+#include <vector>
+
+#include "AnomalyDetector.hpp"
+#include "BenchmarkAllocations.hpp"
+#include "Capture.hpp"
+#include "SessionAnalysis.hpp"
+#include "SyntheticDevice.hpp"
+#include "TriggeredCapture.hpp"
+
+namespace FredEmmott::ControllerTester::Benchmarks {
+
+namespace {
+
+std::filesystem::path GetCapturePath() {
+  return std::filesystem::temp_directory_path()
+    / "freds-controller-tester-benchmark.fctcap";
+}
+
+// One second per thousand samples
+void CreateCapture(const SyntheticLayout& layout, std::size_t sampleCount) {
+  SyntheticDeviceInfo device {0, layout};
+  const CaptureWriter::Clock::time_point start {};
+  CaptureWriter writer {GetCapturePath(), device, start};
+  for (std::size_t i = 0; i < sampleCount; ++i) {
+    writer.Append(
+      start + std::chrono::milliseconds {i},
+      *device.GetState(std::pmr::get_default_resource()));
+  }
+}
+
+}// namespace
+
+// What the batch analyzer does for each file
+template <const SyntheticLayout& TLayout>
+static void BM_CaptureAnalyze(benchmark::State& state) {
+  const auto sampleCount = static_cast<std::size_t>(state.range(0));
+  CreateCapture(TLayout, sampleCount);
+
+  const auto allocations = GetAllocationStats();
+  for (auto _: state) {
+    const CaptureReader reader {GetCapturePath()};
+    auto device = reader.GetDeviceInfo();
+    SessionAnalyzer analyzer {device, {}};
+    DeviceState sample;
+    for (std::size_t i = 0; i < reader.GetSampleCount(); ++i) {
+      analyzer.Push(reader.ReadSample(i, sample), sample);
+    }
+    benchmark::DoNotOptimize(analyzer.GetButtonBounce().data());
+  }
+  ReportAllocations(state, allocations);
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  std::filesystem::remove(GetCapturePath());
+}
+BENCHMARK(BM_CaptureAnalyze<XINPUT_SHAPED>)
+  ->Name("BM_CaptureAnalyze/xinput")
+  ->ArgName("samples")
+  ->Arg(100'000)
+  ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_CaptureAnalyze<DIRECTINPUT_128>)
+  ->Name("BM_CaptureAnalyze/directinput_128")
+  ->ArgName("samples")
+  ->Arg(100'000)
+  ->Unit(benchmark::kMillisecond);
+
+// The cost added to each sample by an armed trigger that doesn't fire
+template <const SyntheticLayout& TLayout>
+static void BM_TriggeredCapturePush(benchmark::State& state) {
+  SyntheticDeviceInfo device {0, TLayout};
+  // Two states that are too similar to fire the trigger
+  std::vector<DeviceState> states;
+  states.push_back(*device.GetState(std::pmr::get_default_resource()));
+  states.push_back(states.front());
+  states.back().mAxes.front() += 1;
+
+  const TriggeredCaptureSettings settings {
+    .mConditions = {.mAxisJump = 0.5f, .mHatLeavesCenter = true},
+  };
+  TriggeredCapture capture {
+    device, std::filesystem::temp_directory_path() / "unused", settings};
+  const auto start = TriggeredCapture::Clock::now();
+  std::size_t i {};
+
+  const auto allocations = GetAllocationStats();
+  for (auto _: state) {
+    capture.Push(start + std::chrono::milliseconds {i}, states[i % 2]);
+    ++i;
+  }
+  ReportAllocations(state, allocations);
+  state.SetItemsProcessed(state.iterations());
+  if (capture.GetTriggerCount() != 0) {
+    state.SkipWithError("Trigger fired");
+  }
+}
+BENCHMARK(BM_TriggeredCapturePush<XINPUT_SHAPED>)
+  ->Name("BM_TriggeredCapturePush/xinput");
+BENCHMARK(BM_TriggeredCapturePush<DIRECTINPUT_128>)
+  ->Name("BM_TriggeredCapturePush/directinput_128");
+
+// Pseudo-random states, so most samples have jumps and many are anomalies
+template <const SyntheticLayout& TLayout>
+static void BM_AnomalyDetectorPush(benchmark::State& state) {
+  SyntheticDeviceInfo device {0, TLayout};
+  std::vector<DeviceState> states;
+  for (std::size_t i = 0; i < 64; ++i) {
+    states.push_back(*device.GetState(std::pmr::get_default_resource()));
+  }
+
+  AnomalyDetector detector {device, {}};
+  const auto start = AnomalyDetector::Clock::now();
+  std::size_t i {};
+
+  const auto allocations = GetAllocationStats();
+  for (auto _: state) {
+    detector.Push(
+      start + std::chrono::milliseconds {i}, states[i % states.size()]);
+    ++i;
+  }
+  ReportAllocations(state, allocations);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_AnomalyDetectorPush<XINPUT_SHAPED>)
+  ->Name("BM_AnomalyDetectorPush/xinput");
+BENCHMARK(BM_AnomalyDetectorPush<DIRECTINPUT_128>)
+  ->Name("BM_AnomalyDetectorPush/directinput_128");
+
+}// namespace FredEmmott::ControllerTester::Benchmarks
@@ -0,0 +1,139 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <numeric>
+#include <span>
+#include <vector>
+
+#include <imgui.h>
+
+#include "BenchmarkAllocations.hpp"
+#include "Config.hpp"
+#include "ControllerGUI.hpp"
+#include "FrameArena.hpp"
+#include "SyntheticDevice.hpp"
+
+namespace FredEmmott::ControllerTester::Benchmarks {
+
+namespace {
+
+/* An ImGui context with a built font atlas, but no renderer or window.
+ *
+ * Frames are laid out and tessellated as usual; the draw lists are just
+ * never submitted to a GPU.
+ */
+class HeadlessImGui final {
+ public:
+  HeadlessImGui() {
+    mContext = ImGui::CreateContext();
+    auto& io = ImGui::GetIO();
+    io.IniFilename = nullptr;
+    io.DisplaySize = {1024, 768};
+    io.DeltaTime = 1.0f / Config::MAX_FPS;
+
+    unsigned char* pixels {nullptr};
+    int width {}, height {};
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+  }
+
+  ~HeadlessImGui() {
+    ImGui::DestroyContext(mContext);
+  }
+
+  HeadlessImGui(const HeadlessImGui&) = delete;
+  HeadlessImGui(HeadlessImGui&&) = delete;
+  HeadlessImGui& operator=(const HeadlessImGui&) = delete;
+  HeadlessImGui& operator=(HeadlessImGui&&) = delete;
+
+ private:
+  ImGuiContext* mContext {nullptr};
+};
+
+// Mirrors `GUI::Run()` and `GUI::GUITabs()`
+void RenderFrame(
+  FrameArena& arena,
+  ControllerGUI& gui,
+  std::span<SyntheticDeviceInfo* const> devices) {
+  ImGui::NewFrame();
+
+  const auto viewport = ImGui::GetMainViewport();
+  ImGui::SetNextWindowPos(viewport->WorkPos);
+  ImGui::SetNextWindowSize(viewport->WorkSize);
+  ImGui::Begin(
+    "MainWindow",
+    0,
+    ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove
+      | ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoSavedSettings
+      | ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoScrollbar
+      | ImGuiWindowFlags_NoScrollWithMouse);
+  ImGui::BeginTabBar("##Controllers", ImGuiTabBarFlags_AutoSelectNewTabs);
+  for (auto device: devices) {
+    ImGui::PushID(device);
+    gui.GUIControllerTab(device);
+    ImGui::PopID();
+  }
+  ImGui::EndTabBar();
+  ImGui::End();
+
+  ImGui::Render();
+  arena.Reset();
+}
+
+}// namespace
+
+/* Args: {devices, axes and buttons per device}
+ *
+ * As in the app, only the selected tab's contents are drawn and polled, but
+ * every device has a tab.
+ */
+static void BM_ControllerTabFrame(benchmark::State& state) {
+  const auto deviceCount = static_cast<uint32_t>(state.range(0));
+  const auto controlCount = static_cast<std::size_t>(state.range(1));
+
+  const SyntheticLayout layout {
+    .mAxisCount = controlCount,
+    .mButtonCount = controlCount,
+    .mHatCount = 4,
+    .mAxisMin = 0,
+    .mAxisMax = 65535,
+  };
+
+  SyntheticDeviceTracker tracker {layout};
+  std::vector<uint32_t> attached(deviceCount);
+  std::iota(attached.begin(), attached.end(), 0);
+  tracker.SetAttached(attached);
+  const auto devices = tracker.GetAllDevices();
+
+  HeadlessImGui imgui;
+  FrameArena arena {Config::FRAME_ARENA_BYTES};
+  ControllerGUI gui {arena};
+
+  // Let tables, tab bars, and ImGui's own buffers settle
+  for (int i = 0; i < 10; ++i) {
+    RenderFrame(arena, gui, devices);
+  }
+
+  uint64_t vertices {};
+  uint64_t indices {};
+  const auto allocations = GetAllocationStats();
+  for (auto _: state) {
+    RenderFrame(arena, gui, devices);
+    const auto drawData = ImGui::GetDrawData();
+    vertices += drawData->TotalVtxCount;
+    indices += drawData->TotalIdxCount;
+  }
+  ReportAllocations(state, allocations);
+  state.counters["vertices/frame"] = benchmark::Counter(
+    static_cast<double>(vertices), benchmark::Counter::kAvgIterations);
+  state.counters["indices/frame"] = benchmark::Counter(
+    static_cast<double>(indices), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_ControllerTabFrame)
+  ->ArgNames({"devices", "controls"})
+  ->ArgsProduct({{1, 8, 32}, {8, 32, 128}})
+  ->Unit(benchmark::kMicrosecond);
+
+}// namespace FredEmmott::ControllerTester::Benchmarks
@@ -0,0 +1,147 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include <benchmark/benchmark.h>
+#include <fcntl.h>
+#include <linux/input.h>
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "InputQueue.hpp"
+#include "UniqueFD.hpp"
+
+namespace FredEmmott::ControllerTester::Benchmarks {
+
+namespace {
+
+constexpr std::chrono::seconds QUEUE_DURATION {2};
+constexpr std::chrono::milliseconds WRITE_INTERVAL {1};
+
+// X, Y, then `SYN_REPORT`, like a stick moving diagonally
+using Report = std::array<input_event, 3>;
+
+std::chrono::nanoseconds GetThreadCPUTime() {
+  timespec ts {};
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return std::chrono::seconds {ts.tv_sec}
+    + std::chrono::nanoseconds {ts.tv_nsec};
+}
+
+struct Pipe {
+  UniqueFD mRead;
+  UniqueFD mWrite;
+};
+
+}// namespace
+
+/* Reads evdev-style reports from many nodes through an `InputQueue`.
+ *
+ * Nodes are pipes, as there's no uinput here; another thread writes one
+ * report to each node in turn, every 1ms, for the given total reports per
+ * second. The queue is drained as it would be by a capture thread;
+ * `cpu_percent` is that thread's CPU time, and `syscalls/s` is only the
+ * reading side.
+ */
+static void BM_InputQueue(benchmark::State& state) {
+  const auto backend = state.range(0) ? InputQueue::Backend::Epoll
+                                      : InputQueue::Backend::IoUring;
+  const auto nodeCount = static_cast<std::size_t>(state.range(1));
+  const auto reportsPerSecond = static_cast<std::size_t>(state.range(2));
+  const auto reportsPerWrite = reportsPerSecond
+    / static_cast<std::size_t>(std::chrono::seconds {1} / WRITE_INTERVAL);
+
+  InputQueue queue {{.mBackend = backend}};
+  if (queue.GetBackend() != backend) {
+    state.SkipWithError("Backend not available");
+    return;
+  }
+
+  std::vector<Pipe> pipes(nodeCount);
+  uint64_t reports {};
+  for (auto& pipe: pipes) {
+    std::array<int, 2> fds {};
+    if (pipe2(fds.data(), O_NONBLOCK | O_CLOEXEC) != 0) {
+      state.SkipWithError("pipe2() failed");
+      return;
+    }
+    pipe.mRead = UniqueFD {fds[0]};
+    pipe.mWrite = UniqueFD {fds[1]};
+    queue.Add(pipe.mRead.Get(), [&reports](std::span<const std::byte> data) {
+      input_event event;
+      for (std::size_t offset = 0; offset + sizeof(event) <= data.size();
+           offset += sizeof(event)) {
+        std::memcpy(&event, data.data() + offset, sizeof(event));
+        reports += (event.type == EV_SYN && event.code == SYN_REPORT);
+      }
+    });
+  }
+
+  uint64_t syscalls {};
+  std::chrono::nanoseconds cpuTime {};
+  uint64_t dropped {};
+  for (auto _: state) {
+    std::atomic_bool stop {false};
+    std::jthread writer([&]() {
+      Report report {};
+      report[0].type = EV_ABS;
+      report[0].code = ABS_X;
+      report[1].type = EV_ABS;
+      report[1].code = ABS_Y;
+      report[2].type = EV_SYN;
+      report[2].code = SYN_REPORT;
+      std::size_t node {};
+      auto next = std::chrono::steady_clock::now();
+      while (!stop.load(std::memory_order_relaxed)) {
+        for (std::size_t i = 0; i < reportsPerWrite; ++i) {
+          ++report[0].value;
+          --report[1].value;
+          // The pipe's full if the reader's fallen behind
+          if (
+            write(pipes[node].mWrite.Get(), report.data(), sizeof(report))
+            != sizeof(report)) {
+            ++dropped;
+          }
+          node = (node + 1) % nodeCount;
+        }
+        next += WRITE_INTERVAL;
+        std::this_thread::sleep_until(next);
+      }
+    });
+
+    const auto syscallsAtStart = queue.GetSyscallCount();
+    const auto cpuAtStart = GetThreadCPUTime();
+    const auto end = std::chrono::steady_clock::now() + QUEUE_DURATION;
+    while (std::chrono::steady_clock::now() < end) {
+      queue.Drain(WRITE_INTERVAL * 10);
+    }
+    cpuTime += GetThreadCPUTime() - cpuAtStart;
+    syscalls += queue.GetSyscallCount() - syscallsAtStart;
+    stop = true;
+  }
+
+  const auto seconds = std::chrono::duration<double>(QUEUE_DURATION).count()
+    * static_cast<double>(state.iterations());
+  state.counters["reports/s"] = static_cast<double>(reports) / seconds;
+  state.counters["syscalls/s"] = static_cast<double>(syscalls) / seconds;
+  state.counters["syscalls/report"]
+    = static_cast<double>(syscalls) / static_cast<double>(reports);
+  state.counters["cpu_percent"]
+    = 100 * std::chrono::duration<double>(cpuTime).count() / seconds;
+  state.counters["dropped"] = static_cast<double>(dropped);
+}
+BENCHMARK(BM_InputQueue)
+  ->ArgNames({"epoll", "nodes", "reports/s"})
+  ->ArgsProduct({{0, 1}, {8, 64}, {8000, 64000}})
+  ->Iterations(1)
+  ->UseRealTime()
+  ->Unit(benchmark::kMillisecond);
+
+}// namespace FredEmmott::ControllerTester::Benchmarks
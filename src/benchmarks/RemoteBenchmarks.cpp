@@ -0,0 +1,116 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <numeric>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "DeviceSet.hpp"
+#include "RemoteClient.hpp"
+#include "RemotePublisher.hpp"
+#include "RemoteServer.hpp"
+#include "Socket.hpp"
+#include "SyntheticDevice.hpp"
+
+namespace FredEmmott::ControllerTester::Benchmarks {
+
+namespace {
+
+constexpr std::chrono::milliseconds SAMPLE_INTERVAL {1};
+constexpr std::chrono::seconds STREAM_DURATION {3};
+
+bool WaitForConnection(const RemoteClient& client) {
+  const auto timeout
+    = std::chrono::steady_clock::now() + std::chrono::seconds {5};
+  while (std::chrono::steady_clock::now() < timeout) {
+    if (client.GetStatus() != RemoteClient::Status::Connecting) {
+      return client.GetStatus() == RemoteClient::Status::Connected;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds {1});
+  }
+  return false;
+}
+
+}// namespace
+
+/* Streams synthetic devices sampled at 1khz to a viewer over loopback.
+ *
+ * Args: {devices, batch interval in ms, stalled viewers}; a stalled viewer
+ * connects but never reads, so the server falls back to summaries for it,
+ * without slowing down the other viewer.
+ *
+ * Latency is from when a sample was taken to when the viewer decoded it,
+ * for the last few thousand samples.
+ */
+static void BM_RemoteLoopback(benchmark::State& state) {
+  const auto deviceCount = static_cast<uint32_t>(state.range(0));
+  const std::chrono::milliseconds batchInterval {state.range(1)};
+  const auto stalledCount = static_cast<std::size_t>(state.range(2));
+
+  RemoteServer server {{
+    .mPort = 0,
+    .mLoopbackOnly = true,
+    .mBatchInterval = batchInterval,
+    .mMaxPendingBytes = 64 * 1024,
+  }};
+  if (!server.IsListening()) {
+    state.SkipWithError("Couldn't listen on loopback");
+    return;
+  }
+
+  DeviceSet<SyntheticDeviceTracker> devices {XINPUT_SHAPED};
+  std::vector<uint32_t> attached(deviceCount);
+  std::iota(attached.begin(), attached.end(), 0);
+  devices.GetTracker<SyntheticDeviceTracker>().SetAttached(attached);
+
+  RemoteClient client {"127.0.0.1", server.GetPort()};
+  std::vector<Socket> stalled;
+  for (std::size_t i = 0; i < stalledCount; ++i) {
+    stalled.push_back(Socket::Connect("127.0.0.1", server.GetPort()));
+  }
+  if (!WaitForConnection(client)) {
+    state.SkipWithError("Couldn't connect over loopback");
+    return;
+  }
+
+  std::optional<RemoteServer::Stats> serverStats;
+  for (auto _: state) {
+    // Synthetic devices change on every read, so are polled at this rate
+    RemotePublisher publisher {server, {.mMinInterval = SAMPLE_INTERVAL}};
+    publisher.Update(devices);
+    std::this_thread::sleep_for(STREAM_DURATION);
+    // Before the publisher stops, so that the viewer count is current
+    serverStats = server.GetStats();
+  }
+  // Let the last batch arrive
+  std::this_thread::sleep_for(batchInterval + std::chrono::milliseconds {50});
+
+  const auto stats = client.GetStats();
+  const auto seconds = std::chrono::duration<double>(STREAM_DURATION).count()
+    * static_cast<double>(state.iterations());
+  state.counters["samples/s"]
+    = static_cast<double>(stats.mSamplesReceived) / seconds;
+  state.counters["bytes/sample"] = stats.mSamplesReceived
+    ? static_cast<double>(stats.mBytesReceived)
+      / static_cast<double>(stats.mSamplesReceived)
+    : 0.0;
+  state.counters["p50_ms"] = stats.mLatency.mP50;
+  state.counters["p99_ms"] = stats.mLatency.mP99;
+  state.counters["max_ms"] = stats.mLatency.mMax;
+  state.counters["summarized_viewers"]
+    = static_cast<double>(serverStats->mSummarizedClientCount);
+  state.counters["lost"] = static_cast<double>(serverStats->mSamplesLost);
+}
+BENCHMARK(BM_RemoteLoopback)
+  ->ArgNames({"devices", "batch_ms", "stalled"})
+  ->ArgsProduct({{1, 16, 64, 256}, {1, 5, 20}, {0}})
+  ->Args({64, 5, 1})
+  ->Iterations(1)
+  ->UseRealTime()
+  ->Unit(benchmark::kMillisecond);
+
+}// namespace FredEmmott::ControllerTester::Benchmarks
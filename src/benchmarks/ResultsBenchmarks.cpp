@@ -0,0 +1,92 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <vector>
+
+#include "BenchmarkAllocations.hpp"
+#include "ResultsDatabase.hpp"
+#include "SyntheticDevice.hpp"
+
+namespace FredEmmott::ControllerTester::Benchmarks {
+
+namespace {
+
+std::filesystem::path GetDatabasePath() {
+  return std::filesystem::temp_directory_path()
+    / "freds-controller-tester-benchmark-results.fctdb";
+}
+
+// A fleet of identical units, with slightly different axis extents
+void CreateDatabase(std::size_t unitCount) {
+  const auto path = GetDatabasePath();
+  std::filesystem::remove(path);
+  ResultsDatabase db {path};
+
+  SyntheticDeviceInfo device {0, DIRECTINPUT_128};
+  device.mProduct.mData1 = 0xfc7;
+  for (uint32_t i = 0; i < unitCount; ++i) {
+    device.mGuid.mData1 = i;
+    for (auto& axis: device.mAxes) {
+      axis.mMinSeen = axis.mMin + static_cast<int32_t>(i % 7);
+      axis.mMaxSeen = axis.mMax - static_cast<int32_t>(i % 13);
+    }
+    auto result = MakeUnitResult(device, {}, {});
+    result.mTime += std::chrono::seconds {i};
+    db.Append(result);
+  }
+}
+
+}// namespace
+
+// Opening the database scans and checksums every result
+static void BM_ResultsDatabaseOpen(benchmark::State& state) {
+  CreateDatabase(static_cast<std::size_t>(state.range(0)));
+  for (auto _: state) {
+    ResultsDatabase db {GetDatabasePath()};
+    benchmark::DoNotOptimize(db.GetResultCount());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  std::filesystem::remove(GetDatabasePath());
+}
+BENCHMARK(BM_ResultsDatabaseOpen)
+  ->ArgName("units")
+  ->Arg(10'000)
+  ->Unit(benchmark::kMillisecond);
+
+// e.g. 'distribution of the Y axis max for the last 10k units'
+static void BM_ResultsDatabaseAxisDistribution(benchmark::State& state) {
+  const auto unitCount = static_cast<std::size_t>(state.range(0));
+  CreateDatabase(unitCount);
+  ResultsDatabase db {GetDatabasePath()};
+  const ResultsDatabase::Query query {
+    .mProduct = Guid {0xfc7, 0, 0, {}},
+    .mMaxResults = unitCount,
+  };
+
+  std::vector<int32_t> values;
+  const auto allocations = GetAllocationStats();
+  for (auto _: state) {
+    const auto results = db.Find(query);
+    values.clear();
+    for (const auto& result: results) {
+      values.push_back(result.mAxes[1].mMaxSeen);
+    }
+    const auto median = values.begin() + (values.size() / 2);
+    std::ranges::nth_element(values, median);
+    benchmark::DoNotOptimize(*median);
+  }
+  ReportAllocations(state, allocations);
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  std::filesystem::remove(GetDatabasePath());
+}
+BENCHMARK(BM_ResultsDatabaseAxisDistribution)
+  ->ArgName("units")
+  ->Arg(1'000)
+  ->Arg(10'000)
+  ->Unit(benchmark::kMillisecond);
+
+}// namespace FredEmmott::ControllerTester::Benchmarks
@@ -0,0 +1,139 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "PerformanceMetrics.hpp"
+#include "PollScheduler.hpp"
+#include "SyntheticDevice.hpp"
+#include "TimerWheel.hpp"
+
+namespace FredEmmott::ControllerTester::Benchmarks {
+
+namespace {
+
+constexpr std::chrono::microseconds WHEEL_TICK {100};
+// Long enough for devices to go idle with the default settings
+constexpr std::chrono::milliseconds POLL_WARMUP {1500};
+constexpr std::chrono::seconds POLL_DURATION {2};
+
+struct BenchmarkTimer : TimerWheel::Timer {
+  std::chrono::microseconds mInterval {};
+};
+
+}// namespace
+
+/* Advances a wheel one tick at a time, rescheduling each timer as it
+ * expires, with a simulated clock.
+ *
+ * Intervals are 1-100ms, like device polls; the cost per expired timer
+ * should be the same for any number of timers.
+ */
+static void BM_TimerWheelReschedule(benchmark::State& state) {
+  const auto timerCount = static_cast<std::size_t>(state.range(0));
+
+  auto now = std::chrono::steady_clock::time_point {};
+  TimerWheel wheel {WHEEL_TICK, now};
+  std::mt19937 random {0};
+  std::uniform_int_distribution<int64_t> intervals {1000, 100'000};
+  std::vector<std::unique_ptr<BenchmarkTimer>> timers;
+  for (std::size_t i = 0; i < timerCount; ++i) {
+    auto& timer = *timers.emplace_back(std::make_unique<BenchmarkTimer>());
+    timer.mInterval = std::chrono::microseconds {intervals(random)};
+    wheel.Schedule(timer, now + timer.mInterval);
+  }
+
+  int64_t expired {};
+  for (auto _: state) {
+    now += WHEEL_TICK;
+    wheel.Advance(now, [&](TimerWheel::Timer& timer) {
+      ++expired;
+      wheel.Schedule(
+        timer, now + static_cast<BenchmarkTimer&>(timer).mInterval);
+    });
+  }
+  state.SetItemsProcessed(expired);
+
+  for (auto& timer: timers) {
+    wheel.Cancel(*timer);
+  }
+}
+BENCHMARK(BM_TimerWheelReschedule)
+  ->ArgName("timers")
+  ->Arg(16)
+  ->Arg(256)
+  ->Arg(4096);
+
+/* Adaptively polls synthetic devices with a mix of update rates: a quarter
+ * each at 1ms, 2ms, and 8ms, and a quarter that never change.
+ *
+ * `vs_1khz` is the poll rate compared to polling every device every 1ms;
+ * detection delay is from when a device's state changed to when the
+ * scheduler saw it. Both are measured after a warmup, so that the update
+ * rates have been estimated.
+ */
+static void BM_PollScheduler(benchmark::State& state) {
+  const auto deviceCount = static_cast<uint32_t>(state.range(0));
+  using namespace std::chrono_literals;
+  constexpr std::array<std::chrono::steady_clock::duration, 4> updates {
+    1ms, 2ms, 8ms, 24h};
+
+  // Only the measured period
+  RollingSamples delays {POLL_DURATION, 64 * 1024};
+  uint64_t polls {};
+  for (auto _: state) {
+    PollScheduler scheduler;
+    for (uint32_t i = 0; i < deviceCount; ++i) {
+      const auto update = updates[i % updates.size()];
+      SyntheticDeviceInfo device {i, XINPUT_SHAPED};
+      device.SetUpdateInterval(update);
+      scheduler.Add(
+        std::move(device),
+        [&delays, update, first = true](
+          PollScheduler::Clock::time_point time,
+          const std::optional<DeviceState>&) mutable {
+          // The first state isn't a change
+          if (std::exchange(first, false)) {
+            return;
+          }
+          // States change at multiples of the update interval
+          const auto delay = time.time_since_epoch() % update;
+          delays.Push(
+            std::chrono::duration<float, std::milli>(delay).count(), time);
+        });
+    }
+    std::this_thread::sleep_for(POLL_WARMUP);
+    const auto warmupPolls = scheduler.GetPollCount();
+    std::this_thread::sleep_for(POLL_DURATION);
+    polls += scheduler.GetPollCount() - warmupPolls;
+  }
+
+  const auto seconds = std::chrono::duration<double>(POLL_DURATION).count()
+    * static_cast<double>(state.iterations());
+  const auto pollsPerSecond = static_cast<double>(polls) / seconds;
+  state.counters["polls/s"] = pollsPerSecond;
+  state.counters["vs_1khz"] = pollsPerSecond / (deviceCount * 1000.0);
+  const auto summary = delays.GetSummary(
+    std::pmr::get_default_resource(), std::chrono::steady_clock::now());
+  state.counters["delay_p50_ms"] = summary.mP50;
+  state.counters["delay_p99_ms"] = summary.mP99;
+}
+BENCHMARK(BM_PollScheduler)
+  ->ArgName("devices")
+  ->Arg(16)
+  ->Arg(256)
+  ->Iterations(1)
+  ->UseRealTime()
+  ->Unit(benchmark::kMillisecond);
+
+}// namespace FredEmmott::ControllerTester::Benchmarks
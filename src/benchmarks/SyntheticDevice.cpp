@@ -0,0 +1,154 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include "SyntheticDevice.hpp"
+
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace FredEmmott::ControllerTester::Benchmarks {
+
+SyntheticDeviceInfo::SyntheticDeviceInfo(
+  uint32_t id,
+  const SyntheticLayout& layout)
+  : mID(id), mLayout(layout), mRandomState(id + 1) {
+  mName = "Synthetic " + std::to_string(id);
+  mGuid.mData1 = id;
+
+  uint32_t offset {};
+  for (std::size_t i = 0; i < layout.mAxisCount; ++i) {
+    mAxes.push_back(AxisInfo {
+      .mName = "Axis " + std::to_string(i + 1),
+      .mMin = layout.mAxisMin,
+      .mMax = layout.mAxisMax,
+      .mDataOffset = offset,
+    });
+    offset += sizeof(int32_t);
+  }
+  for (std::size_t i = 0; i < layout.mHatCount; ++i) {
+    mHats.push_back(HatInfo {
+      .mName = "Hat " + std::to_string(i + 1),
+      .mType = HatType::EightWay,
+      .mDataOffset = offset,
+    });
+    offset += sizeof(int32_t);
+  }
+  for (std::size_t i = 0; i < layout.mButtonCount; ++i) {
+    mButtons.push_back(ButtonInfo {
+      .mName = "Button " + std::to_string(i + 1),
+      .mDataOffset = offset,
+    });
+    ++offset;
+  }
+
+  mDataSize = (offset + 3) & ~3;
+  mDecodePlan = DecodePlan {*this};
+}
+
+SyntheticDeviceInfo::~SyntheticDeviceInfo() {
+}
+
+bool SyntheticDeviceInfo::Poll() {
+  if (mPollDelay > std::chrono::steady_clock::duration::zero()) {
+    std::this_thread::sleep_for(mPollDelay);
+  }
+  return true;
+}
+
+std::optional<DeviceState> SyntheticDeviceInfo::GetState(
+  std::pmr::memory_resource* resource) {
+  DeviceState ret {resource};
+  if (mUpdateInterval) {
+    const auto update = std::chrono::steady_clock::now().time_since_epoch()
+      / *mUpdateInterval;
+    if (update != mLatestUpdate) {
+      mLatestUpdate = update;
+      this->NextState(mLatest);
+    }
+    mDecodePlan.Decode(mLatest, ret);
+    return ret;
+  }
+
+  std::pmr::vector<std::byte> raw(mDataSize, {}, resource);
+  this->NextState(raw);
+  mDecodePlan.Decode(raw, ret);
+  return ret;
+}
+
+void SyntheticDeviceInfo::SetUpdateInterval(
+  std::chrono::steady_clock::duration interval) {
+  mUpdateInterval = interval;
+  mLatest.resize(mDataSize);
+  mLatestUpdate = -1;
+}
+
+void SyntheticDeviceInfo::SetPollDelay(
+  std::chrono::steady_clock::duration delay) {
+  mPollDelay = delay;
+}
+
+std::size_t SyntheticDeviceInfo::GetStateSize() const {
+  return mDataSize;
+}
+
+uint32_t SyntheticDeviceInfo::NextRandom() {
+  // xorshift32
+  auto x = mRandomState;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  mRandomState = x;
+  return x;
+}
+
+void SyntheticDeviceInfo::NextState(std::span<std::byte> state) {
+  const auto range
+    = static_cast<uint64_t>(mLayout.mAxisMax - mLayout.mAxisMin);
+  for (const auto& axis: mAxes) {
+    const int32_t value
+      = mLayout.mAxisMin + static_cast<int32_t>(NextRandom() % (range + 1));
+    std::memcpy(state.data() + axis.mDataOffset, &value, sizeof(value));
+  }
+
+  for (const auto& hat: mHats) {
+    // 8 directions + centered
+    const auto direction = NextRandom() % 9;
+    const int32_t value = (direction == 8) ? -1 : (direction * 4500);
+    std::memcpy(state.data() + hat.mDataOffset, &value, sizeof(value));
+  }
+
+  for (const auto& button: mButtons) {
+    // Pressed 1/4 of the time
+    state[button.mDataOffset]
+      = ((NextRandom() & 3) == 0) ? std::byte {0x80} : std::byte {0};
+  }
+}
+
+SyntheticDeviceTracker::SyntheticDeviceTracker(const SyntheticLayout& layout)
+  : mLayout(layout) {
+}
+
+uint32_t SyntheticDeviceTracker::GetKey(uint32_t id) {
+  return id;
+}
+
+uint32_t SyntheticDeviceTracker::GetKey(const SyntheticDeviceInfo& info) {
+  return info.mID;
+}
+
+void SyntheticDeviceTracker::SetAttached(std::span<const uint32_t> ids) {
+  std::unique_lock lock(mEnumerationMutex);
+  mAttached.assign(ids.begin(), ids.end());
+}
+
+std::vector<uint32_t> SyntheticDeviceTracker::Enumerate() {
+  return mAttached;
+}
+
+SyntheticDeviceInfo SyntheticDeviceTracker::CreateInfo(const uint32_t& id) {
+  return {id, mLayout};
+}
+
+}// namespace FredEmmott::ControllerTester::Benchmarks
@@ -0,0 +1,116 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "DecodePlan.hpp"
+#include "DeviceInfo.hpp"
+#include "DeviceTracker.hpp"
+
+namespace FredEmmott::ControllerTester::Benchmarks {
+
+struct SyntheticLayout {
+  std::size_t mAxisCount {};
+  std::size_t mButtonCount {};
+  std::size_t mHatCount {};
+
+  int32_t mAxisMin {};
+  int32_t mAxisMax {};
+};
+
+// Same control counts and ranges as an XInput pad's thumbsticks
+constexpr SyntheticLayout XINPUT_SHAPED {
+  .mAxisCount = 6,
+  .mButtonCount = 10,
+  .mHatCount = 1,
+  .mAxisMin = -32768,
+  .mAxisMax = 32767,
+};
+
+// The DirectInput maximums, e.g. a fully-configured vJoy device
+constexpr SyntheticLayout DIRECTINPUT_128 {
+  .mAxisCount = 8,
+  .mButtonCount = 128,
+  .mHatCount = 4,
+  .mAxisMin = 0,
+  .mAxisMax = 65535,
+};
+
+/* A device with a DirectInput-style state buffer layout, producing
+ * deterministic pseudo-random states.
+ *
+ * Results are reproducible without hardware, and for a given seed, across
+ * machines.
+ */
+struct SyntheticDeviceInfo final : public DeviceInfo {
+  SyntheticDeviceInfo(uint32_t id, const SyntheticLayout&);
+  ~SyntheticDeviceInfo();
+
+  SyntheticDeviceInfo() = delete;
+  SyntheticDeviceInfo(const SyntheticDeviceInfo&) = delete;
+  SyntheticDeviceInfo(SyntheticDeviceInfo&&) = default;
+
+  SyntheticDeviceInfo& operator=(const SyntheticDeviceInfo&) = delete;
+  SyntheticDeviceInfo& operator=(SyntheticDeviceInfo&&) = default;
+
+  bool Poll();
+  std::optional<DeviceState> GetState(std::pmr::memory_resource*);
+
+  // Fill `state` with the next pseudo-random state
+  void NextState(std::span<std::byte> state);
+  std::size_t GetStateSize() const;
+
+  // By default, every `GetState()` is a new state; with an interval, the
+  // state only changes when `steady_clock` reaches a new multiple of it,
+  // like a device with a fixed report rate
+  void SetUpdateInterval(std::chrono::steady_clock::duration);
+  // `Poll()` blocks for this long, like a misbehaving driver
+  void SetPollDelay(std::chrono::steady_clock::duration);
+
+  uint32_t mID {};
+
+ private:
+  SyntheticLayout mLayout;
+  std::size_t mDataSize {};
+  DecodePlan mDecodePlan;
+  uint32_t mRandomState {};
+
+  std::optional<std::chrono::steady_clock::duration> mUpdateInterval;
+  std::vector<std::byte> mLatest;
+  int64_t mLatestUpdate {-1};
+  std::chrono::steady_clock::duration mPollDelay {};
+
+  uint32_t NextRandom();
+};
+
+class SyntheticDeviceTracker final : public DeviceTracker<
+                                       SyntheticDeviceTracker,
+                                       SyntheticDeviceInfo,
+                                       uint32_t,
+                                       uint32_t> {
+ public:
+  SyntheticDeviceTracker(const SyntheticLayout&);
+  virtual ~SyntheticDeviceTracker() = default;
+
+  static uint32_t GetKey(uint32_t);
+  static uint32_t GetKey(const SyntheticDeviceInfo&);
+
+  // Takes effect after the next `MarkStale()`
+  void SetAttached(std::span<const uint32_t> ids);
+
+ protected:
+  virtual std::vector<uint32_t> Enumerate() override;
+  virtual SyntheticDeviceInfo CreateInfo(const uint32_t&) override;
+
+ private:
+  SyntheticLayout mLayout;
+  std::vector<uint32_t> mAttached;
+};
+
+}// namespace FredEmmott::ControllerTester::Benchmarks
@@ -0,0 +1,120 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <random>
+
+#include "BenchmarkAllocations.hpp"
+#include "FrameArena.hpp"
+#include "TimelineIndex.hpp"
+
+namespace FredEmmott::ControllerTester::Benchmarks {
+
+namespace {
+
+constexpr std::chrono::hours SESSION_LENGTH {1};
+constexpr std::chrono::milliseconds SAMPLE_INTERVAL {1};
+constexpr std::size_t AXIS_COUNT {6};
+constexpr std::size_t HAT_COUNT {1};
+constexpr std::size_t BUTTON_COUNT {32};
+// Like a window that's a little narrower than a 1080p screen
+constexpr std::size_t PIXELS {1600};
+
+/* An hour of 1kHz samples: one noisy axis that changes every sample, axes
+ * that move now and then, and buttons and a hat that change a few times a
+ * second between them.
+ *
+ * Built once, as it takes a few seconds, and is only read.
+ */
+const TimelineIndex& GetSession() {
+  static const auto ret = []() {
+    DeviceInfo info;
+    info.mAxes.resize(AXIS_COUNT);
+    info.mHats.resize(HAT_COUNT);
+    info.mButtons.resize(BUTTON_COUNT);
+    auto index = std::make_unique<TimelineIndex>(info);
+
+    std::mt19937 random {0};
+    std::uniform_int_distribution<int32_t> noise {-8, 8};
+    DeviceState state;
+    state.Resize(AXIS_COUNT, HAT_COUNT, BUTTON_COUNT);
+    for (std::chrono::microseconds time {}; time < SESSION_LENGTH;
+         time += SAMPLE_INTERVAL) {
+      state.mAxes[0] = noise(random);
+      // Each of these moves every ~50 samples
+      for (std::size_t i = 1; i < AXIS_COUNT; ++i) {
+        if (random() % 50 == 0) {
+          state.mAxes[i] = static_cast<int32_t>(random() % 65536);
+        }
+      }
+      if (random() % 500 == 0) {
+        // Centered, or one of 8 directions
+        const auto direction = static_cast<int32_t>(random() % 9);
+        state.mHats[0] = (direction == 8) ? -1 : direction * 4500;
+      }
+      if (random() % 50 == 0) {
+        state.mButtons[0] ^= uint64_t {1} << (random() % BUTTON_COUNT);
+      }
+      index->Push(time, state);
+    }
+    return index;
+  }();
+  return *ret;
+}
+
+}// namespace
+
+/* Finds the spans for every control in a window of the session, with one
+ * span per pixel at most, as the timeline tab does for each frame.
+ *
+ * The window is the argument, in microseconds, from the whole session
+ * down to 100us; the cost should depend on the spans that are returned,
+ * not on the length of the session.
+ */
+static void BM_TimelineQuery(benchmark::State& state) {
+  const auto& session = GetSession();
+  const std::chrono::microseconds window {state.range(0)};
+  const auto resolution = std::max(
+    std::chrono::microseconds {1}, window / static_cast<int64_t>(PIXELS));
+  const auto end = session.GetEnd();
+
+  std::mt19937_64 random {0};
+  std::uniform_int_distribution<int64_t> starts {
+    0, std::max<int64_t>(0, (end - window).count())};
+  FrameArena arena {64 * 1024};
+  std::size_t spans {};
+  const auto allocations = GetAllocationStats();
+  for (auto _: state) {
+    const std::chrono::microseconds begin {starts(random)};
+    const auto query = [&](TimelineIndex::Kind kind, std::size_t count) {
+      for (std::size_t i = 0; i < count; ++i) {
+        spans += session
+                   .GetSpans(kind, i, begin, begin + window, resolution, &arena)
+                   .size();
+      }
+    };
+    query(TimelineIndex::Kind::Axis, AXIS_COUNT);
+    query(TimelineIndex::Kind::Hat, HAT_COUNT);
+    query(TimelineIndex::Kind::Button, BUTTON_COUNT);
+    arena.Reset();
+  }
+  ReportAllocations(state, allocations);
+  state.counters["spans"] = benchmark::Counter(
+    static_cast<double>(spans), benchmark::Counter::kAvgIterations);
+  state.counters["runs"] = static_cast<double>(session.GetRunCount());
+}
+BENCHMARK(BM_TimelineQuery)
+  ->ArgName("window_us")
+  ->Arg(std::chrono::microseconds {SESSION_LENGTH}.count())
+  ->Arg(std::chrono::microseconds {std::chrono::minutes {1}}.count())
+  ->Arg(std::chrono::microseconds {std::chrono::seconds {1}}.count())
+  ->Arg(10'000)
+  ->Arg(100)
+  ->Unit(benchmark::kMicrosecond);
+
+}// namespace FredEmmott::ControllerTester::Benchmarks
@@ -0,0 +1,167 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <numeric>
+#include <vector>
+
+#include "BenchmarkAllocations.hpp"
+#include "DeviceReader.hpp"
+#include "DeviceSet.hpp"
+#include "FrameArena.hpp"
+#include "LayoutCache.hpp"
+#include "SyntheticDevice.hpp"
+
+namespace FredEmmott::ControllerTester::Benchmarks {
+
+// Args: {attached devices, devices replaced per refresh}
+static void BM_TrackerRefresh(benchmark::State& state) {
+  const auto deviceCount = static_cast<uint32_t>(state.range(0));
+  const auto changeCount = static_cast<uint32_t>(state.range(1));
+
+  SyntheticDeviceTracker tracker {DIRECTINPUT_128};
+  std::vector<uint32_t> attached(deviceCount);
+  std::iota(attached.begin(), attached.end(), 0);
+  tracker.SetAttached(attached);
+  benchmark::DoNotOptimize(tracker.GetAllDevices());
+
+  auto nextID = deviceCount;
+  const auto allocations = GetAllocationStats();
+  for (auto _: state) {
+    // Unplug the oldest devices, and plug in the same number of new ones
+    for (uint32_t i = 0; i < changeCount; ++i) {
+      attached[(nextID + i) % deviceCount] = nextID + i;
+    }
+    nextID += changeCount;
+
+    tracker.SetAttached(attached);
+    tracker.MarkStale();
+    benchmark::DoNotOptimize(tracker.GetAllDevices());
+  }
+  ReportAllocations(state, allocations);
+  state.SetItemsProcessed(state.iterations() * deviceCount);
+}
+BENCHMARK(BM_TrackerRefresh)
+  ->ArgNames({"devices", "changes"})
+  ->Apply([](benchmark::internal::Benchmark* benchmark) {
+    // Can't replace more devices than are attached
+    for (const int64_t devices: {1, 8, 32, 128}) {
+      for (const int64_t changes: {0, 1, 8}) {
+        if (changes <= devices) {
+          benchmark->Args({devices, changes});
+        }
+      }
+    }
+  });
+
+// What every frame pays when nothing has been plugged in or removed
+static void BM_TrackerGetAllDevices(benchmark::State& state) {
+  const auto deviceCount = static_cast<uint32_t>(state.range(0));
+
+  SyntheticDeviceTracker tracker {DIRECTINPUT_128};
+  std::vector<uint32_t> attached(deviceCount);
+  std::iota(attached.begin(), attached.end(), 0);
+  tracker.SetAttached(attached);
+  benchmark::DoNotOptimize(tracker.GetAllDevices());
+
+  const auto allocations = GetAllocationStats();
+  for (auto _: state) {
+    benchmark::DoNotOptimize(tracker.GetAllDevices());
+  }
+  ReportAllocations(state, allocations);
+}
+BENCHMARK(BM_TrackerGetAllDevices)->ArgName("devices")->Arg(1)->Arg(32);
+
+// What a sampling loop pays to read every device once
+static void BM_DeviceSetPollAll(benchmark::State& state) {
+  const auto deviceCount = static_cast<uint32_t>(state.range(0));
+
+  DeviceSet<SyntheticDeviceTracker> devices {XINPUT_SHAPED};
+  std::vector<uint32_t> attached(deviceCount);
+  std::iota(attached.begin(), attached.end(), 0);
+  devices.GetTracker<SyntheticDeviceTracker>().SetAttached(attached);
+
+  FrameArena arena {64 * 1024};
+  const auto allocations = GetAllocationStats();
+  for (auto _: state) {
+    devices.ForEachDevice([&arena](auto& device) {
+      device.Poll();
+      benchmark::DoNotOptimize(device.GetState(&arena));
+    });
+    arena.Reset();
+  }
+  ReportAllocations(state, allocations);
+  state.SetItemsProcessed(state.iterations() * deviceCount);
+}
+BENCHMARK(BM_DeviceSetPollAll)->ArgName("devices")->Arg(1)->Arg(8)->Arg(32);
+
+/* What the GUI thread pays per frame to read a device through a
+ * `DeviceReader`, for a device that responds immediately and one whose
+ * `Poll()` blocks for a second.
+ *
+ * `max_ms` is the slowest `Read()`; it should stay near the reader's wait,
+ * however long the driver blocks.
+ */
+static void BM_DeviceReaderRead(benchmark::State& state) {
+  const std::chrono::milliseconds pollDelay {state.range(0)};
+
+  SyntheticDeviceInfo device {0, XINPUT_SHAPED};
+  device.SetPollDelay(pollDelay);
+  DeviceReader reader {std::move(device)};
+
+  FrameArena arena {64 * 1024};
+  std::chrono::steady_clock::duration slowest {};
+  for (auto _: state) {
+    const auto start = std::chrono::steady_clock::now();
+    benchmark::DoNotOptimize(reader.Read(&arena));
+    slowest = std::max(slowest, std::chrono::steady_clock::now() - start);
+    arena.Reset();
+  }
+  state.counters["max_ms"]
+    = std::chrono::duration<double, std::milli>(slowest).count();
+  state.counters["degraded"] = reader.GetHealth(&arena).mDegraded;
+}
+BENCHMARK(BM_DeviceReaderRead)
+  ->ArgName("poll_delay_ms")
+  ->Arg(0)
+  ->Arg(1000)
+  ->UseRealTime();
+
+// What reconnecting a device pays instead of enumerating its controls
+static void BM_LayoutCacheLoad(benchmark::State& state) {
+  const SyntheticDeviceInfo device {0, DIRECTINPUT_128};
+  const auto directory = std::filesystem::temp_directory_path()
+    / "freds-controller-tester-benchmark-layouts";
+  const LayoutCache cache {directory};
+  const LayoutCache::Key key {
+    .mProduct = device.mGuid,
+    .mInstance = device.mGuid,
+  };
+  const LayoutCache::ControlCounts counts {
+    .mAxes = DIRECTINPUT_128.mAxisCount,
+    .mButtons = DIRECTINPUT_128.mButtonCount,
+    .mHats = DIRECTINPUT_128.mHatCount,
+  };
+  cache.Store(key, device, 0);
+
+  DeviceInfo loaded;
+  const auto allocations = GetAllocationStats();
+  for (auto _: state) {
+    if (!cache.Load(key, counts, loaded)) {
+      state.SkipWithError("Cache miss");
+      break;
+    }
+    benchmark::DoNotOptimize(loaded);
+  }
+  ReportAllocations(state, allocations);
+
+  std::error_code ec;
+  std::filesystem::remove_all(directory, ec);
+}
+BENCHMARK(BM_LayoutCacheLoad);
+
+}// namespace FredEmmott::ControllerTester::Benchmarks
@@ -0,0 +1,34 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace FredEmmott::ControllerTester::Tests {
+
+/* Each test is its own executable, with no test framework, so that the
+ * tests build wherever the core library does.
+ *
+ * A failed `CHECK()` is printed, and the test keeps going; `main()` returns
+ * `GetExitCode()`.
+ */
+inline int gFailures {};
+
+inline bool Check(bool ok, const char* expression, const char* file, int line) {
+  if (!ok) {
+    std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", file, line, expression);
+    ++gFailures;
+  }
+  return ok;
+}
+
+inline int GetExitCode() {
+  return gFailures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+}// namespace FredEmmott::ControllerTester::Tests
+
+#define CHECK(...) \
+  ::FredEmmott::ControllerTester::Tests::Check( \
+    static_cast<bool>(__VA_ARGS__), #__VA_ARGS__, __FILE__, __LINE__)
@@ -0,0 +1,171 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Check.hpp"
+#include "ControlAnalysis.hpp"
+#include "DecodePlan.hpp"
+
+namespace FredEmmott::ControllerTester::Tests {
+
+namespace {
+
+constexpr std::size_t LAYOUT_COUNT {2000};
+constexpr std::size_t STATES_PER_LAYOUT {8};
+
+enum class Placement {
+  // Like `DirectInputDeviceInfo`: one run each of axes, hats, and buttons
+  Packed,
+  // Controls of each kind are in order, with gaps between some of them
+  Gaps,
+  // Kinds are interleaved, and some controls are out of order
+  Shuffled,
+};
+
+/* A random layout; axes and hats are 4-byte aligned, like DirectInput
+ * requires.
+ *
+ * Button counts go past several 64-button words, so runs start and end
+ * part-way through words, and in the middle of 8- and 16-byte blocks.
+ */
+DeviceInfo CreateLayout(std::mt19937& random, Placement placement) {
+  const auto count = [&random](std::size_t max) {
+    return std::uniform_int_distribution<std::size_t> {0, max}(random);
+  };
+  DeviceInfo info;
+  info.mAxes.resize(count(12));
+  info.mHats.resize(count(4));
+  info.mButtons.resize(count(200));
+
+  uint32_t cursor {};
+  const auto place = [&](auto& control, uint32_t size) {
+    if (placement != Placement::Packed && random() % 4 == 0) {
+      cursor += 1 + (random() % 16);
+    }
+    cursor = (cursor + size - 1) / size * size;
+    control.mDataOffset = cursor;
+    cursor += size;
+  };
+
+  if (placement != Placement::Shuffled) {
+    for (auto& axis: info.mAxes) {
+      place(axis, sizeof(int32_t));
+    }
+    for (auto& hat: info.mHats) {
+      place(hat, sizeof(int32_t));
+    }
+    for (auto& button: info.mButtons) {
+      place(button, 1);
+    }
+    return info;
+  }
+
+  std::vector<std::pair<char, std::size_t>> order;
+  for (std::size_t i = 0; i < info.mAxes.size(); ++i) {
+    order.push_back({'a', i});
+  }
+  for (std::size_t i = 0; i < info.mHats.size(); ++i) {
+    order.push_back({'h', i});
+  }
+  for (std::size_t i = 0; i < info.mButtons.size(); ++i) {
+    order.push_back({'b', i});
+  }
+  // Mostly in order, so there are still some long runs
+  for (std::size_t i = 1; i < order.size(); ++i) {
+    if (random() % 8 == 0) {
+      std::swap(order[i], order[random() % i]);
+    }
+  }
+  for (const auto& [kind, i]: order) {
+    switch (kind) {
+      case 'a':
+        place(info.mAxes[i], sizeof(int32_t));
+        break;
+      case 'h':
+        place(info.mHats[i], sizeof(int32_t));
+        break;
+      case 'b':
+        place(info.mButtons[i], 1);
+        break;
+    }
+  }
+  return info;
+}
+
+std::size_t GetRawSize(const DeviceInfo& info) {
+  std::size_t ret {};
+  for (const auto& axis: info.mAxes) {
+    ret = std::max<std::size_t>(ret, axis.mDataOffset + sizeof(int32_t));
+  }
+  for (const auto& hat: info.mHats) {
+    ret = std::max<std::size_t>(ret, hat.mDataOffset + sizeof(int32_t));
+  }
+  for (const auto& button: info.mButtons) {
+    ret = std::max<std::size_t>(ret, button.mDataOffset + 1);
+  }
+  return ret;
+}
+
+bool operator==(const DeviceState& a, const DeviceState& b) {
+  return std::ranges::equal(a.mAxes, b.mAxes)
+    && std::ranges::equal(a.mHats, b.mHats)
+    && std::ranges::equal(a.mButtons, b.mButtons);
+}
+
+}// namespace
+
+// `DecodePlan` must match `DecodeState()`, the reference path
+static void MatchesDecodeState(Placement placement) {
+  std::mt19937 random {static_cast<uint32_t>(placement)};
+  // Reused, so stale values from a larger layout would show up
+  DeviceState expected;
+  DeviceState actual;
+  std::vector<std::byte> raw;
+
+  for (std::size_t i = 0; i < LAYOUT_COUNT; ++i) {
+    const auto info = CreateLayout(random, placement);
+    const DecodePlan plan {info};
+    if (!CHECK(plan.GetRawSize() == GetRawSize(info))) {
+      return;
+    }
+    if (placement == Placement::Packed) {
+      CHECK(plan.GetRunCount() <= 3);
+    }
+
+    raw.resize(plan.GetRawSize());
+    for (std::size_t j = 0; j < STATES_PER_LAYOUT; ++j) {
+      // Every byte is random, so buttons also have bits other than the high
+      // bit set, which must be ignored
+      for (auto& byte: raw) {
+        byte = static_cast<std::byte>(random());
+      }
+      DecodeState(info, raw, expected);
+      plan.Decode(raw, actual);
+      if (!CHECK(actual == expected)) {
+        std::fprintf(
+          stderr,
+          "Layout %zu: %zu axes, %zu hats, %zu buttons, %zu runs\n",
+          i,
+          info.mAxes.size(),
+          info.mHats.size(),
+          info.mButtons.size(),
+          plan.GetRunCount());
+        return;
+      }
+    }
+  }
+}
+
+}// namespace FredEmmott::ControllerTester::Tests
+
+int main() {
+  using namespace FredEmmott::ControllerTester::Tests;
+  MatchesDecodeState(Placement::Packed);
+  MatchesDecodeState(Placement::Gaps);
+  MatchesDecodeState(Placement::Shuffled);
+  return GetExitCode();
+}
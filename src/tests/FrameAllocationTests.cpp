@@ -0,0 +1,115 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include <chrono>
+#include <cstdio>
+#include <numeric>
+#include <variant>
+#include <vector>
+
+#include "AllocationCounter.hpp"
+#include "Check.hpp"
+#include "DeviceReader.hpp"
+#include "DeviceSet.hpp"
+#include "FrameArena.hpp"
+#include "PerformanceMetrics.hpp"
+#include "../benchmarks/SyntheticDevice.hpp"
+
+namespace FredEmmott::ControllerTester::Tests {
+
+using Benchmarks::SyntheticDeviceInfo;
+using Benchmarks::SyntheticDeviceTracker;
+using Benchmarks::XINPUT_SHAPED;
+
+namespace {
+// Enough for the arena, trackers, and readers to have grown to fit
+constexpr std::size_t WARMUP_FRAMES {10};
+constexpr std::size_t MEASURED_FRAMES {100};
+}// namespace
+
+static void ArenaGrowsOnResetAfterOverflow() {
+  FrameArena arena {256};
+  const auto frame = [&arena]() {
+    {
+      std::pmr::vector<std::byte> buffer {&arena};
+      buffer.resize(1024);
+    }
+    arena.Reset();
+  };
+
+  frame();
+  CHECK(arena.GetOverflowCount() == 1);
+  CHECK(arena.GetCapacity() >= 1024);
+
+  const auto before = GetAllocationStats();
+  frame();
+  const auto allocations = GetAllocationStats() - before;
+  CHECK(allocations.mCount == 0);
+  CHECK(arena.GetOverflowCount() == 1);
+}
+
+/* The non-ImGui work of a controller tab frame: listing the devices,
+ * reading their states, reading a `DeviceReader`, and summarizing the
+ * timing history.
+ *
+ * Once the buffers have grown to fit, a frame must not touch the heap.
+ */
+static void SteadyStateFramesDoNotAllocate() {
+  DeviceSet<SyntheticDeviceTracker> devices {XINPUT_SHAPED};
+  std::vector<uint32_t> attached(8);
+  std::iota(attached.begin(), attached.end(), 0);
+  devices.GetTracker<SyntheticDeviceTracker>().SetAttached(attached);
+  devices.MarkStale();
+
+  DeviceReader reader {SyntheticDeviceInfo {100, XINPUT_SHAPED}};
+  RollingSamples pollTimes {std::chrono::seconds {1}, 1024};
+  FrameArena arena {64 * 1024};
+
+  std::size_t states {};
+  const auto frame = [&]() {
+    for (const auto& device: devices.GetAllDevices(&arena)) {
+      std::visit(
+        [&](auto info) {
+          info->Poll();
+          states += info->GetState(&arena).has_value();
+        },
+        device);
+    }
+    const auto reading = reader.Read(&arena);
+    if (reading.mFresh) {
+      pollTimes.Push(
+        std::chrono::duration<float, std::micro>(reading.mPoll).count());
+    }
+    (void)reader.GetHealth(&arena);
+    (void)pollTimes.GetSummary(&arena);
+    arena.Reset();
+  };
+
+  for (std::size_t i = 0; i < WARMUP_FRAMES; ++i) {
+    frame();
+  }
+  const auto before = GetAllocationStats();
+  for (std::size_t i = 0; i < MEASURED_FRAMES; ++i) {
+    frame();
+  }
+  const auto allocations = GetAllocationStats() - before;
+
+  if (!CHECK(allocations.mCount == 0)) {
+    std::fprintf(
+      stderr,
+      "%llu allocations, %llu bytes\n",
+      static_cast<unsigned long long>(allocations.mCount),
+      static_cast<unsigned long long>(allocations.mBytes));
+  }
+  CHECK(states == (WARMUP_FRAMES + MEASURED_FRAMES) * attached.size());
+  CHECK(arena.GetOverflowCount() == 0);
+}
+
+}// namespace FredEmmott::ControllerTester::Tests
+
+int main() {
+  using namespace FredEmmott::ControllerTester::Tests;
+  ArenaGrowsOnResetAfterOverflow();
+  SteadyStateFramesDoNotAllocate();
+  return GetExitCode();
+}
@@ -0,0 +1,211 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <memory_resource>
+#include <numeric>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include <imgui.h>
+
+#include "AllocationCounter.hpp"
+#include "Check.hpp"
+#include "Config.hpp"
+#include "ControllerGUI.hpp"
+#include "FrameArena.hpp"
+#include "../benchmarks/SyntheticDevice.hpp"
+
+namespace FredEmmott::ControllerTester::Tests {
+
+using Benchmarks::DIRECTINPUT_128;
+using Benchmarks::SyntheticDeviceInfo;
+using Benchmarks::SyntheticDeviceTracker;
+
+namespace {
+
+// Like the GUI benchmarks': a font atlas, but no renderer or window
+class HeadlessImGui final {
+ public:
+  HeadlessImGui() {
+    mContext = ImGui::CreateContext();
+    auto& io = ImGui::GetIO();
+    io.IniFilename = nullptr;
+    io.DisplaySize = {1024, 768};
+    io.DeltaTime = 1.0f / Config::MAX_FPS;
+
+    unsigned char* pixels {nullptr};
+    int width {}, height {};
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+  }
+
+  ~HeadlessImGui() {
+    ImGui::DestroyContext(mContext);
+  }
+
+  HeadlessImGui(const HeadlessImGui&) = delete;
+  HeadlessImGui(HeadlessImGui&&) = delete;
+  HeadlessImGui& operator=(const HeadlessImGui&) = delete;
+  HeadlessImGui& operator=(HeadlessImGui&&) = delete;
+
+ private:
+  ImGuiContext* mContext {nullptr};
+};
+
+}// namespace
+
+/* A whole controller tab frame, as `GUI::Run()` draws it, with each tab's
+ * device read through a `DeviceReader`.
+ *
+ * ImGui uses `malloc()` rather than `operator new`, so this counts the
+ * allocations made by our own code.
+ */
+static void SteadyStateControllerTabFramesDoNotAllocate() {
+  SyntheticDeviceTracker tracker {DIRECTINPUT_128};
+  std::vector<uint32_t> attached(4);
+  std::iota(attached.begin(), attached.end(), 0);
+  tracker.SetAttached(attached);
+  const auto devices = tracker.GetAllDevices();
+
+  HeadlessImGui imgui;
+  FrameArena arena {Config::FRAME_ARENA_BYTES};
+  ControllerGUI gui {arena};
+
+  const auto frame = [&]() {
+    ImGui::NewFrame();
+    ImGui::Begin("MainWindow");
+    ImGui::BeginTabBar("##Controllers");
+    std::pmr::vector<Guid> present {&arena};
+    for (auto device: devices) {
+      present.push_back(device->mGuid);
+      ImGui::PushID(device);
+      gui.GUIControllerTab(device, [&tracker](const SyntheticDeviceInfo& it) {
+        return tracker.GetOpener(it);
+      });
+      ImGui::PopID();
+    }
+    gui.RemoveMissingDevices(present);
+    ImGui::EndTabBar();
+    ImGui::End();
+    ImGui::Render();
+    arena.Reset();
+  };
+
+  // Let tables, tab bars, readers, and the arena settle
+  for (int i = 0; i < 10; ++i) {
+    frame();
+  }
+  const auto before = GetAllocationStats();
+  for (int i = 0; i < 100; ++i) {
+    frame();
+  }
+  const auto allocations = GetAllocationStats() - before;
+
+  if (!CHECK(allocations.mCount == 0)) {
+    std::fprintf(
+      stderr,
+      "%llu allocations, %llu bytes\n",
+      static_cast<unsigned long long>(allocations.mCount),
+      static_cast<unsigned long long>(allocations.mBytes));
+  }
+  CHECK(arena.GetOverflowCount() == 0);
+}
+
+// A device that's removed and added again must get a new reader, rather
+// than keep reading the instance that was opened before it was removed
+static void ReturningDeviceIsReopened() {
+  SyntheticDeviceTracker tracker {DIRECTINPUT_128};
+  const auto attach = [&tracker](std::span<const uint32_t> ids) {
+    tracker.SetAttached(ids);
+    tracker.MarkStale();
+  };
+  attach(std::array<uint32_t, 1> {0});
+
+  HeadlessImGui imgui;
+  FrameArena arena {Config::FRAME_ARENA_BYTES};
+  ControllerGUI gui {arena};
+  std::size_t opened {};
+
+  const auto frame = [&]() {
+    ImGui::NewFrame();
+    ImGui::Begin("MainWindow");
+    ImGui::BeginTabBar("##Controllers");
+    std::pmr::vector<Guid> present {&arena};
+    tracker.ForEachDevice([&](SyntheticDeviceInfo& device) {
+      present.push_back(device.mGuid);
+      ImGui::PushID(&device);
+      gui.GUIControllerTab(&device, [&](const SyntheticDeviceInfo& it) {
+        ++opened;
+        return tracker.GetOpener(it);
+      });
+      ImGui::PopID();
+    });
+    gui.RemoveMissingDevices(present);
+    ImGui::EndTabBar();
+    ImGui::End();
+    ImGui::Render();
+    arena.Reset();
+  };
+
+  frame();
+  frame();
+  CHECK(opened == 1);
+
+  attach({});
+  frame();
+  attach(std::array<uint32_t, 1> {0});
+  frame();
+  CHECK(opened == 2);
+}
+
+/* Opening a device can block, e.g. in `EnumDevices()` or `Acquire()`, so
+ * the tab's instance must be opened by its reader, not by the GUI thread.
+ */
+static void DevicesAreOpenedByTheirReader() {
+  SyntheticDeviceTracker tracker {DIRECTINPUT_128};
+  tracker.SetAttached(std::array<uint32_t, 1> {0});
+  const auto devices = tracker.GetAllDevices();
+
+  // Declared before the GUI, as its reader uses them
+  std::atomic<std::size_t> opened {};
+  std::atomic<bool> openedOnGUIThread {false};
+  const auto guiThread = std::this_thread::get_id();
+
+  HeadlessImGui imgui;
+  FrameArena arena {Config::FRAME_ARENA_BYTES};
+  ControllerGUI gui {arena};
+
+  for (int i = 0; i < 100 && opened == 0; ++i) {
+    ImGui::NewFrame();
+    ImGui::Begin("MainWindow");
+    ImGui::BeginTabBar("##Controllers");
+    gui.GUIControllerTab(devices.front(), [&](const SyntheticDeviceInfo& it) {
+      return [&, open = tracker.GetOpener(it)]() {
+        if (std::this_thread::get_id() == guiThread) {
+          openedOnGUIThread = true;
+        }
+        ++opened;
+        return open();
+      };
+    });
+    ImGui::EndTabBar();
+    ImGui::End();
+    ImGui::Render();
+    arena.Reset();
+  }
+  CHECK(opened == 1);
+  CHECK(!openedOnGUIThread);
+}
+
+}// namespace FredEmmott::ControllerTester::Tests
+
+int main() {
+  using namespace FredEmmott::ControllerTester::Tests;
+  SteadyStateControllerTabFramesDoNotAllocate();
+  ReturningDeviceIsReopened();
+  DevicesAreOpenedByTheirReader();
+  return GetExitCode();
+}
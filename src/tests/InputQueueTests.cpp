@@ -0,0 +1,263 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdio>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "Check.hpp"
+#include "InputQueue.hpp"
+#include "UniqueFD.hpp"
+
+namespace FredEmmott::ControllerTester::Tests {
+
+namespace {
+
+// More than the submission queue has room for
+constexpr std::size_t NODE_COUNT {100};
+
+// Stands in for an input node, as uinput isn't available everywhere
+struct Pipe {
+  Pipe() {
+    std::array<int, 2> fds {};
+    if (pipe2(fds.data(), O_NONBLOCK | O_CLOEXEC) == 0) {
+      mRead = UniqueFD {fds[0]};
+      mWrite = UniqueFD {fds[1]};
+    }
+  }
+
+  bool Write(std::string_view data) {
+    return write(mWrite.Get(), data.data(), data.size())
+      == static_cast<ssize_t>(data.size());
+  }
+
+  // Written, but not read yet
+  int GetAvailable() const {
+    int ret {};
+    ioctl(mRead.Get(), FIONREAD, &ret);
+    return ret;
+  }
+
+  UniqueFD mRead;
+  UniqueFD mWrite;
+};
+
+const char* GetName(InputQueue::Backend backend) {
+  return backend == InputQueue::Backend::IoUring ? "io_uring" : "epoll";
+}
+
+}// namespace
+
+// Everything that's written is read, then the end of the node is reported
+static void InputNodeReadsUntilClosed(InputQueue::Backend backend) {
+  Pipe pipe;
+  InputNode node {pipe.mRead.Get(), {.mBackend = backend}};
+  if (!CHECK(node.IsValid())) {
+    return;
+  }
+  if (node.GetBackend() != backend) {
+    std::printf("Skipped InputNode with %s\n", GetName(backend));
+    return;
+  }
+
+  std::vector<std::byte> read;
+  const auto append = [&read](std::span<const std::byte> data) {
+    read.insert(read.end(), data.begin(), data.end());
+  };
+  CHECK(node.Read(append));
+  CHECK(read.empty());
+
+  CHECK(pipe.Write("abc"));
+  CHECK(pipe.Write("defg"));
+  // Reads may not complete straight away with io_uring
+  for (int i = 0; i < 100 && read.size() < 7; ++i) {
+    CHECK(node.Read(append));
+    usleep(1000);
+  }
+  CHECK(
+    std::string_view {reinterpret_cast<const char*>(read.data()), read.size()}
+    == "abcdefg");
+
+  pipe.mWrite.Reset();
+  bool present {true};
+  for (int i = 0; i < 100 && present; ++i) {
+    present = node.Read(append);
+    usleep(1000);
+  }
+  CHECK(!present);
+  CHECK(!node.Read(append));
+}
+
+/* Devices are usually opened on one thread, then polled on another, e.g. a
+ * `Sampler`'s; io_uring rejects submissions from any thread but the one
+ * that created the ring.
+ */
+static void InputNodeReadsFromAnotherThread(InputQueue::Backend backend) {
+  Pipe pipe;
+  InputNode node {pipe.mRead.Get(), {.mBackend = backend}};
+  if (!CHECK(node.IsValid())) {
+    return;
+  }
+  if (node.GetBackend() != backend) {
+    std::printf("Skipped InputNode with %s\n", GetName(backend));
+    return;
+  }
+
+  std::vector<std::byte> read;
+  const auto append = [&read](std::span<const std::byte> data) {
+    read.insert(read.end(), data.begin(), data.end());
+  };
+  CHECK(pipe.Write("abc"));
+  std::thread([&]() {
+    for (int i = 0; i < 100 && read.size() < 3; ++i) {
+      CHECK(node.Read(append));
+      usleep(1000);
+    }
+  }).join();
+  CHECK(read.size() == 3);
+}
+
+/* Nodes that are read on the same thread share a queue: reading one
+ * collects what's ready for the others, which they get when they're read.
+ */
+static void InputNodesShareTheThreadsQueue(InputQueue::Backend backend) {
+  Pipe pipeA;
+  Pipe pipeB;
+  InputNode nodeA {pipeA.mRead.Get(), {.mBackend = backend}};
+  InputNode nodeB {pipeB.mRead.Get(), {.mBackend = backend}};
+  if (!CHECK(nodeA.IsValid() && nodeB.IsValid())) {
+    return;
+  }
+  if (nodeA.GetBackend() != backend) {
+    std::printf("Skipped sharing a queue with %s\n", GetName(backend));
+    return;
+  }
+
+  std::string readA;
+  std::string readB;
+  const auto append = [](std::string& out) {
+    return [&out](std::span<const std::byte> data) {
+      out.append(reinterpret_cast<const char*>(data.data()), data.size());
+    };
+  };
+  CHECK(pipeA.Write("abc"));
+  CHECK(pipeB.Write("xyz"));
+  for (int i = 0; i < 100 && (readA.size() < 3 || pipeB.GetAvailable());
+       ++i) {
+    CHECK(nodeA.Read(append(readA)));
+    usleep(1000);
+  }
+  CHECK(readA == "abc");
+  // Collected by `nodeA`'s reads, but not delivered to it
+  CHECK(pipeB.GetAvailable() == 0);
+  CHECK(readB.empty());
+
+  CHECK(nodeB.Read(append(readB)));
+  CHECK(readB == "xyz");
+}
+
+/* Removing more nodes than the submission queue has room for at once must
+ * still cancel every read, so every slot can be reused.
+ *
+ * The ring holds its own references to the files, so closing the fds
+ * doesn't end the reads.
+ */
+static void RemoveRetriesWhenSubmissionQueueIsFull() {
+  InputQueue queue;
+  if (queue.GetBackend() != InputQueue::Backend::IoUring) {
+    std::printf("Skipped removing nodes with io_uring\n");
+    return;
+  }
+
+  std::vector<Pipe> pipes(NODE_COUNT);
+  std::vector<InputQueue::Key> keys;
+  for (auto& pipe: pipes) {
+    const auto key = queue.Add(pipe.mRead.Get(), [](auto) {});
+    if (!CHECK(key)) {
+      return;
+    }
+    keys.push_back(*key);
+  }
+  // Arming every node takes more than one submission queue's worth
+  for (int i = 0; i < 4; ++i) {
+    queue.Drain({});
+  }
+
+  for (const auto key: keys) {
+    queue.Remove(key);
+  }
+  // Closing the write ends would end the reads, unlike closing a device
+  for (auto& pipe: pipes) {
+    pipe.mRead.Reset();
+  }
+  for (int i = 0; i < 4; ++i) {
+    queue.Drain({});
+  }
+
+  std::vector<Pipe> newPipes(NODE_COUNT);
+  for (auto& pipe: newPipes) {
+    const auto key = queue.Add(pipe.mRead.Get(), [](auto) {});
+    if (!CHECK(key)) {
+      return;
+    }
+    CHECK(*key < NODE_COUNT);
+  }
+}
+
+// Polling an idle queue is free; data that arrives later is still read
+static void IdleDrainDoesNotEnterTheKernel() {
+  InputQueue queue;
+  if (queue.GetBackend() != InputQueue::Backend::IoUring) {
+    std::printf("Skipped idle drains with io_uring\n");
+    return;
+  }
+
+  Pipe pipe;
+  std::size_t read {};
+  const auto key = queue.Add(
+    pipe.mRead.Get(), [&read](auto data) { read += data.size(); });
+  if (!CHECK(key)) {
+    return;
+  }
+  // Arms the read
+  queue.Drain({});
+
+  const auto syscalls = queue.GetSyscallCount();
+  for (int i = 0; i < 100; ++i) {
+    CHECK(queue.Drain({}) == 0);
+  }
+  CHECK(queue.GetSyscallCount() == syscalls);
+
+  CHECK(pipe.Write("abc"));
+  for (int i = 0; i < 100 && read < 3; ++i) {
+    queue.Drain({});
+    usleep(1000);
+  }
+  CHECK(read == 3);
+}
+
+}// namespace FredEmmott::ControllerTester::Tests
+
+int main() {
+  using namespace FredEmmott::ControllerTester::Tests;
+  using FredEmmott::ControllerTester::InputQueue;
+  InputNodeReadsUntilClosed(InputQueue::Backend::IoUring);
+  InputNodeReadsUntilClosed(InputQueue::Backend::Epoll);
+  InputNodeReadsFromAnotherThread(InputQueue::Backend::IoUring);
+  InputNodeReadsFromAnotherThread(InputQueue::Backend::Epoll);
+  InputNodesShareTheThreadsQueue(InputQueue::Backend::IoUring);
+  InputNodesShareTheThreadsQueue(InputQueue::Backend::Epoll);
+  RemoveRetriesWhenSubmissionQueueIsFull();
+  IdleDrainDoesNotEnterTheKernel();
+  return GetExitCode();
+}
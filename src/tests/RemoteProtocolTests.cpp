@@ -0,0 +1,285 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "Check.hpp"
+#include "RemoteProtocol.hpp"
+
+namespace FredEmmott::ControllerTester::Tests {
+
+namespace {
+
+constexpr std::size_t STATE_COUNT {1000};
+
+// Splits `stream` with a `RemoteMessageBuffer`, like a client would; it must
+// be exactly one message
+template <class F>
+void ReadOnlyMessage(
+  const std::vector<std::byte>& stream,
+  RemoteMessageType type,
+  F&& f) {
+  RemoteMessageBuffer buffer;
+  const auto space = buffer.GetWritableSpace(stream.size());
+  std::memcpy(space.data(), stream.data(), stream.size());
+  buffer.Commit(stream.size());
+
+  const auto message = buffer.Next();
+  if (!(CHECK(message) && CHECK(message->mType == type))) {
+    return;
+  }
+  f(message->mBody);
+  CHECK(!buffer.Next());
+  CHECK(!buffer.IsCorrupt());
+}
+
+bool operator==(const DeviceState& a, const DeviceState& b) {
+  return std::ranges::equal(a.mAxes, b.mAxes)
+    && std::ranges::equal(a.mHats, b.mHats)
+    && std::ranges::equal(a.mButtons, b.mButtons);
+}
+
+// Mostly unchanged, with some changes to and from the extremes of each type
+void Mutate(std::mt19937& random, DeviceState& state) {
+  const auto pick = [&random](auto& value, const auto& extremes) {
+    switch (random() % 8) {
+      case 0:
+        value = extremes[random() % extremes.size()];
+        return;
+      case 1:
+        value = static_cast<std::remove_reference_t<decltype(value)>>(
+          random());
+        return;
+      default:
+        return;
+    }
+  };
+  constexpr std::array<int32_t, 5> values {
+    std::numeric_limits<int32_t>::min(),
+    std::numeric_limits<int32_t>::max(),
+    -1,
+    0,
+    1,
+  };
+  constexpr std::array<uint64_t, 4> words {
+    0,
+    1,
+    uint64_t {1} << 63,
+    std::numeric_limits<uint64_t>::max(),
+  };
+  for (auto& axis: state.mAxes) {
+    pick(axis, values);
+  }
+  for (auto& hat: state.mHats) {
+    pick(hat, values);
+  }
+  for (auto& word: state.mButtons) {
+    pick(word, words);
+  }
+}
+
+}// namespace
+
+/* Every varint must read back as written, including the values either side
+ * of each extra byte, and the signed extremes that zigzag to the largest
+ * unsigned values.
+ */
+static void VarintsRoundTrip() {
+  std::vector<uint64_t> unsignedValues {
+    std::numeric_limits<uint32_t>::max(),
+    std::numeric_limits<uint64_t>::max(),
+  };
+  for (int bits = 0; bits <= 63; bits += 7) {
+    const auto value = uint64_t {1} << bits;
+    unsignedValues.push_back(value - 1);
+    unsignedValues.push_back(value);
+  }
+  const std::vector<int64_t> signedValues {
+    0,
+    1,
+    -1,
+    63,
+    -64,
+    64,
+    -65,
+    std::numeric_limits<int32_t>::min(),
+    std::numeric_limits<int32_t>::max(),
+    std::numeric_limits<int64_t>::min(),
+    std::numeric_limits<int64_t>::max(),
+  };
+
+  std::vector<std::byte> stream;
+  {
+    RemoteMessageWriter writer {stream, RemoteMessageType::Samples};
+    for (const auto value: unsignedValues) {
+      writer.WriteVarint(value);
+    }
+    for (const auto value: signedValues) {
+      writer.WriteSignedVarint(value);
+    }
+  }
+
+  ReadOnlyMessage(
+    stream, RemoteMessageType::Samples, [&](std::span<const std::byte> body) {
+      RemoteMessageReader reader {body};
+      for (const auto value: unsignedValues) {
+        CHECK(reader.ReadVarint() == value);
+      }
+      for (const auto value: signedValues) {
+        CHECK(reader.ReadSignedVarint() == value);
+      }
+      CHECK(reader.IsValid());
+      CHECK(reader.IsAtEnd());
+    });
+}
+
+// Truncated and over-long varints must mark the reader as invalid
+static void InvalidVarints() {
+  const std::vector<std::byte> truncated {std::byte {0x80}, std::byte {0x80}};
+  RemoteMessageReader truncatedReader {truncated};
+  truncatedReader.ReadVarint();
+  CHECK(!truncatedReader.IsValid());
+
+  std::vector<std::byte> tooLong(11, std::byte {0x80});
+  tooLong.back() = std::byte {0x01};
+  RemoteMessageReader tooLongReader {tooLong};
+  tooLongReader.ReadVarint();
+  CHECK(!tooLongReader.IsValid());
+}
+
+/* A sequence of states must be rebuilt exactly from their deltas, including
+ * axis and hat changes between the int32 extremes, which don't fit in an
+ * int32, and changes to the top bit of button words.
+ */
+static void StateDeltasRoundTrip() {
+  std::mt19937 random {0};
+  DeviceState written;
+  written.Resize(8, 2, 130);
+  DeviceState read;
+  read.Resize(8, 2, 130);
+
+  std::vector<std::byte> stream;
+  for (std::size_t i = 0; i < STATE_COUNT; ++i) {
+    auto next = written;
+    Mutate(random, next);
+    stream.clear();
+    {
+      RemoteMessageWriter writer {stream, RemoteMessageType::Samples};
+      writer.WriteStateDelta(written, next);
+    }
+    written = next;
+
+    ReadOnlyMessage(
+      stream, RemoteMessageType::Samples, [&](std::span<const std::byte> body) {
+        RemoteMessageReader reader {body};
+        reader.ReadStateDelta(read);
+        CHECK(reader.IsValid());
+        CHECK(reader.IsAtEnd());
+      });
+    if (!CHECK(read == written)) {
+      return;
+    }
+  }
+
+  // No changes is just a zero count
+  stream.clear();
+  {
+    RemoteMessageWriter writer {stream, RemoteMessageType::Samples};
+    writer.WriteStateDelta(written, written);
+  }
+  CHECK(stream.size() == REMOTE_MESSAGE_HEADER_SIZE + 1);
+}
+
+// Every serialized part of a device must read back unchanged
+static void DeviceAddedRoundTrips() {
+  DeviceInfo device;
+  device.mName = "Test Device \xe2\x84\xa2";
+  device.mGuid = {0x01234567, 0x89ab, 0xcdef, {1, 2, 3, 4, 5, 6, 7, 8}};
+  device.mProduct = {0xfedcba98, 0x7654, 0x3210, {8, 7, 6, 5, 4, 3, 2, 1}};
+  device.mAxes = {
+    {.mName = "X", .mMin = 0, .mMax = 65535},
+    {.mName = "", .mMin = std::numeric_limits<int32_t>::min(), .mMax = -1},
+    {
+      .mName = "Throttle",
+      .mMin = -32768,
+      .mMax = std::numeric_limits<int32_t>::max(),
+    },
+  };
+  for (std::size_t i = 0; i < 70; ++i) {
+    device.mButtons.push_back({.mName = "Button " + std::to_string(i + 1)});
+  }
+  device.mHats = {
+    {.mName = "Hat 1", .mType = HatType::FourWay},
+    {.mName = "Hat 2", .mType = HatType::EightWay},
+    {.mName = "Hat 3", .mType = HatType::Other},
+  };
+  device.mAxes[0].mGuid.mData1 = 1;
+  device.mButtons[0].mGuid.mData1 = 2;
+  device.mHats[0].mGuid.mData1 = 3;
+
+  constexpr uint32_t id {std::numeric_limits<uint32_t>::max()};
+  std::vector<std::byte> stream;
+  WriteRemoteDeviceAdded(stream, id, device);
+
+  ReadOnlyMessage(
+    stream,
+    RemoteMessageType::DeviceAdded,
+    [&](std::span<const std::byte> body) {
+      uint32_t readId {};
+      const auto read = ReadRemoteDeviceAdded(body, readId);
+      if (!CHECK(read)) {
+        return;
+      }
+      CHECK(readId == id);
+      CHECK(read->mName == device.mName);
+      CHECK(read->mGuid == device.mGuid);
+      CHECK(read->mProduct == device.mProduct);
+      if (
+        !(CHECK(read->mAxes.size() == device.mAxes.size())
+          && CHECK(read->mButtons.size() == device.mButtons.size())
+          && CHECK(read->mHats.size() == device.mHats.size()))) {
+        return;
+      }
+      for (std::size_t i = 0; i < device.mAxes.size(); ++i) {
+        CHECK(read->mAxes[i].mName == device.mAxes[i].mName);
+        CHECK(read->mAxes[i].mGuid == device.mAxes[i].mGuid);
+        CHECK(read->mAxes[i].mMin == device.mAxes[i].mMin);
+        CHECK(read->mAxes[i].mMax == device.mAxes[i].mMax);
+      }
+      for (std::size_t i = 0; i < device.mButtons.size(); ++i) {
+        CHECK(read->mButtons[i].mName == device.mButtons[i].mName);
+        CHECK(read->mButtons[i].mGuid == device.mButtons[i].mGuid);
+      }
+      for (std::size_t i = 0; i < device.mHats.size(); ++i) {
+        CHECK(read->mHats[i].mName == device.mHats[i].mName);
+        CHECK(read->mHats[i].mGuid == device.mHats[i].mGuid);
+        CHECK(read->mHats[i].mType == device.mHats[i].mType);
+      }
+
+      // Every prefix is truncated, so must be rejected
+      for (std::size_t size = 0; size < body.size(); ++size) {
+        uint32_t ignored {};
+        CHECK(!ReadRemoteDeviceAdded(body.first(size), ignored));
+      }
+    });
+}
+
+}// namespace FredEmmott::ControllerTester::Tests
+
+int main() {
+  using namespace FredEmmott::ControllerTester::Tests;
+  VarintsRoundTrip();
+  InvalidVarints();
+  StateDeltasRoundTrip();
+  DeviceAddedRoundTrips();
+  return GetExitCode();
+}
@@ -0,0 +1,161 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Check.hpp"
+#include "ResultsDatabase.hpp"
+#include "../benchmarks/SyntheticDevice.hpp"
+
+namespace FredEmmott::ControllerTester::Tests {
+
+using Benchmarks::SyntheticDeviceInfo;
+using Benchmarks::XINPUT_SHAPED;
+
+namespace {
+
+// Removed when the test finishes
+class TemporaryDirectory final {
+ public:
+  TemporaryDirectory() {
+    mPath = std::filesystem::temp_directory_path()
+      / ("freds-controller-tester-tests-"
+         + std::to_string(std::random_device {}()));
+    std::filesystem::create_directories(mPath);
+  }
+
+  ~TemporaryDirectory() {
+    std::error_code ec;
+    std::filesystem::remove_all(mPath, ec);
+  }
+
+  TemporaryDirectory(const TemporaryDirectory&) = delete;
+  TemporaryDirectory(TemporaryDirectory&&) = delete;
+  TemporaryDirectory& operator=(const TemporaryDirectory&) = delete;
+  TemporaryDirectory& operator=(TemporaryDirectory&&) = delete;
+
+  const std::filesystem::path& GetPath() const {
+    return mPath;
+  }
+
+ private:
+  std::filesystem::path mPath;
+};
+
+std::vector<char> ReadFile(const std::filesystem::path& path) {
+  std::ifstream f(path, std::ios::binary);
+  return {std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>()};
+}
+
+void WriteFile(
+  const std::filesystem::path& path,
+  const std::vector<char>& data) {
+  std::ofstream f(path, std::ios::binary | std::ios::trunc);
+  f.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+// Returns the size of each record
+std::size_t CreateDatabase(const std::filesystem::path& path, uint32_t count) {
+  ResultsDatabase db {path};
+  SyntheticDeviceInfo device {0, XINPUT_SHAPED};
+  for (uint32_t i = 0; i < count; ++i) {
+    device.mGuid.mData1 = i;
+    CHECK(db.Append(MakeUnitResult(device, {}, {})));
+  }
+  return (std::filesystem::file_size(path) - 8) / count;
+}
+
+}// namespace
+
+static void ReadOnlyDoesNotCreate() {
+  const TemporaryDirectory directory;
+  const auto path = directory.GetPath() / "results.fctdb";
+  ResultsDatabase db {path, ResultsDatabase::Mode::ReadOnly};
+  CHECK(db.GetResultCount() == 0);
+  CHECK(db.Find({}).empty());
+  const SyntheticDeviceInfo device {0, XINPUT_SHAPED};
+  CHECK(!db.Append(MakeUnitResult(device, {}, {})));
+  CHECK(!std::filesystem::exists(path));
+}
+
+// Other damaged records are skipped, without changing the file
+static void SkipsDamagedRecords() {
+  const TemporaryDirectory directory;
+  const auto path = directory.GetPath() / "results.fctdb";
+  const auto recordSize = CreateDatabase(path, 3);
+
+  // Give the second record an impossible size
+  auto data = ReadFile(path);
+  const auto second = 8 + recordSize;
+  data[second] = 0x7f;
+  data[second + 3] = 0x7f;
+  WriteFile(path, data);
+
+  for (const auto mode:
+       {ResultsDatabase::Mode::ReadOnly, ResultsDatabase::Mode::ReadWrite}) {
+    const ResultsDatabase db {path, mode};
+    CHECK(db.GetResultCount() == 2);
+    CHECK(db.GetCorruptResultCount() == 1);
+    CHECK(db.GetDamagedTailSize() == 0);
+    CHECK(ReadFile(path) == data);
+  }
+}
+
+/* A partial record at the end is ignored by readers, as the app may be
+ * writing it; a writer moves it to another file, and appends after the
+ * last valid record.
+ */
+static void MovesDamagedTailAside() {
+  const TemporaryDirectory directory;
+  const auto path = directory.GetPath() / "results.fctdb";
+  const auto recordSize = CreateDatabase(path, 2);
+  const auto valid = ReadFile(path);
+
+  auto data = valid;
+  const std::vector<char> tail(recordSize / 2, 0x42);
+  data.insert(data.end(), tail.begin(), tail.end());
+  WriteFile(path, data);
+
+  {
+    const ResultsDatabase db {path, ResultsDatabase::Mode::ReadOnly};
+    CHECK(db.GetResultCount() == 2);
+    CHECK(db.GetDamagedTailSize() == tail.size());
+    CHECK(db.GetDamagedTailPath().empty());
+    CHECK(ReadFile(path) == data);
+  }
+
+  {
+    ResultsDatabase db {path};
+    CHECK(db.GetResultCount() == 2);
+    CHECK(db.GetDamagedTailSize() == tail.size());
+    CHECK(ReadFile(path) == valid);
+    const auto moved = db.GetDamagedTailPath();
+    CHECK(moved.parent_path() == path.parent_path());
+    CHECK(ReadFile(moved) == tail);
+
+    CHECK(db.Append(
+      MakeUnitResult(SyntheticDeviceInfo {2, XINPUT_SHAPED}, {}, {})));
+    CHECK(db.Find({}).size() == 3);
+  }
+
+  const ResultsDatabase db {path, ResultsDatabase::Mode::ReadOnly};
+  CHECK(db.GetResultCount() == 3);
+  CHECK(db.GetCorruptResultCount() == 0);
+  CHECK(db.GetDamagedTailSize() == 0);
+}
+
+}// namespace FredEmmott::ControllerTester::Tests
+
+int main() {
+  using namespace FredEmmott::ControllerTester::Tests;
+  ReadOnlyDoesNotCreate();
+  SkipsDamagedRecords();
+  MovesDamagedTailAside();
+  return GetExitCode();
+}
@@ -0,0 +1,135 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <system_error>
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "Check.hpp"
+#include "SampleRing.hpp"
+#include "SharedMemory.hpp"
+#include "SharedSampleFeed.hpp"
+#include "../benchmarks/SyntheticDevice.hpp"
+
+namespace FredEmmott::ControllerTester::Tests {
+
+using Benchmarks::SyntheticDeviceInfo;
+using Benchmarks::XINPUT_SHAPED;
+
+namespace {
+
+// Unique, so a region left over from an earlier run doesn't get in the way
+SyntheticDeviceInfo CreateDevice() {
+  SyntheticDeviceInfo ret {0, XINPUT_SHAPED};
+  std::random_device random;
+  ret.mGuid.mData1 = random();
+  ret.mGuid.mData2 = static_cast<uint16_t>(random());
+  ret.mGuid.mData3 = static_cast<uint16_t>(random());
+  return ret;
+}
+
+}// namespace
+
+// A second writer for the same unit must fail, not take over the feed
+static void SecondWriterFails() {
+  auto device = CreateDevice();
+  device.mName = "First";
+  const SharedFeedWriter first {device, 16, nullptr};
+  if (!CHECK(first.IsValid())) {
+    return;
+  }
+
+  device.mName = "Second";
+  const SharedFeedWriter second {device, 16, nullptr};
+  CHECK(!second.IsValid());
+  CHECK(second.GetError() == std::errc::file_exists);
+
+  const SharedFeedReader reader {device.mGuid};
+  CHECK(reader.IsValid());
+  CHECK(reader.GetDeviceInfo().mName == "First");
+}
+
+// A ring offset past the end of the feed must be rejected, rather than
+// wrapping around when finding the space that's left
+static void RejectsRingOffsetPastEnd() {
+  const auto device = CreateDevice();
+  constexpr std::size_t size {4096};
+  const SharedMemory memory {GetSharedFeedName(device.mGuid), size};
+  const auto data = memory.GetWritableData();
+  if (!CHECK(data.size() == size)) {
+    return;
+  }
+
+  const SharedFeedHeader header {
+    .mMagic = SharedFeedHeader::MAGIC,
+    .mVersion = SharedFeedHeader::VERSION,
+    .mProduct = device.mProduct,
+    .mUnit = device.mGuid,
+    .mCapacity = 1,
+    .mWordsPerSample
+    = static_cast<uint32_t>(SampleRing::GetWordsPerSample(0, 0, 0)),
+    .mRingOffset = 2 * size,
+    .mSize = size,
+  };
+  std::memcpy(data.data(), &header, sizeof(header));
+
+  const SharedFeedReader reader {device.mGuid};
+  CHECK(!reader.IsValid());
+}
+
+#ifndef _WIN32
+// On POSIX, a feed outlives a writer that crashes; it must be replaced,
+// or the unit can't be shared again until it's removed by hand
+static void ReplacesAbandonedFeed() {
+  // A process ID that was in use, but isn't now
+  const auto child = fork();
+  if (child == 0) {
+    _exit(0);
+  }
+  if (!CHECK(child > 0)) {
+    return;
+  }
+  waitpid(child, nullptr, 0);
+
+  const auto device = CreateDevice();
+  constexpr std::size_t size {4096};
+  const SharedMemory abandoned {GetSharedFeedName(device.mGuid), size};
+  const auto data = abandoned.GetWritableData();
+  if (!CHECK(data.size() == size)) {
+    return;
+  }
+  const SharedFeedHeader header {
+    .mMagic = SharedFeedHeader::MAGIC,
+    .mVersion = SharedFeedHeader::VERSION,
+    .mWriterProcessID = static_cast<uint32_t>(child),
+    .mUnit = device.mGuid,
+    .mSize = size,
+  };
+  std::memcpy(data.data(), &header, sizeof(header));
+
+  const SharedFeedWriter writer {device, 16, nullptr};
+  CHECK(writer.IsValid());
+  const SharedFeedReader reader {device.mGuid};
+  CHECK(reader.IsValid());
+  CHECK(reader.GetWriterProcessID() == static_cast<uint32_t>(getpid()));
+}
+#endif
+
+}// namespace FredEmmott::ControllerTester::Tests
+
+int main() {
+  using namespace FredEmmott::ControllerTester::Tests;
+  SecondWriterFails();
+  RejectsRingOffsetPastEnd();
+#ifndef _WIN32
+  ReplacesAbandonedFeed();
+#endif
+  return GetExitCode();
+}
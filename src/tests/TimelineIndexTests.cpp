@@ -0,0 +1,232 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Check.hpp"
+#include "TimelineIndex.hpp"
+
+namespace FredEmmott::ControllerTester::Tests {
+
+using std::chrono::microseconds;
+
+namespace {
+
+constexpr std::size_t QUERY_COUNT {2000};
+
+struct ReferenceRun {
+  microseconds mStart {};
+  int32_t mValue {};
+};
+
+// The spans that `GetSpans()` should return, found by looking at every run
+std::vector<TimelineSpan> GetReferenceSpans(
+  const std::vector<ReferenceRun>& runs,
+  microseconds sessionEnd,
+  microseconds begin,
+  microseconds end,
+  microseconds resolution) {
+  std::vector<TimelineSpan> ret;
+  if (runs.empty() || begin >= end) {
+    return ret;
+  }
+  std::size_t i {};
+  while (i + 1 < runs.size() && runs[i + 1].mStart <= begin) {
+    ++i;
+  }
+  while (i < runs.size() && runs[i].mStart < end) {
+    const auto start = runs[i].mStart;
+    const auto runEnd
+      = (i + 1 < runs.size()) ? runs[i + 1].mStart : sessionEnd;
+    auto last = i;
+    if (runEnd - start < resolution) {
+      for (auto j = i + 1;
+           j < runs.size() && runs[j].mStart <= start + resolution;
+           ++j) {
+        last = j;
+      }
+    }
+    if (last == i) {
+      ret.push_back({start, runEnd, runs[i].mValue, runs[i].mValue});
+      ++i;
+      continue;
+    }
+    auto span = TimelineSpan {start, runs[last].mStart, runs[i].mValue, 0};
+    span.mMax = span.mMin;
+    for (auto j = i; j < last; ++j) {
+      span.mMin = std::min(span.mMin, runs[j].mValue);
+      span.mMax = std::max(span.mMax, runs[j].mValue);
+    }
+    ret.push_back(span);
+    i = last;
+  }
+  return ret;
+}
+
+bool IsSameSpan(const TimelineSpan& a, const TimelineSpan& b) {
+  return a.mStart == b.mStart && a.mEnd == b.mEnd && a.mMin == b.mMin
+    && a.mMax == b.mMax;
+}
+
+DeviceInfo MakeDevice(std::size_t axes, std::size_t hats, std::size_t buttons) {
+  DeviceInfo ret;
+  ret.mAxes.resize(axes);
+  ret.mHats.resize(hats);
+  ret.mButtons.resize(buttons);
+  return ret;
+}
+
+}// namespace
+
+/* Exact spans at full resolution: the first run starts before `begin` and
+ * is still returned, spans aren't clipped to the query, and the last run
+ * ends at the end of the session.
+ */
+static void SpansAreExactAtFullResolution() {
+  TimelineIndex index {MakeDevice(1, 0, 0)};
+  DeviceState state;
+  state.Resize(1, 0, 0);
+  const std::vector<ReferenceRun> runs {
+    {microseconds {0}, 5},
+    {microseconds {100}, 7},
+    {microseconds {250}, -3},
+  };
+  for (const auto& run: runs) {
+    state.mAxes[0] = run.mValue;
+    index.Push(run.mStart, state);
+  }
+  // Unchanged, so it only extends the last run
+  index.Push(microseconds {400}, state);
+  CHECK(index.GetRunCount() == runs.size());
+  CHECK(index.GetEnd() == microseconds {400});
+
+  const auto spans = index.GetSpans(
+    TimelineIndex::Kind::Axis,
+    0,
+    microseconds {150},
+    microseconds {300},
+    microseconds {1});
+  const std::vector<TimelineSpan> expected {
+    {microseconds {100}, microseconds {250}, 7, 7},
+    {microseconds {250}, microseconds {400}, -3, -3},
+  };
+  CHECK(std::ranges::equal(spans, expected, IsSameSpan));
+
+  // A query that ends exactly where a run starts doesn't include it
+  const auto before = index.GetSpans(
+    TimelineIndex::Kind::Axis,
+    0,
+    microseconds {0},
+    microseconds {100},
+    microseconds {1});
+  CHECK(before.size() == 1 && before.front().mEnd == microseconds {100});
+}
+
+// Short runs are merged with the runs that start within the resolution,
+// and the merged span has their minimum and maximum
+static void ShortRunsAreMerged() {
+  TimelineIndex index {MakeDevice(0, 0, 1)};
+  DeviceState state;
+  state.Resize(0, 0, 1);
+  // A button that bounces for 10us, then stays pressed
+  for (int i = 0; i <= 10; ++i) {
+    state.mButtons[0] = (i % 2) ? 0 : 1;
+    index.Push(microseconds {1000 + i}, state);
+  }
+  index.Push(microseconds {2000}, state);
+
+  const auto spans = index.GetSpans(
+    TimelineIndex::Kind::Button,
+    0,
+    microseconds {0},
+    microseconds {2000},
+    microseconds {100});
+  const std::vector<TimelineSpan> expected {
+    {microseconds {1000}, microseconds {1010}, 0, 1},
+    {microseconds {1010}, microseconds {2000}, 1, 1},
+  };
+  CHECK(std::ranges::equal(spans, expected, IsSameSpan));
+  CHECK(spans.front().IsMerged());
+}
+
+/* Random sessions and queries must match the reference, including merged
+ * spans that cross the index's blocks and chunks of runs, and gaps that
+ * are too long for a chunk's 32-bit offsets.
+ */
+static void SpansMatchReference() {
+  std::mt19937 random {0};
+  TimelineIndex index {MakeDevice(1, 0, 0)};
+  DeviceState state;
+  state.Resize(1, 0, 0);
+
+  std::vector<ReferenceRun> runs;
+  microseconds time {};
+  for (std::size_t i = 0; i < 5000; ++i) {
+    switch (random() % 16) {
+      case 0:
+        time += microseconds {1000 + (random() % 100000)};
+        break;
+      case 1:
+        // Just over the longest offset, so a truncated offset would land
+        // in the middle of the chunk
+        if (i > 2000 && i < 2100) {
+          time += microseconds {(int64_t {1} << 32) + (random() % 100000)};
+          break;
+        }
+        [[fallthrough]];
+      default:
+        time += microseconds {1 + (random() % 20)};
+    }
+    const auto value = static_cast<int32_t>(random() % 2001) - 1000;
+    if (runs.empty() || runs.back().mValue != value) {
+      runs.push_back({time, value});
+    }
+    state.mAxes[0] = value;
+    index.Push(time, state);
+  }
+  const auto sessionEnd = time;
+  CHECK(index.GetRunCount() == runs.size());
+
+  const auto pick = [&random](microseconds max) {
+    return microseconds {static_cast<int64_t>(
+      random() % static_cast<uint64_t>(max.count() + 1))};
+  };
+  for (std::size_t i = 0; i < QUERY_COUNT; ++i) {
+    auto begin = pick(sessionEnd);
+    auto end = pick(sessionEnd);
+    if (end < begin) {
+      std::swap(begin, end);
+    }
+    const microseconds resolution {1 << (random() % 24)};
+    const auto spans = index.GetSpans(
+      TimelineIndex::Kind::Axis, 0, begin, end, resolution);
+    const auto expected
+      = GetReferenceSpans(runs, sessionEnd, begin, end, resolution);
+    if (!CHECK(std::ranges::equal(spans, expected, IsSameSpan))) {
+      std::fprintf(
+        stderr,
+        "[%lld, %lld) at %lldus: %zu spans, expected %zu\n",
+        static_cast<long long>(begin.count()),
+        static_cast<long long>(end.count()),
+        static_cast<long long>(resolution.count()),
+        spans.size(),
+        expected.size());
+      return;
+    }
+  }
+}
+
+}// namespace FredEmmott::ControllerTester::Tests
+
+int main() {
+  using namespace FredEmmott::ControllerTester::Tests;
+  SpansAreExactAtFullResolution();
+  ShortRunsAreMerged();
+  SpansMatchReference();
+  return GetExitCode();
+}
@@ -0,0 +1,29 @@
+# Copyright 2023 Fred Emmott <fred@fredemmott.com>
+# SPDX-License-Identifier: ISC
+
+# Runs freds-controller-tester-hid, and compares its output with a file:
+#
+#   cmake -DTOOL=... -DDESCRIPTOR=... [-DREPORTS=...] -DEXPECTED=... \
+#     -P RunFixture.cmake
+execute_process(
+  COMMAND "${TOOL}" "${DESCRIPTOR}" ${REPORTS}
+  OUTPUT_VARIABLE ACTUAL
+  ERROR_VARIABLE ERRORS
+  RESULT_VARIABLE RESULT
+)
+if (NOT RESULT EQUAL 0)
+  message(FATAL_ERROR "${TOOL} failed (${RESULT}):\n${ERRORS}")
+endif ()
+
+file(READ "${EXPECTED}" EXPECTED_OUTPUT)
+# Both may have CRLF line endings on Windows
+string(REPLACE "\r\n" "\n" ACTUAL "${ACTUAL}")
+string(REPLACE "\r\n" "\n" EXPECTED_OUTPUT "${EXPECTED_OUTPUT}")
+if (NOT ACTUAL STREQUAL EXPECTED_OUTPUT)
+  message(
+    FATAL_ERROR
+    "Output doesn't match ${EXPECTED}\n"
+    "Expected:\n${EXPECTED_OUTPUT}\n"
+    "Actual:\n${ACTUAL}"
+  )
+endif ()
@@ -0,0 +1,341 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "Capture.hpp"
+#include "ControlAnalysis.hpp"
+#include "SessionAnalysis.hpp"
+
+using namespace FredEmmott::ControllerTester;
+
+namespace {
+
+constexpr std::string_view USAGE {
+  "Usage: freds-controller-tester-analyze DIRECTORY [options]\n"
+  "\n"
+  "Analyzes every .fctcap file under DIRECTORY.\n"
+  "\n"
+  "Options:\n"
+  "  --threads N        Defaults to the number of hardware threads\n"
+  "  --bounce-ms MS     Button transitions closer than this are bounces;\n"
+  "                     defaults to 5\n"
+  "  --noise-percent P  Axis changes up to this percentage of the range are\n"
+  "                     noise; defaults to 1\n"
+  "  --verbose          Include per-control results\n"};
+
+struct Options {
+  std::filesystem::path mDirectory;
+  unsigned int mThreads {std::max(1u, std::thread::hardware_concurrency())};
+  AnalysisThresholds mThresholds {};
+  bool mVerbose {false};
+};
+
+template <class T>
+std::optional<T> ParseNumber(std::string_view text) {
+  T value {};
+  const auto end = text.data() + text.size();
+  const auto [ptr, ec] = std::from_chars(text.data(), end, value);
+  if (ec != std::errc {} || ptr != end) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+std::optional<Options> ParseOptions(int argc, char** argv) {
+  if (argc < 2) {
+    return std::nullopt;
+  }
+  Options ret {.mDirectory = argv[1]};
+  for (int i = 2; i < argc; ++i) {
+    const std::string_view name {argv[i]};
+    if (name == "--verbose") {
+      ret.mVerbose = true;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      std::cerr << "Missing value for " << name << std::endl;
+      return std::nullopt;
+    }
+    const std::string_view value {argv[++i]};
+
+    if (name == "--threads") {
+      const auto threads = ParseNumber<unsigned int>(value);
+      if (!(threads && *threads > 0)) {
+        std::cerr << "Invalid thread count: " << value << std::endl;
+        return std::nullopt;
+      }
+      ret.mThreads = *threads;
+      continue;
+    }
+    if (name == "--bounce-ms") {
+      const auto ms = ParseNumber<float>(value);
+      if (!(ms && *ms >= 0)) {
+        std::cerr << "Invalid bounce window: " << value << std::endl;
+        return std::nullopt;
+      }
+      ret.mThresholds.mBounceWindow = std::chrono::microseconds {
+        static_cast<int64_t>(*ms * 1000)};
+      continue;
+    }
+    if (name == "--noise-percent") {
+      const auto percent = ParseNumber<float>(value);
+      if (!(percent && *percent >= 0)) {
+        std::cerr << "Invalid noise threshold: " << value << std::endl;
+        return std::nullopt;
+      }
+      ret.mThresholds.mNoiseFraction = *percent / 100;
+      continue;
+    }
+
+    std::cerr << "Unknown option: " << name << std::endl;
+    return std::nullopt;
+  }
+  return ret;
+}
+
+struct AxisResult {
+  std::string mName;
+  int32_t mMinSeen {};
+  int32_t mMaxSeen {};
+  TestedRange mTestedRange {};
+  double mNoiseRMS {};
+  // RMS as a percentage of the range
+  double mNoisePercent {};
+};
+
+struct ButtonResult {
+  std::string mName;
+  ButtonBounce mBounce;
+};
+
+struct FileResult {
+  std::filesystem::path mPath;
+  bool mValid {false};
+  std::string mDeviceName {};
+  std::size_t mSamples {};
+  std::chrono::microseconds mDuration {};
+  bool mPassed {false};
+  uint32_t mBounces {};
+  std::vector<AxisResult> mAxes {};
+  std::vector<ButtonResult> mButtons {};
+
+  const AxisResult* GetNoisiestAxis() const {
+    const auto it
+      = std::ranges::max_element(mAxes, {}, &AxisResult::mNoisePercent);
+    return (it == mAxes.end()) ? nullptr : &*it;
+  }
+};
+
+FileResult AnalyzeFile(
+  const std::filesystem::path& path,
+  const AnalysisThresholds& thresholds) {
+  FileResult ret {.mPath = path};
+  const CaptureReader reader {path};
+  if (!reader.IsValid()) {
+    return ret;
+  }
+
+  auto device = reader.GetDeviceInfo();
+  SessionAnalyzer analyzer {device, thresholds};
+  // Decode one sample at a time into the same buffers, rather than
+  // materializing the whole capture
+  DeviceState state;
+  std::chrono::microseconds time {};
+  for (std::size_t i = 0; i < reader.GetSampleCount(); ++i) {
+    time = reader.ReadSample(i, state);
+    analyzer.Push(time, state);
+  }
+
+  ret.mValid = true;
+  ret.mDeviceName = device.mName;
+  ret.mSamples = reader.GetSampleCount();
+  ret.mDuration = time;
+  ret.mPassed = IsFullyTested(device);
+
+  const auto& noise = analyzer.GetAxisNoise();
+  for (std::size_t i = 0; i < device.mAxes.size(); ++i) {
+    const auto& axis = device.mAxes[i];
+    const auto rms = noise[i].GetRMS();
+    const auto range = static_cast<double>(axis.mMax) - axis.mMin;
+    ret.mAxes.push_back({
+      .mName = axis.mName,
+      .mMinSeen = axis.mMinSeen,
+      .mMaxSeen = axis.mMaxSeen,
+      .mTestedRange = GetTestedRange(axis),
+      .mNoiseRMS = rms,
+      .mNoisePercent = (range > 0) ? (100 * rms / range) : 0,
+    });
+  }
+
+  const auto& bounce = analyzer.GetButtonBounce();
+  for (std::size_t i = 0; i < device.mButtons.size(); ++i) {
+    ret.mBounces += bounce[i].mBounces;
+    ret.mButtons.push_back({
+      .mName = device.mButtons[i].mName,
+      .mBounce = bounce[i],
+    });
+  }
+  return ret;
+}
+
+// Work-stealing over a shared index; results are written to their own
+// slots, so no other synchronization is needed
+std::vector<FileResult> AnalyzeFiles(
+  const std::vector<std::filesystem::path>& paths,
+  const Options& options) {
+  std::vector<FileResult> results(paths.size());
+  std::atomic<std::size_t> next {0};
+  const auto worker = [&]() {
+    while (true) {
+      const auto i = next.fetch_add(1, std::memory_order_relaxed);
+      if (i >= paths.size()) {
+        return;
+      }
+      results[i] = AnalyzeFile(paths[i], options.mThresholds);
+    }
+  };
+
+  const auto threadCount
+    = std::min<std::size_t>(options.mThreads, paths.size());
+  std::vector<std::jthread> threads;
+  threads.reserve(threadCount);
+  for (std::size_t i = 0; i < threadCount; ++i) {
+    threads.emplace_back(worker);
+  }
+  threads.clear();
+  return results;
+}
+
+const char* GetTestedRangeName(TestedRange range) {
+  switch (range) {
+    case TestedRange::FullRange:
+      return "full";
+    case TestedRange::NearFullRange:
+      return "near-full";
+    case TestedRange::Default:
+      break;
+  }
+  return "partial";
+}
+
+void PrintFileResult(const FileResult& result, bool verbose) {
+  if (!result.mValid) {
+    std::cout << result.mPath.string() << "\tunreadable" << std::endl;
+    return;
+  }
+  const auto noisiest = result.GetNoisiestAxis();
+  std::cout << result.mPath.string() << '\t' << result.mDeviceName << '\t'
+            << result.mSamples << " samples\t"
+            << (result.mDuration.count() / 1e6) << "s\t"
+            << (result.mPassed ? "passed" : "not fully tested") << '\t'
+            << result.mBounces << " bounces\t"
+            << (noisiest ? noisiest->mNoisePercent : 0.0) << "% noise"
+            << std::endl;
+  if (!verbose) {
+    return;
+  }
+
+  for (const auto& axis: result.mAxes) {
+    std::cout << "  axis " << axis.mName << ": " << axis.mMinSeen << ".."
+              << axis.mMaxSeen << " (" << GetTestedRangeName(axis.mTestedRange)
+              << "), noise RMS " << axis.mNoiseRMS << std::endl;
+  }
+  for (const auto& button: result.mButtons) {
+    const auto& bounce = button.mBounce;
+    if (bounce.mBounces == 0) {
+      continue;
+    }
+    std::cout << "  button " << button.mName << ": " << bounce.mBounces
+              << " bounces in " << bounce.mPresses << " presses, shortest "
+              << (bounce.mShortestInterval->count() / 1000.0) << "ms"
+              << std::endl;
+  }
+}
+
+}// namespace
+
+int main(int argc, char** argv) {
+  const auto options = ParseOptions(argc, argv);
+  if (!options) {
+    std::cerr << USAGE;
+    return EXIT_FAILURE;
+  }
+
+  std::error_code ec;
+  std::vector<std::filesystem::path> paths;
+  for (const auto& entry:
+       std::filesystem::recursive_directory_iterator(options->mDirectory, ec)) {
+    if (entry.is_regular_file() && entry.path().extension() == ".fctcap") {
+      paths.push_back(entry.path());
+    }
+  }
+  if (ec) {
+    std::cerr << "Couldn't read " << options->mDirectory.string() << ": "
+              << ec.message() << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::ranges::sort(paths);
+
+  const auto start = std::chrono::steady_clock::now();
+  const auto results = AnalyzeFiles(paths, *options);
+  const auto elapsed = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start);
+
+  std::size_t unreadable {};
+  std::size_t passed {};
+  std::size_t samples {};
+  std::size_t withBounces {};
+  uint64_t bounces {};
+  const FileResult* noisiest {nullptr};
+  for (const auto& result: results) {
+    PrintFileResult(result, options->mVerbose);
+    if (!result.mValid) {
+      ++unreadable;
+      continue;
+    }
+    passed += result.mPassed ? 1 : 0;
+    samples += result.mSamples;
+    bounces += result.mBounces;
+    withBounces += (result.mBounces > 0) ? 1 : 0;
+    const auto axis = result.GetNoisiestAxis();
+    if (
+      axis
+      && (!noisiest
+          || axis->mNoisePercent
+            > noisiest->GetNoisiestAxis()->mNoisePercent)) {
+      noisiest = &result;
+    }
+  }
+
+  std::cout << std::endl
+            << "Captures: " << results.size() << " (" << unreadable
+            << " unreadable)" << std::endl
+            << "Fully tested: " << passed << std::endl
+            << "Samples: " << samples << std::endl
+            << "Bounces: " << bounces << " in " << withBounces << " captures"
+            << std::endl;
+  if (noisiest) {
+    const auto axis = noisiest->GetNoisiestAxis();
+    std::cout << "Noisiest axis: " << axis->mName << " in "
+              << noisiest->mPath.string() << " (" << axis->mNoisePercent
+              << "% of range)" << std::endl;
+  }
+  std::cout << "Analyzed in " << elapsed.count() << "s with "
+            << std::min<std::size_t>(options->mThreads, paths.size())
+            << " threads (" << (samples / std::max(elapsed.count(), 1e-9))
+            << " samples/s)" << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,210 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#include "DeviceState.hpp"
+#include "SharedSampleFeed.hpp"
+
+using namespace FredEmmott::ControllerTester;
+
+namespace {
+
+constexpr std::string_view USAGE {
+  "Usage: freds-controller-tester-feed [INDEX] [--csv]\n"
+  "\n"
+  "Without INDEX, lists the devices that Fred's Controller Tester is\n"
+  "sampling. With INDEX, follows that device's samples.\n"
+  "\n"
+  "Options:\n"
+  "  --csv    Print every sample, instead of a summary each second\n"};
+
+// Well within the feed's capacity, without spinning
+constexpr std::chrono::milliseconds POLL_INTERVAL {10};
+
+struct Options {
+  std::optional<std::size_t> mIndex;
+  bool mCSV {false};
+};
+
+std::optional<Options> ParseOptions(int argc, char** argv) {
+  Options ret;
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg {argv[i]};
+    if (arg == "--csv") {
+      ret.mCSV = true;
+      continue;
+    }
+    std::size_t index {};
+    const auto end = arg.data() + arg.size();
+    const auto [ptr, ec] = std::from_chars(arg.data(), end, index);
+    if (ec != std::errc {} || ptr != end || ret.mIndex) {
+      std::cerr << "Unexpected argument: " << arg << std::endl;
+      return std::nullopt;
+    }
+    ret.mIndex = index;
+  }
+  if (ret.mCSV && !ret.mIndex) {
+    std::cerr << "--csv requires INDEX" << std::endl;
+    return std::nullopt;
+  }
+  return ret;
+}
+
+void PrintCSVHeader(const DeviceInfo& device) {
+  std::cout << "microseconds";
+  for (const auto& axis: device.mAxes) {
+    std::cout << ',' << axis.mName;
+  }
+  for (const auto& hat: device.mHats) {
+    std::cout << ',' << hat.mName;
+  }
+  constexpr auto perWord = DeviceState::BUTTONS_PER_WORD;
+  const auto words = DeviceState::GetButtonWordCount(device.mButtons.size());
+  for (std::size_t i = 0; i < words; ++i) {
+    std::cout << ",buttons" << (i * perWord) << '-'
+              << (((i + 1) * perWord) - 1);
+  }
+  std::cout << '\n';
+}
+
+void PrintCSVRow(std::chrono::microseconds time, const DeviceState& state) {
+  std::cout << time.count();
+  for (const auto value: state.mAxes) {
+    std::cout << ',' << value;
+  }
+  for (const auto value: state.mHats) {
+    std::cout << ',' << value;
+  }
+  for (const auto word: state.mButtons) {
+    std::cout << ",0x" << std::hex << word << std::dec;
+  }
+  std::cout << '\n';
+}
+
+void PrintSummary(
+  const DeviceInfo& device,
+  uint64_t samples,
+  uint64_t lost,
+  const DeviceState& latest) {
+  std::cout << samples << " samples/s";
+  if (lost) {
+    std::cout << ", " << lost << " lost";
+  }
+  for (std::size_t i = 0; i < latest.mAxes.size(); ++i) {
+    std::cout << "; " << device.mAxes[i].mName << ' ' << latest.mAxes[i];
+  }
+  std::size_t pressed {};
+  for (std::size_t i = 0; i < device.mButtons.size(); ++i) {
+    if (latest.IsButtonPressed(i)) {
+      ++pressed;
+    }
+  }
+  std::cout << "; " << pressed << " buttons pressed" << std::endl;
+}
+
+int Follow(const Guid& unit, bool csv) {
+  const SharedFeedReader reader {unit};
+  if (!reader.IsValid()) {
+    std::cerr << "The feed is gone, or from another version" << std::endl;
+    return EXIT_FAILURE;
+  }
+  const auto& device = reader.GetDeviceInfo();
+  const auto capacity = reader.GetCapacity();
+  if (csv) {
+    PrintCSVHeader(device);
+  } else {
+    std::cout << "Following " << device.mName << " (" << device.mAxes.size()
+              << " axes, " << device.mButtons.size() << " buttons, "
+              << device.mHats.size() << " hats)" << std::endl;
+  }
+
+  DeviceState state;
+  DeviceState latest;
+  latest.Resize(
+    device.mAxes.size(), device.mHats.size(), device.mButtons.size());
+  uint64_t next = reader.GetEnd();
+  uint64_t samples {};
+  uint64_t lost {};
+  auto nextSummary
+    = std::chrono::steady_clock::now() + std::chrono::seconds {1};
+  while (true) {
+    // Check before reading, so nothing written before it closed is missed
+    const auto closed = reader.IsClosed();
+    const auto end = reader.GetEnd();
+    if (end - next > capacity) {
+      lost += end - capacity - next;
+      next = end - capacity;
+    }
+    for (; next < end; ++next) {
+      const auto time = reader.Read(next, state);
+      if (!time) {
+        ++lost;
+        continue;
+      }
+      ++samples;
+      if (csv) {
+        PrintCSVRow(*time, state);
+      } else {
+        std::swap(state, latest);
+      }
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    if (!csv && now >= nextSummary) {
+      PrintSummary(device, samples, lost, latest);
+      samples = 0;
+      lost = 0;
+      nextSummary += std::chrono::seconds {1};
+    }
+    if (closed) {
+      std::cerr << "The tester stopped sampling this device" << std::endl;
+      return EXIT_SUCCESS;
+    }
+    std::this_thread::sleep_for(POLL_INTERVAL);
+  }
+}
+
+}// namespace
+
+int main(int argc, char** argv) {
+  const auto options = ParseOptions(argc, argv);
+  if (!options) {
+    std::cerr << USAGE;
+    return EXIT_FAILURE;
+  }
+
+  const auto units = GetSharedFeeds();
+  if (options->mIndex) {
+    if (*options->mIndex >= units.size()) {
+      std::cerr << "No device with index " << *options->mIndex << std::endl;
+      return EXIT_FAILURE;
+    }
+    return Follow(units[*options->mIndex], options->mCSV);
+  }
+
+  if (units.empty()) {
+    std::cout << "No devices are being sampled" << std::endl;
+    return EXIT_SUCCESS;
+  }
+  for (std::size_t i = 0; i < units.size(); ++i) {
+    const SharedFeedReader reader {units[i]};
+    if (!reader.IsValid()) {
+      continue;
+    }
+    const auto& device = reader.GetDeviceInfo();
+    std::cout << std::setw(3) << i << ": " << device.mName << " ("
+              << reader.GetEnd() << " samples so far, writer process "
+              << reader.GetWriterProcessID() << ")" << std::endl;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,248 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "DeviceState.hpp"
+#include "HidDecodeProgram.hpp"
+
+using namespace FredEmmott::ControllerTester;
+
+namespace {
+
+constexpr std::string_view USAGE {
+  "Usage: freds-controller-tester-hid DESCRIPTOR [REPORTS]\n"
+  "\n"
+  "Compiles a HID report descriptor, and lists the controls that the hidraw\n"
+  "backend would show. With REPORTS, also decodes each input report, as\n"
+  "CSV.\n"
+  "\n"
+  "DESCRIPTOR is either binary, e.g.\n"
+  "/sys/class/hidraw/hidraw0/device/report_descriptor, or a hid-recorder\n"
+  "capture with an 'R:' line. REPORTS is a hid-recorder capture, or one\n"
+  "report per line in hex; it defaults to DESCRIPTOR if that's a capture.\n"};
+
+struct Report {
+  // The capture's timestamp, or the line number
+  std::string mLabel;
+  std::vector<std::byte> mData {};
+};
+
+struct Capture {
+  std::optional<std::vector<std::byte>> mDescriptor;
+  std::vector<Report> mReports;
+};
+
+std::optional<std::string> ReadFile(const std::filesystem::path& path) {
+  std::ifstream file {path, std::ios::binary};
+  if (!file) {
+    return std::nullopt;
+  }
+  return std::string {
+    std::istreambuf_iterator<char> {file}, std::istreambuf_iterator<char> {}};
+}
+
+std::optional<std::vector<std::byte>> ParseHex(std::istream& tokens) {
+  std::vector<std::byte> ret;
+  std::string token;
+  while (tokens >> token) {
+    uint8_t byte {};
+    const auto end = token.data() + token.size();
+    const auto [ptr, ec] = std::from_chars(token.data(), end, byte, 16);
+    if (ec != std::errc {} || ptr != end) {
+      return std::nullopt;
+    }
+    ret.push_back(std::byte {byte});
+  }
+  return ret;
+}
+
+// hid-recorder's 'R: LENGTH BYTES...' and 'E: TIMESTAMP LENGTH BYTES...'
+// lines, or bare hex; other lines are ignored
+std::optional<Capture> ParseCapture(std::string_view text) {
+  Capture ret;
+  std::istringstream lines {std::string {text}};
+  std::string line;
+  for (std::size_t number = 1; std::getline(lines, line); ++number) {
+    std::istringstream tokens {line};
+    std::string first;
+    if (!(tokens >> first) || first.starts_with('#')) {
+      continue;
+    }
+
+    Report report {.mLabel = std::to_string(number)};
+    std::size_t length {};
+    if (first == "R:") {
+      tokens >> length;
+    } else if (first == "E:") {
+      tokens >> report.mLabel >> length;
+    } else if (first.ends_with(':')) {
+      continue;
+    } else {
+      // Bare hex; `first` is the first byte
+      tokens.clear();
+      tokens.seekg(0);
+    }
+
+    auto bytes = ParseHex(tokens);
+    if (!bytes || (length && bytes->size() != length)) {
+      std::cerr << "Invalid hex on line " << number << std::endl;
+      return std::nullopt;
+    }
+    if (first == "R:") {
+      ret.mDescriptor = std::move(*bytes);
+    } else {
+      report.mData = std::move(*bytes);
+      ret.mReports.push_back(std::move(report));
+    }
+  }
+  return ret;
+}
+
+bool IsText(std::string_view data) {
+  return data.starts_with("#") || data.starts_with("R:")
+    || data.starts_with("N:") || data.starts_with("E:");
+}
+
+void PrintControls(const HidDecodeProgram& program, const DeviceInfo& info) {
+  std::cout << "Application usage 0x" << std::hex << std::setfill('0')
+            << std::setw(8) << program.GetApplicationUsage() << std::dec
+            << std::setfill(' ') << "; " << program.GetInstructionCount()
+            << " instructions; reports";
+  for (const auto id: program.GetReportIDs()) {
+    std::cout << ' ' << static_cast<int>(id);
+  }
+  std::cout << ", up to " << program.GetMaxReportSize() << " bytes"
+            << std::endl;
+
+  for (const auto& axis: info.mAxes) {
+    std::cout << "  Axis    " << std::left << std::setw(24) << axis.mName
+              << std::right << axis.mMin << ".." << axis.mMax << std::endl;
+  }
+  for (const auto& hat: info.mHats) {
+    std::cout << "  Hat     " << std::left << std::setw(24) << hat.mName
+              << std::right
+              << (hat.mType == HatType::EightWay      ? "8-way"
+                    : hat.mType == HatType::FourWay ? "4-way"
+                                                    : "other")
+              << std::endl;
+  }
+  for (const auto& button: info.mButtons) {
+    std::cout << "  Button  " << button.mName << std::endl;
+  }
+}
+
+int DecodeReports(
+  const HidDecodeProgram& program,
+  const DeviceInfo& info,
+  const std::vector<Report>& reports) {
+  std::cout << "report";
+  for (const auto& axis: info.mAxes) {
+    std::cout << ',' << axis.mName;
+  }
+  for (const auto& hat: info.mHats) {
+    std::cout << ',' << hat.mName;
+  }
+  for (const auto& button: info.mButtons) {
+    std::cout << ',' << button.mName;
+  }
+  std::cout << '\n';
+
+  DeviceState state;
+  std::size_t failures {};
+  for (const auto& report: reports) {
+    if (!program.Decode(report.mData, state)) {
+      std::cerr << "Report " << report.mLabel
+                << ": unknown report ID, or too short" << std::endl;
+      ++failures;
+      continue;
+    }
+    std::cout << report.mLabel;
+    for (const auto value: state.mAxes) {
+      std::cout << ',' << value;
+    }
+    for (const auto value: state.mHats) {
+      std::cout << ',' << value;
+    }
+    for (std::size_t i = 0; i < info.mButtons.size(); ++i) {
+      std::cout << ',' << state.IsButtonPressed(i);
+    }
+    std::cout << '\n';
+  }
+  std::cout << std::flush;
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+}// namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2 || argc > 3) {
+    std::cerr << USAGE;
+    return EXIT_FAILURE;
+  }
+
+  const std::filesystem::path descriptorPath {argv[1]};
+  const auto descriptorFile = ReadFile(descriptorPath);
+  if (!descriptorFile) {
+    std::cerr << "Couldn't read " << descriptorPath << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::vector<std::byte> descriptor;
+  std::optional<std::vector<Report>> reports;
+  if (IsText(*descriptorFile)) {
+    auto capture = ParseCapture(*descriptorFile);
+    if (!(capture && capture->mDescriptor)) {
+      std::cerr << "No descriptor in " << descriptorPath << std::endl;
+      return EXIT_FAILURE;
+    }
+    descriptor = std::move(*capture->mDescriptor);
+    reports = std::move(capture->mReports);
+  } else {
+    const auto bytes = std::as_bytes(std::span {*descriptorFile});
+    descriptor.assign(bytes.begin(), bytes.end());
+  }
+
+  if (argc == 3) {
+    const std::filesystem::path reportsPath {argv[2]};
+    const auto reportsFile = ReadFile(reportsPath);
+    if (!reportsFile) {
+      std::cerr << "Couldn't read " << reportsPath << std::endl;
+      return EXIT_FAILURE;
+    }
+    auto capture = ParseCapture(*reportsFile);
+    if (!capture) {
+      return EXIT_FAILURE;
+    }
+    reports = std::move(capture->mReports);
+  }
+
+  const HidDecodeProgram program {descriptor};
+  if (!program.IsValid()) {
+    std::cerr << "The descriptor is malformed, or has no controls"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+  DeviceInfo info;
+  program.Describe(info);
+  PrintControls(program, info);
+
+  if (!(reports && !reports->empty())) {
+    return EXIT_SUCCESS;
+  }
+  std::cout << std::endl;
+  return DecodeReports(program, info, *reports);
+}
@@ -0,0 +1,131 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include <charconv>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <string_view>
+
+#include "RealTimeThread.hpp"
+
+using namespace FredEmmott::ControllerTester;
+
+namespace {
+
+constexpr std::string_view USAGE {
+  "Usage: freds-controller-tester-jitter [options]\n"
+  "\n"
+  "Measures how late a sampling thread wakes up on this machine, with and\n"
+  "without each part of the low-jitter sampling mode.\n"
+  "\n"
+  "Options:\n"
+  "  --interval-us US  Time between deadlines; defaults to 1000\n"
+  "  --seconds S       Duration of each configuration; defaults to 5\n"
+  "  --core N          Core to pin to; defaults to the highest-numbered\n"};
+
+struct Options {
+  std::chrono::microseconds mInterval {1000};
+  std::chrono::seconds mDuration {5};
+  std::optional<unsigned int> mCore;
+};
+
+template <class T>
+std::optional<T> ParseNumber(std::string_view text) {
+  T value {};
+  const auto end = text.data() + text.size();
+  const auto [ptr, ec] = std::from_chars(text.data(), end, value);
+  if (ec != std::errc {} || ptr != end) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+std::optional<Options> ParseOptions(int argc, char** argv) {
+  Options ret;
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view name {argv[i]};
+    if (i + 1 >= argc) {
+      std::cerr << "Missing value for " << name << std::endl;
+      return std::nullopt;
+    }
+    const std::string_view value {argv[++i]};
+    const auto number = ParseNumber<unsigned int>(value);
+    if (!number) {
+      std::cerr << "Invalid value for " << name << ": " << value << std::endl;
+      return std::nullopt;
+    }
+
+    if (name == "--interval-us" && *number > 0) {
+      ret.mInterval = std::chrono::microseconds {*number};
+    } else if (name == "--seconds" && *number > 0) {
+      ret.mDuration = std::chrono::seconds {*number};
+    } else if (name == "--core") {
+      ret.mCore = *number;
+    } else {
+      std::cerr << "Unexpected argument: " << name << std::endl;
+      return std::nullopt;
+    }
+  }
+  return ret;
+}
+
+}// namespace
+
+int main(int argc, char** argv) {
+  const auto options = ParseOptions(argc, argv);
+  if (!options) {
+    std::cerr << USAGE;
+    return EXIT_FAILURE;
+  }
+
+  const RealTimeSettings hybrid {
+    .mEnabled = true,
+    .mCore = options->mCore,
+    .mPinToCore = false,
+    .mRealTimePriority = false,
+    .mLockMemory = false,
+  };
+  auto full = hybrid;
+  full.mPinToCore = true;
+  full.mRealTimePriority = true;
+  full.mLockMemory = true;
+  auto spin = full;
+  spin.mSpinBefore = options->mInterval;
+
+  const struct {
+    const char* mName;
+    RealTimeSettings mSettings;
+  } configurations[] {
+    {"sleep", {}},
+    {"hybrid sleep", hybrid},
+    {"hybrid + real-time", full},
+    {"spin + real-time", spin},
+  };
+
+  std::cout << "Lateness in microseconds, for " << options->mInterval.count()
+            << "us deadlines over " << options->mDuration.count() << "s"
+            << std::endl;
+  std::cout << std::left << std::setw(20) << "configuration" << std::right
+            << std::setw(9) << "p50" << std::setw(9) << "p90" << std::setw(9)
+            << "p99" << std::setw(9) << "p99.9" << std::setw(9) << "max"
+            << std::setw(8) << "missed"
+            << "  applied" << std::endl;
+  std::cout << std::fixed << std::setprecision(1);
+  for (const auto& [name, settings]: configurations) {
+    const auto report
+      = MeasureJitter(settings, options->mInterval, options->mDuration);
+    std::cout << std::left << std::setw(20) << name << std::right
+              << std::setw(9) << report.mP50 << std::setw(9) << report.mP90
+              << std::setw(9) << report.mP99 << std::setw(9) << report.mP999
+              << std::setw(9) << report.mMax << std::setw(8) << report.mMissed
+              << "  "
+              << (settings.mEnabled
+                    ? FormatRealTimeStatus(settings, report.mStatus)
+                    : "-")
+              << std::endl;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,539 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include <fcntl.h>
+#include <linux/uinput.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <numbers>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "AnomalyDetector.hpp"
+#include "EvdevDeviceTracker.hpp"
+#include "InputQueue.hpp"
+#include "NoiseAnalysis.hpp"
+#include "Sampler.hpp"
+#include "SharedSampleFeed.hpp"
+#include "UniqueFD.hpp"
+
+using namespace FredEmmott::ControllerTester;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr std::string_view USAGE {
+  "Usage: freds-controller-tester-loopback [options]\n"
+  "\n"
+  "Creates a virtual controller with /dev/uinput, injects timestamped\n"
+  "changes, and reads them back with the evdev backend, through the same\n"
+  "sampling, analysis, and shared feed pipeline as the app. Latencies are\n"
+  "from each change being written to each stage seeing it.\n"
+  "\n"
+  "Exits with status 77 if uinput isn't available.\n"
+  "\n"
+  "Options:\n"
+  "  --axes N          At least 2, at most 8; defaults to 6\n"
+  "  --buttons N       At most 56; defaults to 10\n"
+  "  --hats N          At most 4; defaults to 1\n"
+  "  --rate HZ         Changes per second; defaults to 500\n"
+  "  --seconds S       Defaults to 5\n"
+  "  --interval-us US  Sampling interval; defaults to 250\n"
+  "  --low-jitter      Sample with `RealTimeSettings`\n"
+  "  --epoll           Read with epoll instead of io_uring\n"};
+
+// The conventional status for a skipped test, e.g. CTest's
+// `SKIP_RETURN_CODE`
+constexpr int EXIT_SKIPPED {77};
+
+constexpr std::array<uint16_t, 8> AXIS_CODES {
+  ABS_X,
+  ABS_Y,
+  ABS_Z,
+  ABS_RX,
+  ABS_RY,
+  ABS_RZ,
+  ABS_THROTTLE,
+  ABS_RUDDER,
+};
+constexpr int32_t AXIS_MAX {65535};
+// Axis 0 is a sine wave; axis 1 is the change's sequence number
+constexpr std::size_t WAVE_AXIS {0};
+constexpr std::size_t SEQUENCE_AXIS {1};
+constexpr std::size_t MIN_AXES {2};
+constexpr std::size_t MAX_HATS {4};
+// `BTN_JOYSTICK` and the 15 codes after it, then `BTN_TRIGGER_HAPPY*`
+constexpr std::size_t JOYSTICK_BUTTONS {16};
+constexpr std::size_t MAX_BUTTONS {JOYSTICK_BUTTONS + 40};
+// Changes per cycle of the sine wave
+constexpr std::size_t WAVE_PERIOD {100};
+
+// For udev to create the device node
+constexpr std::chrono::seconds NODE_TIMEOUT {2};
+// For the sampler to start before the first change, and to see the last
+constexpr std::chrono::milliseconds SETTLE_TIME {200};
+constexpr std::size_t FEED_CAPACITY {4096};
+
+// Edges of each histogram bucket, in microseconds; the last bucket is
+// everything slower
+constexpr std::array<float, 10> BUCKET_EDGES {
+  50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000};
+constexpr std::size_t BAR_WIDTH {40};
+
+struct Options {
+  std::size_t mAxes {6};
+  std::size_t mButtons {10};
+  std::size_t mHats {1};
+  unsigned int mRate {500};
+  std::chrono::seconds mDuration {5};
+  std::chrono::microseconds mInterval {250};
+  bool mLowJitter {false};
+  InputQueue::Backend mBackend {InputQueue::Backend::IoUring};
+};
+
+template <class T>
+std::optional<T> ParseNumber(std::string_view text) {
+  T value {};
+  const auto end = text.data() + text.size();
+  const auto [ptr, ec] = std::from_chars(text.data(), end, value);
+  if (ec != std::errc {} || ptr != end) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+std::optional<Options> ParseOptions(int argc, char** argv) {
+  Options ret;
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view name {argv[i]};
+    if (name == "--low-jitter") {
+      ret.mLowJitter = true;
+      continue;
+    }
+    if (name == "--epoll") {
+      ret.mBackend = InputQueue::Backend::Epoll;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      std::cerr << "Missing value for " << name << std::endl;
+      return std::nullopt;
+    }
+    const std::string_view value {argv[++i]};
+    const auto number = ParseNumber<unsigned int>(value);
+    if (!number) {
+      std::cerr << "Invalid value for " << name << ": " << value << std::endl;
+      return std::nullopt;
+    }
+
+    if (
+      name == "--axes" && *number >= MIN_AXES
+      && *number <= AXIS_CODES.size()) {
+      ret.mAxes = *number;
+    } else if (name == "--buttons" && *number <= MAX_BUTTONS) {
+      ret.mButtons = *number;
+    } else if (name == "--hats" && *number <= MAX_HATS) {
+      ret.mHats = *number;
+    } else if (name == "--rate" && *number > 0) {
+      ret.mRate = *number;
+    } else if (name == "--seconds" && *number > 0) {
+      ret.mDuration = std::chrono::seconds {*number};
+    } else if (name == "--interval-us" && *number > 0) {
+      ret.mInterval = std::chrono::microseconds {*number};
+    } else {
+      std::cerr << "Unexpected argument: " << name << " " << value
+                << std::endl;
+      return std::nullopt;
+    }
+  }
+  return ret;
+}
+
+uint16_t GetButtonCode(std::size_t index) {
+  if (index < JOYSTICK_BUTTONS) {
+    return static_cast<uint16_t>(BTN_JOYSTICK + index);
+  }
+  return static_cast<uint16_t>(
+    BTN_TRIGGER_HAPPY + (index - JOYSTICK_BUTTONS));
+}
+
+/* A uinput device with the requested controls.
+ *
+ * Each change moves the sine wave on axis 0, sets axis 1 to the change's
+ * sequence number, toggles a button, and turns the first hat; the sequence
+ * number matches observed states to changes.
+ *
+ * Failures leave it invalid, with an explanation in `GetError()`.
+ */
+class VirtualController final {
+ public:
+  VirtualController(const Options& options, const std::string& name)
+    : mOptions(options),
+      mFD(open("/dev/uinput", O_WRONLY | O_NONBLOCK | O_CLOEXEC)) {
+    if (!mFD) {
+      mError = std::string {"can't open /dev/uinput: "} + strerror(errno);
+      return;
+    }
+    const auto fd = mFD.Get();
+
+    ioctl(fd, UI_SET_EVBIT, EV_ABS);
+    const auto setupAxis = [fd](uint16_t code, int32_t min, int32_t max) {
+      ioctl(fd, UI_SET_ABSBIT, code);
+      uinput_abs_setup setup {};
+      setup.code = code;
+      setup.absinfo.minimum = min;
+      setup.absinfo.maximum = max;
+      return ioctl(fd, UI_ABS_SETUP, &setup) == 0;
+    };
+    bool ok = true;
+    for (std::size_t i = 0; i < options.mAxes; ++i) {
+      ok &= setupAxis(AXIS_CODES[i], 0, AXIS_MAX);
+    }
+    for (std::size_t i = 0; i < options.mHats; ++i) {
+      const auto x = static_cast<uint16_t>(ABS_HAT0X + (i * 2));
+      ok &= setupAxis(x, -1, 1);
+      ok &= setupAxis(x + 1, -1, 1);
+    }
+    if (options.mButtons) {
+      ioctl(fd, UI_SET_EVBIT, EV_KEY);
+      for (std::size_t i = 0; i < options.mButtons; ++i) {
+        ioctl(fd, UI_SET_KEYBIT, GetButtonCode(i));
+      }
+    }
+
+    uinput_setup setup {};
+    setup.id.bustype = BUS_VIRTUAL;
+    // pid.codes' test VID/PID
+    setup.id.vendor = 0x1209;
+    setup.id.product = 0x0001;
+    std::strncpy(setup.name, name.c_str(), UINPUT_MAX_NAME_SIZE - 1);
+    if (
+      !ok || ioctl(fd, UI_DEV_SETUP, &setup) < 0
+      || ioctl(fd, UI_DEV_CREATE) < 0) {
+      mError = std::string {"can't create a uinput device: "}
+        + strerror(errno);
+      mFD.Reset();
+    }
+  }
+
+  ~VirtualController() {
+    if (mFD) {
+      ioctl(mFD.Get(), UI_DEV_DESTROY);
+    }
+  }
+
+  VirtualController() = delete;
+  VirtualController(const VirtualController&) = delete;
+  VirtualController(VirtualController&&) = delete;
+  VirtualController& operator=(const VirtualController&) = delete;
+  VirtualController& operator=(VirtualController&&) = delete;
+
+  bool IsValid() const {
+    return static_cast<bool>(mFD);
+  }
+
+  const std::string& GetError() const {
+    return mError;
+  }
+
+  // The `/dev/input/event*` node's name; udev may not have created it yet
+  std::optional<std::filesystem::path> GetEventNode() const {
+    std::array<char, 64> sysName {};
+    if (ioctl(mFD.Get(), UI_GET_SYSNAME(sysName.size()), sysName.data()) < 0) {
+      return std::nullopt;
+    }
+    std::error_code ec;
+    for (const auto& entry: std::filesystem::directory_iterator {
+           std::filesystem::path {"/sys/devices/virtual/input"}
+             / sysName.data(),
+           ec}) {
+      const auto name = entry.path().filename();
+      if (name.string().starts_with("event")) {
+        return std::filesystem::path {"/dev/input"} / name;
+      }
+    }
+    return std::nullopt;
+  }
+
+  // Writes every event for the change, then a `SYN_REPORT`
+  bool Inject(uint64_t sequence) {
+    std::array<input_event, 8> events {};
+    std::size_t count {};
+    // Assigned rather than designated-initialized, as the timestamp fields
+    // differ between architectures; the kernel sets the time anyway
+    const auto push = [&](uint16_t type, uint16_t code, int32_t value) {
+      auto& event = events[count++];
+      event.type = type;
+      event.code = code;
+      event.value = value;
+    };
+
+    const auto phase = (2 * std::numbers::pi * (sequence % WAVE_PERIOD))
+      / WAVE_PERIOD;
+    push(
+      EV_ABS,
+      AXIS_CODES[WAVE_AXIS],
+      static_cast<int32_t>(std::lround((std::sin(phase) + 1) * AXIS_MAX / 2)));
+    push(
+      EV_ABS,
+      AXIS_CODES[SEQUENCE_AXIS],
+      static_cast<int32_t>(sequence % (AXIS_MAX + 1)));
+    if (mOptions.mButtons) {
+      // Presses each button in turn, then releases each in turn
+      const auto button = sequence % mOptions.mButtons;
+      const auto pressed = (sequence / mOptions.mButtons) % 2 == 0;
+      push(EV_KEY, GetButtonCode(button), pressed);
+    }
+    if (mOptions.mHats) {
+      // Clockwise from north, including the diagonals
+      constexpr std::array<std::array<int32_t, 2>, 8> directions {{
+        {0, -1},
+        {1, -1},
+        {1, 0},
+        {1, 1},
+        {0, 1},
+        {-1, 1},
+        {-1, 0},
+        {-1, -1},
+      }};
+      const auto& [x, y] = directions[sequence % directions.size()];
+      push(EV_ABS, ABS_HAT0X, x);
+      push(EV_ABS, ABS_HAT0Y, y);
+    }
+    push(EV_SYN, SYN_REPORT, 0);
+
+    const auto bytes = count * sizeof(input_event);
+    return write(mFD.Get(), events.data(), bytes)
+      == static_cast<ssize_t>(bytes);
+  }
+
+ private:
+  const Options mOptions;
+  UniqueFD mFD;
+  std::string mError;
+};
+
+// Waits for the evdev backend to list the device
+std::optional<EvdevDeviceInfo> OpenWithBackend(
+  EvdevDeviceTracker& tracker,
+  const VirtualController& controller) {
+  const auto timeout = Clock::now() + NODE_TIMEOUT;
+  while (Clock::now() < timeout) {
+    if (const auto node = controller.GetEventNode()) {
+      tracker.MarkStale();
+      for (const auto device: tracker.GetAllDevices()) {
+        if (device->mPath == *node) {
+          return tracker.OpenAnother(*device);
+        }
+      }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds {10});
+  }
+  return std::nullopt;
+}
+
+// Latencies for changes that were observed, in microseconds
+struct Observations {
+  explicit Observations(std::size_t capacity) {
+    mAcquired.reserve(capacity);
+    mAnalyzed.reserve(capacity);
+    mPublished.reserve(capacity);
+  }
+
+  std::vector<float> mAcquired;
+  std::vector<float> mAnalyzed;
+  std::vector<float> mPublished;
+  // Changes that were replaced by a later one before they were sampled
+  uint64_t mCoalesced {};
+  uint64_t mFailures {};
+};
+
+float Percentile(const std::vector<float>& sorted, float percentile) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  const auto index = static_cast<std::size_t>(
+    (percentile / 100) * static_cast<float>(sorted.size() - 1));
+  return sorted[index];
+}
+
+void PrintHistogram(std::string_view title, std::vector<float> micros) {
+  std::ranges::sort(micros);
+  std::cout << std::endl
+            << title << " (us): p50 " << Percentile(micros, 50) << ", p90 "
+            << Percentile(micros, 90) << ", p99 " << Percentile(micros, 99)
+            << ", max " << (micros.empty() ? 0 : micros.back()) << std::endl;
+
+  std::array<std::size_t, BUCKET_EDGES.size() + 1> counts {};
+  for (const auto value: micros) {
+    const auto it = std::ranges::lower_bound(BUCKET_EDGES, value);
+    ++counts[it - BUCKET_EDGES.begin()];
+  }
+  const auto most = std::max<std::size_t>(1, std::ranges::max(counts));
+  for (std::size_t i = 0; i < counts.size(); ++i) {
+    if (i < BUCKET_EDGES.size()) {
+      std::cout << "  <= " << std::setw(6) << BUCKET_EDGES[i];
+    } else {
+      std::cout << "   > " << std::setw(6) << BUCKET_EDGES.back();
+    }
+    std::cout << std::setw(8) << counts[i] << " "
+              << std::string((counts[i] * BAR_WIDTH) / most, '#')
+              << std::endl;
+  }
+}
+
+}// namespace
+
+int main(int argc, char** argv) {
+  const auto options = ParseOptions(argc, argv);
+  if (!options) {
+    std::cerr << USAGE;
+    return EXIT_FAILURE;
+  }
+
+  VirtualController controller {
+    *options,
+    "Fred's Controller Tester loopback " + std::to_string(getpid())};
+  if (!controller.IsValid()) {
+    std::cout << "Skipped: " << controller.GetError() << std::endl;
+    return EXIT_SKIPPED;
+  }
+
+  EvdevDeviceTracker tracker {options->mBackend};
+  auto device = OpenWithBackend(tracker, controller);
+  if (!device) {
+    std::cout << "Skipped: the uinput device didn't appear in /dev/input"
+              << std::endl;
+    return EXIT_SKIPPED;
+  }
+  if (
+    device->mAxes.size() != options->mAxes
+    || device->mButtons.size() != options->mButtons
+    || device->mHats.size() != options->mHats) {
+    std::cerr << "The evdev backend found " << device->mAxes.size()
+              << " axes, " << device->mButtons.size() << " buttons, and "
+              << device->mHats.size() << " hats; expected "
+              << options->mAxes << ", " << options->mButtons << ", and "
+              << options->mHats << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const auto period = std::chrono::duration_cast<Clock::duration>(
+    std::chrono::seconds {1}) / options->mRate;
+  const auto count = static_cast<uint64_t>(options->mDuration / period);
+  // Indexed by sequence number; 0 is the initial state, so the first
+  // change is 1
+  const auto injected = std::make_unique<std::atomic<int64_t>[]>(count + 1);
+  Observations observations {count};
+
+  AnomalyDetector anomalies {*device, {}};
+  NoiseAnalyzer noise {*device, {}};
+  SharedFeedWriter feed {*device, FEED_CAPACITY};
+  RealTimeSettings realTime;
+  realTime.mEnabled = options->mLowJitter;
+
+  std::optional<Sampler> sampler;
+  sampler.emplace(
+    std::move(*device),
+    options->mInterval,
+    [&, lastSequence = uint64_t {}](
+      Clock::time_point time,
+      const std::optional<DeviceState>& state) mutable {
+      if (!state) {
+        ++observations.mFailures;
+        anomalies.PushReadFailure(time);
+        return;
+      }
+      anomalies.Push(time, *state);
+      noise.Push(time, *state);
+      const auto analyzed = Clock::now();
+      if (feed.IsValid()) {
+        feed.Push(time, *state);
+      }
+      const auto published = Clock::now();
+
+      // The axis wraps, but changes are in order
+      const auto value = static_cast<uint64_t>(state->mAxes[SEQUENCE_AXIS]);
+      const auto sequence = lastSequence
+        + ((value - lastSequence) % (AXIS_MAX + 1));
+      if (sequence == lastSequence || sequence > count) {
+        return;
+      }
+      const auto injectedAt
+        = injected[sequence].load(std::memory_order_acquire);
+      if (!injectedAt) {
+        return;
+      }
+      observations.mCoalesced += sequence - lastSequence - 1;
+      lastSequence = sequence;
+
+      const Clock::time_point start {Clock::duration {injectedAt}};
+      const auto micros = [start](Clock::time_point end) {
+        return std::chrono::duration<float, std::micro>(end - start).count();
+      };
+      observations.mAcquired.push_back(micros(time));
+      observations.mAnalyzed.push_back(micros(analyzed));
+      observations.mPublished.push_back(micros(published));
+    },
+    realTime);
+
+  std::this_thread::sleep_for(SETTLE_TIME);
+  const auto start = Clock::now();
+  uint64_t failedWrites {};
+  for (uint64_t sequence = 1; sequence <= count; ++sequence) {
+    std::this_thread::sleep_until(start + (period * sequence));
+    injected[sequence].store(
+      Clock::now().time_since_epoch().count(), std::memory_order_release);
+    if (!controller.Inject(sequence)) {
+      ++failedWrites;
+    }
+  }
+  const auto injectSeconds
+    = std::chrono::duration<double>(Clock::now() - start).count();
+  std::this_thread::sleep_for(SETTLE_TIME);
+  const auto samples = sampler->GetSampleCount();
+  const auto overruns = sampler->GetOverrunCount();
+  sampler.reset();
+
+  const auto observed = observations.mAcquired.size();
+  const auto neverSeen = count
+    - std::min<uint64_t>(count, observed + observations.mCoalesced);
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << "Injected " << count << " changes in " << injectSeconds
+            << "s (" << (count / injectSeconds) << "/s); observed "
+            << observed << " (" << (observed / injectSeconds) << "/s), "
+            << observations.mCoalesced << " coalesced, "
+            << neverSeen << " never seen" << std::endl;
+  std::cout << "Sampled every " << options->mInterval.count() << "us: "
+            << samples << " samples, " << overruns << " overruns, "
+            << observations.mFailures << " read failures, " << failedWrites
+            << " failed writes" << std::endl;
+  if (!feed.IsValid()) {
+    std::cout << "The shared feed couldn't be created, so publishing was "
+                 "skipped"
+              << std::endl;
+  }
+
+  PrintHistogram("Acquired", std::move(observations.mAcquired));
+  PrintHistogram("Analyzed", std::move(observations.mAnalyzed));
+  PrintHistogram("Published", std::move(observations.mPublished));
+
+  return observed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,267 @@
+// Copyright 2023 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: ISC
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "ResultsDatabase.hpp"
+
+using namespace FredEmmott::ControllerTester;
+
+namespace {
+
+constexpr std::string_view USAGE {
+  "Usage: freds-controller-tester-results DATABASE [options]\n"
+  "\n"
+  "Options:\n"
+  "  --product GUID     Only include results for this product\n"
+  "  --unit GUID        Only include results for this unit\n"
+  "  --last N           Only include the N most recent results\n"
+  "  --axis AXIS        Summarize an axis; AXIS is x, y, z, rx, ry, rz,\n"
+  "                     slider, or a zero-based index\n"
+  "  --field FIELD      min-seen or max-seen; defaults to max-seen\n"};
+
+// DirectInput's `GUID_*Axis` values
+constexpr std::array<std::pair<std::string_view, Guid>, 7> AXIS_TYPES {{
+  {"x", {0xa36d02e0, 0xc9f3, 0x11cf, {0xbf, 0xc7, 0x44, 0x45, 0x53, 0x54}}},
+  {"y", {0xa36d02e1, 0xc9f3, 0x11cf, {0xbf, 0xc7, 0x44, 0x45, 0x53, 0x54}}},
+  {"z", {0xa36d02e2, 0xc9f3, 0x11cf, {0xbf, 0xc7, 0x44, 0x45, 0x53, 0x54}}},
+  {"rx", {0xa36d02f4, 0xc9f3, 0x11cf, {0xbf, 0xc7, 0x44, 0x45, 0x53, 0x54}}},
+  {"ry", {0xa36d02f5, 0xc9f3, 0x11cf, {0xbf, 0xc7, 0x44, 0x45, 0x53, 0x54}}},
+  {"rz", {0xa36d02e3, 0xc9f3, 0x11cf, {0xbf, 0xc7, 0x44, 0x45, 0x53, 0x54}}},
+  {"slider",
+   {0xa36d02e4, 0xc9f3, 0x11cf, {0xbf, 0xc7, 0x44, 0x45, 0x53, 0x54}}},
+}};
+
+template <class T>
+std::optional<T> ParseHex(std::string_view text) {
+  T value {};
+  const auto end = text.data() + text.size();
+  const auto [ptr, ec] = std::from_chars(text.data(), end, value, 16);
+  if (ec != std::errc {} || ptr != end) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+// {XXXXXXXX-XXXX-XXXX-XXXX-XXXXXXXXXXXX}, with or without the braces
+std::optional<Guid> ParseGuid(std::string_view text) {
+  if (text.starts_with('{') && text.ends_with('}')) {
+    text = text.substr(1, text.size() - 2);
+  }
+  if (
+    text.size() != 36 || text[8] != '-' || text[13] != '-' || text[18] != '-'
+    || text[23] != '-') {
+    return std::nullopt;
+  }
+
+  const auto data1 = ParseHex<uint32_t>(text.substr(0, 8));
+  const auto data2 = ParseHex<uint16_t>(text.substr(9, 4));
+  const auto data3 = ParseHex<uint16_t>(text.substr(14, 4));
+  if (!(data1 && data2 && data3)) {
+    return std::nullopt;
+  }
+  std::array<uint8_t, 8> data4 {};
+  for (std::size_t i = 0; i < data4.size(); ++i) {
+    const auto offset = (i < 2) ? (19 + (i * 2)) : (24 + ((i - 2) * 2));
+    const auto byte = ParseHex<uint8_t>(text.substr(offset, 2));
+    if (!byte) {
+      return std::nullopt;
+    }
+    data4[i] = *byte;
+  }
+  return Guid {*data1, *data2, *data3, data4};
+}
+
+struct Options {
+  std::string mDatabase;
+  ResultsDatabase::Query mQuery {};
+  std::optional<Guid> mAxisType {};
+  std::optional<std::size_t> mAxisIndex {};
+  bool mMinSeen {false};
+};
+
+std::optional<Options> ParseOptions(int argc, char** argv) {
+  if (argc < 2) {
+    return std::nullopt;
+  }
+  Options ret {.mDatabase = argv[1]};
+  for (int i = 2; i < argc; i += 2) {
+    const std::string_view name {argv[i]};
+    if (i + 1 >= argc) {
+      std::cerr << "Missing value for " << name << std::endl;
+      return std::nullopt;
+    }
+    const std::string_view value {argv[i + 1]};
+
+    if (name == "--product" || name == "--unit") {
+      const auto guid = ParseGuid(value);
+      if (!guid) {
+        std::cerr << "Invalid GUID: " << value << std::endl;
+        return std::nullopt;
+      }
+      (name == "--product" ? ret.mQuery.mProduct : ret.mQuery.mUnit) = guid;
+      continue;
+    }
+
+    if (name == "--last") {
+      std::size_t count {};
+      const auto end = value.data() + value.size();
+      const auto [ptr, ec] = std::from_chars(value.data(), end, count);
+      if (ec != std::errc {} || ptr != end) {
+        std::cerr << "Invalid count: " << value << std::endl;
+        return std::nullopt;
+      }
+      ret.mQuery.mMaxResults = count;
+      continue;
+    }
+
+    if (name == "--axis") {
+      const auto it = std::ranges::find(
+        AXIS_TYPES, value, [](const auto& pair) { return pair.first; });
+      if (it != AXIS_TYPES.end()) {
+        ret.mAxisType = it->second;
+        continue;
+      }
+      std::size_t index {};
+      const auto end = value.data() + value.size();
+      const auto [ptr, ec] = std::from_chars(value.data(), end, index);
+      if (ec != std::errc {} || ptr != end) {
+        std::cerr << "Invalid axis: " << value << std::endl;
+        return std::nullopt;
+      }
+      ret.mAxisIndex = index;
+      continue;
+    }
+
+    if (name == "--field") {
+      if (value != "min-seen" && value != "max-seen") {
+        std::cerr << "Invalid field: " << value << std::endl;
+        return std::nullopt;
+      }
+      ret.mMinSeen = (value == "min-seen");
+      continue;
+    }
+
+    std::cerr << "Unknown option: " << name << std::endl;
+    return std::nullopt;
+  }
+  return ret;
+}
+
+template <class T>
+T GetPercentile(const std::vector<T>& sorted, double percentile) {
+  const auto index = static_cast<std::size_t>(
+    percentile * static_cast<double>(sorted.size() - 1));
+  return sorted[index];
+}
+
+void PrintAxisSummary(
+  const Options& options,
+  const std::vector<ResultsDatabase::ResultView>& results) {
+  std::vector<int32_t> values;
+  values.reserve(results.size());
+  for (const auto& result: results) {
+    const ResultsDatabase::AxisResult* axis {nullptr};
+    if (options.mAxisType) {
+      axis = result.FindAxis(*options.mAxisType);
+    } else if (*options.mAxisIndex < result.mAxes.size()) {
+      axis = &result.mAxes[*options.mAxisIndex];
+    }
+    if (axis) {
+      values.push_back(options.mMinSeen ? axis->mMinSeen : axis->mMaxSeen);
+    }
+  }
+
+  std::cout << (options.mMinSeen ? "Minimum" : "Maximum")
+            << " seen value: " << values.size() << " results with this axis"
+            << std::endl;
+  if (values.empty()) {
+    return;
+  }
+  std::ranges::sort(values);
+  std::cout << "  min " << values.front() << ", p1 "
+            << GetPercentile(values, 0.01) << ", p50 "
+            << GetPercentile(values, 0.5) << ", p99 "
+            << GetPercentile(values, 0.99) << ", max " << values.back()
+            << std::endl;
+
+  constexpr std::size_t bucketCount {10};
+  const int64_t low = values.front();
+  const int64_t width
+    = std::max<int64_t>(1, ((values.back() - low) / bucketCount) + 1);
+  std::array<std::size_t, bucketCount> buckets {};
+  for (const auto value: values) {
+    ++buckets[static_cast<std::size_t>((value - low) / width)];
+  }
+  for (std::size_t i = 0; i < bucketCount; ++i) {
+    const auto first = low + (static_cast<int64_t>(i) * width);
+    std::cout << "  [" << std::setw(11) << first << ", " << std::setw(11)
+              << (first + width) << ") " << buckets[i] << std::endl;
+  }
+}
+
+}// namespace
+
+int main(int argc, char** argv) {
+  const auto options = ParseOptions(argc, argv);
+  if (!options) {
+    std::cerr << USAGE;
+    return EXIT_FAILURE;
+  }
+
+  if (!std::filesystem::exists(options->mDatabase)) {
+    std::cerr << "Database not found: " << options->mDatabase << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // The app may be appending to it
+  ResultsDatabase db {options->mDatabase, ResultsDatabase::Mode::ReadOnly};
+  const auto start = std::chrono::steady_clock::now();
+  const auto results = db.Find(options->mQuery);
+
+  const auto passed = std::ranges::count_if(
+    results, [](const auto& result) { return result.mPassed; });
+  std::cout << "Results: " << results.size() << " (" << passed << " passed)"
+            << std::endl;
+  if (db.GetCorruptResultCount()) {
+    std::cout << "Skipped " << db.GetCorruptResultCount()
+              << " damaged results" << std::endl;
+  }
+  if (db.GetDamagedTailSize()) {
+    std::cout << "Ignored " << db.GetDamagedTailSize()
+              << " bytes after the last complete result" << std::endl;
+  }
+
+  if (!results.empty()) {
+    std::vector<float> poll;
+    poll.reserve(results.size());
+    for (const auto& result: results) {
+      poll.push_back(result.mPoll.mP99);
+    }
+    std::ranges::sort(poll);
+    std::cout << "Poll p99 (ms) across units: p50 " << GetPercentile(poll, 0.5)
+              << ", max " << poll.back() << std::endl;
+  }
+
+  if (options->mAxisType || options->mAxisIndex) {
+    PrintAxisSummary(*options, results);
+  }
+
+  const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now() - start);
+  std::cout << "Query took " << (elapsed.count() / 1000.0) << "ms"
+            << std::endl;
+  return EXIT_SUCCESS;
+}